@@ -0,0 +1,484 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "common/inc/Clock.h"
+#include "task/Resumable.h"
+#include "task/FramePool.h"
+#include "processor/Processor.h"
+#include "scheduler/Scheduler.h"
+#include "co/sync/channel.h"
+#include "co/sync/co_latch.h"
+#include "co/sync/co_wait_group.h"
+#include "co/sync/join_handle.h"
+#include "co/sync/task_group.h"
+
+// C++20无栈协程, 需要编译器支持协程(-std=c++20), 否则本文件为空
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+
+namespace co
+{
+
+template <typename R = void>
+class Async;
+
+// promise的公共部分, 同时是P调度的节点
+// 协程帧从FramePool分配; 挂起期间只占协程帧本身, 没有栈和Task对象.
+class AsyncPromiseBase : public Resumable
+{
+public:
+    AsyncPromiseBase() { resume_ = &AsyncPromiseBase::StaticResume; }
+
+    static void* operator new(std::size_t size) { return FrameAlloc(size); }
+    static void operator delete(void* ptr, std::size_t size) { FrameFree(ptr, size); }
+
+    // 创建后不立即执行, 由co_await或spawn/detach启动
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            AsyncPromiseBase & p = h.promise();
+            if (p.continuation_)
+                return p.continuation_;
+
+            // spawn/detach启动的根协程: 发布结果并释放协程帧
+            p.complete_(&p);
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() { eptr_ = std::current_exception(); }
+
+    ALWAYS_INLINE std::coroutine_handle<> handle() const
+    {
+        return std::coroutine_handle<>::from_address(frame_);
+    }
+
+    void* frame_ = nullptr;
+    std::coroutine_handle<> continuation_;      // co_await本协程的协程, 结束时切回它
+    void (*complete_)(AsyncPromiseBase*) = nullptr;
+    void* completeArg_ = nullptr;
+    std::exception_ptr eptr_;
+
+private:
+    static void StaticResume(Resumable* r)
+    {
+        static_cast<AsyncPromiseBase*>(r)->handle().resume();
+    }
+};
+
+template <typename R>
+class AsyncPromise : public AsyncPromiseBase
+{
+public:
+    ~AsyncPromise()
+    {
+        if (hasValue_)
+            value().~R();
+    }
+
+    Async<R> get_return_object();
+
+    template <typename U>
+    void return_value(U && v)
+    {
+        new (&storage_) R(std::forward<U>(v));
+        hasValue_ = true;
+    }
+
+    R Result()
+    {
+        if (eptr_)
+            std::rethrow_exception(eptr_);
+        return std::move(value());
+    }
+
+private:
+    R& value() { return *reinterpret_cast<R*>(&storage_); }
+
+    typename std::aligned_storage<sizeof(R), alignof(R)>::type storage_;
+    bool hasValue_ = false;
+};
+
+template <>
+class AsyncPromise<void> : public AsyncPromiseBase
+{
+public:
+    Async<void> get_return_object();
+
+    void return_void() {}
+
+    void Result()
+    {
+        if (eptr_)
+            std::rethrow_exception(eptr_);
+    }
+};
+
+// 挂起当前无栈协程时取得它的调度节点, 记下所在的P, 唤醒时回到这里
+template <typename P>
+ALWAYS_INLINE Resumable* AsyncSuspendNode(std::coroutine_handle<P> h)
+{
+    static_assert(std::is_base_of<AsyncPromiseBase, P>::value,
+            "co awaitables can only be awaited in co::Async coroutines");
+    Resumable* r = &h.promise();
+    r->proc_ = Processor::GetCurrentProcessor();
+    return r;
+}
+
+/// 无栈协程
+// 返回类型为co::Async<R>的函数是一个C++20协程, 在co_await处挂起时不占用任何栈,
+// 与普通协程(Task)由同一组P调度: 被唤醒后P在调度循环中直接恢复它, 没有上下文切换.
+//   co::Async<int> f() { int v; co_await co::async_pop(ch, v); co_return v + 1; }
+// 创建后不执行, 启动方式:
+//   co_await f()         在另一个无栈协程中执行, 结束后继续(不经过调度队列)
+//   co::spawn(f())       交给调度器执行, 返回JoinHandle; 普通协程/原生线程用get()等待结果
+//   co::detach(f())      交给调度器执行, 不关心结果; 未捕获的异常终止进程(同go)
+// 无栈协程中只能用co_await等待(async_*, JoinHandle, Async),
+// 不能调用会挂起普通协程的接口(channel的<<, co_sleep, co_mutex, hook的io等), 它们会阻塞整个P.
+// co_yield已被定义为让出普通协程的宏, 无栈协程中用co_await co::async_yield().
+template <typename R>
+class Async
+{
+public:
+    typedef AsyncPromise<R> promise_type;
+    typedef std::coroutine_handle<promise_type> handle_t;
+
+    Async() = default;
+    explicit Async(handle_t h) : h_(h) {}
+
+    Async(Async && other) noexcept : h_(other.h_) { other.h_ = nullptr; }
+
+    Async& operator=(Async && other) noexcept
+    {
+        if (this != &other) {
+            if (h_) h_.destroy();
+            h_ = other.h_;
+            other.h_ = nullptr;
+        }
+        return *this;
+    }
+
+    ~Async()
+    {
+        if (h_)
+            h_.destroy();
+    }
+
+    ALWAYS_INLINE bool valid() const { return !!h_; }
+
+    // 交出协程帧的所有权
+    handle_t release()
+    {
+        handle_t h = h_;
+        h_ = nullptr;
+        return h;
+    }
+
+    struct Awaiter
+    {
+        handle_t h_;
+
+        bool await_ready() noexcept { return false; }
+
+        // 对称转移: 直接切入子协程, 结束时由FinalAwaiter切回
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> parent) noexcept
+        {
+            h_.promise().continuation_ = parent;
+            return h_;
+        }
+
+        R await_resume() { return h_.promise().Result(); }
+    };
+
+    // 一个Async只能co_await一次
+    Awaiter operator co_await() const & noexcept { return Awaiter{h_}; }
+    Awaiter operator co_await() const && noexcept { return Awaiter{h_}; }
+
+private:
+    Async(Async const&) = delete;
+    Async& operator=(Async const&) = delete;
+
+    handle_t h_;
+};
+
+template <typename R>
+Async<R> AsyncPromise<R>::get_return_object()
+{
+    auto h = std::coroutine_handle<AsyncPromise<R>>::from_promise(*this);
+    frame_ = h.address();
+    return Async<R>(h);
+}
+
+inline Async<void> AsyncPromise<void>::get_return_object()
+{
+    auto h = std::coroutine_handle<AsyncPromise<void>>::from_promise(*this);
+    frame_ = h.address();
+    return Async<void>(h);
+}
+
+// spawn的根协程结束时把结果写进JoinState
+template <typename R>
+class AsyncJoinState : public JoinState<R>
+{
+public:
+    static void Complete(AsyncPromiseBase* base)
+    {
+        AsyncPromise<R> & p = static_cast<AsyncPromise<R>&>(*base);
+        AsyncJoinState* state = static_cast<AsyncJoinState*>(p.completeArg_);
+        auto result = [&]{ return p.Result(); };
+        try {
+            state->Invoke(result);
+        } catch (...) {
+            state->eptr_ = std::current_exception();
+        }
+        p.handle().destroy();
+        state->SetReady();
+        state->DecrementRef();
+    }
+};
+
+// 交给调度器执行无栈协程, 返回等待其结果的JoinHandle
+// 普通协程中get()挂起, 原生线程中阻塞, 无栈协程中co_await.
+template <typename R>
+JoinHandle<R> spawn(Async<R> task)
+{
+    auto h = task.release();
+    // 初始引用归协程帧所有
+    AsyncJoinState<R>* state = new AsyncJoinState<R>;
+    JoinHandle<R> handle(state);
+
+    AsyncPromiseBase & p = h.promise();
+    p.complete_ = &AsyncJoinState<R>::Complete;
+    p.completeArg_ = state;
+    Processor::PostResumable(&p);
+    return handle;
+}
+
+template <typename R>
+void AsyncCompleteDetached(AsyncPromiseBase* base)
+{
+    std::exception_ptr eptr = base->eptr_;
+    base->handle().destroy();
+    if (eptr)
+        std::rethrow_exception(eptr);
+}
+
+// 交给调度器执行, 不等待结果
+template <typename R>
+void detach(Async<R> task)
+{
+    auto h = task.release();
+    AsyncPromiseBase & p = h.promise();
+    p.complete_ = &AsyncCompleteDetached<R>;
+    Processor::PostResumable(&p);
+}
+
+/// ---------------- awaitables ----------------
+
+// 让出P, 排到本P无栈协程队列的末尾
+struct AsyncYield
+{
+    bool await_ready() noexcept { return false; }
+
+    template <typename P>
+    void await_suspend(std::coroutine_handle<P> h)
+    {
+        Processor::PostResumable(AsyncSuspendNode(h));
+    }
+
+    void await_resume() noexcept {}
+};
+
+inline AsyncYield async_yield() { return AsyncYield{}; }
+
+// 定时器: 到期后回到挂起前所在的P
+struct AsyncSleep
+{
+    FastSteadyClock::time_point deadline_;
+
+    bool await_ready() { return deadline_ <= FastSteadyClock::now(); }
+
+    template <typename P>
+    void await_suspend(std::coroutine_handle<P> h)
+    {
+        Resumable* r = AsyncSuspendNode(h);
+        Scheduler* scheduler = Processor::GetCurrentScheduler();
+        if (!scheduler) scheduler = &Scheduler::getInstance();
+        scheduler->GetTimer().StartTimer(deadline_, [r]{ Processor::PostResumable(r); });
+    }
+
+    void await_resume() noexcept {}
+};
+
+inline AsyncSleep async_sleep_until(FastSteadyClock::time_point deadline)
+{
+    return AsyncSleep{deadline};
+}
+
+template <typename Rep, typename Period>
+AsyncSleep async_sleep(std::chrono::duration<Rep, Period> dur)
+{
+    return AsyncSleep{FastSteadyClock::now() +
+        std::chrono::duration_cast<FastSteadyClock::duration>(dur)};
+}
+
+// channel读写: 结果同阻塞读写, channel关闭时为false
+// 登记为等待者之后协程随时可能在其他P上恢复, await_suspend登记后不能再访问awaiter.
+template <typename T>
+struct ChannelAwaiter
+{
+    std::shared_ptr<ChannelImpl<T>> impl_;
+    T* slot_;
+    bool push_;
+    ChannelAsync status_ = ChannelAsync::queued;
+
+    bool await_ready() noexcept { return false; }
+
+    template <typename P>
+    bool await_suspend(std::coroutine_handle<P> h)
+    {
+        Resumable* r = AsyncSuspendNode(h);
+        ChannelAsync status = push_ ? impl_->PushAsync(slot_, r) : impl_->PopAsync(slot_, r);
+        if (status == ChannelAsync::queued)
+            return true;
+
+        if (status != ChannelAsync::unsupported) {
+            status_ = status;
+            return false;
+        }
+
+        // 该实现不支持无栈协程等待: 由一个共享栈协程代为阻塞读写, 完成后恢复
+        TaskOpt opt;
+        opt.shared_stack_ = true;
+        Scheduler* scheduler = Processor::GetCurrentScheduler();
+        if (!scheduler) scheduler = &Scheduler::getInstance();
+        scheduler->CreateTask([this, r]{
+                    bool ok = push_ ? impl_->Push(*slot_, true) : impl_->Pop(*slot_, true);
+                    status_ = ok ? ChannelAsync::done : ChannelAsync::closed;
+                    Processor::PostResumable(r);
+                }, opt);
+        return true;
+    }
+
+    bool await_resume()
+    {
+        if (status_ == ChannelAsync::queued)
+            return !impl_->Closed();
+        return status_ == ChannelAsync::done;
+    }
+};
+
+// 值在awaiter中保存到被读走为止
+template <typename T>
+struct ChannelPushAwaiter : public ChannelAwaiter<T>
+{
+    T value_;
+
+    ChannelPushAwaiter(std::shared_ptr<ChannelImpl<T>> const& impl, T const& value)
+        : ChannelAwaiter<T>{impl, nullptr, true}, value_(value)
+    {
+        this->slot_ = &value_;
+    }
+
+    ChannelPushAwaiter(ChannelPushAwaiter const&) = delete;
+    ChannelPushAwaiter& operator=(ChannelPushAwaiter const&) = delete;
+};
+
+template <typename T>
+ChannelPushAwaiter<T> async_push(Channel<T> const& ch, T const& value)
+{
+    return ChannelPushAwaiter<T>(ch.Impl(), value);
+}
+
+// 读到的值写入t, t在等待期间必须有效(通常是协程中的局部变量)
+template <typename T>
+ChannelAwaiter<T> async_pop(Channel<T> const& ch, T & t)
+{
+    return ChannelAwaiter<T>{ch.Impl(), &t, false};
+}
+
+// 等待co_latch / co_wait_group / TaskGroup
+template <typename W>
+struct WaitAwaiter
+{
+    W & w_;
+    StackWaitList::Node node_;
+
+    bool await_ready() noexcept { return false; }
+
+    template <typename P>
+    bool await_suspend(std::coroutine_handle<P> h)
+    {
+        return w_.wait_async(&node_, AsyncSuspendNode(h));
+    }
+
+    void await_resume() {}
+};
+
+inline WaitAwaiter<Latch> async_wait(Latch & latch)
+{
+    return WaitAwaiter<Latch>{latch};
+}
+
+inline WaitAwaiter<WaitGroup> async_wait(WaitGroup & wg)
+{
+    return WaitAwaiter<WaitGroup>{wg};
+}
+
+// 组内协程全部结束后, 重新抛出其中第一个异常
+struct TaskGroupAwaiter : public WaitAwaiter<TaskGroup>
+{
+    void await_resume() { w_.wait(); }
+};
+
+inline TaskGroupAwaiter async_wait(TaskGroup & group)
+{
+    return TaskGroupAwaiter{{group}};
+}
+
+// co_await JoinHandle: 等待普通协程(co::spawn(fn))或无栈协程(co::spawn(Async))结束并取得结果
+// 与get()相同, 之后handle失效.
+template <typename R>
+struct JoinAwaiter
+{
+    JoinHandle<R> handle_;
+    JoinWaitNode node_;
+
+    bool await_ready() noexcept { return handle_.ready(); }
+
+    template <typename P>
+    bool await_suspend(std::coroutine_handle<P> h)
+    {
+        node_.resumable = AsyncSuspendNode(h);
+        return handle_.state()->AddWaiter(&node_);
+    }
+
+    R await_resume() { return handle_.get(); }
+};
+
+template <typename R>
+JoinAwaiter<R> operator co_await(JoinHandle<R> && handle)
+{
+    return JoinAwaiter<R>{std::move(handle)};
+}
+
+template <typename R>
+JoinAwaiter<R> operator co_await(JoinHandle<R> & handle)
+{
+    return JoinAwaiter<R>{std::move(handle)};
+}
+
+} //namespace co
+
+#endif // __cpp_impl_coroutine
@@ -2,17 +2,30 @@
 #include "common/inc/OsSupport.h"
 #include "co/pp.h"
 #include "co/syntax_helper.h"
+#include "co/sleep.h"
 #include "co/sync/channel.h"
 #include "co/sync/co_mutex.h"
 #include "co/sync/co_rwmutex.h"
+#include "co/sync/co_semaphore.h"
+#include "co/sync/co_wait_group.h"
+#include "co/sync/co_latch.h"
+#include "co/sync/join_handle.h"
+#include "co/sync/task_group.h"
+#include "co/sync/parallel.h"
+#include "co/async.h"
 #include "common/inc/Timer.h"
 #include "processor/Processor.h"
 #include "processor/CoLocalStorage.h"
+#include "netio/NetPoller.h"
 #include "pool/ConnectionPool.h"
 #include "pool/AsyncCoroutinePool.h"
 #include "defer/Defer.h"
 #include "debug/Listener.h"
 #include "debug/CoDebugger.h"
+#include "debug/Trace.h"
+#include "debug/Metrics.h"
+#include "debug/SwitchTrace.h"
+#include "debug/Profiler.h"
 #include "timer/Timer.h"
 
 #define LIBGO_VERSION 300
@@ -24,19 +37,30 @@
 #define co_stack(size) ::co::__go_option<::co::opt_stack_size>{size}-
 #define co_scheduler(pScheduler) ::co::__go_option<::co::opt_scheduler>{pScheduler}-
 
+// 运行在所在P的共享栈上, 切出时只把已用的栈拷贝到堆上, 适合海量的空闲协程.
+// 限制: 协程挂起期间, 其他协程/线程不能访问它栈上的对象(栈内容已被拷走).
+#define co_shared_stack ::co::__go_option<::co::opt_shared_stack>{true}-
+
+// 固定在创建时所在的P上执行, 不会被调度线程偷到其他P(阻塞的P上也不会), 适合依赖线程局部数据/缓存的协程.
+#define co_affinity ::co::__go_option<::co::opt_affinity>{true}-
+
+// 放到第n个P上执行并固定在该P上(n超出P的数量时取模), 语义同co_affinity
+#define co_processor(n) ::co::__go_option<::co::opt_processor>{n}-
+
+// 不继承创建者所属TaskGroup的取消令牌, 组被取消时不受影响, 适合比创建者活得久的常驻协程
+#define co_detach_cancel ::co::__go_option<::co::opt_detach_cancel>{true}-
+
 #define go_stack(size) go co_stack(size)
 
 #define co_yield do { ::co::Processor::StaticCoYield(); } while (0)
 
+// 抢占检查点, 放在长时间运行的计算循环中. 开启co_opt.preempt_slice_us后,
+// 协程执行超过时间片且本P还有其他协程待执行时在此让出, 否则开销仅为一次线程局部变量的读.
+#define co_preempt_check() do { ::co::Processor::PreemptCheck(); } while (0)
+
 // coroutine sleep, never blocks current thread if run in coroutine.
-#if defined(LIBGO_SYS_Unix)
-// # define co_sleep(milliseconds) do { usleep(1000 * milliseconds); } while (0)
-# define co_sleep(milliseconds) do {  \
-    this::this_thread::sleep_for(std::chrono::microseconds(milliseconds)); } \
-    while (0)
-#else
-# define co_sleep(milliseconds) do { ::sleep(milliseconds); } while (0)
-#endif
+// 挂起在调度器的定时器上, 不依赖hook
+#define co_sleep(ms) do { ::co::sleep_for(std::chrono::milliseconds(ms)); } while (0)
 
 // co_sched
 #define co_sched g_Scheduler
@@ -51,6 +75,11 @@ using ::co::co_rwmutex;
 using ::co::co_rmutex;
 using ::co::co_wmutex;
 
+// co_semaphore, co_wait_group, co_latch
+using ::co::co_semaphore;
+using ::co::co_wait_group;
+using ::co::co_latch;
+
 // co_chan
 using ::co::co_chan;
 
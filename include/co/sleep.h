@@ -0,0 +1,62 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "common/inc/Clock.h"
+#include "processor/Processor.h"
+#include <chrono>
+#include <thread>
+
+namespace co
+{
+
+/// 睡眠
+// 在协程中挂起当前协程, 由调度器的定时器到期唤醒, 不阻塞所在的线程, 也不依赖hook;
+// 不在协程中时退化为std::this_thread::sleep_for.
+// 睡眠时长小于等于0时在协程中相当于co_yield.
+// 在协程中是取消点: 所属TaskGroup被取消时提前醒来并抛出co::task_cancelled.
+
+ALWAYS_INLINE void sleep_for(FastSteadyClock::duration dur)
+{
+    if (!Processor::IsCoroutine()) {
+        if (dur > FastSteadyClock::duration::zero())
+            std::this_thread::sleep_for(dur);
+        return ;
+    }
+
+    Processor::CancellationPoint();
+    if (dur > FastSteadyClock::duration::zero())
+        Processor::Suspend(dur);
+    Processor::StaticCoYield();
+    Processor::CancellationPoint();
+}
+
+template <typename Rep, typename Period>
+ALWAYS_INLINE void sleep_for(std::chrono::duration<Rep, Period> const& dur)
+{
+    // 向上取整, 保证不早于指定的时长醒来
+    auto d = std::chrono::duration_cast<FastSteadyClock::duration>(dur);
+    if (d < dur)
+        ++d;
+    sleep_for(d);
+}
+
+ALWAYS_INLINE void sleep_until(FastSteadyClock::time_point tp)
+{
+    if (!Processor::IsCoroutine()) {
+        std::this_thread::sleep_until(tp);
+        return ;
+    }
+
+    Processor::CancellationPoint();
+    if (tp > FastSteadyClock::now())
+        Processor::Suspend(tp);
+    Processor::StaticCoYield();
+    Processor::CancellationPoint();
+}
+
+template <typename Clock, typename Duration>
+ALWAYS_INLINE void sleep_until(std::chrono::time_point<Clock, Duration> const& tp)
+{
+    sleep_for(tp - Clock::now());
+}
+
+} //namespace co
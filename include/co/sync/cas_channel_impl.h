@@ -43,6 +43,11 @@ public:
     }
     
     // write
+    bool Closed()
+    {
+        return closed_;
+    }
+
     bool Push(T t, bool bWait, FastSteadyClock::time_point deadline = FastSteadyClock::time_point{})
     {
         DebugPrint1(dbg_channel, "[id=%ld] Push ->", this->getId());
@@ -216,10 +221,15 @@ public:
                 break;
         }
 
+        // 共享栈协程挂起后栈内容会被拷走, 改为经由堆上的临时变量交换
+        std::unique_ptr<T> heap;
+        if (UNLIKELY(Processor::IsSharedStackTask()))
+            heap.reset(new T());
+
         FakeLock lock;
         Entry entry;
         entry.id = GetCurrentCoroID();
-        entry.pvalue = &t;
+        entry.pvalue = heap ? heap.get() : &t;
         auto cond = [&](size_t size) -> typename cond_t::CondRet {
             typename cond_t::CondRet ret{true, true};
             if (closed_) {
@@ -243,6 +253,8 @@ public:
                     return false;
                 }
 
+                if (heap)
+                    t = std::move(*heap);
                 DebugPrint1(dbg_channel, "[id=%ld] Pop complete.", this->getId());
                 return true;
 
@@ -17,9 +17,13 @@ private:
     mutable std::shared_ptr<ChannelImpl<T>> impl_;
 
 public:
-    // @capacity: capacity of channel.
+    // capacity of an unbounded channel.
+    static constexpr std::size_t kUnbounded = (std::size_t)-1;
+
+    // @capacity: capacity of channel, kUnbounded means never block on push.
     // @choose1: use CASChannelImpl if capacity less than choose1
-    // @choose2: if capacity less than choose2, use ringbuffer. else use std::list.
+    // @choose2: if capacity less than choose2, use ringbuffer. else use segmented queue,
+    //           which allocates memory in proportion to the number of queued elements.
     explicit Channel(std::size_t capacity = 0,
             std::size_t choose1 = 0, //16,
             std::size_t choose2 = 100001)
@@ -35,22 +39,32 @@ public:
         impl_->SetDbgMask(mask);
     }
 
+    // 阻塞的读写(含Timed*)在协程中是取消点: 所属TaskGroup被取消时抛出co::task_cancelled
     Channel const& operator<<(T t) const
     {
-        impl_->Push(t, true);
+        Processor::CancellableScope scope;
+        scope.Check();
+        if (!impl_->Push(t, true))
+            scope.Check();
         return *this;
     }
 
     Channel const& operator>>(T & t) const
     {
-        impl_->Pop(t, true);
+        Processor::CancellableScope scope;
+        scope.Check();
+        if (!impl_->Pop(t, true))
+            scope.Check();
         return *this;
     }
 
     Channel const& operator>>(std::nullptr_t ignore) const
     {
         T t;
-        impl_->Pop(t, true);
+        Processor::CancellableScope scope;
+        scope.Check();
+        if (!impl_->Pop(t, true))
+            scope.Check();
         return *this;
     }
 
@@ -73,36 +87,56 @@ public:
     template <typename Rep, typename Period>
     bool TimedPush(T t, std::chrono::duration<Rep, Period> dur) const
     {
-        return impl_->Push(t, true, dur + FastSteadyClock::now());
+        return TimedPush(t, dur + FastSteadyClock::now());
     }
 
     bool TimedPush(T t, FastSteadyClock::time_point deadline) const
     {
-        return impl_->Push(t, true, deadline);
+        Processor::CancellableScope scope;
+        scope.Check();
+        bool ok = impl_->Push(t, true, deadline);
+        if (!ok)
+            scope.Check();
+        return ok;
     }
 
     template <typename Rep, typename Period>
     bool TimedPop(T & t, std::chrono::duration<Rep, Period> dur) const
     {
-        return impl_->Pop(t, true, dur + FastSteadyClock::now());
+        return TimedPop(t, dur + FastSteadyClock::now());
     }
 
     bool TimedPop(T & t, FastSteadyClock::time_point deadline) const
     {
-        return impl_->Pop(t, true, deadline);
+        Processor::CancellableScope scope;
+        scope.Check();
+        bool ok = impl_->Pop(t, true, deadline);
+        if (!ok)
+            scope.Check();
+        return ok;
     }
 
     template <typename Rep, typename Period>
     bool TimedPop(std::nullptr_t ignore, std::chrono::duration<Rep, Period> dur) const
     {
-        T t;
-        return impl_->Pop(t, true, dur + FastSteadyClock::now());
+        return TimedPop(nullptr, dur + FastSteadyClock::now());
     }
 
     bool TimedPop(std::nullptr_t ignore, FastSteadyClock::time_point deadline) const
     {
         T t;
-        return impl_->Pop(t, true, deadline);
+        Processor::CancellableScope scope;
+        scope.Check();
+        bool ok = impl_->Pop(t, true, deadline);
+        if (!ok)
+            scope.Check();
+        return ok;
+    }
+
+    // 无栈协程读写(co/async.h)使用
+    std::shared_ptr<ChannelImpl<T>> const& Impl() const
+    {
+        return impl_;
     }
 
     bool Unique() const
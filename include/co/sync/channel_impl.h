@@ -1,15 +1,31 @@
 #pragma once
 #include "common/inc/OsSupport.h"
 #include "common/inc/Clock.h"
+#include "task/Resumable.h"
 
 namespace co
 {
 
+// 无栈协程读写(PushAsync/PopAsync)的结果
+enum class ChannelAsync
+{
+    done,           // 已完成
+    closed,         // channel已关闭
+    queued,         // 已登记为等待者, 完成或关闭时恢复协程
+    unsupported,    // 不支持无栈协程等待, 由调用者改用阻塞读写
+};
+
 template <typename T>
 struct ChannelImpl : public IdCounter<ChannelImpl<T>>
 {
     virtual ~ChannelImpl() {}
 
+    // 无栈协程的读写, r是已挂起的协程; slot在等待期间必须有效(位于协程帧中).
+    // 返回queued之后r随时可能在其他线程恢复.
+    virtual ChannelAsync PushAsync(T* slot, Resumable* r) { return ChannelAsync::unsupported; }
+    virtual ChannelAsync PopAsync(T* slot, Resumable* r) { return ChannelAsync::unsupported; }
+    virtual bool Closed() = 0;
+
     virtual bool Push(T t, bool bWait,
             FastSteadyClock::time_point deadline = FastSteadyClock::time_point{}) = 0;
     virtual bool Pop(T & t, bool bWait,
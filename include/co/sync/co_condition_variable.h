@@ -51,9 +51,12 @@ private:
 
         NativeThreadEntry* nativeThreadEntry;
 
+        // 无栈协程等待者(wait_async), 唤醒时交给P恢复
+        Resumable* resumable;
+
         bool isWaiting;
 
-        Entry() : value(), nativeThreadEntry(nullptr), isWaiting(true) {}
+        Entry() : value(), nativeThreadEntry(nullptr), resumable(nullptr), isWaiting(true) {}
         ~Entry() {
             if (nativeThreadEntry) {
                 delete nativeThreadEntry;
@@ -100,6 +103,17 @@ private:
 
             DebugPrint(dbg_channel, "cv::notify -> wakeup");
 
+            // stackless coroutine
+            if (resumable) {
+                if (!noTimeoutLock.try_lock())
+                    return false;
+
+                if (func)
+                    func(value);
+                Processor::PostResumable(resumable);
+                return true;
+            }
+
             // coroutine
             if (!nativeThreadEntry) {
                 if (!noTimeoutLock.try_lock())
@@ -187,6 +201,23 @@ public:
         return do_wait(lock, &timepoint, value, cond);
     }
 
+    // 无栈协程的等待: r已挂起, 登记后立即返回(调用者仍持有外部的锁), 被notify时恢复r.
+    // 不支持超时, 只会被notify(或关闭时的notify_all)唤醒.
+    void wait_async(Resumable* r, T value = T())
+    {
+        Entry *entry = new Entry;
+        AutoRelease<Entry> pEntry(entry);
+        entry->value = value;
+        entry->resumable = r;
+        // 协程帧在登记前就已挂起, 唤醒方不需要等待挂起完成
+        entry->suspendFlags.store(eSuspendFlag::suspend_begin | eSuspendFlag::suspend_end,
+                std::memory_order_relaxed);
+        queue_.push(entry, [&](size_t){
+                entry->IncrementRef();
+                return CondRet{true, true};
+                });
+    }
+
     bool notify_one(Functor const& func = NULL)
     {
         Entry* entry = nullptr;
@@ -358,6 +389,7 @@ private:
 
     static bool isValid(Entry* entry) {
         if (!entry->isWaiting) return true;
+        if (entry->resumable) return true;
         if ((entry->suspendFlags & eSuspendFlag::suspend_begin) == 0) return true;
         if (!entry->nativeThreadEntry)
             return !entry->coroEntry.IsExpire();
@@ -0,0 +1,52 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "co/sync/stack_wait_list.h"
+
+namespace co
+{
+
+/// 一次性的倒计数门闩
+// 同C++20的std::latch: 计数只减不增, 归零后所有wait立即返回.
+class Latch
+{
+    std::atomic_long count_;
+
+    StackWaitList waiters_;
+
+public:
+    explicit Latch(long count) : count_(count) { assert(count >= 0); }
+
+    Latch(Latch const&) = delete;
+    Latch& operator=(Latch const&) = delete;
+
+    ALWAYS_INLINE void count_down(long n = 1)
+    {
+        long c = count_.fetch_sub(n, std::memory_order_acq_rel) - n;
+        assert(c >= 0);
+        if (UNLIKELY(c == 0))
+            wakeAll();
+    }
+
+    ALWAYS_INLINE bool try_wait() const
+    {
+        return count_.load(std::memory_order_acquire) == 0;
+    }
+
+    void wait();
+
+    // 无栈协程的等待(co_await): 已满足时返回false; 否则登记已挂起的r并返回true, 满足时恢复r
+    bool wait_async(StackWaitList::Node* node, Resumable* r);
+
+    void arrive_and_wait(long n = 1)
+    {
+        count_down(n);
+        wait();
+    }
+
+private:
+    void wakeAll();
+};
+
+typedef Latch co_latch;
+
+} //namespace co
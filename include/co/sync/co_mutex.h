@@ -1,5 +1,6 @@
 #pragma once
 #include "common/inc/OsSupport.h"
+#include "common/inc/Clock.h"
 #include "processor/Processor.h"
 #include <queue>
 #include "co/sync/co_condition_variable.h"
@@ -8,16 +9,43 @@ namespace co
 {
 
 /// 协程锁
+// 自适应锁:
+//   1.无竞争时一次CAS完成加锁/解锁.
+//   2.持有者正在其他P上运行时, 有限次数自旋等待, 避免短临界区付出一次协程切换的代价.
+//   3.持有者已被切出(或超过自旋上限)时, 挂起等待.
+//   4.有等待者等待超过kStarvationThreshold时进入交接模式:
+//     解锁时直接把锁交给队首的等待者, 新来的加锁者不能插队, 防止饿死.
 class CoMutex
 {
     typedef std::mutex lock_t;
+
+    // 等待队列的锁, 保护waiter计数与cv_入队的原子性
     lock_t lock_;
-    bool notified_ = false;
-    ConditionVariableAny cv_;
 
+    // 被唤醒的等待者通过指针得知锁是否已被直接交接给自己
+    typedef ConditionVariableAnyT<bool*> cv_t;
+    cv_t cv_;
+
+    // bit0: 是否已加锁, 其余位: 等待者数量
     std::atomic_long sem_;
 
+    // 交接模式
+    std::atomic_bool starving_{false};
+
+    // 持有者所在的P和加锁时P的调度计数, 用于判断持有者是否仍在运行
+    std::atomic<Processor*> ownerProc_{nullptr};
+    std::atomic<uint64_t> ownerSwitch_{0};
+
+    static const long kLocked = 1;
+    static const long kWaiter = 2;
+
 public:
+    // 自旋次数上限
+    static const int kSpinCount = 128;
+
+    // 等待者等待超过该时长后进入交接模式
+    static constexpr FastSteadyClock::duration kStarvationThreshold = std::chrono::milliseconds(1);
+
     CoMutex();
     ~CoMutex();
 
@@ -25,6 +53,30 @@ public:
     bool try_lock();
     bool is_lock();
     void unlock();
+
+private:
+    ALWAYS_INLINE bool tryAcquire()
+    {
+        long s = sem_.load(std::memory_order_relaxed);
+        while (!(s & kLocked)) {
+            if (sem_.compare_exchange_weak(s, s | kLocked,
+                        std::memory_order_acquire, std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+
+    // 持有者是否正在其他P上运行
+    bool ownerIsRunning();
+
+    // 加锁成功后记录持有者
+    void setOwner();
+
+    // 自旋等待, 返回是否加锁成功
+    bool spin();
+
+    // 挂起等待, 返回锁是否已被直接交接给自己
+    bool park(FastSteadyClock::time_point waitStart);
 };
 
 typedef CoMutex co_mutex;
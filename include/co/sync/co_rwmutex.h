@@ -8,19 +8,36 @@ namespace co
 {
 
 /// 读写锁
+// 等待者被唤醒时锁已直接交接给它, 不需要重新竞争:
+//   写锁释放时, 当前所有等待中的读者作为一批同时获得读锁, 否则交给一个写者;
+//   最后一个读锁释放时, 交给一个等待中的写者.
+// 写优先模式下, 有写者等待时新来的读者需要排队, 因此读写双方都不会饿死.
+// 写锁持有者正在其他P上运行时, 加锁者先有限次数自旋再挂起.
 class CoRWMutex
 {
     LFLock lock_;
     long lockState_;  // 0:无锁, >=1:读锁, -1:写锁
 
+    // 等待中的读者/写者数量, 由lock_保护
+    long readWaiting_ = 0;
+    long writeWaiting_ = 0;
+
     // 兼容原生线程
-    ConditionVariableAny rCv_;
-    ConditionVariableAny wCv_;
+    typedef ConditionVariableAnyT<bool*> cv_t;
+    cv_t rCv_;
+    cv_t wCv_;
 
     // 是否写优先
     bool writePriority_;
 
+    // 写锁持有者所在的P和加锁时P的调度计数
+    std::atomic<Processor*> writerProc_{nullptr};
+    std::atomic<uint64_t> writerSwitch_{0};
+
 public:
+    // 自旋次数上限
+    static const int kSpinCount = 128;
+
     explicit CoRWMutex(bool writePriority = true);
     ~CoRWMutex();
 
@@ -35,7 +52,15 @@ public:
     bool IsLock();
 
 private:
-    void TryWakeUp();
+    ALWAYS_INLINE bool canRead()
+    {
+        return lockState_ >= 0 && !(writePriority_ && writeWaiting_ > 0);
+    }
+
+    // 写锁持有者是否正在其他P上运行
+    bool writerIsRunning();
+
+    void setWriter();
 
 public:
     class ReadView
@@ -0,0 +1,67 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "co/sync/stack_wait_list.h"
+
+namespace co
+{
+
+/// 协程信号量
+// count_ > 0: 可用的信号量数量
+// count_ < 0: 等待者数量(包括已经扣减计数, 还未进入等待队列的)
+// 无竞争时acquire/release只有一次原子操作, 等待节点分配在等待者的栈上.
+class Semaphore
+{
+    std::atomic_long count_;
+
+    // release时还没来得及入队的等待者, 由其入队前直接领取(lock保护)
+    long pending_ = 0;
+
+    StackWaitList waiters_;
+
+public:
+    explicit Semaphore(long initial = 0) : count_(initial) {}
+
+    Semaphore(Semaphore const&) = delete;
+    Semaphore& operator=(Semaphore const&) = delete;
+
+    ALWAYS_INLINE void acquire()
+    {
+        if (LIKELY(count_.fetch_sub(1, std::memory_order_acquire) > 0))
+            return ;
+
+        acquireSlow();
+    }
+
+    ALWAYS_INLINE bool try_acquire()
+    {
+        long c = count_.load(std::memory_order_relaxed);
+        while (c > 0) {
+            if (count_.compare_exchange_weak(c, c - 1,
+                        std::memory_order_acquire, std::memory_order_relaxed))
+                return true;
+        }
+        return false;
+    }
+
+    ALWAYS_INLINE void release(long n = 1)
+    {
+        assert(n > 0);
+        long prev = count_.fetch_add(n, std::memory_order_release);
+        if (LIKELY(prev >= 0))
+            return ;
+
+        releaseSlow((std::min)(n, -prev));
+    }
+
+    // 当前计数, 负数表示等待者数量
+    long value() const { return count_.load(std::memory_order_relaxed); }
+
+private:
+    void acquireSlow();
+
+    void releaseSlow(long wakeups);
+};
+
+typedef Semaphore co_semaphore;
+
+} //namespace co
@@ -0,0 +1,46 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "co/sync/stack_wait_list.h"
+
+namespace co
+{
+
+/// 等待一组协程完成
+// 同golang的sync.WaitGroup: add(n)登记任务数, 每个任务完成时done(), wait()等待计数归零.
+// 计数归零后可以重新add复用, 但需要等上一轮的wait全部返回.
+class WaitGroup
+{
+    std::atomic_long count_;
+
+    StackWaitList waiters_;
+
+public:
+    explicit WaitGroup(long count = 0) : count_(count) {}
+
+    WaitGroup(WaitGroup const&) = delete;
+    WaitGroup& operator=(WaitGroup const&) = delete;
+
+    ALWAYS_INLINE void add(long delta = 1)
+    {
+        long c = count_.fetch_add(delta, std::memory_order_acq_rel) + delta;
+        assert(c >= 0);
+        if (UNLIKELY(c == 0))
+            wakeAll();
+    }
+
+    ALWAYS_INLINE void done() { add(-1); }
+
+    void wait();
+
+    // 无栈协程的等待(co_await): 已满足时返回false; 否则登记已挂起的r并返回true, 满足时恢复r
+    bool wait_async(StackWaitList::Node* node, Resumable* r);
+
+    long count() const { return count_.load(std::memory_order_relaxed); }
+
+private:
+    void wakeAll();
+};
+
+typedef WaitGroup co_wait_group;
+
+} //namespace co
@@ -0,0 +1,255 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "common/inc/SpinLock.h"
+#include "scheduler/Scheduler.h"
+#include <exception>
+#include <type_traits>
+#include <vector>
+
+namespace co
+{
+
+struct JoinWaiter;
+
+// 等待者登记在JoinState上的节点
+// 无栈协程(co_await JoinHandle)登记resumable, 完成时直接恢复它
+struct JoinWaitNode
+{
+    JoinWaitNode* next = nullptr;
+    JoinWaiter* waiter = nullptr;
+    Resumable* resumable = nullptr;
+    std::size_t index = 0;
+};
+
+/// 协程结果的共享状态
+// 与协程入口函数一起分配, 协程和JoinHandle各持有一个引用.
+// 等待者把节点登记在这里, 完成时逐个通知, 不需要额外的协程或channel.
+class JoinStateBase : public RefObject
+{
+public:
+    ALWAYS_INLINE bool ready() const { return ready_.load(std::memory_order_acquire); }
+
+    // 挂起当前协程/线程直到完成
+    void wait();
+
+    // 登记等待者, 已完成时返回false
+    bool AddWaiter(JoinWaitNode* node);
+
+    // 注销等待者, 返回后不会再有针对该节点的通知
+    void RemoveWaiter(JoinWaitNode* node);
+
+protected:
+    // 结果(或异常)写入后调用, 通知所有等待者
+    void SetReady();
+
+    std::exception_ptr eptr_;
+
+private:
+    std::atomic<bool> ready_{false};
+    LFLock lock_;
+    JoinWaitNode* waiters_ = nullptr;
+};
+
+// 等待states中至少need个完成(need为0或大于n时按n算)
+// @return: 最先完成的下标
+std::size_t WaitJoinStates(JoinStateBase* const* states, std::size_t n, std::size_t need);
+
+template <typename R>
+class JoinState : public JoinStateBase
+{
+public:
+    ~JoinState()
+    {
+        if (hasValue_)
+            value().~R();
+    }
+
+    // 等待完成并取走结果, 协程抛出的异常在这里重新抛出
+    R Take()
+    {
+        wait();
+        if (eptr_)
+            std::rethrow_exception(eptr_);
+        return std::move(value());
+    }
+
+protected:
+    template <typename F>
+    void Invoke(F & fn)
+    {
+        new (&storage_) R(fn());
+        hasValue_ = true;
+    }
+
+private:
+    R& value() { return *reinterpret_cast<R*>(&storage_); }
+
+    typename std::aligned_storage<sizeof(R), alignof(R)>::type storage_;
+    bool hasValue_ = false;
+};
+
+template <>
+class JoinState<void> : public JoinStateBase
+{
+public:
+    void Take()
+    {
+        wait();
+        if (eptr_)
+            std::rethrow_exception(eptr_);
+    }
+
+protected:
+    template <typename F>
+    void Invoke(F & fn)
+    {
+        fn();
+    }
+};
+
+// 带入口函数的共享状态, 入口函数执行完立即析构(释放捕获的对象)
+template <typename R, typename F>
+class JoinTask : public JoinState<R>
+{
+public:
+    template <typename Fn>
+    explicit JoinTask(Fn && fn)
+    {
+        new (&fn_) F(std::forward<Fn>(fn));
+    }
+
+    ~JoinTask()
+    {
+        // 协程没有执行(调度器已停止)
+        if (!this->ready())
+            fn().~F();
+    }
+
+    void Run()
+    {
+        try {
+            this->Invoke(fn());
+        } catch (...) {
+            this->eptr_ = std::current_exception();
+        }
+        fn().~F();
+        this->SetReady();
+    }
+
+private:
+    F& fn() { return *reinterpret_cast<F*>(&fn_); }
+
+    typename std::aligned_storage<sizeof(F), alignof(F)>::type fn_;
+};
+
+// 协程入口, 只有一个指针, 可以放进std::function的内部存储
+// 持有JoinTask的一个引用, 执行完释放
+template <typename T>
+struct JoinTaskCall
+{
+    T* task_;
+
+    void operator()() const
+    {
+        task_->Run();
+        task_->DecrementRef();
+    }
+};
+
+/// 等待一个协程结束并取得结果
+// 由co::spawn返回. get()挂起当前协程(原生线程中则阻塞线程)直到协程结束, 只能调用一次.
+// 析构时不等待, 协程照常执行完.
+// 在协程中等待(get/wait/when_all/when_any)是取消点, 所属TaskGroup被取消时抛出co::task_cancelled.
+template <typename R>
+class JoinHandle
+{
+public:
+    JoinHandle() = default;
+    explicit JoinHandle(JoinState<R>* state) : state_(state) {}
+
+    ALWAYS_INLINE bool valid() const { return !!state_; }
+
+    ALWAYS_INLINE bool ready() const { return state_ && state_->ready(); }
+
+    void wait() const { state_->wait(); }
+
+    // 取走结果后handle失效
+    R get()
+    {
+        IncursivePtr<JoinState<R>> state(std::move(state_));
+        return state->Take();
+    }
+
+    ALWAYS_INLINE JoinStateBase* state() const { return state_.get(); }
+
+private:
+    IncursivePtr<JoinState<R>> state_;
+};
+
+template <typename R>
+using Future = JoinHandle<R>;
+
+// 创建协程执行fn, 返回等待其结果的JoinHandle
+// 结果与入口函数一起分配, 协程本身只捕获一个指针.
+template <typename F>
+JoinHandle<typename std::decay<decltype(std::declval<F&>()())>::type>
+spawn(TaskOpt const& opt, F && fn)
+{
+    typedef typename std::decay<decltype(std::declval<F&>()())>::type R;
+    typedef JoinTask<R, typename std::decay<F>::type> Task_t;
+
+    // 初始引用归协程所有
+    Task_t* task = new Task_t(std::forward<F>(fn));
+    JoinHandle<R> handle(task);
+
+    Scheduler* scheduler = Processor::GetCurrentScheduler();
+    if (!scheduler) scheduler = &Scheduler::getInstance();
+    scheduler->CreateTask(JoinTaskCall<Task_t>{task}, opt);
+    return handle;
+}
+
+template <typename F>
+auto spawn(F && fn) -> decltype(spawn(TaskOpt(), std::forward<F>(fn)))
+{
+    return spawn(TaskOpt(), std::forward<F>(fn));
+}
+
+// 等待所有协程结束, 之后get()不再挂起
+template <typename R, typename ... Rs>
+void when_all(JoinHandle<R> const& h, JoinHandle<Rs> const& ... hs)
+{
+    JoinStateBase* states[] = { h.state(), hs.state()... };
+    WaitJoinStates(states, sizeof(states) / sizeof(states[0]), sizeof(states) / sizeof(states[0]));
+}
+
+template <typename R>
+void when_all(std::vector<JoinHandle<R>> const& hs)
+{
+    if (hs.empty()) return ;
+    std::vector<JoinStateBase*> states;
+    states.reserve(hs.size());
+    for (auto const& h : hs)
+        states.push_back(h.state());
+    WaitJoinStates(states.data(), states.size(), states.size());
+}
+
+// 等待任意一个协程结束, 返回其下标
+template <typename R, typename ... Rs>
+std::size_t when_any(JoinHandle<R> const& h, JoinHandle<Rs> const& ... hs)
+{
+    JoinStateBase* states[] = { h.state(), hs.state()... };
+    return WaitJoinStates(states, sizeof(states) / sizeof(states[0]), 1);
+}
+
+template <typename R>
+std::size_t when_any(std::vector<JoinHandle<R>> const& hs)
+{
+    assert(!hs.empty());
+    std::vector<JoinStateBase*> states;
+    states.reserve(hs.size());
+    for (auto const& h : hs)
+        states.push_back(h.state());
+    return WaitJoinStates(states.data(), states.size(), 1);
+}
+
+} //namespace co
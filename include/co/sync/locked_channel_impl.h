@@ -2,7 +2,7 @@
 #include "common/inc/OsSupport.h"
 #include "co/sync/channel_impl.h"
 #include "co/sync/ringbuffer.h"
-#include <list>
+#include "co/sync/segmented_queue.h"
 
 namespace co
 {
@@ -20,7 +20,7 @@ class LockedChannelImpl : public ChannelImpl<T>
 
     bool useRingBuffer_;
     RingBuffer<T> q_;
-    std::list<T> lq_;
+    SegmentedQueue<T> lq_;
 
     typedef ConditionVariableAnyT<T*> wait_queue_t;
     wait_queue_t wq_;
@@ -43,7 +43,7 @@ public:
             if (lq_.size() >= capacity_)
                 return false;
 
-            lq_.emplace_back(t);
+            lq_.push(t);
             return true;
         }
     }
@@ -51,14 +51,8 @@ public:
     bool pop(T & t) {
         if (useRingBuffer_)
             return q_.pop(t);
-        else {
-            if (lq_.empty())
-                return false;
-
-            t = lq_.front();
-            lq_.pop_front();
-            return true;
-        }
+        else
+            return lq_.pop(t);
     }
     
     // write
@@ -92,11 +86,19 @@ public:
 
         DebugPrint(dbg_channel, "[id=%ld] Push wait", this->getId());
 
+        // 共享栈协程挂起后栈内容会被拷走, 改为经由堆上的副本交换
+        std::unique_ptr<T> heap;
+        T* slot = &t;
+        if (UNLIKELY(Processor::IsSharedStackTask())) {
+            heap.reset(new T(std::move(t)));
+            slot = heap.get();
+        }
+
         typename wait_queue_t::cv_status cv_status;
         if (deadline == time_point_t())
-            cv_status = wq_.wait(lock, &t);
+            cv_status = wq_.wait(lock, slot);
         else
-            cv_status = wq_.wait_util(lock, deadline, &t);
+            cv_status = wq_.wait_util(lock, deadline, slot);
 
         switch ((int)cv_status) {
             case (int)wait_queue_t::cv_status::no_timeout:
@@ -152,11 +154,19 @@ public:
 
         DebugPrint(dbg_channel, "[id=%ld] Pop wait.", this->getId());
 
+        // 共享栈协程挂起后栈内容会被拷走, 改为经由堆上的临时变量交换
+        std::unique_ptr<T> heap;
+        T* slot = &t;
+        if (UNLIKELY(Processor::IsSharedStackTask())) {
+            heap.reset(new T());
+            slot = heap.get();
+        }
+
         typename wait_queue_t::cv_status cv_status;
         if (deadline == time_point_t())
-            cv_status = rq_.wait(lock, &t);
+            cv_status = rq_.wait(lock, slot);
         else
-            cv_status = rq_.wait_util(lock, deadline, &t);
+            cv_status = rq_.wait_util(lock, deadline, slot);
 
         switch ((int)cv_status) {
             case (int)wait_queue_t::cv_status::no_timeout:
@@ -165,6 +175,8 @@ public:
                     return false;
                 }
 
+                if (heap)
+                    t = std::move(*heap);
                 DebugPrint(dbg_channel, "[id=%ld] Pop complete.", this->getId());
                 return true;
 
@@ -179,6 +191,52 @@ public:
         return false;
     }
 
+    ChannelAsync PushAsync(T* slot, Resumable* r)
+    {
+        if (closed_) return ChannelAsync::closed;
+        std::unique_lock<lock_t> lock(lock_);
+        if (closed_) return ChannelAsync::closed;
+
+        if (!capacity_ && rq_.notify_one([&](T* p){ *p = *slot; }))
+            return ChannelAsync::done;
+
+        if (capacity_ > 0 && push(*slot)) {
+            if (Size() == 1)
+                rq_.notify_one([&](T* p){ pop(*p); });
+            return ChannelAsync::done;
+        }
+
+        DebugPrint(dbg_channel, "[id=%ld] PushAsync wait", this->getId());
+        wq_.wait_async(r, slot);
+        return ChannelAsync::queued;
+    }
+
+    ChannelAsync PopAsync(T* slot, Resumable* r)
+    {
+        if (closed_) return ChannelAsync::closed;
+        std::unique_lock<lock_t> lock(lock_);
+        if (closed_) return ChannelAsync::closed;
+
+        if (capacity_ > 0) {
+            if (pop(*slot)) {
+                if (Size() == capacity_ - 1)
+                    wq_.notify_one([&](T* p){ push(*p); });
+                return ChannelAsync::done;
+            }
+        } else if (wq_.notify_one([&](T* p){ *slot = *p; })) {
+            return ChannelAsync::done;
+        }
+
+        DebugPrint(dbg_channel, "[id=%ld] PopAsync wait", this->getId());
+        rq_.wait_async(r, slot);
+        return ChannelAsync::queued;
+    }
+
+    bool Closed()
+    {
+        return closed_;
+    }
+
     ~LockedChannelImpl() {
         DebugPrint1(dbg_mask_ + "dbg_channel", "[id=%ld] Channel destory.", this->getId());
 
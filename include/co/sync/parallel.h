@@ -0,0 +1,360 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "common/inc/SpinLock.h"
+#include "common/inc/LangSupport.h"
+#include "scheduler/Scheduler.h"
+#include "co/sync/stack_wait_list.h"
+#include <exception>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+#include <mutex>
+#include <type_traits>
+
+namespace co
+{
+
+// 并行算法的共享状态
+// 区间以[0, n)的偏移表示, 递归二分: 右半边派生(Fork)成一个可被认领的子区间, 左半边继续二分,
+// 直到不超过grain后直接执行, 再倒序认领自己派生的子区间.
+// 每个子区间对应一个共享栈协程, 优先交给空闲的P; 其他P上的协程先认领到就在那里执行(被偷走),
+// 否则由派生者自己执行, 派生者从不等待自己派生的子区间, 只有发起者等待全部结束.
+// 发起者和每个协程各持有一个引用.
+class ParallelJob : public RefObject
+{
+public:
+    struct Piece
+    {
+        Piece* next = nullptr;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+        std::atomic<bool> claimed{false};
+    };
+
+    // 单个执行栈上最多派生的子区间数量, 二分时不会超过
+    static const int kMaxForks = 64;
+
+    explicit ParallelJob(std::size_t grain);
+    ~ParallelJob();
+
+    ALWAYS_INLINE std::size_t grain() const { return grain_; }
+
+    // 有子区间抛出了异常, 其余的子区间不再执行
+    ALWAYS_INLINE bool Stopped() const { return stopped_.load(std::memory_order_relaxed); }
+
+    // 派生子区间
+    Piece* Fork(std::size_t begin, std::size_t end);
+
+    // 认领成功时由调用者执行该子区间, 执行完调用Finish
+    ALWAYS_INLINE bool Claim(Piece* p)
+    {
+        return !p->claimed.load(std::memory_order_relaxed) &&
+            !p->claimed.exchange(true, std::memory_order_acq_rel);
+    }
+
+    void Finish();
+
+    // 记录第一个异常, 停止执行其余的子区间
+    void Fail(std::exception_ptr eptr);
+
+    // 协程入口: 认领并执行子区间, 然后释放引用
+    void RunPiece(Piece* p);
+
+    // 发起者调用: 把[0, n)平分成parts段交给各P, 自己执行第一段并倒序认领其余的段,
+    // 然后等待全部结束(协程中挂起, 原生线程阻塞), 重新抛出第一个异常
+    void Launch(std::size_t n, std::size_t parts);
+
+    // 二分执行[begin, end), leaf(b, e)执行不超过grain的一段
+    template <typename Leaf>
+    void Split(std::size_t begin, std::size_t end, Leaf & leaf)
+    {
+        Piece* forks[kMaxForks];
+        int n = 0;
+        while (end - begin > grain_ && n < kMaxForks) {
+            std::size_t mid = begin + (end - begin) / 2;
+            forks[n++] = Fork(mid, end);
+            end = mid;
+        }
+
+        if (!Stopped())
+            leaf(begin, end);
+
+        while (n > 0) {
+            Piece* p = forks[--n];
+            if (!Claim(p))
+                continue;
+
+            try {
+                Split(p->begin, p->end, leaf);
+            } catch (...) {
+                Fail(std::current_exception());
+            }
+            Finish();
+        }
+    }
+
+protected:
+    // 执行认领到的区间, 期间可以继续Fork/Claim
+    virtual void Execute(std::size_t begin, std::size_t end) = 0;
+
+private:
+    ParallelJob(ParallelJob const&) = delete;
+    ParallelJob& operator=(ParallelJob const&) = delete;
+
+    // Execute, 异常转给Fail, 然后Finish
+    void Run(std::size_t begin, std::size_t end);
+
+    Piece* NewPiece(std::size_t begin, std::size_t end);
+
+    void Wait();
+
+    std::size_t grain_;
+    Scheduler* scheduler_;
+    std::atomic<bool> stopped_{false};
+    std::atomic<std::size_t> pending_{0};
+
+    // 所有子区间, 随job一起释放
+    std::atomic<Piece*> pieces_{nullptr};
+    std::vector<Piece*> parts_;
+
+    StackWaitList waiters_;
+    std::exception_ptr eptr_;
+};
+
+// 未指定grain时: 每个P大约分到8段
+std::size_t ParallelDefaultGrain(std::size_t n);
+
+// 发起者所在的环境无法并行(只有一个P且当前就在它上面)时直接串行执行
+bool ParallelSerialOnly();
+
+template <typename Index, typename F>
+class ParallelForJob : public ParallelJob
+{
+public:
+    ParallelForJob(Index first, std::size_t grain, F & fn)
+        : ParallelJob(grain), first_(first), fn_(fn) {}
+
+protected:
+    void Execute(std::size_t begin, std::size_t end) override
+    {
+        auto leaf = [this](std::size_t b, std::size_t e) {
+            for (; b < e; ++b)
+                fn_(static_cast<Index>(first_ + b));
+        };
+        Split(begin, end, leaf);
+    }
+
+private:
+    Index first_;
+    F & fn_;
+};
+
+template <typename Index, typename T, typename Map, typename Reduce>
+class ParallelReduceJob : public ParallelJob
+{
+public:
+    ParallelReduceJob(Index first, std::size_t grain, T const& identity, Map & map, Reduce & reduce)
+        : ParallelJob(grain), first_(first), identity_(identity), result_(identity), map_(map), reduce_(reduce) {}
+
+    T & result() { return result_; }
+
+protected:
+    // 每个执行者(协程或发起者)在自己的累加值上归约认领到的所有子区间, 最后合并一次
+    void Execute(std::size_t begin, std::size_t end) override
+    {
+        T acc(identity_);
+        auto leaf = [this, &acc](std::size_t b, std::size_t e) {
+            for (; b < e; ++b)
+                acc = reduce_(std::move(acc), map_(static_cast<Index>(first_ + b)));
+        };
+        Split(begin, end, leaf);
+
+        std::unique_lock<LFLock> lock(lock_);
+        result_ = reduce_(std::move(result_), std::move(acc));
+    }
+
+private:
+    Index first_;
+    T const& identity_;
+    T result_;
+    Map & map_;
+    Reduce & reduce_;
+    LFLock lock_;
+};
+
+template <typename RandomIt, typename Compare>
+class ParallelSortJob : public ParallelJob
+{
+public:
+    ParallelSortJob(RandomIt first, std::size_t grain, Compare & comp)
+        : ParallelJob(grain), first_(first), comp_(comp) {}
+
+protected:
+    void Execute(std::size_t begin, std::size_t end) override
+    {
+        Sort(begin, end);
+    }
+
+private:
+    typedef typename std::iterator_traits<RandomIt>::value_type value_type;
+
+    // 快排: 较大的一边派生出去, 在较小的一边上继续划分, 派生数量不超过log2(n)
+    void Sort(std::size_t begin, std::size_t end)
+    {
+        Piece* forks[kMaxForks];
+        int n = 0;
+        while (end - begin > grain() && n < kMaxForks && !Stopped()) {
+            std::size_t mid = Partition(begin, end);
+            if (mid == end) {
+                // 全部等价, 已有序
+                end = begin;
+                break;
+            }
+
+            if (mid - begin < end - mid) {
+                forks[n++] = Fork(mid, end);
+                end = mid;
+            } else {
+                forks[n++] = Fork(begin, mid);
+                begin = mid;
+            }
+        }
+
+        if (!Stopped())
+            std::sort(first_ + begin, first_ + end, comp_);
+
+        while (n > 0) {
+            Piece* p = forks[--n];
+            if (!Claim(p))
+                continue;
+
+            try {
+                Sort(p->begin, p->end);
+            } catch (...) {
+                Fail(std::current_exception());
+            }
+            Finish();
+        }
+    }
+
+    // 三数取中选主元, 返回划分点; 全部等价时返回end
+    std::size_t Partition(std::size_t begin, std::size_t end)
+    {
+        RandomIt lo = first_ + begin, hi = first_ + end;
+        RandomIt a = lo, b = lo + (end - begin) / 2, c = hi - 1;
+        if (comp_(*b, *a)) std::swap(a, b);
+        if (comp_(*c, *b)) b = comp_(*c, *a) ? a : c;
+        value_type pivot(*b);
+
+        RandomIt mid = std::partition(lo, hi, [&](value_type const& v){ return comp_(v, pivot); });
+        if (mid == lo) {
+            // 主元是最小值: 与它等价的放左边, 左边整段已有序
+            mid = std::partition(lo, hi, [&](value_type const& v){ return !comp_(pivot, v); });
+        }
+        return begin + (mid - lo);
+    }
+
+    RandomIt first_;
+    Compare & comp_;
+};
+
+/// 并行循环
+// 对[first, last)中的每个i调用fn(i), 在调度器的P上并行执行; fn可能在多个线程上同时调用.
+// 区间递归二分到不超过grain的段, 空闲的P认领派生出去的段(工作窃取), 没被认领的由派生者自己执行.
+// 在协程中调用时, 调用者自己执行一部分, 剩余的段在其他P上执行完之前挂起(不阻塞所在的P);
+// 在原生线程中调用时, 调用线程同样参与执行, 然后阻塞等待.
+// fn抛出的第一个异常会停止其余的段, 并在所有已开始的段结束后重新抛出.
+template <typename Index, typename F>
+void parallel_for(Index first, Index last, std::size_t grain, F && fn)
+{
+    static_assert(std::is_integral<Index>::value, "parallel_for needs an integral index");
+    if (!(first < last))
+        return ;
+
+    std::size_t n = static_cast<std::size_t>(last - first);
+    if (!grain) grain = ParallelDefaultGrain(n);
+    if (n <= grain || ParallelSerialOnly()) {
+        for (Index i = first; i < last; ++i)
+            fn(i);
+        return ;
+    }
+
+    ParallelForJob<Index, typename std::remove_reference<F>::type> *job =
+        new ParallelForJob<Index, typename std::remove_reference<F>::type>(first, grain, fn);
+    AutoRelease<ParallelJob> release(job);
+    job->Launch(n, 0);
+}
+
+template <typename Index, typename F>
+void parallel_for(Index first, Index last, F && fn)
+{
+    parallel_for(first, last, 0, std::forward<F>(fn));
+}
+
+/// 并行归约
+// 返回 reduce(...reduce(identity, map(first))..., map(last - 1)),
+// 各段的归约顺序不确定, reduce需满足结合律和交换律, identity需是reduce的单位元.
+template <typename Index, typename T, typename Map, typename Reduce>
+T parallel_reduce(Index first, Index last, std::size_t grain, T identity, Map && map, Reduce && reduce)
+{
+    static_assert(std::is_integral<Index>::value, "parallel_reduce needs an integral index");
+    if (!(first < last))
+        return identity;
+
+    std::size_t n = static_cast<std::size_t>(last - first);
+    if (!grain) grain = ParallelDefaultGrain(n);
+    if (n <= grain || ParallelSerialOnly()) {
+        T acc(identity);
+        for (Index i = first; i < last; ++i)
+            acc = reduce(std::move(acc), map(i));
+        return acc;
+    }
+
+    typedef ParallelReduceJob<Index, T, typename std::remove_reference<Map>::type,
+            typename std::remove_reference<Reduce>::type> job_t;
+    job_t *job = new job_t(first, grain, identity, map, reduce);
+    AutoRelease<ParallelJob> release(job);
+    job->Launch(n, 0);
+    return std::move(job->result());
+}
+
+template <typename Index, typename T, typename Map, typename Reduce>
+T parallel_reduce(Index first, Index last, T identity, Map && map, Reduce && reduce)
+{
+    return parallel_reduce(first, last, 0, std::move(identity), std::forward<Map>(map), std::forward<Reduce>(reduce));
+}
+
+/// 并行排序(不稳定)
+// 并行快排: 划分后较大的一边派生出去, 不超过grain的段用std::sort.
+template <typename RandomIt, typename Compare>
+void parallel_sort(RandomIt first, RandomIt last, std::size_t grain, Compare comp)
+{
+    if (last - first < 2)
+        return ;
+
+    std::size_t n = static_cast<std::size_t>(last - first);
+    if (!grain) grain = (std::max<std::size_t>)(ParallelDefaultGrain(n), 2048);
+    if (n <= grain || ParallelSerialOnly()) {
+        std::sort(first, last, comp);
+        return ;
+    }
+
+    ParallelSortJob<RandomIt, Compare> *job = new ParallelSortJob<RandomIt, Compare>(first, grain, comp);
+    AutoRelease<ParallelJob> release(job);
+    job->Launch(n, 1);
+}
+
+template <typename RandomIt, typename Compare>
+void parallel_sort(RandomIt first, RandomIt last, Compare comp)
+{
+    parallel_sort(first, last, 0, comp);
+}
+
+template <typename RandomIt>
+void parallel_sort(RandomIt first, RandomIt last)
+{
+    parallel_sort(first, last, 0, std::less<typename std::iterator_traits<RandomIt>::value_type>());
+}
+
+} //namespace co
@@ -0,0 +1,163 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+
+namespace co {
+
+// 分段队列
+// 由固定大小的chunk串成的单链表, 读写各占一端.
+// 用空的chunk通过freelist回收复用, 稳定状态下push/pop不再分配内存,
+// 内存占用与实际元素数量成正比(外加最多maxFreeChunks个空闲chunk).
+// 非线程安全, 由外部加锁.
+template <typename T, std::size_t ChunkSize = 256>
+class SegmentedQueue
+{
+    static_assert(ChunkSize > 0, "ChunkSize must be greater than 0");
+
+    struct Chunk
+    {
+        Chunk* next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type slots[ChunkSize];
+
+        ALWAYS_INLINE T* at(std::size_t idx) {
+            return reinterpret_cast<T*>(&slots[idx]);
+        }
+    };
+
+    Chunk* head_;       // pop端
+    Chunk* tail_;       // push端
+    std::size_t read_;  // head_中下一个要读的槽位
+    std::size_t write_; // tail_中下一个要写的槽位
+    std::size_t size_;
+
+    Chunk* free_;
+    std::size_t freeCount_;
+    const std::size_t maxFreeChunks_;
+
+    // 当前持有的chunk数量(包括freelist)
+    std::size_t chunkCount_;
+
+public:
+    // @maxFreeChunks: freelist中最多缓存的空闲chunk数量
+    explicit SegmentedQueue(std::size_t maxFreeChunks = 4)
+        : head_(nullptr), tail_(nullptr), read_(0), write_(0), size_(0)
+        , free_(nullptr), freeCount_(0), maxFreeChunks_(maxFreeChunks)
+        , chunkCount_(0)
+    {
+    }
+
+    ~SegmentedQueue()
+    {
+        while (size_ > 0) {
+            head_->at(read_)->~T();
+            advanceRead();
+        }
+        if (head_)
+            DeleteChunk(head_);
+        while (free_) {
+            Chunk* c = free_;
+            free_ = free_->next;
+            DeleteChunk(c);
+        }
+    }
+
+    SegmentedQueue(SegmentedQueue const&) = delete;
+    SegmentedQueue& operator=(SegmentedQueue const&) = delete;
+
+    template <typename Arg>
+    ALWAYS_INLINE void push(Arg && arg)
+    {
+        if (UNLIKELY(!tail_)) {
+            head_ = tail_ = NewChunk();
+            read_ = write_ = 0;
+        } else if (UNLIKELY(write_ == ChunkSize)) {
+            Chunk* c = NewChunk();
+            tail_->next = c;
+            tail_ = c;
+            write_ = 0;
+        }
+
+        new (tail_->at(write_)) T(std::forward<Arg>(arg));
+        ++write_;
+        ++size_;
+    }
+
+    template <typename Arg>
+    ALWAYS_INLINE bool pop(Arg & arg)
+    {
+        if (size_ == 0)
+            return false;
+
+        T* ptr = head_->at(read_);
+        arg = std::move(*ptr);
+        ptr->~T();
+        advanceRead();
+        return true;
+    }
+
+    ALWAYS_INLINE std::size_t size() const { return size_; }
+
+    ALWAYS_INLINE bool empty() const { return size_ == 0; }
+
+    // 当前持有的chunk数量, 用于统计内存占用
+    std::size_t chunk_count() const { return chunkCount_; }
+
+    static constexpr std::size_t chunk_bytes() { return sizeof(Chunk); }
+
+private:
+    ALWAYS_INLINE void advanceRead()
+    {
+        --size_;
+        if (++read_ < ChunkSize) {
+            if (size_ == 0 && head_ == tail_) {
+                // 队列读空了, 复用当前chunk, 从头开始写
+                read_ = write_ = 0;
+            }
+            return ;
+        }
+
+        // 当前chunk读完了
+        if (head_ == tail_) {
+            read_ = write_ = 0;
+            return ;
+        }
+
+        Chunk* c = head_;
+        head_ = head_->next;
+        read_ = 0;
+        FreeChunk(c);
+    }
+
+    Chunk* NewChunk()
+    {
+        Chunk* c = free_;
+        if (c) {
+            free_ = c->next;
+            --freeCount_;
+        } else {
+            c = static_cast<Chunk*>(::operator new(sizeof(Chunk)));
+            ++chunkCount_;
+        }
+        c->next = nullptr;
+        return c;
+    }
+
+    void FreeChunk(Chunk* c)
+    {
+        if (freeCount_ < maxFreeChunks_) {
+            c->next = free_;
+            free_ = c;
+            ++freeCount_;
+            return ;
+        }
+
+        DeleteChunk(c);
+    }
+
+    void DeleteChunk(Chunk* c)
+    {
+        ::operator delete(c);
+        --chunkCount_;
+    }
+};
+
+} // namespace co
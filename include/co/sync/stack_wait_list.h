@@ -0,0 +1,172 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "common/inc/Clock.h"
+#include "processor/Processor.h"
+#include <mutex>
+#include <condition_variable>
+
+namespace co
+{
+
+// 等待者链表
+// 等待节点分配在等待者自己的栈上, 入队/唤醒均不分配内存(共享栈协程除外, 见SuspendLocal).
+// 协程等待者通过Processor::Suspend/Wakeup挂起和唤醒, 原生线程等待者使用节点内的条件变量.
+// 所有操作都需要在持有mutex()时调用.
+class StackWaitList
+{
+public:
+    typedef std::mutex lock_t;
+
+    struct Node
+    {
+        Node* next = nullptr;
+        Processor::SuspendEntry entry;
+        Resumable* resumable = nullptr;     // 无栈协程等待者, 节点在它的协程帧里
+        std::condition_variable cv;
+        bool done = false;
+    };
+
+    StackWaitList() = default;
+    StackWaitList(StackWaitList const&) = delete;
+    StackWaitList& operator=(StackWaitList const&) = delete;
+
+    ~StackWaitList()
+    {
+        assert(!head_);
+    }
+
+    ALWAYS_INLINE lock_t& mutex() { return lock_; }
+
+    ALWAYS_INLINE bool empty() const { return !head_; }
+
+    // 挂起当前协程/线程直到被wakeOne/wakeAll唤醒.
+    // 返回时lock已释放.
+    void park(std::unique_lock<lock_t> & lock)
+    {
+        SuspendLocal<Node> node;
+        push(node.get());
+
+        if (Processor::IsCoroutine()) {
+            // 先登记挂起, 再释放锁, 唤醒者在锁内拿到的entry一定有效
+            node->entry = Processor::Suspend();
+            lock.unlock();
+            Processor::StaticCoYield();
+            assert(node->done);
+            return ;
+        }
+
+        // 唤醒者在持锁时notify, 节点的生命周期不会早于notify结束
+        node->cv.wait(lock, [&]{ return node->done; });
+        lock.unlock();
+    }
+
+    // 带超时的挂起, 超时返回false(此时已从链表中移除).
+    // 返回时lock已释放.
+    bool park_for(std::unique_lock<lock_t> & lock, FastSteadyClock::duration dur)
+    {
+        SuspendLocal<Node> node;
+        push(node.get());
+
+        if (Processor::IsCoroutine()) {
+            node->entry = Processor::Suspend(dur);
+            lock.unlock();
+            Processor::StaticCoYield();
+            lock.lock();
+        } else {
+            node->cv.wait_for(lock, dur, [&]{ return node->done; });
+        }
+
+        bool done = node->done;
+        if (!done)
+            erase(node.get());
+        lock.unlock();
+        return done;
+    }
+
+    // 登记一个已挂起的无栈协程, 唤醒时把它交给P恢复.
+    // 返回时lock仍持有; 释放锁之后节点随时可能被唤醒并失效.
+    void park_async(Node* node, Resumable* r)
+    {
+        node->resumable = r;
+        push(node);
+    }
+
+    // 唤醒队首的一个等待者
+    bool wakeOne()
+    {
+        Node* node = head_;
+        if (!node)
+            return false;
+
+        head_ = node->next;
+        if (!head_)
+            tail_ = nullptr;
+
+        wake(node);
+        return true;
+    }
+
+    // 唤醒所有等待者
+    std::size_t wakeAll()
+    {
+        std::size_t n = 0;
+        while (wakeOne())
+            ++n;
+        return n;
+    }
+
+private:
+    ALWAYS_INLINE void push(Node* node)
+    {
+        if (tail_)
+            tail_->next = node;
+        else
+            head_ = node;
+        tail_ = node;
+    }
+
+    void erase(Node* node)
+    {
+        Node* prev = nullptr;
+        for (Node* pos = head_; pos; prev = pos, pos = pos->next) {
+            if (pos != node)
+                continue;
+
+            if (prev)
+                prev->next = node->next;
+            else
+                head_ = node->next;
+            if (tail_ == node)
+                tail_ = prev;
+            return ;
+        }
+    }
+
+    ALWAYS_INLINE void wake(Node* node)
+    {
+        if (node->resumable) {
+            Resumable* r = node->resumable;
+            node->done = true;
+            Processor::PostResumable(r);
+            return ;
+        }
+
+        if (node->entry) {
+            // 协程被唤醒后栈上的节点随时可能失效, 先把entry取出来
+            Processor::SuspendEntry entry = std::move(node->entry);
+            node->done = true;
+            Processor::Wakeup(entry);
+            return ;
+        }
+
+        node->done = true;
+        node->cv.notify_one();
+    }
+
+private:
+    lock_t lock_;
+    Node* head_ = nullptr;
+    Node* tail_ = nullptr;
+};
+
+} //namespace co
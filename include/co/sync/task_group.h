@@ -0,0 +1,132 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "common/inc/Clock.h"
+#include "task/CancelToken.h"
+#include "scheduler/Scheduler.h"
+#include "co/sync/stack_wait_list.h"
+#include <exception>
+#include <type_traits>
+
+namespace co
+{
+
+// TaskGroup的共享状态, 同时是组内协程的取消令牌
+// TaskGroup和组内每个协程各持有一个引用.
+class TaskGroupState : public CancelToken
+{
+public:
+    explicit TaskGroupState(CancelToken* parent) : CancelToken(parent) {}
+
+    ALWAYS_INLINE void Add() { pending_.fetch_add(1, std::memory_order_relaxed); }
+
+    // 组内协程结束
+    void Done();
+
+    // 组内协程抛出异常: 记录第一个并取消整组
+    void Fail(std::exception_ptr eptr);
+
+    // 等待组内协程全部结束, 不是取消点
+    void Wait();
+
+    // 超时返回false, 可以被取消提前唤醒
+    bool WaitUntil(FastSteadyClock::time_point deadline);
+
+    // 无栈协程的等待: 已全部结束时返回false; 否则登记已挂起的r并返回true
+    bool WaitAsync(StackWaitList::Node* node, Resumable* r);
+
+    std::exception_ptr Error();
+
+    ALWAYS_INLINE std::size_t Pending() const { return pending_.load(std::memory_order_acquire); }
+
+private:
+    std::atomic<std::size_t> pending_{0};
+    StackWaitList waiters_;
+    std::exception_ptr eptr_;
+};
+
+// 组内协程的入口: 用户函数执行完先析构(释放捕获的对象), 再计数
+template <typename F>
+struct TaskGroupCall
+{
+    TaskGroupState* state_;     // 协程持有引用(Task::cancel_), 执行期间一定有效
+    F fn_;
+
+    void operator()()
+    {
+        {
+            F fn(std::move(fn_));
+            try {
+                fn();
+            } catch (task_cancelled const&) {
+            } catch (...) {
+                state_->Fail(std::current_exception());
+            }
+        }
+        state_->Done();
+    }
+};
+
+/// 协程组
+// spawn创建的协程属于本组, wait等待它们全部结束, cancel取消它们.
+// 取消是协作式的: 组内协程在取消点(channel读写, sleep, 带超时的挂起, hook的io, JoinHandle的等待)
+// 提前醒来, C++接口抛出co::task_cancelled, hook的C接口以ECANCELED失败返回.
+// 组内协程用go创建的子协程继承同一个取消令牌(随组一起取消, 但wait不等待它们);
+// 在组内协程中创建的TaskGroup随外层的组一起取消.
+// 组内协程抛出的第一个异常(task_cancelled除外)会取消整组, 并由wait重新抛出.
+// 析构时取消尚未结束的协程并等待它们退出.
+class TaskGroup
+{
+public:
+    TaskGroup();
+    ~TaskGroup();
+
+    template <typename F>
+    void spawn(F && fn)
+    {
+        spawn(TaskOpt(), std::forward<F>(fn));
+    }
+
+    // 已取消的组不再创建协程
+    template <typename F>
+    void spawn(TaskOpt opt, F && fn)
+    {
+        if (state_->cancelled())
+            return ;
+
+        state_->Add();
+        opt.cancel_ = state_;
+        Scheduler* scheduler = Processor::GetCurrentScheduler();
+        if (!scheduler) scheduler = &Scheduler::getInstance();
+        scheduler->CreateTask(TaskGroupCall<typename std::decay<F>::type>{state_, std::forward<F>(fn)}, opt);
+    }
+
+    // 等待组内协程全部结束
+    void wait();
+
+    // 无栈协程的等待(co_await), 见co/async.h
+    bool wait_async(StackWaitList::Node* node, Resumable* r);
+
+    // 在期限内等到全部结束返回true, 超时(或当前协程被取消)返回false
+    bool wait_until(FastSteadyClock::time_point deadline);
+
+    template <typename Rep, typename Period>
+    bool wait_for(std::chrono::duration<Rep, Period> const& dur)
+    {
+        return wait_until(FastSteadyClock::now() + dur);
+    }
+
+    void cancel();
+
+    bool cancelled() const;
+
+    // 尚未结束的协程数量
+    std::size_t size() const;
+
+private:
+    TaskGroup(TaskGroup const&) = delete;
+    TaskGroup& operator=(TaskGroup const&) = delete;
+
+    TaskGroupState* state_;
+};
+
+} //namespace co
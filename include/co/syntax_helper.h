@@ -9,6 +9,9 @@ enum {
     opt_stack_size,
     opt_dispatch,
     opt_affinity,
+    opt_shared_stack,
+    opt_processor,
+    opt_detach_cancel,
 };
 
 template <int OptType>
@@ -36,6 +39,27 @@ struct __go_option<opt_affinity>
     explicit __go_option(bool affinity) : affinity_(affinity) {}
 };
 
+template <>
+struct __go_option<opt_shared_stack>
+{
+    bool shared_stack_;
+    explicit __go_option(bool shared_stack) : shared_stack_(shared_stack) {}
+};
+
+template <>
+struct __go_option<opt_processor>
+{
+    int processor_;
+    explicit __go_option(int processor) : processor_(processor) {}
+};
+
+template <>
+struct __go_option<opt_detach_cancel>
+{
+    bool detach_cancel_;
+    explicit __go_option(bool detach_cancel) : detach_cancel_(detach_cancel) {}
+};
+
 struct __go
 {
     __go(const char* file, int lineno)
@@ -71,6 +95,24 @@ struct __go
         return *this;
     }
 
+    ALWAYS_INLINE __go& operator-(__go_option<opt_shared_stack> const& opt)
+    {
+        opt_.shared_stack_ = opt.shared_stack_;
+        return *this;
+    }
+
+    ALWAYS_INLINE __go& operator-(__go_option<opt_processor> const& opt)
+    {
+        opt_.processor_ = opt.processor_;
+        return *this;
+    }
+
+    ALWAYS_INLINE __go& operator-(__go_option<opt_detach_cancel> const& opt)
+    {
+        opt_.detach_cancel_ = opt.detach_cancel_;
+        return *this;
+    }
+
     TaskOpt opt_;
     Scheduler* scheduler_;
 };
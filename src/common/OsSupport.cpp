@@ -26,14 +26,10 @@ static int staticInitialize()
     // costeam_ = new CoStream();
 
     // scheduler
-    TaskRefInit(Affinity);
     TaskRefInit(Location);
     TaskRefInit(DebugInfo);
     TaskRefInit(SuspendId);
 
-    // cls
-    TaskRefInit(ClsMap);
-
 #if ENABLE_HOOK
   #if defined(OS_Linux) || defined(OS_Windows)
     initHook();
@@ -50,8 +46,11 @@ void coInitialize()
 
 std::mutex gDbgLock;
 
+std::atomic<uint64_t> gDbgMask{0};
+
 CoroutineOptions::CoroutineOptions()
-    : protect_stack_page(StackTraits::GetProtectStackPageSize()),
+    : debug(gDbgMask),
+    protect_stack_page(StackTraits::GetProtectStackPageSize()),
     stack_malloc_fn(StackTraits::MallocFunc()),
     stack_free_fn(StackTraits::FreeFunc())
 {
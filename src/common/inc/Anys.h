@@ -7,6 +7,8 @@
 #include <mutex>
 #include <assert.h>
 #include <memory>
+#include <cstddef>
+#include <stdexcept>
 
 namespace co
 {
@@ -15,6 +17,8 @@ template <typename Group>
 class Anys
 {
 public:
+    static const std::size_t kMaxAlign = alignof(std::max_align_t);
+
     typedef void (*Constructor)(void*);
     typedef void (*Destructor)(void*);
 
@@ -45,26 +49,47 @@ public:
         if (!inited.try_lock())
             throw std::logic_error("Anys::Register mustbe at front of new first instance.");
 
+        if (std::alignment_of<T>::value > kMaxAlign)
+            throw std::logic_error("Anys::Register alignment of T is too large.");
+
+        // 存储的起始地址按kMaxAlign对齐, 每个kv的偏移量在注册时即可确定
         KeyInfo info;
         info.align = std::alignment_of<T>::value;
         info.size = sizeof(T);
-        info.offset = StorageLen();
+        info.offset = (StorageLen() + info.align - 1) & ~(std::size_t)(info.align - 1);
         info.constructor = constructor;
         info.destructor = destructor;
         GetKeys().push_back(info);
-        StorageLen() += info.align + info.size - 1;
+        StorageLen() = info.offset + info.size;
         Size()++;
         return GetKeys().size() - 1;
     }
 
+    // 注册时返回的index对应的存储偏移量
+    static std::size_t Offset(std::size_t index)
+    {
+        return GetKeys()[index].offset;
+    }
+
+    // 每个实例需要的存储大小, 调用后不能再注册
+    static std::size_t StorageSize()
+    {
+        GetInitGuard().try_lock();
+        return StorageLen();
+    }
+
     template <typename T>
     ALWAYS_INLINE T& get(std::size_t index)
     {
-        if (index >= *(std::size_t*)hold_)
-            throw std::logic_error("Anys::get overflow");
+        assert(index < Size());
+        return at<T>(Offset(index));
+    }
 
-        char *p = storage_ + offsets_[index];
-        return *reinterpret_cast<T*>(p);
+    // 按偏移量取数据, 省去查表
+    template <typename T>
+    ALWAYS_INLINE T& at(std::size_t offset)
+    {
+        return *reinterpret_cast<T*>(storage_ + offset);
     }
 
 private:
@@ -103,46 +128,37 @@ private:
     }
 
 private:
-    // TODO: 优化:紧凑内存布局, 提高利用率
-    char* hold_;
-    std::size_t* offsets_;
     char* storage_;
+    bool owned_;
 
 public:
     Anys()
-        : hold_(nullptr), offsets_(nullptr), storage_(nullptr)
+        : storage_(nullptr), owned_(true)
     {
-        GetInitGuard().try_lock();
-        if (!Size()) return ;
-        hold_ = (char*)malloc(sizeof(std::size_t) * (Size() + 1) + StorageLen());
-        storage_ = hold_ + sizeof(std::size_t) * (Size() + 1);
-        *(std::size_t*)hold_ = Size();
-        offsets_ = (std::size_t*)(hold_ + sizeof(std::size_t));
-        for (std::size_t i = 0; i < Size(); i++) {
-            auto const& keyInfo = GetKeys()[i];
-            std::size_t offset = keyInfo.offset;
-            std::size_t space = keyInfo.align + keyInfo.size - 1;
-            char *base = storage_ + offset;
-            void *ptr = base;
-            if (!align(keyInfo.align, keyInfo.size, ptr, space))
-                throw std::logic_error("Anys::get call std::align error");
-            offset += (char*)ptr - base;
-            offsets_[i] = offset;
-        }
+        if (StorageSize())
+            storage_ = (char*)malloc(StorageSize());
+        Init();
+    }
+
+    // 使用外部存储(不小于StorageSize(), 按kMaxAlign对齐), 如宿主对象尾部的一段内存
+    explicit Anys(void* storage)
+        : storage_((char*)storage), owned_(false)
+    {
+        StorageSize();
         Init();
     }
 
     ~Anys()
     {
         Deinit();
-        if (hold_) {
-            free(hold_);
-            hold_ = nullptr;
-            offsets_ = nullptr;
-            storage_ = nullptr;
-        }
+        if (owned_ && storage_)
+            free(storage_);
+        storage_ = nullptr;
     }
 
+    Anys(Anys const&) = delete;
+    Anys& operator=(Anys const&) = delete;
+
     void Reset()
     {
         Deinit();
@@ -158,8 +174,7 @@ public:
             if (!keyInfo.constructor)
                 continue;
 
-            char *p = storage_ + offsets_[i];
-            keyInfo.constructor(p);
+            keyInfo.constructor(storage_ + keyInfo.offset);
         }
     }
 
@@ -172,23 +187,7 @@ public:
             if (!keyInfo.destructor)
                 continue;
 
-            char *p = storage_ + offsets_[i];
-            keyInfo.destructor(p);
-        }
-    }
-
-    // Copy from g++ std.
-    inline void* align(size_t __align, size_t __size, void*& __ptr, size_t& __space) noexcept
-    {
-        const auto __intptr = reinterpret_cast<uintptr_t>(__ptr);
-        const auto __aligned = (__intptr - 1u + __align) & -__align;
-        const auto __diff = __aligned - __intptr;
-        if ((__size + __diff) > __space)
-            return nullptr;
-        else
-        {
-            __space -= __diff;
-            return __ptr = reinterpret_cast<void*>(__aligned);
+            keyInfo.destructor(storage_ + keyInfo.offset);
         }
     }
 };
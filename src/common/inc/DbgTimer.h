@@ -9,8 +9,8 @@ namespace co {
     } while (0)
 
 struct DbgTimer {
-    explicit DbgTimer(std::string dbgMask) {
-        active_ = (CoroutineOptions::getInstance().debug(dbgMask)) != 0;
+    explicit DbgTimer(uint64_t dbgMask) {
+        active_ = TraceEnabled(dbgMask);
         if (!active_) return ;
 
         costs_.reserve(32);
@@ -1,12 +1,77 @@
 #pragma once
 
 #include <deque>
+#include <atomic>
+#include <stdexcept>
 
 namespace co
 {
     template <typename T, typename Alloc = std::allocator<T>>
     using Deque = std::deque<T, Alloc>;
 
-    // TODO: 实现多读一写线程安全的deque
+    // 多读一写线程安全的deque: 一个写者push_back, 任意线程同时读size()/operator[]
+    // 元素分段存放, 段一经分配不再移动也不释放, 读者不加锁, 也不需要epoch/引用计数保护;
+    // 读到的size()以内的元素都已写完. 只增不减, 元素写入后不再修改.
+    // 容量上限为 (1 << SegmentBits) * MaxSegments.
+    template <typename T, std::size_t SegmentBits = 6, std::size_t MaxSegments = 1024>
+    class ConcurrentDeque
+    {
+    public:
+        static const std::size_t kSegmentSize = (std::size_t)1 << SegmentBits;
+        static const std::size_t kCapacity = kSegmentSize * MaxSegments;
+
+        ConcurrentDeque()
+        {
+            for (auto & seg : segments_)
+                seg.store(nullptr, std::memory_order_relaxed);
+        }
+
+        ~ConcurrentDeque()
+        {
+            for (auto & seg : segments_)
+                delete[] seg.load(std::memory_order_relaxed);
+        }
+
+        ConcurrentDeque(ConcurrentDeque const&) = delete;
+        ConcurrentDeque& operator=(ConcurrentDeque const&) = delete;
+
+        std::size_t size() const
+        {
+            return size_.load(std::memory_order_acquire);
+        }
+
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        // i必须小于读到的size()
+        T const& operator[](std::size_t i) const
+        {
+            T* seg = segments_[i >> SegmentBits].load(std::memory_order_acquire);
+            return seg[i & (kSegmentSize - 1)];
+        }
+
+        // 同一时刻只能有一个写者
+        void push_back(T const& value)
+        {
+            std::size_t n = size_.load(std::memory_order_relaxed);
+            if (n >= kCapacity)
+                throw std::length_error("co::ConcurrentDeque capacity exceeded");
+
+            std::atomic<T*> & seg = segments_[n >> SegmentBits];
+            T* p = seg.load(std::memory_order_relaxed);
+            if (!p) {
+                p = new T[kSegmentSize]();
+                seg.store(p, std::memory_order_release);
+            }
+            p[n & (kSegmentSize - 1)] = value;
+            size_.store(n + 1, std::memory_order_release);
+        }
+
+    private:
+        std::atomic<T*> segments_[MaxSegments];
+        std::atomic<std::size_t> size_{0};
+    };
 
 } // namespace co
@@ -91,19 +91,66 @@ enum class eCoExHandle : uint8_t
     on_listener,        // 使用listener处理, 如果没设置listener则立刻抛出
 };
 
+// 调试跟踪的类别, 可以按位组合
+enum eCoDebugFlags : uint64_t
+{
+    dbg_none            = 0,
+    dbg_all             = ~(uint64_t)0,
+    dbg_hook            = 0x1,
+    dbg_yield           = 0x1 << 1,
+    dbg_scheduler       = 0x1 << 2,
+    dbg_task            = 0x1 << 3,
+    dbg_switch          = 0x1 << 4,
+    dbg_ioblock         = 0x1 << 5,
+    dbg_suspend         = 0x1 << 6,
+    dbg_exception       = 0x1 << 7,
+    dbg_syncblock       = 0x1 << 8,
+    dbg_timer           = 0x1 << 9,
+    dbg_scheduler_sleep = 0x1 << 10,
+    dbg_sleepblock      = 0x1 << 11,
+    dbg_spinlock        = 0x1 << 12,
+    dbg_fd_ctx          = 0x1 << 13,
+    dbg_debugger        = 0x1 << 14,
+    dbg_signal          = 0x1 << 15,
+    dbg_channel         = 0x1 << 16,
+    dbg_thread          = 0x1 << 17,
+    dbg_sys_max,
+};
+
+// 编译期跟踪级别:
+//   0: DebugPrint整个编译掉 (release构建)
+//   1: 只保留冷路径上的类别, 调度/切换/锁/队列等热路径上的编译掉
+//   2: 全部保留, 运行时由co_opt.debug按类别开关
+#ifndef LIBGO_TRACE_LEVEL
+# if defined(NDEBUG)
+#  define LIBGO_TRACE_LEVEL 0
+# else
+#  define LIBGO_TRACE_LEVEL 2
+# endif
+#endif
+
+// 热路径上的类别
+static constexpr uint64_t kTraceHotMask = dbg_yield | dbg_scheduler | dbg_task | dbg_switch
+    | dbg_suspend | dbg_timer | dbg_spinlock | dbg_channel;
+
+// 编译进来的类别
+static constexpr uint64_t kTraceCompiledMask = LIBGO_TRACE_LEVEL >= 2 ? (uint64_t)dbg_all
+    : LIBGO_TRACE_LEVEL == 1 ? ~kTraceHotMask : 0;
+
+// 运行时开启的类别, 即co_opt.debug
+extern std::atomic<uint64_t> gDbgMask;
+
 typedef void*(*stack_malloc_fn_t)(size_t size);
 typedef void(*stack_free_fn_t)(void *ptr);
 
 ///---- 配置选项
 struct CoroutineOptions
 {
-    // 调试选项, 例如: dbg_switch 或 dbg_hook|dbg_task|dbg_wait
-    // uint64_t debug = 0;
-    bool debug(std::string dbg) {
-        return false;
-    }
+    // 调试选项, 例如: dbg_switch 或 dbg_hook|dbg_task|dbg_timer
+    // 开启的类别记录到各线程的跟踪缓冲区中, 调用co::TraceDump输出
+    std::atomic<uint64_t> & debug;
 
-    // 调试信息输出位置，改写这个配置项可以重定向输出位置
+    // 调试信息输出位置，改写这个配置项可以重定向co::TraceDump的默认输出位置
     FILE* debug_output = stdout;
 
     // 协程中抛出未捕获异常时的处理方式
@@ -120,6 +167,31 @@ struct CoroutineOptions
     // 调度线程的触发频率(单位：微秒)
     uint32_t dispatcher_thread_cycle_us = 1000;
 
+    // 阻塞时扩展出来的P(超过Start的minThreadNumber部分)连续空闲超过此时长(单位：微秒)后退出线程, 0表示不回收.
+    // 只回收没有挂起协程的P, 再次扩展时复用.
+    uint32_t processor_idle_retire_us = 1000 * 1000;
+
+    // 抢占时间片(单位：微秒), 0表示不抢占(仅Unix)
+    // 协程连续执行超过此时长且本P还有其他协程待执行时, 调度线程向P线程发送SIGURG,
+    // 协程在下一次co_preempt_check()处让出. 实际精度受dispatcher_thread_cycle_us限制.
+    uint32_t preempt_slice_us = 0;
+
+    // co::read/co::write等接口是否使用io_uring(内核不支持时自动退化为普通系统调用)
+    bool enable_io_uring = true;
+
+    // 是否统计调度延迟直方图(创建到首次执行/唤醒到执行/单次执行时长), 见Scheduler::GetMetrics
+    // 开启后每次协程切换多两次读时钟, 计数类指标不受此开关影响, 始终统计
+    bool enable_metrics = false;
+
+    // 协程挂起/yield时是否直接切换到本P的下一个可执行协程, 不经过调度循环(每次切换少一次上下文跳转)
+    // 队列中没有下一个协程或协程执行完毕时仍回到调度循环
+    bool enable_direct_switch = true;
+
+    // 共享栈协程(go co_shared_stack)使用的每个共享栈的大小, 以及每个P的共享栈数量
+    // 只影响之后创建的共享栈, 建议在首次Run前设置.
+    uint32_t shared_stack_size = 1 * 1024 * 1024;
+    int shared_stack_count = 4;
+
     // 栈顶设置保护内存段的内存页数量(仅linux下有效)(默认为0, 即:不设置)
     // 在栈顶内存对齐后的前几页设置为protect属性.
     // 所以开启此选项时, stack_size不能少于protect_stack_page+1页
@@ -184,22 +256,30 @@ private:
 
 extern std::mutex gDbgLock;
 
+// 类别是否开启: 编译期的类别掩码 + 一次relaxed读
+ALWAYS_INLINE bool TraceEnabled(uint64_t type)
+{
+    return (kTraceCompiledMask & type)
+        && UNLIKELY(gDbgMask.load(std::memory_order_relaxed) & type);
+}
+
+// 格式化一条记录写入当前线程的跟踪缓冲区, 不加锁也不做IO
+#if defined(OS_Unix)
+__attribute__((format(printf,5,6)))
+#endif
+void TraceRecord(uint64_t type, const char* file, int line, const char* func, const char* fmt, ...);
+
 } //namespace co
 // #define DbgFlag()
 #define DebugPrint1(type, fmt, ...) \
     do { \
     } while(0)
 
+// 编译期未包含的类别在这里就是常量false, 整个调用被优化掉
 #define DebugPrint(type, fmt, ...) \
     do { \
-        if (UNLIKELY(::co::CoroutineOptions::getInstance().debug(#type))) { \
-            ::co::ErrnoStore es; \
-            std::unique_lock<std::mutex> lock(::co::gDbgLock); \
-            fprintf(::co::CoroutineOptions::getInstance().debug_output, "[%s][%05d][%04d][%06d]%s:%d:(%s)\t " fmt "\n", \
-                    ::co::GetCurrentTimeStr().c_str(),\
-                    ::co::GetCurrentProcessID(), ::co::GetCurrentThreadID(), ::co::GetCurrentCoroID(), \
-                    ::co::BaseFile(__FILE__), __LINE__, __FUNCTION__, ##__VA_ARGS__); \
-            fflush(::co::CoroutineOptions::getInstance().debug_output); \
+        if (::co::TraceEnabled((uint64_t)(type))) { \
+            ::co::TraceRecord((uint64_t)(type), __FILE__, __LINE__, __FUNCTION__, fmt, ##__VA_ARGS__); \
         } \
     } while(0)
 
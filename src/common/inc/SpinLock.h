@@ -1,10 +1,55 @@
 #pragma once
 #include "OsSupport.h"
 #include <exception>
+#include <thread>
 
 namespace co
 {
 
+// 自旋等待时提示cpu降低功耗, 并让出流水线给同核的超线程
+ALWAYS_INLINE void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// 自旋退避策略
+// 前几轮按指数增长的次数执行pause, 超过上限后改为让出线程,
+// 避免长时间持锁时空转占满cpu.
+struct SpinBackoff
+{
+    static const int kMaxPause = 64;
+
+    int pause_ = 1;
+
+    ALWAYS_INLINE void operator()()
+    {
+        if (pause_ <= kMaxPause) {
+            for (int i = 0; i < pause_; ++i)
+                CpuRelax();
+            pause_ <<= 1;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    // 是否已经退避到了让出线程的阶段
+    ALWAYS_INLINE bool IsYielding() const
+    {
+        return pause_ > kMaxPause;
+    }
+
+    ALWAYS_INLINE void Reset()
+    {
+        pause_ = 1;
+    }
+};
+
 struct BooleanFakeLock
 {
     bool locked_ = false;
@@ -47,7 +92,13 @@ struct LFLock
 
     ALWAYS_INLINE void lock()
     {
-        while (flag.test_and_set(std::memory_order_acquire)) ;
+        if (LIKELY(!flag.test_and_set(std::memory_order_acquire)))
+            return ;
+
+        SpinBackoff backoff;
+        do {
+            backoff();
+        } while (flag.test_and_set(std::memory_order_acquire));
     }
 
     ALWAYS_INLINE bool try_lock()
@@ -79,7 +130,15 @@ struct LFLock2
 
     ALWAYS_INLINE void lock()
     {
-        while (state.exchange(true, std::memory_order_acquire)) ;
+        SpinBackoff backoff;
+        for (;;) {
+            if (!state.exchange(true, std::memory_order_acquire))
+                return ;
+
+            // test-and-test-and-set: 只读等待, 减少cache line争用
+            while (state.load(std::memory_order_relaxed))
+                backoff();
+        }
     }
 
     ALWAYS_INLINE bool try_lock()
@@ -239,7 +239,7 @@ void Timer<F>::Stop()
 template <typename F>
 void Timer<F>::RunOnce()
 {
-    DbgTimer dt("dbg_timer");
+    DbgTimer dt(dbg_timer);
 
     Trigger(completeSlot_);
     DBG_TIMER_CHECK(dt);
@@ -263,7 +263,7 @@ void Timer<F>::RunOnce()
     point_.p64 = destPoint.p64;
 	std::atomic_thread_fence(std::memory_order_release);
 #else
-    __atomic_store(&point_.p64, &destPoint.p64, std::memory_order_release);
+    __atomic_store(&point_.p64, &destPoint.p64, __ATOMIC_RELEASE);
 #endif
 
     DBG_TIMER_CHECK(dt);
@@ -342,7 +342,7 @@ FastSteadyClock::time_point Timer<F>::NextTrigger(FastSteadyClock::duration max)
 	std::atomic_thread_fence(std::memory_order_acquire);
 	last.p64 = point_.p64;	
 #else 
-	__atomic_load(&point_.p64, &last.p64, std::memory_order_acquire);
+	__atomic_load(&point_.p64, &last.p64, __ATOMIC_ACQUIRE);
 #endif
 
     auto lastTime = last.p64 * precision_ + begin_;
@@ -434,7 +434,7 @@ sync_retry:
 	std::atomic_thread_fence(std::memory_order_acquire);
     last.p64 = point_.p64;
 #else
-    __atomic_load(&point_.p64, &last.p64, std::memory_order_acquire);
+    __atomic_load(&point_.p64, &last.p64, __ATOMIC_ACQUIRE);
 #endif
     FastSteadyClock::time_point lastTime(begin_ + last.p64 * precision_);
 
@@ -471,7 +471,7 @@ sync_retry:
 		std::atomic_thread_fence(std::memory_order_acquire);
 		atomicPointP64 = point_.p64;
 #else 
-		__atomic_load(&point_.p64, &atomicPointP64, std::memory_order_acquire);
+		__atomic_load(&point_.p64, &atomicPointP64, __ATOMIC_ACQUIRE);
 #endif
        
         if (last.p64 != atomicPointP64) {
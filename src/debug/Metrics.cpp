@@ -0,0 +1,210 @@
+#include "Metrics.h"
+#include "scheduler/Scheduler.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <cmath>
+
+namespace co {
+
+uint64_t LatencyHistogram::BucketUpperBound(int idx)
+{
+    if (idx < kSubBuckets)
+        return idx;
+    int shift = idx / kSubBuckets - 1;
+    uint64_t sub = idx % kSubBuckets;
+    if (shift + kSubBits + 1 >= 64 && sub == kSubBuckets - 1)
+        return UINT64_MAX;
+    return ((kSubBuckets + sub + 1) << shift) - 1;
+}
+
+HistogramSnapshot::HistogramSnapshot(LatencyHistogram const& h)
+    : buckets(LatencyHistogram::kBuckets, 0)
+{
+    for (int i = 0; i < LatencyHistogram::kBuckets; ++i)
+        buckets[i] = h.buckets_[i].load(std::memory_order_relaxed);
+    count = h.count_.load(std::memory_order_relaxed);
+    sum = h.sum_.load(std::memory_order_relaxed);
+    max = h.max_.load(std::memory_order_relaxed);
+}
+
+void HistogramSnapshot::Merge(HistogramSnapshot const& other)
+{
+    for (int i = 0; i < LatencyHistogram::kBuckets; ++i)
+        buckets[i] += other.buckets[i];
+    count += other.count;
+    sum += other.sum;
+    max = (std::max)(max, other.max);
+}
+
+uint64_t HistogramSnapshot::Percentile(double q) const
+{
+    // 各桶是分别读取的, 以桶的合计为准
+    uint64_t total = 0;
+    for (uint64_t n : buckets)
+        total += n;
+    if (!total)
+        return 0;
+
+    uint64_t rank = (uint64_t)std::ceil(q * total);
+    rank = (std::min)((std::max<uint64_t>)(rank, 1), total);
+    uint64_t acc = 0;
+    for (int i = 0; i < LatencyHistogram::kBuckets; ++i) {
+        acc += buckets[i];
+        if (acc >= rank)
+            return (std::min)(LatencyHistogram::BucketUpperBound(i), max ? max : UINT64_MAX);
+    }
+    return max;
+}
+
+uint64_t HistogramSnapshot::CountBelow(uint64_t v) const
+{
+    uint64_t n = 0;
+    for (int i = 0; i < LatencyHistogram::kBuckets; ++i) {
+        if (LatencyHistogram::BucketUpperBound(i) > v)
+            break;
+        n += buckets[i];
+    }
+    return n;
+}
+
+namespace {
+
+struct PromWriter
+{
+    std::string & out;
+    std::string const& prefix;
+
+    void Head(const char* name, const char* type, const char* help)
+    {
+        Printf("# HELP %s_%s %s\n", prefix.c_str(), name, help);
+        Printf("# TYPE %s_%s %s\n", prefix.c_str(), name, type);
+    }
+
+    void Value(const char* name, const char* labels, double v)
+    {
+        Printf("%s_%s%s %.9g\n", prefix.c_str(), name, labels, v);
+    }
+
+    // 输出为秒, le按1-2-5从1us到10s
+    void Histogram(const char* name, int proc, HistogramSnapshot const& h)
+    {
+        static const uint64_t kMaxNs = 10000000000ull;
+        char label[64];
+        uint64_t n = 0;
+        int idx = 0;
+        for (uint64_t decade = 1000; decade <= kMaxNs; decade *= 10)
+            for (uint64_t m : {1, 2, 5}) {
+                uint64_t bound = decade * m;
+                if (bound > kMaxNs)
+                    break;
+                // 和CountBelow一样按桶上界累加, 各le只需扫描一遍
+                for (; idx < LatencyHistogram::kBuckets && LatencyHistogram::BucketUpperBound(idx) <= bound; ++idx)
+                    n += h.buckets[idx];
+                snprintf(label, sizeof(label), "{processor=\"%d\",le=\"%.9g\"}", proc, bound / 1e9);
+                Value(name, label, (double)n, "_bucket");
+            }
+        snprintf(label, sizeof(label), "{processor=\"%d\",le=\"+Inf\"}", proc);
+        Value(name, label, (double)h.count, "_bucket");
+        snprintf(label, sizeof(label), "{processor=\"%d\"}", proc);
+        Value(name, label, h.sum / 1e9, "_sum");
+        Value(name, label, (double)h.count, "_count");
+    }
+
+    void Value(const char* name, const char* labels, double v, const char* suffix)
+    {
+        Printf("%s_%s%s%s %.9g\n", prefix.c_str(), name, suffix, labels, v);
+    }
+
+    void Printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char buf[256];
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+        if (n > 0)
+            out.append(buf, (std::min<size_t>)(n, sizeof(buf) - 1));
+    }
+};
+
+} //namespace
+
+std::string MetricsToPrometheus(SchedulerMetrics const& metrics, std::string const& prefix)
+{
+    std::string out;
+    PromWriter w{out, prefix};
+
+    w.Head("tasks", "gauge", "Number of live coroutines.");
+    w.Value("tasks", "", (double)metrics.taskCount);
+
+    w.Head("processors", "gauge", "Number of processors.");
+    w.Value("processors", "", (double)metrics.processors.size());
+
+    typedef ProcessorMetricsSnapshot P;
+    struct Field { const char* name; const char* type; const char* help; std::function<double(P const&)> get; };
+    const Field fields[] = {
+        {"processor_waiting", "gauge", "Whether the processor is parked.", [](P const& p) { return (double)p.waiting; }},
+        {"processor_retired", "gauge", "Whether the processor has retired its thread.", [](P const& p) { return (double)p.retired; }},
+        {"processor_runnable", "gauge", "Runnable coroutines queued on the processor.", [](P const& p) { return (double)p.runnable; }},
+        {"processor_pinned", "gauge", "Runnable coroutines pinned to the processor.", [](P const& p) { return (double)p.pinned; }},
+        {"processor_blocked", "gauge", "Suspended coroutines owned by the processor.", [](P const& p) { return (double)p.blocked; }},
+        {"processor_switches_total", "counter", "Coroutine switches.", [](P const& p) { return (double)p.switches; }},
+        {"processor_suspends_total", "counter", "Coroutine suspends.", [](P const& p) { return (double)p.suspends; }},
+        {"processor_wakeups_total", "counter", "Suspended coroutines woken up.", [](P const& p) { return (double)p.wakeups; }},
+        {"processor_tasks_added_total", "counter", "New coroutines dispatched to the processor.", [](P const& p) { return (double)p.tasksAdded; }},
+        {"processor_stolen_in_total", "counter", "Coroutines moved in from other processors.", [](P const& p) { return (double)p.stolenIn; }},
+        {"processor_stolen_out_total", "counter", "Coroutines stolen by the dispatcher.", [](P const& p) { return (double)p.stolenOut; }},
+        {"processor_parks_total", "counter", "Times the processor parked with nothing to run.", [](P const& p) { return (double)p.parks; }},
+        {"processor_unparks_total", "counter", "Times a parked processor was notified.", [](P const& p) { return (double)p.unparks; }},
+        {"processor_park_seconds_total", "counter", "Time spent parked.", [](P const& p) { return p.parkNs / 1e9; }},
+        {"processor_preempt_requests_total", "counter", "Preemption requests sent to long-running coroutines.", [](P const& p) { return (double)p.preemptRequests; }},
+        {"processor_preempts_total", "counter", "Coroutines preempted at co_preempt_check().", [](P const& p) { return (double)p.preempts; }},
+        {"processor_retires_total", "counter", "Times the processor retired its thread after idling.", [](P const& p) { return (double)p.retires; }},
+    };
+
+    char label[32];
+    for (Field const& f : fields) {
+        w.Head(f.name, f.type, f.help);
+        for (P const& p : metrics.processors) {
+            snprintf(label, sizeof(label), "{processor=\"%d\"}", p.id);
+            w.Value(f.name, label, f.get(p));
+        }
+    }
+
+    w.Head("create_to_run_seconds", "histogram", "Delay from coroutine creation to its first run.");
+    for (P const& p : metrics.processors)
+        w.Histogram("create_to_run_seconds", p.id, p.createToRun);
+
+    w.Head("wakeup_to_run_seconds", "histogram", "Delay from wakeup to the coroutine running again.");
+    for (P const& p : metrics.processors)
+        w.Histogram("wakeup_to_run_seconds", p.id, p.wakeupToRun);
+
+    w.Head("run_slice_seconds", "histogram", "Time a coroutine runs before switching out.");
+    for (P const& p : metrics.processors)
+        w.Histogram("run_slice_seconds", p.id, p.runSlice);
+    return out;
+}
+
+bool ExportMetrics(Scheduler & scheduler, std::string const& path)
+{
+    std::string text = MetricsToPrometheus(scheduler.GetMetrics());
+    std::string tmp = path + ".tmp";
+    FILE* fp = fopen(tmp.c_str(), "w");
+    if (!fp)
+        return false;
+
+    bool ok = fwrite(text.data(), 1, text.size(), fp) == text.size();
+    ok = (fclose(fp) == 0) && ok;
+    if (ok)
+        ok = rename(tmp.c_str(), path.c_str()) == 0;
+    if (!ok)
+        remove(tmp.c_str());
+    return ok;
+}
+
+void ExportMetrics(Scheduler & scheduler, std::function<void(std::string const&)> const& fn)
+{
+    fn(MetricsToPrometheus(scheduler.GetMetrics()));
+}
+
+} //namespace co
@@ -0,0 +1,162 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "common/inc/Clock.h"
+
+namespace co
+{
+
+class Scheduler;
+
+// 调度器运行指标
+// 计数器和直方图按P分开存放并按cache line对齐, 更新不加锁:
+//   1.只由本P线程写的计数器用relaxed的load+store, 没有原子RMW.
+//   2.其他线程也会写的(投递新协程/偷协程/唤醒)用relaxed的fetch_add.
+// 快照在任意线程读取, 数值之间不保证是同一时刻的.
+
+// 单一写者的计数器累加
+ALWAYS_INLINE void MetricsInc(std::atomic<uint64_t> & c, uint64_t v = 1)
+{
+    c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+// 多个写者的计数器累加
+ALWAYS_INLINE void MetricsAdd(std::atomic<uint64_t> & c, uint64_t v = 1)
+{
+    c.fetch_add(v, std::memory_order_relaxed);
+}
+
+// 延迟直方图, HDR风格的对数分桶:
+// 小于8的值各占一个桶, 之后每个2的幂区间再等分8个子桶, 相对误差不超过12.5%.
+// 单一写者(本P线程).
+class LatencyHistogram
+{
+public:
+    static constexpr int kSubBits = 3;
+    static constexpr int kSubBuckets = 1 << kSubBits;
+    static constexpr int kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+    ALWAYS_INLINE static int BucketOf(uint64_t v)
+    {
+        if (v < (uint64_t)kSubBuckets)
+            return (int)v;
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - kSubBits;
+        return (shift + 1) * kSubBuckets + (int)((v >> shift) & (kSubBuckets - 1));
+    }
+
+    // 桶中最大的值
+    static uint64_t BucketUpperBound(int idx);
+
+    ALWAYS_INLINE void Record(uint64_t v)
+    {
+        MetricsInc(buckets_[BucketOf(v)]);
+        MetricsInc(count_);
+        MetricsInc(sum_, v);
+        if (v > max_.load(std::memory_order_relaxed))
+            max_.store(v, std::memory_order_relaxed);
+    }
+
+private:
+    friend struct HistogramSnapshot;
+    std::atomic<uint64_t> buckets_[kBuckets] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+struct HistogramSnapshot
+{
+    std::vector<uint64_t> buckets;
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+
+    HistogramSnapshot() : buckets(LatencyHistogram::kBuckets, 0) {}
+    explicit HistogramSnapshot(LatencyHistogram const& h);
+
+    void Merge(HistogramSnapshot const& other);
+
+    // 分位数(0~1), 返回所在桶的上界
+    uint64_t Percentile(double q) const;
+
+    // 不大于v的样本数(按桶上界估算)
+    uint64_t CountBelow(uint64_t v) const;
+};
+
+// 单个P的指标, 单位: 纳秒
+struct ProcessorMetrics
+{
+    // 本P线程写
+    alignas(64) std::atomic<uint64_t> switches{0};  // 协程切换次数
+    std::atomic<uint64_t> suspends{0};              // 协程挂起次数
+    std::atomic<uint64_t> parks{0};                 // 无协程可执行而阻塞等待的次数
+    std::atomic<uint64_t> parkNs{0};                // 阻塞等待的总时长
+    std::atomic<uint64_t> preempts{0};              // 协程在co_preempt_check()处被抢占的次数
+    std::atomic<uint64_t> retires{0};               // 空闲退休(退出线程)的次数
+
+    LatencyHistogram createToRun;   // 创建到首次执行
+    LatencyHistogram wakeupToRun;   // 被唤醒到再次执行
+    LatencyHistogram runSlice;      // 单次执行时长
+
+    // 其他线程也会写
+    alignas(64) std::atomic<uint64_t> tasksAdded{0};    // 投递进来的新协程
+    std::atomic<uint64_t> stolenIn{0};                  // 从其他P偷来的协程
+    std::atomic<uint64_t> stolenOut{0};                 // 被其他P偷走的协程
+    std::atomic<uint64_t> wakeups{0};                   // 唤醒本P上挂起的协程
+    std::atomic<uint64_t> unparks{0};                   // 唤醒阻塞等待中的P
+    std::atomic<uint64_t> preemptRequests{0};           // 调度线程发出的抢占请求
+};
+
+struct ProcessorMetricsSnapshot
+{
+    int id = 0;
+    bool waiting = false;
+    bool retired = false;       // 已退休, 没有线程
+    uint64_t runnable = 0;      // 可执行队列(含新协程队列)长度
+    uint64_t pinned = 0;        // 其中固定在本P上的协程数
+    uint64_t blocked = 0;       // 挂起中的协程数
+    uint64_t switches = 0;
+    uint64_t suspends = 0;
+    uint64_t parks = 0;
+    uint64_t parkNs = 0;
+    uint64_t tasksAdded = 0;
+    uint64_t stolenIn = 0;
+    uint64_t stolenOut = 0;
+    uint64_t wakeups = 0;
+    uint64_t unparks = 0;
+    uint64_t preempts = 0;
+    uint64_t preemptRequests = 0;
+    uint64_t retires = 0;
+    HistogramSnapshot createToRun;
+    HistogramSnapshot wakeupToRun;
+    HistogramSnapshot runSlice;
+};
+
+struct SchedulerMetrics
+{
+    uint64_t taskCount = 0;
+    std::vector<ProcessorMetricsSnapshot> processors;
+
+    // 所有P合并后的直方图
+    HistogramSnapshot createToRun;
+    HistogramSnapshot wakeupToRun;
+    HistogramSnapshot runSlice;
+};
+
+// 调度延迟统计用的时间戳
+ALWAYS_INLINE int64_t MetricsNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            FastSteadyClock::now().time_since_epoch()).count();
+}
+
+// 输出Prometheus文本格式
+std::string MetricsToPrometheus(SchedulerMetrics const& metrics, std::string const& prefix = "libgo");
+
+// 导出调度器的指标到文件(先写临时文件再rename, 适合node_exporter的textfile collector)
+bool ExportMetrics(Scheduler & scheduler, std::string const& path);
+
+// 导出调度器的指标到回调
+void ExportMetrics(Scheduler & scheduler, std::function<void(std::string const&)> const& fn);
+
+} //namespace co
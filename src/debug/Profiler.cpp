@@ -0,0 +1,420 @@
+#include "Profiler.h"
+#include "scheduler/Scheduler.h"
+#include "processor/Processor.h"
+#include "task/Task.h"
+#include <map>
+#include <algorithm>
+
+#if defined(OS_Linux) && defined(__x86_64__)
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <ucontext.h>
+#include <sys/syscall.h>
+#define LIBGO_PROFILER 1
+#endif
+
+namespace co {
+
+#if LIBGO_PROFILER
+
+struct ProfileSample
+{
+    // 序号: 奇数表示正在写入, 偶数表示写入完成
+    std::atomic<uint32_t> seq{0};
+    uint16_t proc = 0;
+    uint16_t depth = 0;
+    uint64_t task = 0;
+    uintptr_t pcs[kProfileMaxDepth];
+};
+
+// 每个P线程一个, 只由该线程的信号处理函数写入
+struct ProfileBuffer
+{
+    std::atomic<uint64_t> write{0};
+    uint64_t read = 0;      // 汇总线程读到的位置
+
+    int procId = 0;
+    pid_t tid = 0;
+    pthread_t thread;
+    uintptr_t stackLow = 0;
+    uintptr_t stackHigh = 0;
+    timer_t timer;
+    bool armed = false;
+
+    // 首次开始采样时才分配
+    ProfileSample* samples = nullptr;
+};
+
+static thread_local ProfileBuffer* tlsProfileBuffer = nullptr;
+
+struct ProfilerState
+{
+    std::mutex mtx;
+    std::vector<ProfileBuffer*> buffers;
+    bool running = false;
+    int hz = 0;
+    bool handlerInstalled = false;
+
+    // 汇总的调用栈, 第一个元素标记是否在协程中
+    std::map<std::vector<uintptr_t>, uint64_t> stacks;
+    uint64_t samples = 0;
+
+    std::thread collector;
+    std::condition_variable cv;
+};
+
+static ProfilerState & State()
+{
+    static ProfilerState *state = new ProfilerState;
+    return *state;
+}
+
+// 沿帧指针回溯, 只访问[low, high)内的内存
+static int WalkFrames(uintptr_t fp, uintptr_t low, uintptr_t high, uintptr_t* pcs, int depth)
+{
+    while (depth < kProfileMaxDepth && fp >= low && fp + 2 * sizeof(uintptr_t) <= high && !(fp & 7)) {
+        uintptr_t next = ((uintptr_t*)fp)[0];
+        uintptr_t ret = ((uintptr_t*)fp)[1];
+        if (!ret)
+            break;
+        pcs[depth++] = ret;
+        if (next <= fp)
+            break;
+        fp = next;
+    }
+    return depth;
+}
+
+static void ProfileSignalHandler(int, siginfo_t*, void* uc)
+{
+    ProfileBuffer* buf = tlsProfileBuffer;
+    if (!buf || !buf->samples)
+        return ;
+
+    ErrnoStore es;
+    mcontext_t & mc = ((ucontext_t*)uc)->uc_mcontext;
+    uintptr_t pc = mc.gregs[REG_RIP];
+    uintptr_t fp = mc.gregs[REG_RBP];
+    uintptr_t sp = mc.gregs[REG_RSP];
+
+    uint64_t index = buf->write.load(std::memory_order_relaxed);
+    ProfileSample & s = buf->samples[index % kProfileBufferSize];
+    uint32_t seq = s.seq.load(std::memory_order_relaxed);
+    s.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_signal_fence(std::memory_order_release);
+
+    s.proc = buf->procId;
+    s.task = 0;
+    s.pcs[0] = pc;
+    uintptr_t low = buf->stackLow, high = buf->stackHigh;
+
+    // runningTask_在切入之前就已设置, 以sp是否在协程栈内为准
+    Task* tk = Processor::GetCurrentTask();
+    if (tk && sp >= (uintptr_t)tk->ctx_.StackLow() && sp < (uintptr_t)tk->ctx_.StackHigh()) {
+        s.task = tk->id_;
+        low = (uintptr_t)tk->ctx_.StackLow();
+        high = (uintptr_t)tk->ctx_.StackHigh();
+    }
+    s.depth = WalkFrames(fp, (std::max)(low, sp), high, s.pcs, 1);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    s.seq.store(seq + 2, std::memory_order_relaxed);
+    buf->write.store(index + 1, std::memory_order_release);
+}
+
+static bool ArmTimer(ProfileBuffer* buf, int hz)
+{
+    if (!buf->samples)
+        buf->samples = new ProfileSample[kProfileBufferSize];
+
+    clockid_t clk;
+    if (pthread_getcpuclockid(buf->thread, &clk) != 0)
+        return false;
+
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev._sigev_un._tid = buf->tid;
+    if (timer_create(clk, &sev, &buf->timer) != 0)
+        return false;
+
+    long ns = 1000000000L / hz;
+    struct itimerspec its;
+    its.it_interval.tv_sec = ns / 1000000000L;
+    its.it_interval.tv_nsec = ns % 1000000000L;
+    its.it_value = its.it_interval;
+    if (timer_settime(buf->timer, 0, &its, nullptr) != 0) {
+        timer_delete(buf->timer);
+        return false;
+    }
+    buf->armed = true;
+    return true;
+}
+
+static void DisarmTimer(ProfileBuffer* buf)
+{
+    if (!buf->armed)
+        return ;
+    timer_delete(buf->timer);
+    buf->armed = false;
+}
+
+// 把各缓冲区的新样本汇总到stacks, 需持有State().mtx
+static void Collect()
+{
+    ProfilerState & state = State();
+    std::vector<uintptr_t> key;
+    ProfileSample copy;
+    for (ProfileBuffer* buf : state.buffers) {
+        if (!buf->samples)
+            continue;
+        uint64_t write = buf->write.load(std::memory_order_acquire);
+        if (write - buf->read > kProfileBufferSize)
+            buf->read = write - kProfileBufferSize;
+
+        for (; buf->read < write; ++buf->read) {
+            ProfileSample & s = buf->samples[buf->read % kProfileBufferSize];
+            uint32_t seq = s.seq.load(std::memory_order_acquire);
+            if (seq & 1)
+                continue;
+            copy.task = s.task;
+            copy.depth = (std::min<uint16_t>)(s.depth, kProfileMaxDepth);
+            memcpy(copy.pcs, s.pcs, copy.depth * sizeof(uintptr_t));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s.seq.load(std::memory_order_relaxed) != seq)
+                continue;
+
+            key.assign(1, copy.task ? 1 : 0);
+            key.insert(key.end(), copy.pcs, copy.pcs + copy.depth);
+            ++state.stacks[key];
+            ++state.samples;
+        }
+    }
+}
+
+static void CollectorThread()
+{
+    ProfilerState & state = State();
+    std::unique_lock<std::mutex> lock(state.mtx);
+    while (state.running) {
+        state.cv.wait_for(lock, std::chrono::milliseconds(100));
+        Collect();
+    }
+}
+
+void ProfilerRegisterThread(int procId)
+{
+    ProfileBuffer* buf = new ProfileBuffer;
+    buf->procId = procId;
+    buf->tid = (pid_t)syscall(SYS_gettid);
+    buf->thread = pthread_self();
+
+    pthread_attr_t attr;
+    if (pthread_getattr_np(buf->thread, &attr) == 0) {
+        void* addr = nullptr;
+        size_t size = 0;
+        if (pthread_attr_getstack(&attr, &addr, &size) == 0) {
+            buf->stackLow = (uintptr_t)addr;
+            buf->stackHigh = (uintptr_t)addr + size;
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    tlsProfileBuffer = buf;
+
+    ProfilerState & state = State();
+    std::unique_lock<std::mutex> lock(state.mtx);
+    state.buffers.push_back(buf);
+    if (state.running)
+        ArmTimer(buf, state.hz);
+}
+
+void ProfilerUnregisterThread()
+{
+    ProfileBuffer* buf = tlsProfileBuffer;
+    if (!buf)
+        return ;
+
+    // 信号只发给本线程, 先断开信号处理函数与缓冲区的联系
+    tlsProfileBuffer = nullptr;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+
+    ProfilerState & state = State();
+    std::unique_lock<std::mutex> lock(state.mtx);
+    Collect();
+    DisarmTimer(buf);
+    state.buffers.erase(std::remove(state.buffers.begin(), state.buffers.end(), buf), state.buffers.end());
+    lock.unlock();
+
+    delete[] buf->samples;
+    delete buf;
+}
+
+bool ProfilerStart(int hz)
+{
+    if (hz <= 0)
+        return false;
+
+    ProfilerState & state = State();
+    std::unique_lock<std::mutex> lock(state.mtx);
+    if (state.running)
+        return false;
+
+    // SIGPROF的默认行为是终止进程, 安装后不再卸载, 停止后残留的信号也能安全忽略
+    if (!state.handlerInstalled) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = &ProfileSignalHandler;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        if (sigaction(SIGPROF, &sa, nullptr) != 0)
+            return false;
+        state.handlerInstalled = true;
+    }
+
+    state.running = true;
+    state.hz = hz;
+    for (ProfileBuffer* buf : state.buffers)
+        ArmTimer(buf, hz);
+    state.collector = std::thread(&CollectorThread);
+    return true;
+}
+
+void ProfilerStop()
+{
+    ProfilerState & state = State();
+    std::thread collector;
+    {
+        std::unique_lock<std::mutex> lock(state.mtx);
+        if (!state.running)
+            return ;
+        state.running = false;
+        for (ProfileBuffer* buf : state.buffers)
+            DisarmTimer(buf);
+        collector.swap(state.collector);
+        state.cv.notify_all();
+    }
+    collector.join();
+
+    std::unique_lock<std::mutex> lock(state.mtx);
+    Collect();
+}
+
+bool ProfilerRunning()
+{
+    ProfilerState & state = State();
+    std::unique_lock<std::mutex> lock(state.mtx);
+    return state.running;
+}
+
+void ProfilerClear()
+{
+    ProfilerState & state = State();
+    std::unique_lock<std::mutex> lock(state.mtx);
+    Collect();
+    state.stacks.clear();
+    state.samples = 0;
+}
+
+// 地址转成符号名, folded格式中的';'和' '替换掉
+static std::string Symbolize(uintptr_t pc, std::map<uintptr_t, std::string> & cache)
+{
+    auto it = cache.find(pc);
+    if (it != cache.end())
+        return it->second;
+
+    std::string name;
+    Dl_info info;
+    if (dladdr((void*)pc, &info) && info.dli_sname) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        name = (status == 0 && demangled) ? demangled : info.dli_sname;
+        free(demangled);
+    } else if (info.dli_fname) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "+0x%lx", (unsigned long)(pc - (uintptr_t)info.dli_fbase));
+        name = std::string(BaseFile(info.dli_fname)) + buf;
+    } else {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "0x%lx", (unsigned long)pc);
+        name = buf;
+    }
+
+    for (char & c : name)
+        if (c == ';' || c == ' ')
+            c = '_';
+    return cache[pc] = name;
+}
+
+size_t ProfilerDumpFolded(FILE* fp)
+{
+    ProfilerState & state = State();
+    std::unique_lock<std::mutex> lock(state.mtx);
+    Collect();
+
+    std::map<uintptr_t, std::string> cache;
+    for (auto & kv : state.stacks) {
+        std::vector<uintptr_t> const& key = kv.first;
+        fputs(key[0] ? "coroutine" : "scheduler", fp);
+        // 除了第一帧, 其余都是返回地址, 减1后落在调用指令内
+        for (size_t i = key.size() - 1; i >= 1; --i)
+            fprintf(fp, ";%s", Symbolize(i == 1 ? key[i] : key[i] - 1, cache).c_str());
+        fprintf(fp, " %llu\n", (unsigned long long)kv.second);
+    }
+    fflush(fp);
+    return state.samples;
+}
+
+size_t DumpSuspendedStacks(Scheduler & scheduler, FILE* fp)
+{
+    std::map<uintptr_t, std::string> cache;
+    size_t n = 0;
+    scheduler.ForEachSuspendedTask([&](Task* tk) {
+            // 共享栈协程的栈内容已拷出时无法回溯
+            if (!tk->ctx_.StackResident()) {
+                fprintf(fp, "task(%s) suspended: stack saved off shared stack (%u bytes)\n",
+                        tk->DebugInfo(), (unsigned)tk->ctx_.SavedStackSize());
+                ++n;
+                return ;
+            }
+
+            // jump_fcontext在切出时依次压栈: rbp rbx r15 r14 r13 r12, 再预留8字节fpu控制字
+            uintptr_t* saved = (uintptr_t*)tk->ctx_.SavedContext();
+            uintptr_t low = (uintptr_t)tk->ctx_.StackLow();
+            uintptr_t high = (uintptr_t)tk->ctx_.StackHigh();
+            if ((uintptr_t)saved < low || (uintptr_t)(saved + 8) > high)
+                return ;
+
+            uintptr_t pcs[kProfileMaxDepth];
+            pcs[0] = saved[7];
+            int depth = WalkFrames(saved[6], (uintptr_t)(saved + 8), high, pcs, 1);
+
+            fprintf(fp, "task(%s) suspended:\n", tk->DebugInfo());
+            for (int i = 0; i < depth; ++i)
+                fprintf(fp, "    #%-2d 0x%016lx %s\n", i, (unsigned long)pcs[i],
+                        Symbolize(pcs[i] - 1, cache).c_str());
+            ++n;
+        });
+    fflush(fp);
+    return n;
+}
+
+#else // LIBGO_PROFILER
+
+bool ProfilerStart(int) { return false; }
+void ProfilerStop() {}
+bool ProfilerRunning() { return false; }
+size_t ProfilerDumpFolded(FILE*) { return 0; }
+void ProfilerClear() {}
+size_t DumpSuspendedStacks(Scheduler &, FILE*) { return 0; }
+void ProfilerRegisterThread(int) {}
+
+void ProfilerUnregisterThread() {}
+
+#endif // LIBGO_PROFILER
+
+} //namespace co
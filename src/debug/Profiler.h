@@ -0,0 +1,53 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+
+namespace co
+{
+
+class Scheduler;
+
+// 协程采样分析器
+// 协程运行在私有栈上, perf/gdb难以把耗时归到协程上. 这里在进程内按线程CPU时间采样:
+//   1.每个P线程一个timer_create定时器, 到期向该线程发送SIGPROF.
+//   2.信号处理函数记录正在执行的协程ID, 并沿帧指针回溯调用栈, 回溯范围限定在该协程的栈内
+//     (不在协程中时限定在线程栈内), 写入本P私有的环形缓冲区, 不加锁不分配内存.
+//   3.后台线程定期把样本汇总成调用栈计数, ProfilerDumpFolded输出为flamegraph.pl可用的folded格式.
+// 回溯依赖帧指针, libgo自身以-fno-omit-frame-pointer编译, 业务代码也需要, 否则只能得到不完整的调用栈.
+// 符号取自动态符号表, 可执行文件需以-rdynamic链接, 否则输出为"模块+偏移", 可用addr2line解析.
+// SIGPROF会打断P线程上的阻塞系统调用(EINTR), 业务代码需能正确处理.
+// 仅支持Linux x86_64, 其他平台ProfilerStart返回false.
+
+// 单个样本的最大栈深度
+static const int kProfileMaxDepth = 64;
+
+// 每个P的样本缓冲区大小, 写满后覆盖最旧的样本(后台线程每100ms汇总一次)
+static const size_t kProfileBufferSize = 4096;
+
+// 开始采样, 对所有调度器的P线程(包括之后创建的)生效
+// @hz: 每秒采样次数(按线程CPU时间), 实际频率不超过内核的时钟中断频率(CONFIG_HZ)
+bool ProfilerStart(int hz = 100);
+
+// 停止采样, 已汇总的数据保留
+void ProfilerStop();
+
+bool ProfilerRunning();
+
+// 输出汇总的调用栈(folded格式: "根;...;叶 次数"), 根为coroutine或scheduler
+// @return: 样本数
+size_t ProfilerDumpFolded(FILE* fp);
+
+// 清空已汇总的数据
+void ProfilerClear();
+
+// 输出调度器中所有已挂起协程的调用栈(从切出时保存的上下文回溯)
+// 栈内容已拷出共享栈的协程无法回溯, 只输出一行
+// @return: 协程数
+size_t DumpSuspendedStacks(Scheduler & scheduler, FILE* fp);
+
+// P线程启动时调用
+void ProfilerRegisterThread(int procId);
+
+// P线程退出前调用, 汇总剩余样本并释放采样缓冲区
+void ProfilerUnregisterThread();
+
+} //namespace co
@@ -0,0 +1,112 @@
+#include "SwitchTrace.h"
+#include "ThreadRing.h"
+#include "task/Task.h"
+
+namespace co {
+
+std::atomic<bool> gSwitchTraceOn{false};
+
+// 一条记录, 缓冲区中加上序号共40字节
+struct SwitchTraceEvent
+{
+    uint8_t type;
+    uint8_t state;
+    uint16_t proc;
+    int64_t ns;
+    int64_t arg;
+    uint64_t task;
+};
+
+typedef ThreadRing<SwitchTraceEvent, kSwitchTraceRingSize> SwitchTraceRing;
+
+void SwitchTraceEnable(bool on)
+{
+    gSwitchTraceOn.store(on, std::memory_order_relaxed);
+}
+
+void SwitchTraceRecord(eSwitchTraceEvent type, int proc, uint64_t task,
+        int64_t ns, int64_t arg, uint8_t state)
+{
+    SwitchTraceRing::Write([&](SwitchTraceEvent & e) {
+            e.type = type;
+            e.state = state;
+            e.proc = (uint16_t)proc;
+            e.ns = ns;
+            e.arg = arg;
+            e.task = task;
+        });
+}
+
+static const char* SwitchTraceEventName(uint8_t type)
+{
+    switch (type) {
+        case ste_run: return "run";
+        case ste_suspend: return "suspend";
+        case ste_wakeup: return "wakeup";
+        case ste_timer: return "timer";
+        case ste_steal: return "steal";
+        case ste_receive: return "receive";
+    }
+    return "unknown";
+}
+
+size_t SwitchTraceExport(FILE* fp)
+{
+    std::vector<SwitchTraceEvent> records;
+    SwitchTraceRing::Collect(records);
+
+    std::stable_sort(records.begin(), records.end(),
+            [](SwitchTraceEvent const& a, SwitchTraceEvent const& b) { return a.ns < b.ns; });
+
+    // 时间从第一条记录开始算, 单位us
+    int64_t base = records.empty() ? 0 : records.front().ns;
+    std::vector<bool> procs;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    const char* sep = "";
+    for (SwitchTraceEvent const& e : records) {
+        if (e.proc >= procs.size())
+            procs.resize(e.proc + 1, false);
+        procs[e.proc] = true;
+
+        double ts = (e.ns - base) / 1000.0;
+        if (e.type == ste_run) {
+            fprintf(fp, "%s{\"name\":\"task %llu\",\"cat\":\"run\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"pid\":1,\"tid\":%d,\"args\":{\"task\":%llu,\"state\":\"%s\"}}",
+                    sep, (unsigned long long)e.task, ts, e.arg / 1000.0, (int)e.proc,
+                    (unsigned long long)e.task, GetTaskStateName((TaskState)e.state));
+        } else {
+            fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"sched\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+                    "\"pid\":1,\"tid\":%d,\"args\":{\"task\":%llu,\"arg\":%lld}}",
+                    sep, SwitchTraceEventName(e.type), ts, (int)e.proc,
+                    (unsigned long long)e.task, (long long)e.arg);
+        }
+        sep = ",\n";
+    }
+
+    for (size_t i = 0; i < procs.size(); ++i) {
+        if (!procs[i]) continue;
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"Processor %d\"}}",
+                sep, (int)i, (int)i);
+        sep = ",\n";
+    }
+    fprintf(fp, "\n]}\n");
+    fflush(fp);
+    return records.size();
+}
+
+bool SwitchTraceExport(std::string const& path)
+{
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp)
+        return false;
+    SwitchTraceExport(fp);
+    return fclose(fp) == 0;
+}
+
+void SwitchTraceClear()
+{
+    SwitchTraceRing::Clear();
+}
+
+} //namespace co
@@ -0,0 +1,48 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+
+namespace co
+{
+
+// 调度跟踪
+// 记录协程在哪个P上、从何时执行到何时, 以及挂起/唤醒/偷取/定时器触发等调度事件,
+// 用于排查调度延迟毛刺, 导出为Chrome trace JSON, 可用chrome://tracing或Perfetto UI打开.
+//   1.事件是定长的二进制记录, 写入当前线程私有的环形缓冲区, 写满后覆盖最旧的记录.
+//   2.运行期开关, 关闭时每个埋点只有一次relaxed读.
+//   3.协程的一次执行在切出时记录一条(含切入时间和时长), 每次切换只读一次时钟.
+
+enum eSwitchTraceEvent : uint8_t
+{
+    ste_run,        // 协程执行了一段: ns为切入时间, arg为时长, state为切出后的状态
+    ste_suspend,    // 协程挂起
+    ste_wakeup,     // 协程被唤醒(记录在唤醒方的线程)
+    ste_timer,      // 定时器到期触发唤醒
+    ste_steal,      // 调度线程从P偷走协程, arg为数量
+    ste_receive,    // P收到偷来的协程, arg为数量
+};
+
+// 每个线程缓冲区的记录数
+static const size_t kSwitchTraceRingSize = 1 << 16;
+
+extern std::atomic<bool> gSwitchTraceOn;
+
+ALWAYS_INLINE bool SwitchTraceEnabled()
+{
+    return gSwitchTraceOn.load(std::memory_order_relaxed);
+}
+
+// 开启/关闭跟踪, 可在任意线程调用
+void SwitchTraceEnable(bool on);
+
+void SwitchTraceRecord(eSwitchTraceEvent type, int proc, uint64_t task,
+        int64_t ns, int64_t arg = 0, uint8_t state = 0);
+
+// 导出所有线程的记录为Chrome trace JSON (每个P一个轨道)
+// @return: 导出的事件数
+size_t SwitchTraceExport(FILE* fp);
+bool SwitchTraceExport(std::string const& path);
+
+// 清空所有线程的记录
+void SwitchTraceClear();
+
+} //namespace co
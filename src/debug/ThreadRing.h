@@ -0,0 +1,130 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "common/inc/SpinLock.h"
+
+namespace co
+{
+
+// 线程私有的定长记录环形缓冲区, 调试跟踪和调度跟踪共用
+//   1.每个线程首次写入时分配一个缓冲区(或复用已退出线程留下的), 只有单个生产者, 写入无锁.
+//   2.缓冲区写满后覆盖最旧的记录.
+//   3.每条记录带一个序号(seqlock), 其他线程读取时据此丢弃正在写或已被覆盖的记录.
+// 每种Event类型有各自独立的缓冲区列表. Event需要可平凡拷贝, N需要是2的幂.
+template <typename Event, size_t N>
+class ThreadRing
+{
+    static_assert((N & (N - 1)) == 0, "ThreadRing size must be a power of 2");
+
+    struct Slot
+    {
+        // 序号: 奇数表示正在写入, 偶数表示写入完成, 0表示没有记录
+        std::atomic<uint32_t> seq{0};
+        Event event;
+    };
+
+    std::atomic<uint64_t> write_{0};
+    std::atomic<bool> inUse_{true};
+    Slot slots_[N];
+
+public:
+    // 在当前线程的缓冲区中写入一条记录, fill(Event&)填写内容
+    template <typename Fill>
+    ALWAYS_INLINE static void Write(Fill const& fill)
+    {
+        static thread_local Holder holder;
+        ThreadRing* ring = holder.Get();
+
+        uint64_t index = ring->write_.load(std::memory_order_relaxed);
+        Slot & slot = ring->slots_[index & (N - 1)];
+        uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+        slot.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        fill(slot.event);
+
+        slot.seq.store(seq + 2, std::memory_order_release);
+        ring->write_.store(index + 1, std::memory_order_release);
+    }
+
+    // 拷贝出所有线程的记录, 追加到out, 可以在任意线程调用
+    static void Collect(std::vector<Event> & out)
+    {
+        std::unique_lock<LFLock> lock(RingsLock());
+        for (ThreadRing* ring : Rings()) {
+            uint64_t write = ring->write_.load(std::memory_order_acquire);
+            uint64_t begin = write > N ? write - N : 0;
+            out.reserve(out.size() + (write - begin));
+            for (uint64_t i = begin; i < write; ++i) {
+                out.emplace_back();
+                if (!Copy(ring->slots_[i & (N - 1)], out.back()))
+                    out.pop_back();
+            }
+        }
+    }
+
+    // 清空所有线程的记录
+    static void Clear()
+    {
+        std::unique_lock<LFLock> lock(RingsLock());
+        for (ThreadRing* ring : Rings())
+            for (Slot & slot : ring->slots_)
+                slot.seq.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    // 拷贝出一致的记录, 记录正在被写或已被覆盖时返回false
+    static bool Copy(Slot & slot, Event & out)
+    {
+        uint32_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq == 0 || (seq & 1))
+            return false;
+
+        out = slot.event;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.seq.load(std::memory_order_relaxed) == seq;
+    }
+
+    static LFLock & RingsLock()
+    {
+        static LFLock lock;
+        return lock;
+    }
+
+    static std::vector<ThreadRing*> & Rings()
+    {
+        static std::vector<ThreadRing*> *rings = new std::vector<ThreadRing*>;
+        return *rings;
+    }
+
+    // 线程退出时把缓冲区留给后来的线程复用, 其中的记录仍然可以被读出
+    struct Holder
+    {
+        ThreadRing* ring = nullptr;
+
+        ~Holder()
+        {
+            if (ring)
+                ring->inUse_.store(false, std::memory_order_release);
+        }
+
+        ThreadRing* Get()
+        {
+            if (LIKELY(ring))
+                return ring;
+
+            std::unique_lock<LFLock> lock(RingsLock());
+            for (ThreadRing* r : Rings()) {
+                bool expected = false;
+                if (r->inUse_.compare_exchange_strong(expected, true))
+                    return ring = r;
+            }
+
+            ring = new ThreadRing;
+            Rings().push_back(ring);
+            return ring;
+        }
+    };
+};
+
+} //namespace co
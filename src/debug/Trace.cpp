@@ -0,0 +1,80 @@
+#include "Trace.h"
+#include "ThreadRing.h"
+#include <stdarg.h>
+
+namespace co {
+
+// 一条记录, 加上缓冲区中的序号定长256字节
+struct TraceEvent
+{
+    int64_t ns;
+    uint64_t type;
+    const char* file;
+    const char* func;
+    int line;
+    int thread;
+    int coro;
+    char msg[256 - 52];
+};
+
+typedef ThreadRing<TraceEvent, kTraceRingSize> TraceRing;
+
+static int64_t TraceNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TraceRecord(uint64_t type, const char* file, int line, const char* func, const char* fmt, ...)
+{
+    ErrnoStore es;
+    va_list ap;
+    va_start(ap, fmt);
+    TraceRing::Write([&](TraceEvent & e) {
+            e.ns = TraceNowNs();
+            e.type = type;
+            e.file = file;
+            e.func = func;
+            e.line = line;
+            e.thread = GetCurrentThreadID();
+            e.coro = GetCurrentCoroID();
+            vsnprintf(e.msg, sizeof(e.msg), fmt, ap);
+        });
+    va_end(ap);
+}
+
+size_t TraceDump(FILE* fp)
+{
+    if (!fp)
+        fp = CoroutineOptions::getInstance().debug_output;
+
+    std::vector<TraceEvent> events;
+    TraceRing::Collect(events);
+
+    // 记录较大, 只排序指针
+    std::vector<TraceEvent*> records;
+    records.reserve(events.size());
+    for (TraceEvent & e : events) {
+        e.msg[sizeof(e.msg) - 1] = '\0';
+        records.push_back(&e);
+    }
+    std::stable_sort(records.begin(), records.end(),
+            [](TraceEvent* a, TraceEvent* b) { return a->ns < b->ns; });
+
+    std::unique_lock<std::mutex> lock(gDbgLock);
+    for (TraceEvent* e : records) {
+        fprintf(fp, "[%ld.%06ld][%05d][%04d][%06d]%s:%d:(%s)\t %s\n",
+                (long)(e->ns / 1000000000), (long)(e->ns % 1000000000 / 1000),
+                GetCurrentProcessID(), e->thread, e->coro,
+                BaseFile(e->file), e->line, e->func, e->msg);
+    }
+    fflush(fp);
+    return records.size();
+}
+
+void TraceClear()
+{
+    TraceRing::Clear();
+}
+
+} //namespace co
@@ -0,0 +1,24 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+
+namespace co
+{
+
+// 调试跟踪
+// DebugPrint的输出不再直接写文件, 而是格式化成定长的二进制记录写入当前线程私有的环形缓冲区:
+//   1.每个线程首次记录时分配一个缓冲区(或复用已退出线程留下的), 写入只有单个生产者, 无锁.
+//   2.缓冲区写满后覆盖最旧的记录.
+//   3.需要时调用TraceDump把所有线程的记录按时间排序后输出, 可以在其他线程中调用.
+// 类别未开启时DebugPrint只有一次relaxed读, 编译期级别为0时整个调用被编译掉, 见LIBGO_TRACE_LEVEL.
+
+// 每个线程缓冲区的记录数
+static const size_t kTraceRingSize = 4096;
+
+// 输出所有线程的跟踪记录, fp为空时输出到co_opt.debug_output
+// @return: 输出的记录数
+size_t TraceDump(FILE* fp = nullptr);
+
+// 清空所有线程的跟踪记录
+void TraceClear();
+
+} //namespace co
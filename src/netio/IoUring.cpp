@@ -0,0 +1,386 @@
+#include "IoUring.h"
+#include "NetPoller.h"
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#if defined(LIBGO_HAS_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#endif
+
+namespace co {
+
+#if defined(LIBGO_HAS_IO_URING)
+
+IoUring::IoUring(int notifyFd, unsigned entries)
+    : notifyFd_(notifyFd)
+{
+    if (!Setup(entries))
+        Close();
+}
+
+IoUring::~IoUring()
+{
+    Close();
+}
+
+void IoUring::Close()
+{
+    if (sqes_) munmap(sqes_, sqesSize_);
+    if (cqRing_ && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+    if (sqRing_) munmap(sqRing_, sqRingSize_);
+    if (ringFd_ >= 0) ::close(ringFd_);
+    sqes_ = cqRing_ = sqRing_ = nullptr;
+    ringFd_ = -1;
+}
+
+bool IoUring::Setup(unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ringFd_ = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (ringFd_ < 0) {
+        DebugPrint(dbg_ioblock, "io_uring_setup failed. errno=%d", errno);
+        return false;
+    }
+
+    // IORING_OP_READ/WRITE及读写当前文件位置需要5.6+
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+        DebugPrint(dbg_ioblock, "io_uring features(%x) too old", p.features);
+        return false;
+    }
+
+    sqRingSize_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        sqRingSize_ = cqRingSize_ = (std::max)(sqRingSize_, cqRingSize_);
+
+    sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED) {
+        sqRing_ = nullptr;
+        return false;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        cqRing_ = sqRing_;
+    } else {
+        cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) {
+            cqRing_ = nullptr;
+            return false;
+        }
+    }
+
+    sqesSize_ = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+        sqes_ = nullptr;
+        return false;
+    }
+
+    char* sq = (char*)sqRing_;
+    sqHead_ = (unsigned*)(sq + p.sq_off.head);
+    sqTail_ = (unsigned*)(sq + p.sq_off.tail);
+    sqMask_ = (unsigned*)(sq + p.sq_off.ring_mask);
+    sqArray_ = (unsigned*)(sq + p.sq_off.array);
+    sqEntries_ = p.sq_entries;
+
+    char* cq = (char*)cqRing_;
+    cqHead_ = (unsigned*)(cq + p.cq_off.head);
+    cqTail_ = (unsigned*)(cq + p.cq_off.tail);
+    cqMask_ = (unsigned*)(cq + p.cq_off.ring_mask);
+    cqes_ = cq + p.cq_off.cqes;
+
+    // 有完成事件时写P的eventfd, 阻塞在epoll_wait上的P会被唤醒
+    if (notifyFd_ >= 0 && syscall(__NR_io_uring_register, ringFd_,
+                IORING_REGISTER_EVENTFD, &notifyFd_, 1) < 0) {
+        DebugPrint(dbg_ioblock, "io_uring register eventfd failed. errno=%d", errno);
+        return false;
+    }
+
+    return true;
+}
+
+IoUring* IoUring::Current()
+{
+    if (!CoroutineOptions::getInstance().enable_io_uring)
+        return nullptr;
+
+    Processor* proc = Processor::GetCurrentProcessor();
+    if (!proc || !Processor::IsCoroutine())
+        return nullptr;
+
+    // 内核在协程挂起期间直接读写调用方的缓冲区(往往在栈上), 共享栈协程退化为普通系统调用
+    if (Processor::IsSharedStackTask())
+        return nullptr;
+
+    return proc->GetUring();
+}
+
+int IoUring::Execute(uint8_t opcode, int fd, uint64_t addr, uint32_t len,
+        uint64_t off, uint32_t opFlags)
+{
+    // SQ满了先提交一次; 内核仍无法消费时(CQ溢出)收割后再试, 还不行就返回-EBUSY由调用方退化
+    unsigned tail = *sqTail_;
+    if (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+        Flush();
+        if (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+            return -EBUSY;
+    }
+
+    Op op;
+    unsigned index = tail & *sqMask_;
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*)sqes_ + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->off = off;
+    sqe->addr = addr;
+    sqe->len = len;
+    sqe->rw_flags = opFlags;
+    sqe->user_data = (uint64_t)(uintptr_t)&op;
+    sqArray_[index] = index;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    ++queued_;
+
+    // 提交和收割都在本P的线程上, 挂起之后才可能收割到这个请求
+    op.entry = Processor::Suspend();
+    Processor::StaticCoYield();
+
+    // 唤醒后可能已经被偷到其他P上执行, 不能再访问this
+    return op.res;
+}
+
+int IoUring::Flush()
+{
+    Submit();
+    return inflight_ ? Reap() : 0;
+}
+
+void IoUring::Submit()
+{
+    while (queued_) {
+        int n = (int)syscall(__NR_io_uring_enter, ringFd_, queued_, 0, 0, nullptr, 0);
+        if (n < 0) {
+            // EAGAIN/EBUSY: 资源不足或CQ溢出, 留到下一轮再提交
+            if (errno == EINTR)
+                continue;
+            DebugPrint(dbg_ioblock, "io_uring_enter(%u) failed. errno=%d", queued_, errno);
+            return ;
+        }
+
+        queued_ -= n;
+        inflight_ += n;
+        if (!n)
+            return ;
+    }
+}
+
+int IoUring::Reap()
+{
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    int woken = 0;
+    for (; head != tail; ++head) {
+        struct io_uring_cqe* cqe = (struct io_uring_cqe*)cqes_ + (head & *cqMask_);
+        Op* op = (Op*)(uintptr_t)cqe->user_data;
+        --inflight_;
+
+        // 唤醒后协程栈上的op随时失效, 先取出entry再写结果
+        Processor::SuspendEntry entry = std::move(op->entry);
+        op->res = cqe->res;
+        if (Processor::Wakeup(entry))
+            ++woken;
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    return woken;
+}
+
+// 执行一个请求, 非阻塞fd返回EAGAIN时等待就绪后重试.
+// @fallback: 无法使用ring时的同步调用
+template <typename Prepare, typename Fallback>
+static ssize_t ringCall(int fd, uint32_t events, Prepare const& prepare, Fallback const& fallback)
+{
+    for (;;) {
+        // 等待就绪时协程可能被偷到其他P上, 每次都重新取当前P的ring
+        IoUring* ring = IoUring::Current();
+        if (!ring)
+            return fallback();
+
+        int res = prepare(ring);
+        if (res >= 0)
+            return res;
+
+        if (res == -EBUSY)
+            return fallback();
+
+        if (res == -EINTR)
+            continue;
+
+        if (res == -EAGAIN && events) {
+            if (NetPoller::WaitFd(fd, events) < 0)
+                return -1;
+            continue;
+        }
+
+        errno = -res;
+        return -1;
+    }
+}
+
+ssize_t read(int fd, void* buf, size_t count, off_t offset)
+{
+    return ringCall(fd, EPOLLIN,
+            [=](IoUring* ring) {
+                return ring->Execute(IORING_OP_READ, fd, (uint64_t)(uintptr_t)buf,
+                        (uint32_t)count, (uint64_t)offset);
+            },
+            [=]{
+                return offset < 0 ? ::read(fd, buf, count) : ::pread(fd, buf, count, offset);
+            });
+}
+
+ssize_t write(int fd, const void* buf, size_t count, off_t offset)
+{
+    return ringCall(fd, EPOLLOUT,
+            [=](IoUring* ring) {
+                return ring->Execute(IORING_OP_WRITE, fd, (uint64_t)(uintptr_t)buf,
+                        (uint32_t)count, (uint64_t)offset);
+            },
+            [=]{
+                return offset < 0 ? ::write(fd, buf, count) : ::pwrite(fd, buf, count, offset);
+            });
+}
+
+ssize_t readv(int fd, const struct iovec* iov, int iovcnt, off_t offset)
+{
+    return ringCall(fd, EPOLLIN,
+            [=](IoUring* ring) {
+                return ring->Execute(IORING_OP_READV, fd, (uint64_t)(uintptr_t)iov,
+                        (uint32_t)iovcnt, (uint64_t)offset);
+            },
+            [=]{
+                return offset < 0 ? ::readv(fd, iov, iovcnt) : ::preadv(fd, iov, iovcnt, offset);
+            });
+}
+
+ssize_t writev(int fd, const struct iovec* iov, int iovcnt, off_t offset)
+{
+    return ringCall(fd, EPOLLOUT,
+            [=](IoUring* ring) {
+                return ring->Execute(IORING_OP_WRITEV, fd, (uint64_t)(uintptr_t)iov,
+                        (uint32_t)iovcnt, (uint64_t)offset);
+            },
+            [=]{
+                return offset < 0 ? ::writev(fd, iov, iovcnt) : ::pwritev(fd, iov, iovcnt, offset);
+            });
+}
+
+int accept(int fd, struct sockaddr* addr, socklen_t* addrlen, int flags)
+{
+    return (int)ringCall(fd, EPOLLIN,
+            [=](IoUring* ring) {
+                // addr2(即off)存放addrlen指针
+                return ring->Execute(IORING_OP_ACCEPT, fd, (uint64_t)(uintptr_t)addr,
+                        0, (uint64_t)(uintptr_t)addrlen, (uint32_t)flags);
+            },
+            [=]{
+                return ::accept4(fd, addr, addrlen, flags);
+            });
+}
+
+int connect(int fd, const struct sockaddr* addr, socklen_t addrlen)
+{
+    IoUring* ring = IoUring::Current();
+    if (!ring)
+        return ::connect(fd, addr, addrlen);
+
+    int res = ring->Execute(IORING_OP_CONNECT, fd, (uint64_t)(uintptr_t)addr, 0, addrlen);
+    if (res == -EBUSY)
+        return ::connect(fd, addr, addrlen);
+
+    // 非阻塞socket: 等待可写后取连接结果
+    if (res == -EINPROGRESS) {
+        if (NetPoller::WaitFd(fd, EPOLLOUT) < 0)
+            return -1;
+
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+            return -1;
+        res = -err;
+    }
+
+    if (res < 0) {
+        errno = -res;
+        return -1;
+    }
+    return 0;
+}
+
+int fsync(int fd)
+{
+    return (int)ringCall(fd, 0,
+            [=](IoUring* ring) {
+                return ring->Execute(IORING_OP_FSYNC, fd, 0, 0, 0);
+            },
+            [=]{
+                return ::fsync(fd);
+            });
+}
+
+#else
+
+IoUring::IoUring(int notifyFd, unsigned) : notifyFd_(notifyFd) {}
+IoUring::~IoUring() {}
+bool IoUring::Setup(unsigned) { return false; }
+void IoUring::Close() {}
+IoUring* IoUring::Current() { return nullptr; }
+int IoUring::Execute(uint8_t, int, uint64_t, uint32_t, uint64_t, uint32_t) { return -ENOSYS; }
+int IoUring::Flush() { return 0; }
+void IoUring::Submit() {}
+int IoUring::Reap() { return 0; }
+
+ssize_t read(int fd, void* buf, size_t count, off_t offset)
+{
+    return offset < 0 ? ::read(fd, buf, count) : ::pread(fd, buf, count, offset);
+}
+
+ssize_t write(int fd, const void* buf, size_t count, off_t offset)
+{
+    return offset < 0 ? ::write(fd, buf, count) : ::pwrite(fd, buf, count, offset);
+}
+
+ssize_t readv(int fd, const struct iovec* iov, int iovcnt, off_t offset)
+{
+    return offset < 0 ? ::readv(fd, iov, iovcnt) : ::preadv(fd, iov, iovcnt, offset);
+}
+
+ssize_t writev(int fd, const struct iovec* iov, int iovcnt, off_t offset)
+{
+    return offset < 0 ? ::writev(fd, iov, iovcnt) : ::pwritev(fd, iov, iovcnt, offset);
+}
+
+int accept(int fd, struct sockaddr* addr, socklen_t* addrlen, int flags)
+{
+    return flags ? ::accept4(fd, addr, addrlen, flags) : ::accept(fd, addr, addrlen);
+}
+
+int connect(int fd, const struct sockaddr* addr, socklen_t addrlen)
+{
+    return ::connect(fd, addr, addrlen);
+}
+
+int fsync(int fd)
+{
+    return ::fsync(fd);
+}
+
+#endif
+
+} //namespace co
@@ -0,0 +1,108 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "processor/Processor.h"
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#if defined(OS_Linux) && defined(__has_include)
+# if __has_include(<linux/io_uring.h>)
+#  define LIBGO_HAS_IO_URING 1
+# endif
+#endif
+
+namespace co
+{
+
+// io_uring后端
+// 每个P按需创建一个ring, 协程填好SQE后挂起, 由所在的P统一提交和收割:
+//   1.一轮调度(遍历一遍可执行队列)结束后, 把这一轮积攒的SQE用一次io_uring_enter批量提交.
+//   2.收割CQE时唤醒对应的协程, 结果写在协程栈上的Op中.
+//   3.ring上登记了P的eventfd, P阻塞在epoll_wait上时也能被完成事件唤醒.
+// 内核不支持(或被禁用)时IsValid()为false, 上层自动退化为普通的系统调用.
+class IoUring
+{
+public:
+    // 一次请求, 分配在等待协程的栈上
+    struct Op
+    {
+        Processor::SuspendEntry entry;
+        int res = 0;
+    };
+
+    // @notifyFd: 有完成事件时写入的eventfd, 小于0表示不登记
+    explicit IoUring(int notifyFd, unsigned entries = 256);
+    ~IoUring();
+
+    IoUring(IoUring const&) = delete;
+    IoUring& operator=(IoUring const&) = delete;
+
+    ALWAYS_INLINE bool IsValid() const { return ringFd_ >= 0; }
+
+    // 当前协程所在P的ring, 不在协程中/未开启/不支持时返回nullptr
+    static IoUring* Current();
+
+    // 填写一个SQE, 挂起当前协程直到完成. 必须在本P的协程中调用.
+    // @return: cqe.res, 负数为-errno
+    int Execute(uint8_t opcode, int fd, uint64_t addr, uint32_t len,
+            uint64_t off, uint32_t opFlags = 0);
+
+    // 是否有未提交的SQE或未完成的请求
+    ALWAYS_INLINE bool HasPending() const { return queued_ + inflight_ > 0; }
+
+    // 提交积攒的SQE并收割已完成的CQE, 仅由所属P的线程调用.
+    // @return: 唤醒的协程数
+    int Flush();
+
+private:
+    bool Setup(unsigned entries);
+
+    void Close();
+
+    // 提交积攒的SQE
+    void Submit();
+
+    // 收割已完成的CQE
+    int Reap();
+
+private:
+    int ringFd_ = -1;
+    int notifyFd_ = -1;
+
+    void* sqRing_ = nullptr;
+    void* cqRing_ = nullptr;
+    void* sqes_ = nullptr;
+    size_t sqRingSize_ = 0;
+    size_t cqRingSize_ = 0;
+    size_t sqesSize_ = 0;
+
+    // 映射到ring中的字段
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqMask_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqEntries_ = 0;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned* cqMask_ = nullptr;
+    void* cqes_ = nullptr;
+
+    unsigned queued_ = 0;       // 已填写未提交的SQE数
+    unsigned inflight_ = 0;     // 已提交未完成的请求数
+};
+
+// 协程友好的IO接口
+// 在开启了io_uring的P上执行时提交到ring并挂起当前协程, 否则直接调用同名的系统调用
+// (开启hook时socket读写在协程中同样只挂起协程).
+// 对设置了O_NONBLOCK的socket, 返回EAGAIN时等待就绪后重试, 不会把EAGAIN返回给调用者.
+// 与::read等同名, 因此不随coroutine.h引入, 以免using namespace co的代码产生二义性.
+// @offset: 文件偏移, -1表示使用并推进文件当前位置
+ssize_t read(int fd, void* buf, size_t count, off_t offset = -1);
+ssize_t write(int fd, const void* buf, size_t count, off_t offset = -1);
+ssize_t readv(int fd, const struct iovec* iov, int iovcnt, off_t offset = -1);
+ssize_t writev(int fd, const struct iovec* iov, int iovcnt, off_t offset = -1);
+int accept(int fd, struct sockaddr* addr, socklen_t* addrlen, int flags = 0);
+int connect(int fd, const struct sockaddr* addr, socklen_t addrlen);
+int fsync(int fd);
+
+} //namespace co
@@ -0,0 +1,349 @@
+#include "NetPoller.h"
+#include "scheduler/Scheduler.h"
+
+#if defined(OS_Linux)
+#include <sys/eventfd.h>
+#include <poll.h>
+#endif
+
+namespace co {
+
+#if defined(OS_Linux)
+
+static const uint32_t kWaitEvents = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLRDHUP;
+static const uint32_t kErrorEvents = EPOLLERR | EPOLLHUP;
+
+LFLock & NetPoller::RegistryLock()
+{
+    static LFLock lock;
+    return lock;
+}
+
+std::vector<NetPoller*> & NetPoller::Registry()
+{
+    static std::vector<NetPoller*> *pollers = new std::vector<NetPoller*>;
+    return *pollers;
+}
+
+NetPoller::NetPoller()
+{
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd_ < 0)
+        return ;
+
+    eventfd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (eventfd_ < 0) {
+        close(epfd_);
+        epfd_ = -1;
+        return ;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = eventfd_;
+    if (epoll_ctl(epfd_, EPOLL_CTL_ADD, eventfd_, &ev) < 0) {
+        close(eventfd_);
+        close(epfd_);
+        eventfd_ = epfd_ = -1;
+        return ;
+    }
+
+    std::unique_lock<LFLock> lock(RegistryLock());
+    Registry().push_back(this);
+}
+
+NetPoller::~NetPoller()
+{
+    if (IsValid()) {
+        std::unique_lock<LFLock> lock(RegistryLock());
+        auto & pollers = Registry();
+        pollers.erase(std::remove(pollers.begin(), pollers.end(), this), pollers.end());
+    }
+
+    if (eventfd_ >= 0) close(eventfd_);
+    if (epfd_ >= 0) close(epfd_);
+}
+
+int NetPoller::WaitFd(int fd, uint32_t events, int timeoutMs)
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = (short)(events & kWaitEvents);
+    pfd.revents = 0;
+    if (!pfd.events) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int n = WaitFds(&pfd, 1, timeoutMs);
+    return n > 0 ? pfd.revents : n;
+}
+
+int NetPoller::WaitFds(struct pollfd* fds, nfds_t nfds, int timeoutMs)
+{
+    Processor* proc = Processor::GetCurrentProcessor();
+    NetPoller* poller = (proc && Processor::IsCoroutine()) ? proc->GetPoller() : nullptr;
+    if (!poller || timeoutMs == 0) {
+        // 用ppoll而不是poll, 开启hook时不会再绕回这里
+        // EPOLLIN/EPOLLOUT等与POLLIN/POLLOUT数值一致
+        struct timespec ts, *pts = nullptr;
+        if (timeoutMs >= 0) {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (long)(timeoutMs % 1000) * 1000000;
+            pts = &ts;
+        }
+        return ::ppoll(fds, nfds, pts, nullptr);
+    }
+
+    static const nfds_t kStackNodes = 8;
+    Node stackNodes[kStackNodes];
+    std::unique_ptr<Node[]> heapNodes;
+    Node* nodes = stackNodes;
+    // 节点挂在轮询器上, 共享栈协程挂起后栈内容会被拷走, 也要放在堆上
+    if (nfds > kStackNodes || Processor::IsSharedStackTask()) {
+        heapNodes.reset(new Node[nfds]);
+        nodes = heapNodes.get();
+    }
+
+    // 所属TaskGroup被取消时不再等待, 以ECANCELED失败返回
+    Processor::CancellableScope scope;
+    if (scope.Cancelled()) {
+        errno = ECANCELED;
+        return -1;
+    }
+
+    // 先登记挂起再把节点挂到轮询器上, 其他线程关闭fd时从节点中拿到的entry一定有效
+    Processor::SuspendEntry entry = timeoutMs > 0
+        ? Processor::Suspend(std::chrono::milliseconds(timeoutMs))
+        : Processor::Suspend();
+
+    int ready = 0;
+    for (nfds_t i = 0; i < nfds; ++i) {
+        fds[i].revents = 0;
+        uint32_t events = fds[i].events & kWaitEvents;
+        if (fds[i].fd < 0 || !events)
+            continue;
+
+        Node & node = nodes[i];
+        node.fd = fds[i].fd;
+        node.events = events;
+        node.entry = entry;
+        if (!poller->Add(node.fd, &node)) {
+            node.fd = -1;
+
+            // 不支持epoll的fd(例如普通文件)总是就绪
+            if (errno == EPERM)
+                fds[i].revents = events & (POLLIN | POLLOUT);
+            else
+                fds[i].revents = (errno == EBADF) ? POLLNVAL : POLLERR;
+            ++ready;
+            break;
+        }
+    }
+
+    // 已经有就绪的fd, 撤销挂起
+    if (ready)
+        Processor::Wakeup(entry);
+
+    Processor::StaticCoYield();
+
+    for (nfds_t i = 0; i < nfds; ++i) {
+        Node & node = nodes[i];
+        if (node.fd < 0)
+            continue;
+
+        // 还在链表中说明是超时返回或者被其他fd唤醒的
+        if (poller->Remove(node.fd, &node))
+            continue;
+
+        fds[i].revents = node.revents;
+        ++ready;
+    }
+
+    if (!ready && scope.Cancelled()) {
+        errno = ECANCELED;
+        return -1;
+    }
+    return ready;
+}
+
+bool NetPoller::Add(int fd, Node* node)
+{
+    std::unique_lock<LFLock> lock(lock_);
+    FdState & state = fds_[fd];
+    node->next = state.head;
+    state.head = node;
+    node->linked = true;
+
+    // 已有其他等待者且关注的事件已武装时不必再epoll_ctl.
+    // 第一个等待者总是重新武装: 上次武装后fd可能已被关闭并复用了同号.
+    bool armed = node->next && (node->events & ~state.armed) == 0;
+    if (!armed && !Arm(fd, state)) {
+        state.head = node->next;
+        node->linked = false;
+        return false;
+    }
+
+    ++waiters_;
+    return true;
+}
+
+bool NetPoller::Remove(int fd, Node* node)
+{
+    std::unique_lock<LFLock> lock(lock_);
+    if (!node->linked)
+        return false;
+
+    // 不重新武装, 多余的就绪事件在分发时丢弃即可, 省掉一次epoll_ctl
+    FdState & state = fds_[fd];
+    for (Node** pos = &state.head; *pos; pos = &(*pos)->next) {
+        if (*pos == node) {
+            *pos = node->next;
+            break;
+        }
+    }
+    node->linked = false;
+    --waiters_;
+    return true;
+}
+
+bool NetPoller::Arm(int fd, FdState & state)
+{
+    uint32_t events = 0;
+    for (Node* node = state.head; node; node = node->next)
+        events |= node->events;
+
+    struct epoll_event ev;
+    ev.events = events | EPOLLONESHOT;
+    ev.data.fd = fd;
+
+    int op = state.added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    int res = epoll_ctl(epfd_, op, fd, &ev);
+    if (res < 0 && op == EPOLL_CTL_MOD && errno == ENOENT) {
+        // fd关闭后内核已经移除了登记, 这是一个复用了同号的新fd
+        res = epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+    } else if (res < 0 && op == EPOLL_CTL_ADD && errno == EEXIST) {
+        res = epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev);
+    }
+
+    if (res < 0) {
+        DebugPrint(dbg_ioblock, "epoll_ctl fd(%d) events(%u) failed. errno=%d", fd, events, errno);
+        return false;
+    }
+
+    state.added = true;
+    state.armed = events;
+    return true;
+}
+
+int NetPoller::Poll(int timeoutMs)
+{
+    static const int kMaxEvents = 128;
+    struct epoll_event evs[kMaxEvents];
+
+    int n = epoll_wait(epfd_, evs, kMaxEvents, timeoutMs);
+    int woken = 0;
+    for (int i = 0; i < n; ++i) {
+        if (evs[i].data.fd == eventfd_) {
+            DrainNotify();
+            continue;
+        }
+
+        woken += Dispatch(evs[i].data.fd, evs[i].events);
+    }
+    return woken;
+}
+
+int NetPoller::Dispatch(int fd, uint32_t revents)
+{
+    std::unique_lock<LFLock> lock(lock_);
+    auto it = fds_.find(fd);
+    if (it == fds_.end())
+        return 0;
+
+    FdState & state = it->second;
+
+    // ONESHOT触发后自动解除武装
+    state.armed = 0;
+
+    int woken = 0;
+    for (Node** pos = &state.head; *pos; ) {
+        Node* node = *pos;
+        uint32_t ready = revents & (node->events | kErrorEvents);
+        if (!ready) {
+            pos = &node->next;
+            continue;
+        }
+
+        *pos = node->next;
+        node->linked = false;
+        node->revents = ready;
+        --waiters_;
+
+        // 协程被唤醒后栈上的节点随时可能失效, 先把entry取出来
+        Processor::SuspendEntry entry = std::move(node->entry);
+        if (Processor::Wakeup(entry))
+            ++woken;
+    }
+
+    if (state.head)
+        Arm(fd, state);
+    return woken;
+}
+
+void NetPoller::CloseFd(int fd)
+{
+    std::unique_lock<LFLock> lock(RegistryLock());
+    for (NetPoller* poller : Registry())
+        if (poller->HasWaiters())
+            poller->OnClose(fd);
+}
+
+void NetPoller::OnClose(int fd)
+{
+    // fd关闭后内核会自动移除epoll中的登记, 这里只需要唤醒等待者
+    std::unique_lock<LFLock> lock(lock_);
+    auto it = fds_.find(fd);
+    if (it == fds_.end())
+        return ;
+
+    for (Node* node = it->second.head; node; ) {
+        Node* next = node->next;
+        node->linked = false;
+        node->revents = POLLNVAL;
+        --waiters_;
+
+        Processor::SuspendEntry entry = std::move(node->entry);
+        Processor::Wakeup(entry);
+        node = next;
+    }
+    fds_.erase(it);
+}
+
+void NetPoller::Notify()
+{
+    uint64_t one = 1;
+    ssize_t res = write(eventfd_, &one, sizeof(one));
+    (void)res;
+}
+
+void NetPoller::DrainNotify()
+{
+    uint64_t value;
+    ssize_t res = read(eventfd_, &value, sizeof(value));
+    (void)res;
+}
+
+#else
+
+NetPoller::NetPoller() {}
+NetPoller::~NetPoller() {}
+int NetPoller::WaitFd(int, uint32_t, int) { errno = ENOSYS; return -1; }
+int NetPoller::WaitFds(struct pollfd*, nfds_t, int) { errno = ENOSYS; return -1; }
+void NetPoller::CloseFd(int) {}
+int NetPoller::Poll(int) { return 0; }
+void NetPoller::Notify() {}
+
+#endif
+
+} //namespace co
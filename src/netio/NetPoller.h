@@ -0,0 +1,115 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "common/inc/SpinLock.h"
+#include "processor/Processor.h"
+#include <unordered_map>
+
+#if defined(OS_Linux)
+#include <sys/epoll.h>
+#include <poll.h>
+#endif
+
+namespace co
+{
+
+// 网络轮询器
+// 每个P持有一个epoll实例, 协程登记关注的fd事件后挂起, 由所在的P轮询:
+//   1.两批协程调度之间做一次零超时的轮询.
+//   2.没有可执行的协程时阻塞在epoll_wait上, 超时时间为下一个定时器的触发时间.
+// 另有一个eventfd, 其他线程投递协程或唤醒协程时用来唤醒阻塞在epoll_wait上的P.
+//
+// fd以EPOLLONESHOT方式登记, 每次就绪后需重新武装, 避免同一事件重复唤醒.
+// 登记信息只在首次等待时创建, fd关闭后由内核自动移除, 再次等待同号fd时会重新ADD.
+class NetPoller
+{
+public:
+    // 等待节点, 分配在等待协程的栈上
+    struct Node
+    {
+        Node* next = nullptr;
+        int fd = -1;
+        Processor::SuspendEntry entry;
+        uint32_t events = 0;    // 关注的事件
+        uint32_t revents = 0;   // 就绪的事件
+        bool linked = false;
+    };
+
+    NetPoller();
+    ~NetPoller();
+
+    NetPoller(NetPoller const&) = delete;
+    NetPoller& operator=(NetPoller const&) = delete;
+
+    ALWAYS_INLINE bool IsValid() const { return epfd_ >= 0; }
+
+    // 等待fd就绪, 在协程中只挂起当前协程, 不在协程中时退化为poll(2).
+    // @events: EPOLLIN/EPOLLOUT/EPOLLPRI/EPOLLRDHUP的组合
+    // @timeoutMs: 小于0表示不超时
+    // @return: 就绪的事件(可能带有EPOLLERR/EPOLLHUP), 超时返回0, 出错返回-1并设置errno,
+    //          所属TaskGroup被取消时返回-1, errno为ECANCELED
+    static int WaitFd(int fd, uint32_t events, int timeoutMs = -1);
+
+    // 等待一组fd中的任意一个就绪, 就绪的事件写入revents.
+    // fd小于0的项被忽略, 没有有效项时相当于睡眠timeoutMs.
+    // @return: 就绪的fd数量, 超时返回0, 出错返回-1并设置errno(被取消时为ECANCELED)
+    static int WaitFds(struct pollfd* fds, nfds_t nfds, int timeoutMs = -1);
+
+    // fd被关闭, 唤醒所有P上等待该fd的协程(revents为POLLNVAL), 线程安全
+    static void CloseFd(int fd);
+
+    // 轮询一次, 唤醒就绪的协程. 仅由所属P的线程调用.
+    // @return: 唤醒的协程数
+    int Poll(int timeoutMs);
+
+    // 唤醒阻塞在Poll中的P, 线程安全
+    void Notify();
+
+    // 唤醒用的eventfd, 供io_uring登记完成通知
+    ALWAYS_INLINE int NotifyFd() const { return eventfd_; }
+
+    // 是否有协程在等待fd
+    ALWAYS_INLINE bool HasWaiters() const
+    {
+        return waiters_.load(std::memory_order_relaxed) > 0;
+    }
+
+private:
+    struct FdState
+    {
+        Node* head = nullptr;
+        uint32_t armed = 0;     // 当前在epoll中武装的事件, 0表示未武装
+        bool added = false;     // 是否已经EPOLL_CTL_ADD过
+    };
+
+    // 登记等待节点并武装epoll, 失败时不登记
+    bool Add(int fd, Node* node);
+
+    // 把还在链表中的节点摘掉, 返回节点是否还在链表中(即未被分发唤醒)
+    bool Remove(int fd, Node* node);
+
+    // 按链表中所有节点关注的事件重新武装
+    bool Arm(int fd, FdState & state);
+
+    // 处理一个就绪事件
+    int Dispatch(int fd, uint32_t revents);
+
+    void DrainNotify();
+
+    void OnClose(int fd);
+
+    // 所有P的轮询器, 关闭fd时需要逐个通知
+    static LFLock & RegistryLock();
+    static std::vector<NetPoller*> & Registry();
+
+private:
+    int epfd_ = -1;
+    int eventfd_ = -1;
+
+    // fd登记表, 就绪分发在P线程, 但超时摘除可能发生在被偷走后的其他线程
+    LFLock lock_;
+    std::unordered_map<int, FdState> fds_;
+
+    std::atomic<long> waiters_{0};
+};
+
+} //namespace co
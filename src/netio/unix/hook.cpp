@@ -0,0 +1,948 @@
+#include "hook.h"
+#include "netio/NetPoller.h"
+#include "processor/Processor.h"
+#include "processor/CoLocalStorage.h"
+#include "common/inc/Clock.h"
+
+#if defined(OS_Linux)
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <thread>
+#include <condition_variable>
+
+namespace co {
+
+// fd上下文, 记录hook需要的socket状态
+struct FdContext
+{
+    bool inited = false;
+    bool isSocket = false;
+
+    // 用户设置的非阻塞标志
+    bool userNonBlock = false;
+
+    // hook替用户设置的非阻塞, 此时读写需要模拟阻塞语义
+    bool sysNonBlock = false;
+
+    int rcvTimeoutMs = 0;
+    int sndTimeoutMs = 0;
+    int connectTimeoutMs = 0;
+};
+
+// fd -> FdContext, 按块惰性分配, 查找无锁
+class FdContextTable
+{
+    static const int kChunkBits = 10;
+    static const int kChunkSize = 1 << kChunkBits;
+    static const int kMaxChunks = 1 << 12;
+
+    std::atomic<FdContext*> chunks_[kMaxChunks];
+
+public:
+    static FdContextTable& getInstance()
+    {
+        static FdContextTable *obj = new FdContextTable;
+        return *obj;
+    }
+
+    FdContextTable()
+    {
+        for (int i = 0; i < kMaxChunks; ++i)
+            chunks_[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    // 取得fd的上下文, create为false时不分配
+    FdContext* Get(int fd, bool create = true)
+    {
+        if (fd < 0 || (fd >> kChunkBits) >= kMaxChunks)
+            return nullptr;
+
+        std::atomic<FdContext*> & slot = chunks_[fd >> kChunkBits];
+        FdContext* chunk = slot.load(std::memory_order_acquire);
+        if (!chunk) {
+            if (!create)
+                return nullptr;
+
+            FdContext* newChunk = new FdContext[kChunkSize];
+            if (slot.compare_exchange_strong(chunk, newChunk,
+                        std::memory_order_acq_rel, std::memory_order_acquire))
+                chunk = newChunk;
+            else
+                delete[] newChunk;
+        }
+        return &chunk[fd & (kChunkSize - 1)];
+    }
+
+    void Reset(int fd)
+    {
+        FdContext* ctx = Get(fd, false);
+        if (ctx)
+            *ctx = FdContext();
+    }
+
+    void Copy(int from, int to)
+    {
+        FdContext* src = Get(from, false);
+        if (!src || !src->inited) {
+            Reset(to);
+            return ;
+        }
+
+        FdContext* dst = Get(to);
+        if (dst)
+            *dst = *src;
+    }
+};
+
+static int getTimeoutMs(int fd, int optname)
+{
+    struct timeval tv = {0, 0};
+    socklen_t len = sizeof(tv);
+    if (getsockopt(fd, SOL_SOCKET, optname, &tv, &len) != 0)
+        return 0;
+    return (int)(tv.tv_sec * 1000 + tv.tv_usec / 1000);
+}
+
+// 在协程中首次使用时初始化: socket设为非阻塞, 记录用户原本的标志和超时
+static void initFdContext(int fd, FdContext* ctx)
+{
+    ErrnoStore es;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return ;
+
+    ctx->isSocket = S_ISSOCK(st.st_mode);
+    if (ctx->isSocket) {
+        int flags = fcntl_f(fd, F_GETFL);
+        ctx->userNonBlock = !!(flags & O_NONBLOCK);
+        if (!ctx->userNonBlock && fcntl_f(fd, F_SETFL, flags | O_NONBLOCK) == 0)
+            ctx->sysNonBlock = true;
+        ctx->rcvTimeoutMs = getTimeoutMs(fd, SO_RCVTIMEO);
+        ctx->sndTimeoutMs = getTimeoutMs(fd, SO_SNDTIMEO);
+    }
+    ctx->inited = true;
+    DebugPrint(dbg_hook, "init fd(%d) socket=%d user_nonblock=%d sys_nonblock=%d",
+            fd, (int)ctx->isSocket, (int)ctx->userNonBlock, (int)ctx->sysNonBlock);
+}
+
+// 需要模拟阻塞语义的fd返回其上下文, 否则返回nullptr
+static FdContext* blockingContext(int fd)
+{
+    FdContext* ctx = FdContextTable::getInstance().Get(fd, Processor::IsCoroutine());
+    if (!ctx)
+        return nullptr;
+
+    if (!ctx->inited && Processor::IsCoroutine())
+        initFdContext(fd, ctx);
+
+    return ctx->sysNonBlock ? ctx : nullptr;
+}
+
+// 剩余的毫秒数, 向上取整, 不超时返回-1
+static int leftMs(FastSteadyClock::time_point deadline)
+{
+    if (deadline == FastSteadyClock::time_point::max())
+        return -1;
+
+    auto left = deadline - FastSteadyClock::now();
+    if (left <= FastSteadyClock::duration::zero())
+        return 0;
+
+    return (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+            left + std::chrono::milliseconds(1) - FastSteadyClock::duration(1)).count();
+}
+
+static FastSteadyClock::time_point deadlineOf(int timeoutMs)
+{
+    if (timeoutMs <= 0)
+        return FastSteadyClock::time_point::max();
+    return FastSteadyClock::now() + std::chrono::milliseconds(timeoutMs);
+}
+
+// 等待单个fd: 协程中挂起, 原生线程中阻塞在原始的poll上
+static int waitFd(int fd, short events, int timeoutMs)
+{
+    if (Processor::IsCoroutine())
+        return NetPoller::WaitFd(fd, events, timeoutMs);
+
+    struct pollfd pfd = {fd, events, 0};
+    int n = poll_f(&pfd, 1, timeoutMs);
+    return n > 0 ? pfd.revents : n;
+}
+
+template <typename OriginF, typename ... Args>
+static ssize_t doIo(OriginF fn, const char* name, int fd, short events, int timeoutType, Args ... args)
+{
+    FdContext* ctx = blockingContext(fd);
+    if (!ctx)
+        return fn(fd, args...);
+
+    int timeoutMs = timeoutType == SO_RCVTIMEO ? ctx->rcvTimeoutMs : ctx->sndTimeoutMs;
+    auto deadline = deadlineOf(timeoutMs);
+    for (;;) {
+        ssize_t n = fn(fd, args...);
+        if (n >= 0 || errno != EAGAIN)
+            return n;
+
+        int left = leftMs(deadline);
+        if (left == 0) {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        DebugPrint(dbg_hook, "%s fd(%d) wait events(%d) timeout(%d ms)", name, fd, (int)events, left);
+        int res = waitFd(fd, events, left);
+        if (res == 0) {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        if (res < 0 && errno != EINTR)
+            return -1;
+    }
+}
+
+// 协程中的睡眠, 所属TaskGroup被取消时提前返回false并置errno为ECANCELED.
+// hook的函数不能抛出异常, 不使用co::sleep_for.
+static bool coSleepUntil(FastSteadyClock::time_point deadline)
+{
+    if (Processor::IsCancelled()) {
+        errno = ECANCELED;
+        return false;
+    }
+
+    if (deadline > FastSteadyClock::now())
+        Processor::Suspend(deadline);
+    Processor::StaticCoYield();
+
+    if (Processor::IsCancelled()) {
+        errno = ECANCELED;
+        return false;
+    }
+    return true;
+}
+
+// 在协程中睡眠, 时长为0时只让出一次
+// 先注册关注的fd挂起, 被唤醒或超时后用check做一次零超时检查, 直到有结果或超时.
+// check返回非0时直接作为结果返回.
+template <typename Check>
+static int waitUntil(struct pollfd* fds, nfds_t nfds, int timeoutMs, Check const& check)
+{
+    bool hasFd = false;
+    for (nfds_t i = 0; i < nfds; ++i)
+        if (fds[i].fd >= 0 && fds[i].events)
+            hasFd = true;
+
+    if (!hasFd) {
+        auto deadline = FastSteadyClock::now();
+        if (timeoutMs > 0)
+            deadline += std::chrono::milliseconds(timeoutMs);
+        if (!coSleepUntil(deadline))
+            return -1;
+        return check();
+    }
+
+    auto deadline = deadlineOf(timeoutMs);
+    for (;;) {
+        int left = leftMs(deadline);
+        if (left == 0)
+            return check();
+
+        int res = NetPoller::WaitFds(fds, nfds, left);
+        if (res < 0)
+            return res;
+
+        int n = check();
+        if (n != 0 || res == 0)
+            return n;
+    }
+}
+
+// 域名解析线程
+// glibc的解析器在内部直接发起系统调用, hook不到, 只能放到独立的线程中执行, 协程挂起等待.
+class ResolverThreads
+{
+    struct Job
+    {
+        std::function<void()> fn;
+        Processor::SuspendEntry entry;
+        bool done = false;
+    };
+
+    static const int kMaxThreads = 8;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Job*> jobs_;
+    int threads_ = 0;
+    int idle_ = 0;
+
+public:
+    static ResolverThreads& getInstance()
+    {
+        static ResolverThreads *obj = new ResolverThreads;
+        return *obj;
+    }
+
+    void Call(std::function<void()> const& fn)
+    {
+        // fn在解析线程上读写调用方栈上的变量, 共享栈协程挂起后栈内容会被拷走, 只能在当前线程同步执行
+        if (!Processor::IsCoroutine() || Processor::IsSharedStackTask()) {
+            fn();
+            return ;
+        }
+
+        Job job;
+        job.fn = fn;
+        job.entry = Processor::Suspend();
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            jobs_.push_back(&job);
+            if (idle_ > 0) {
+                cv_.notify_one();
+            } else if (threads_ < kMaxThreads) {
+                ++threads_;
+                std::thread([this]{ this->Run(); }).detach();
+            }
+        }
+        Processor::StaticCoYield();
+        assert(job.done);
+    }
+
+private:
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        for (;;) {
+            while (jobs_.empty()) {
+                ++idle_;
+                cv_.wait(lock);
+                --idle_;
+            }
+
+            Job* job = jobs_.front();
+            jobs_.pop_front();
+            lock.unlock();
+
+            job->fn();
+
+            // 协程被唤醒后job随时可能失效, 先把entry取出来
+            Processor::SuspendEntry entry = std::move(job->entry);
+            job->done = true;
+            Processor::Wakeup(entry);
+
+            lock.lock();
+        }
+    }
+};
+
+// 不可重入的gethostbyXXX在协程中使用协程本地的缓冲区
+struct HostentBuffer
+{
+    struct hostent host;
+    std::vector<char> buf;
+};
+
+template <typename F>
+static struct hostent* gethostbyXXX(F const& fn)
+{
+    HostentBuffer & hb = CLS(HostentBuffer);
+    if (hb.buf.empty())
+        hb.buf.resize(1024);
+
+    for (;;) {
+        struct hostent* result = nullptr;
+        int err = 0;
+        int res = fn(&hb.host, &hb.buf[0], hb.buf.size(), &result, &err);
+        if (res == ERANGE && err == NETDB_INTERNAL) {
+            hb.buf.resize(hb.buf.size() * 2);
+            continue;
+        }
+
+        h_errno = err;
+        return result;
+    }
+}
+
+bool setTcpConnectTimeout(int fd, int milliseconds)
+{
+    FdContext* ctx = FdContextTable::getInstance().Get(fd);
+    if (!ctx)
+        return false;
+
+    ctx->connectTimeoutMs = milliseconds;
+    return true;
+}
+
+} //namespace co
+
+using namespace co;
+
+extern "C" {
+
+socket_t socket_f = NULL;
+socketpair_t socketpair_f = NULL;
+connect_t connect_f = NULL;
+accept_t accept_f = NULL;
+accept4_t accept4_f = NULL;
+read_t read_f = NULL;
+readv_t readv_f = NULL;
+recv_t recv_f = NULL;
+recvfrom_t recvfrom_f = NULL;
+recvmsg_t recvmsg_f = NULL;
+write_t write_f = NULL;
+writev_t writev_f = NULL;
+send_t send_f = NULL;
+sendto_t sendto_f = NULL;
+sendmsg_t sendmsg_f = NULL;
+poll_t poll_f = NULL;
+select_t select_f = NULL;
+sleep_t sleep_f = NULL;
+usleep_t usleep_f = NULL;
+nanosleep_t nanosleep_f = NULL;
+close_t close_f = NULL;
+fcntl_t fcntl_f = NULL;
+ioctl_t ioctl_f = NULL;
+setsockopt_t setsockopt_f = NULL;
+dup_t dup_f = NULL;
+dup2_t dup2_f = NULL;
+dup3_t dup3_f = NULL;
+gethostbyname_t gethostbyname_f = NULL;
+gethostbyname2_t gethostbyname2_f = NULL;
+gethostbyaddr_t gethostbyaddr_f = NULL;
+getaddrinfo_t getaddrinfo_f = NULL;
+gethostbyname_r_t gethostbyname_r_f = NULL;
+gethostbyname2_r_t gethostbyname2_r_f = NULL;
+gethostbyaddr_r_t gethostbyaddr_r_f = NULL;
+
+} // extern "C"
+
+namespace co {
+
+#define HOOK_SYS_FUNC(name) name##_f = (name##_t)dlsym(RTLD_NEXT, #name)
+
+void initHook()
+{
+    HOOK_SYS_FUNC(socket);
+    HOOK_SYS_FUNC(socketpair);
+    HOOK_SYS_FUNC(connect);
+    HOOK_SYS_FUNC(accept);
+    HOOK_SYS_FUNC(accept4);
+    HOOK_SYS_FUNC(read);
+    HOOK_SYS_FUNC(readv);
+    HOOK_SYS_FUNC(recv);
+    HOOK_SYS_FUNC(recvfrom);
+    HOOK_SYS_FUNC(recvmsg);
+    HOOK_SYS_FUNC(write);
+    HOOK_SYS_FUNC(writev);
+    HOOK_SYS_FUNC(send);
+    HOOK_SYS_FUNC(sendto);
+    HOOK_SYS_FUNC(sendmsg);
+    HOOK_SYS_FUNC(poll);
+    HOOK_SYS_FUNC(select);
+    HOOK_SYS_FUNC(sleep);
+    HOOK_SYS_FUNC(usleep);
+    HOOK_SYS_FUNC(nanosleep);
+    HOOK_SYS_FUNC(close);
+    HOOK_SYS_FUNC(fcntl);
+    HOOK_SYS_FUNC(ioctl);
+    HOOK_SYS_FUNC(setsockopt);
+    HOOK_SYS_FUNC(dup);
+    HOOK_SYS_FUNC(dup2);
+    HOOK_SYS_FUNC(dup3);
+    HOOK_SYS_FUNC(gethostbyname);
+    HOOK_SYS_FUNC(gethostbyname2);
+    HOOK_SYS_FUNC(gethostbyaddr);
+    HOOK_SYS_FUNC(getaddrinfo);
+    HOOK_SYS_FUNC(gethostbyname_r);
+    HOOK_SYS_FUNC(gethostbyname2_r);
+    HOOK_SYS_FUNC(gethostbyaddr_r);
+}
+
+#undef HOOK_SYS_FUNC
+
+} //namespace co
+
+#if ENABLE_HOOK
+
+// 第一次调用可能早于coInitialize(例如在全局对象的构造函数中)
+#define HOOK_INIT(name) do { if (UNLIKELY(!name##_f)) ::co::initHook(); } while (0)
+
+extern "C" {
+
+int socket(int domain, int type, int protocol)
+{
+    HOOK_INIT(socket);
+    int fd = socket_f(domain, type, protocol);
+    if (fd >= 0)
+        FdContextTable::getInstance().Reset(fd);
+    return fd;
+}
+
+int socketpair(int domain, int type, int protocol, int sv[2])
+{
+    HOOK_INIT(socketpair);
+    int res = socketpair_f(domain, type, protocol, sv);
+    if (res == 0) {
+        FdContextTable::getInstance().Reset(sv[0]);
+        FdContextTable::getInstance().Reset(sv[1]);
+    }
+    return res;
+}
+
+int connect(int fd, const struct sockaddr *addr, socklen_t addrlen)
+{
+    HOOK_INIT(connect);
+    FdContext* ctx = blockingContext(fd);
+    if (!ctx)
+        return connect_f(fd, addr, addrlen);
+
+    int n = connect_f(fd, addr, addrlen);
+    if (n == 0 || errno != EINPROGRESS)
+        return n;
+
+    int timeoutMs = ctx->connectTimeoutMs > 0 ? ctx->connectTimeoutMs : -1;
+    int res = waitFd(fd, POLLOUT, timeoutMs);
+    if (res == 0) {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    if (res < 0)
+        return -1;
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0)
+        return -1;
+
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+int accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
+{
+    HOOK_INIT(accept);
+    int fd = (int)doIo(accept_f, "accept", sockfd, POLLIN, SO_RCVTIMEO, addr, addrlen);
+    if (fd >= 0)
+        FdContextTable::getInstance().Reset(fd);
+    return fd;
+}
+
+int accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int flags)
+{
+    HOOK_INIT(accept4);
+    int fd = (int)doIo(accept4_f, "accept4", sockfd, POLLIN, SO_RCVTIMEO, addr, addrlen, flags);
+    if (fd >= 0)
+        FdContextTable::getInstance().Reset(fd);
+    return fd;
+}
+
+ssize_t read(int fd, void *buf, size_t count)
+{
+    HOOK_INIT(read);
+    return doIo(read_f, "read", fd, POLLIN, SO_RCVTIMEO, buf, count);
+}
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    HOOK_INIT(readv);
+    return doIo(readv_f, "readv", fd, POLLIN, SO_RCVTIMEO, iov, iovcnt);
+}
+
+ssize_t recv(int sockfd, void *buf, size_t len, int flags)
+{
+    HOOK_INIT(recv);
+    return doIo(recv_f, "recv", sockfd, POLLIN, SO_RCVTIMEO, buf, len, flags);
+}
+
+ssize_t recvfrom(int sockfd, void *buf, size_t len, int flags,
+        struct sockaddr *src_addr, socklen_t *addrlen)
+{
+    HOOK_INIT(recvfrom);
+    return doIo(recvfrom_f, "recvfrom", sockfd, POLLIN, SO_RCVTIMEO, buf, len, flags, src_addr, addrlen);
+}
+
+ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags)
+{
+    HOOK_INIT(recvmsg);
+    return doIo(recvmsg_f, "recvmsg", sockfd, POLLIN, SO_RCVTIMEO, msg, flags);
+}
+
+ssize_t write(int fd, const void *buf, size_t count)
+{
+    HOOK_INIT(write);
+    return doIo(write_f, "write", fd, POLLOUT, SO_SNDTIMEO, buf, count);
+}
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    HOOK_INIT(writev);
+    return doIo(writev_f, "writev", fd, POLLOUT, SO_SNDTIMEO, iov, iovcnt);
+}
+
+ssize_t send(int sockfd, const void *buf, size_t len, int flags)
+{
+    HOOK_INIT(send);
+    return doIo(send_f, "send", sockfd, POLLOUT, SO_SNDTIMEO, buf, len, flags);
+}
+
+ssize_t sendto(int sockfd, const void *buf, size_t len, int flags,
+        const struct sockaddr *dest_addr, socklen_t addrlen)
+{
+    HOOK_INIT(sendto);
+    return doIo(sendto_f, "sendto", sockfd, POLLOUT, SO_SNDTIMEO, buf, len, flags, dest_addr, addrlen);
+}
+
+ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags)
+{
+    HOOK_INIT(sendmsg);
+    return doIo(sendmsg_f, "sendmsg", sockfd, POLLOUT, SO_SNDTIMEO, msg, flags);
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    HOOK_INIT(poll);
+    if (!Processor::IsCoroutine() || timeout == 0)
+        return poll_f(fds, nfds, timeout);
+
+    int n = poll_f(fds, nfds, 0);
+    if (n != 0)
+        return n;
+
+    return waitUntil(fds, nfds, timeout, [=]{ return poll_f(fds, nfds, 0); });
+}
+
+int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout)
+{
+    HOOK_INIT(select);
+    int timeoutMs = timeout ? (int)(timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000) : -1;
+    if (!Processor::IsCoroutine() || timeoutMs == 0)
+        return select_f(nfds, readfds, writefds, exceptfds, timeout);
+
+    // 每次检查都要从用户传入的集合开始, 检查结果写回用户的集合
+    fd_set sets[3], origin[3];
+    fd_set* user[3] = {readfds, writefds, exceptfds};
+    for (int i = 0; i < 3; ++i)
+        if (user[i])
+            origin[i] = *user[i];
+
+    auto check = [&]{
+        fd_set* args[3] = {nullptr, nullptr, nullptr};
+        for (int i = 0; i < 3; ++i) {
+            if (!user[i]) continue;
+            sets[i] = origin[i];
+            args[i] = &sets[i];
+        }
+
+        struct timeval zero = {0, 0};
+        int n = select_f(nfds, args[0], args[1], args[2], &zero);
+        if (n >= 0) {
+            for (int i = 0; i < 3; ++i)
+                if (user[i])
+                    *user[i] = sets[i];
+        }
+        return n;
+    };
+
+    int n = check();
+    if (n != 0)
+        return n;
+
+    std::vector<struct pollfd> fds;
+    for (int fd = 0; fd < nfds; ++fd) {
+        short events = 0;
+        if (readfds && FD_ISSET(fd, &origin[0]))
+            events |= POLLIN;
+        if (writefds && FD_ISSET(fd, &origin[1]))
+            events |= POLLOUT;
+        if (exceptfds && FD_ISSET(fd, &origin[2]))
+            events |= POLLPRI;
+        if (events)
+            fds.push_back(pollfd{fd, events, 0});
+    }
+
+    return waitUntil(fds.data(), fds.size(), timeoutMs, check);
+}
+
+unsigned int sleep(unsigned int seconds)
+{
+    HOOK_INIT(sleep);
+    if (!Processor::IsCoroutine())
+        return sleep_f(seconds);
+
+    auto deadline = FastSteadyClock::now() + std::chrono::seconds(seconds);
+    if (!coSleepUntil(deadline)) {
+        // 返回未睡完的秒数
+        auto left = deadline - FastSteadyClock::now();
+        return (unsigned int)std::chrono::duration_cast<std::chrono::seconds>(
+                left + std::chrono::seconds(1) - FastSteadyClock::duration(1)).count();
+    }
+    return 0;
+}
+
+int usleep(useconds_t usec)
+{
+    HOOK_INIT(usleep);
+    if (!Processor::IsCoroutine())
+        return usleep_f(usec);
+
+    if (!coSleepUntil(FastSteadyClock::now() + std::chrono::microseconds(usec)))
+        return -1;
+    return 0;
+}
+
+int nanosleep(const struct timespec *req, struct timespec *rem)
+{
+    HOOK_INIT(nanosleep);
+    if (!Processor::IsCoroutine())
+        return nanosleep_f(req, rem);
+
+    if (!req || req->tv_sec < 0 || req->tv_nsec < 0 || req->tv_nsec >= 1000000000) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    auto deadline = FastSteadyClock::now() + std::chrono::seconds(req->tv_sec) + std::chrono::nanoseconds(req->tv_nsec);
+    if (!coSleepUntil(deadline)) {
+        if (rem) {
+            auto left = (std::max)(deadline - FastSteadyClock::now(), FastSteadyClock::duration::zero());
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+            rem->tv_sec = (time_t)(ns / 1000000000);
+            rem->tv_nsec = (long)(ns % 1000000000);
+        }
+        return -1;
+    }
+    return 0;
+}
+
+int close(int fd)
+{
+    HOOK_INIT(close);
+    FdContextTable::getInstance().Reset(fd);
+    int res = close_f(fd);
+
+    // 唤醒还在等待这个fd的协程, 它们重新检查时会得到POLLNVAL/EBADF
+    ErrnoStore es;
+    NetPoller::CloseFd(fd);
+    return res;
+}
+
+int fcntl(int fd, int cmd, ...)
+{
+    HOOK_INIT(fcntl);
+    va_list va;
+    va_start(va, cmd);
+
+    switch (cmd) {
+        case F_DUPFD:
+        case F_DUPFD_CLOEXEC:
+            {
+                int arg = va_arg(va, int);
+                va_end(va);
+                int newfd = fcntl_f(fd, cmd, arg);
+                if (newfd >= 0)
+                    FdContextTable::getInstance().Copy(fd, newfd);
+                return newfd;
+            }
+
+        case F_GETFL:
+            {
+                va_end(va);
+                int flags = fcntl_f(fd, cmd);
+                FdContext* ctx = FdContextTable::getInstance().Get(fd, false);
+                if (flags >= 0 && ctx && ctx->sysNonBlock)
+                    flags &= ~O_NONBLOCK;
+                return flags;
+            }
+
+        case F_SETFL:
+            {
+                int arg = va_arg(va, int);
+                va_end(va);
+                FdContext* ctx = FdContextTable::getInstance().Get(fd, false);
+                if (ctx && ctx->inited && ctx->isSocket) {
+                    // 已经被hook接管的socket始终保持非阻塞, 只记录用户的意图
+                    ctx->userNonBlock = !!(arg & O_NONBLOCK);
+                    ctx->sysNonBlock = !ctx->userNonBlock;
+                    arg |= O_NONBLOCK;
+                }
+                return fcntl_f(fd, cmd, arg);
+            }
+
+        default:
+            {
+                void* arg = va_arg(va, void*);
+                va_end(va);
+                return fcntl_f(fd, cmd, arg);
+            }
+    }
+}
+
+int ioctl(int fd, unsigned long int request, ...)
+{
+    HOOK_INIT(ioctl);
+    va_list va;
+    va_start(va, request);
+    void* arg = va_arg(va, void*);
+    va_end(va);
+
+    if (request == FIONBIO && arg) {
+        FdContext* ctx = FdContextTable::getInstance().Get(fd, false);
+        if (ctx && ctx->inited && ctx->isSocket) {
+            int userNonBlock = *(int*)arg;
+            int nonblock = 1;
+            int res = ioctl_f(fd, request, &nonblock);
+            if (res == 0) {
+                ctx->userNonBlock = !!userNonBlock;
+                ctx->sysNonBlock = !userNonBlock;
+            }
+            return res;
+        }
+    }
+
+    return ioctl_f(fd, request, arg);
+}
+
+int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen)
+{
+    HOOK_INIT(setsockopt);
+    int res = setsockopt_f(sockfd, level, optname, optval, optlen);
+    if (res == 0 && level == SOL_SOCKET && (optname == SO_RCVTIMEO || optname == SO_SNDTIMEO)
+            && optval && optlen >= sizeof(struct timeval))
+    {
+        FdContext* ctx = FdContextTable::getInstance().Get(sockfd, false);
+        if (ctx && ctx->inited) {
+            const struct timeval & tv = *(const struct timeval*)optval;
+            int ms = (int)(tv.tv_sec * 1000 + tv.tv_usec / 1000);
+            if (optname == SO_RCVTIMEO)
+                ctx->rcvTimeoutMs = ms;
+            else
+                ctx->sndTimeoutMs = ms;
+        }
+    }
+    return res;
+}
+
+int dup(int oldfd)
+{
+    HOOK_INIT(dup);
+    int fd = dup_f(oldfd);
+    if (fd >= 0)
+        FdContextTable::getInstance().Copy(oldfd, fd);
+    return fd;
+}
+
+int dup2(int oldfd, int newfd)
+{
+    HOOK_INIT(dup2);
+    int fd = dup2_f(oldfd, newfd);
+    if (fd >= 0 && fd != oldfd)
+        FdContextTable::getInstance().Copy(oldfd, fd);
+    return fd;
+}
+
+int dup3(int oldfd, int newfd, int flags)
+{
+    HOOK_INIT(dup3);
+    int fd = dup3_f(oldfd, newfd, flags);
+    if (fd >= 0)
+        FdContextTable::getInstance().Copy(oldfd, fd);
+    return fd;
+}
+
+int getaddrinfo(const char *node, const char *service,
+        const struct addrinfo *hints, struct addrinfo **res)
+{
+    HOOK_INIT(getaddrinfo);
+    int ret = 0, err = 0;
+    ResolverThreads::getInstance().Call([&]{
+            ret = getaddrinfo_f(node, service, hints, res);
+            err = errno;
+        });
+    errno = err;
+    return ret;
+}
+
+int gethostbyname_r(const char *name, struct hostent *ret, char *buf, size_t buflen,
+        struct hostent **result, int *h_errnop)
+{
+    HOOK_INIT(gethostbyname_r);
+    int res = 0;
+    ResolverThreads::getInstance().Call([&]{
+            res = gethostbyname_r_f(name, ret, buf, buflen, result, h_errnop);
+        });
+    return res;
+}
+
+int gethostbyname2_r(const char *name, int af, struct hostent *ret, char *buf,
+        size_t buflen, struct hostent **result, int *h_errnop)
+{
+    HOOK_INIT(gethostbyname2_r);
+    int res = 0;
+    ResolverThreads::getInstance().Call([&]{
+            res = gethostbyname2_r_f(name, af, ret, buf, buflen, result, h_errnop);
+        });
+    return res;
+}
+
+int gethostbyaddr_r(const void *addr, socklen_t len, int type, struct hostent *ret,
+        char *buf, size_t buflen, struct hostent **result, int *h_errnop)
+{
+    HOOK_INIT(gethostbyaddr_r);
+    int res = 0;
+    ResolverThreads::getInstance().Call([&]{
+            res = gethostbyaddr_r_f(addr, len, type, ret, buf, buflen, result, h_errnop);
+        });
+    return res;
+}
+
+struct hostent* gethostbyname(const char *name)
+{
+    HOOK_INIT(gethostbyname);
+    if (!Processor::IsCoroutine())
+        return gethostbyname_f(name);
+
+    return gethostbyXXX([=](struct hostent *ret, char *buf, size_t buflen,
+                struct hostent **result, int *h_errnop) {
+            return gethostbyname_r(name, ret, buf, buflen, result, h_errnop);
+        });
+}
+
+struct hostent* gethostbyname2(const char *name, int af)
+{
+    HOOK_INIT(gethostbyname2);
+    if (!Processor::IsCoroutine())
+        return gethostbyname2_f(name, af);
+
+    return gethostbyXXX([=](struct hostent *ret, char *buf, size_t buflen,
+                struct hostent **result, int *h_errnop) {
+            return gethostbyname2_r(name, af, ret, buf, buflen, result, h_errnop);
+        });
+}
+
+struct hostent* gethostbyaddr(const void *addr, socklen_t len, int type)
+{
+    HOOK_INIT(gethostbyaddr);
+    if (!Processor::IsCoroutine())
+        return gethostbyaddr_f(addr, len, type);
+
+    return gethostbyXXX([=](struct hostent *ret, char *buf, size_t buflen,
+                struct hostent **result, int *h_errnop) {
+            return gethostbyaddr_r(addr, len, type, ret, buf, buflen, result, h_errnop);
+        });
+}
+
+} // extern "C"
+
+#undef HOOK_INIT
+
+#endif // ENABLE_HOOK
+
+#endif // defined(OS_Linux)
@@ -0,0 +1,143 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/uio.h>
+
+// 系统调用hook
+// 在协程中调用阻塞的网络IO/睡眠函数时, 只挂起当前协程, 不阻塞所在的线程:
+//   1.socket在协程中首次使用时被设置为非阻塞(对用户不可见, fcntl/ioctl仍返回用户设置的标志).
+//   2.读写返回EAGAIN时通过NetPoller挂起, 就绪后重试; 超时遵循SO_RCVTIMEO/SO_SNDTIMEO.
+//   3.poll/select先做一次零超时的检查, 没有就绪再挂起等待.
+//   4.sleep/usleep/nanosleep挂起协程.
+//   5.域名解析在独立的线程中执行, 协程挂起等待结果.
+// 在原生线程中调用时直接调用原始函数; 被协程设置为非阻塞的socket在原生线程中仍保持阻塞语义.
+
+namespace co {
+
+// 取得被hook的系统函数的原始地址, 一般无需手动调用
+void initHook();
+
+// 设置tcp连接超时(毫秒), 只对hook后的connect有效, 小于等于0表示不超时
+bool setTcpConnectTimeout(int fd, int milliseconds);
+
+} //namespace co
+
+extern "C" {
+
+typedef int(*socket_t)(int domain, int type, int protocol);
+extern socket_t socket_f;
+
+typedef int(*socketpair_t)(int domain, int type, int protocol, int sv[2]);
+extern socketpair_t socketpair_f;
+
+typedef int(*connect_t)(int, const struct sockaddr *, socklen_t);
+extern connect_t connect_f;
+
+typedef int(*accept_t)(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
+extern accept_t accept_f;
+
+typedef int(*accept4_t)(int sockfd, struct sockaddr *addr, socklen_t *addrlen, int flags);
+extern accept4_t accept4_f;
+
+typedef ssize_t(*read_t)(int, void *, size_t);
+extern read_t read_f;
+
+typedef ssize_t(*readv_t)(int, const struct iovec *, int);
+extern readv_t readv_f;
+
+typedef ssize_t(*recv_t)(int sockfd, void *buf, size_t len, int flags);
+extern recv_t recv_f;
+
+typedef ssize_t(*recvfrom_t)(int sockfd, void *buf, size_t len, int flags,
+        struct sockaddr *src_addr, socklen_t *addrlen);
+extern recvfrom_t recvfrom_f;
+
+typedef ssize_t(*recvmsg_t)(int sockfd, struct msghdr *msg, int flags);
+extern recvmsg_t recvmsg_f;
+
+typedef ssize_t(*write_t)(int, const void *, size_t);
+extern write_t write_f;
+
+typedef ssize_t(*writev_t)(int, const struct iovec *, int);
+extern writev_t writev_f;
+
+typedef ssize_t(*send_t)(int sockfd, const void *buf, size_t len, int flags);
+extern send_t send_f;
+
+typedef ssize_t(*sendto_t)(int sockfd, const void *buf, size_t len, int flags,
+        const struct sockaddr *dest_addr, socklen_t addrlen);
+extern sendto_t sendto_f;
+
+typedef ssize_t(*sendmsg_t)(int sockfd, const struct msghdr *msg, int flags);
+extern sendmsg_t sendmsg_f;
+
+typedef int(*poll_t)(struct pollfd *fds, nfds_t nfds, int timeout);
+extern poll_t poll_f;
+
+typedef int(*select_t)(int nfds, fd_set *readfds, fd_set *writefds,
+        fd_set *exceptfds, struct timeval *timeout);
+extern select_t select_f;
+
+typedef unsigned int(*sleep_t)(unsigned int seconds);
+extern sleep_t sleep_f;
+
+typedef int(*usleep_t)(useconds_t usec);
+extern usleep_t usleep_f;
+
+typedef int(*nanosleep_t)(const struct timespec *req, struct timespec *rem);
+extern nanosleep_t nanosleep_f;
+
+typedef int(*close_t)(int);
+extern close_t close_f;
+
+typedef int(*fcntl_t)(int fd, int cmd, ...);
+extern fcntl_t fcntl_f;
+
+typedef int(*ioctl_t)(int fd, unsigned long int request, ...);
+extern ioctl_t ioctl_f;
+
+typedef int(*setsockopt_t)(int sockfd, int level, int optname,
+        const void *optval, socklen_t optlen);
+extern setsockopt_t setsockopt_f;
+
+typedef int(*dup_t)(int);
+extern dup_t dup_f;
+
+typedef int(*dup2_t)(int, int);
+extern dup2_t dup2_f;
+
+typedef int(*dup3_t)(int, int, int);
+extern dup3_t dup3_f;
+
+typedef struct hostent*(*gethostbyname_t)(const char *name);
+extern gethostbyname_t gethostbyname_f;
+
+typedef struct hostent*(*gethostbyname2_t)(const char *name, int af);
+extern gethostbyname2_t gethostbyname2_f;
+
+typedef struct hostent*(*gethostbyaddr_t)(const void *addr, socklen_t len, int type);
+extern gethostbyaddr_t gethostbyaddr_f;
+
+typedef int(*getaddrinfo_t)(const char *node, const char *service,
+        const struct addrinfo *hints, struct addrinfo **res);
+extern getaddrinfo_t getaddrinfo_f;
+
+typedef int(*gethostbyname_r_t)(const char *name, struct hostent *ret, char *buf,
+        size_t buflen, struct hostent **result, int *h_errnop);
+extern gethostbyname_r_t gethostbyname_r_f;
+
+typedef int(*gethostbyname2_r_t)(const char *name, int af, struct hostent *ret,
+        char *buf, size_t buflen, struct hostent **result, int *h_errnop);
+extern gethostbyname2_r_t gethostbyname2_r_f;
+
+typedef int(*gethostbyaddr_r_t)(const void *addr, socklen_t len, int type,
+        struct hostent *ret, char *buf, size_t buflen, struct hostent **result,
+        int *h_errnop);
+extern gethostbyaddr_r_t gethostbyaddr_r_f;
+
+} // extern "C"
@@ -1,5 +1,5 @@
-#include "async_coroutine_pool.h"
-#include "../coroutine.h"
+#include "AsyncCoroutinePool.h"
+#include "co/coroutine.h"
 
 namespace co {
 
@@ -7,53 +7,163 @@ AsyncCoroutinePool * AsyncCoroutinePool::Create(size_t maxCallbackPoints)
 {
     return new AsyncCoroutinePool(maxCallbackPoints);
 }
-void AsyncCoroutinePool::InitCoroutinePool(size_t maxCoroutineCount)
+void AsyncCoroutinePool::InitCoroutinePool(size_t maxCoroutineCount, size_t minCoroutineCount)
 {
     maxCoroutineCount_ = maxCoroutineCount;
+    minCoroutineCount_ = minCoroutineCount;
+}
+void AsyncCoroutinePool::SetIdleTimeout(FastSteadyClock::duration idleTimeout)
+{
+    idleTimeout_ = idleTimeout;
 }
 void AsyncCoroutinePool::Start(int minThreadNumber, int maxThreadNumber)
 {
     if (!started_.try_lock()) return ;
-    std::thread([=]{ 
-                scheduler_->Start(minThreadNumber, maxThreadNumber); 
-            }).detach();
+    // Scheduler::Start不阻塞, 返回时P已经创建好, 之后可以立即投递任务
+    scheduler_->Start(minThreadNumber, maxThreadNumber);
     if (maxCoroutineCount_ == 0) {
         maxCoroutineCount_ = (std::max)(minThreadNumber * 128, maxThreadNumber);
         maxCoroutineCount_ = (std::min<size_t>)(maxCoroutineCount_, 10240);
     }
-    for (size_t i = 0; i < maxCoroutineCount_; ++i) {
-        go co_scheduler(scheduler_) [this]{
-            this->Go();
-        };
+    minCoroutineCount_ = (std::min)(minCoroutineCount_, maxCoroutineCount_);
+
+    // 常驻的工作协程, 其余的按需创建
+    for (size_t i = 0; i < minCoroutineCount_; ++i) {
+        ++coroutineCount_;
+        Spawn();
     }
 }
+void AsyncCoroutinePool::Spawn()
+{
+    // 工作协程比创建它的协程活得久, 不能继承所属TaskGroup的取消令牌
+    go co_scheduler(scheduler_) co_detach_cancel [this]{
+        this->Go();
+    };
+}
 void AsyncCoroutinePool::Go()
 {
-    for (;;) {
-        PoolTask task;
-        tasks_ >> task;
+    try {
+        for (;;) {
+            PoolTask task;
+            while (PopTask(task)) {
+                if (task.func_)
+                    task.func_();
+
+                if (task.cb_)
+                    RunCallback(std::move(task.cb_));
+
+                task.func_ = nullptr;
+            }
+
+            // 先登记为空闲再检查任务数, 与Post的先计数再检查空闲数配对, 不会丢失唤醒
+            std::unique_lock<StackWaitList::lock_t> lock(idle_.mutex());
+            idleCount_.fetch_add(1, std::memory_order_seq_cst);
+            if (pendingCount_.load(std::memory_order_seq_cst) > 0) {
+                --idleCount_;
+                continue;
+            }
 
-        if (task.func_)
-            task.func_();
+            // 被唤醒时唤醒者已经扣减了idleCount_
+            if (idle_.park_for(lock, idleTimeout_))
+                continue;
+
+            --idleCount_;
+
+            // 空闲超时, 多于常驻数量时退出
+            size_t count = coroutineCount_.load(std::memory_order_relaxed);
+            bool quit = false;
+            while (count > minCoroutineCount_) {
+                if (coroutineCount_.compare_exchange_weak(count, count - 1,
+                            std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    quit = true;
+                    break;
+                }
+            }
+
+            if (!quit)
+                continue;
+
+            // 退出前有新任务提交, 且提交者看到的协程数还没减少, 由退出者补一个
+            if (pendingCount_.load(std::memory_order_seq_cst) > 0)
+                WakeupOrSpawn();
+            return ;
+        }
+    } catch (task_cancelled const&) {
+        // 被取消退出时也要归还名额, 否则协程数一直停在上限, 不再创建新的工作协程
+        --coroutineCount_;
+        if (pendingCount_.load(std::memory_order_seq_cst) > 0)
+            WakeupOrSpawn();
+    }
+}
+void AsyncCoroutinePool::Post(Func func, Func callback)
+{
+    PoolTask task{std::move(func), std::move(callback)};
 
-        if (!task.cb_)
-            continue;
+    // 先计数再入队, pendingCount_不会小于队列中的实际任务数
+    pendingCount_.fetch_add(1, std::memory_order_seq_cst);
+    LocalQueue & q = SelectQueue();
+    {
+        std::unique_lock<LFLock> lock(q.lock_);
+        q.queue_.push(std::move(task));
+    }
+    WakeupOrSpawn();
+}
+void AsyncCoroutinePool::WakeupOrSpawn()
+{
+    if (idleCount_.load(std::memory_order_seq_cst) > 0) {
+        std::unique_lock<StackWaitList::lock_t> lock(idle_.mutex());
+        if (idle_.wakeOne()) {
+            --idleCount_;
+            return ;
+        }
+    }
 
-        size_t pointsCount = pointsCount_;
-        if (!pointsCount) {
-            task.cb_();
-            continue;
+    size_t count = coroutineCount_.load(std::memory_order_relaxed);
+    while (count < maxCoroutineCount_) {
+        if (coroutineCount_.compare_exchange_weak(count, count + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            Spawn();
+            return ;
         }
+    }
+}
+AsyncCoroutinePool::LocalQueue & AsyncCoroutinePool::SelectQueue()
+{
+    Processor* proc = Processor::GetCurrentProcessor();
+    if (proc && proc->GetScheduler() == scheduler_)
+        return queues_[proc->Id() % queueCount_];
 
-        size_t idx = ++robin_ % pointsCount;
-        points_[idx]->Post(std::move(task.cb_));
-        points_[idx]->Notify();
+    static thread_local size_t threadHash = std::hash<unsigned long>()(NativeThreadID());
+    return queues_[threadHash % queueCount_];
+}
+bool AsyncCoroutinePool::PopTask(PoolTask & task)
+{
+    if (pendingCount_.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    size_t begin = &SelectQueue() - queues_;
+    for (size_t i = 0; i < queueCount_; ++i) {
+        LocalQueue & q = queues_[(begin + i) % queueCount_];
+        std::unique_lock<LFLock> lock(q.lock_);
+        if (q.queue_.pop(task)) {
+            lock.unlock();
+            --pendingCount_;
+            return true;
+        }
     }
+    return false;
 }
-void AsyncCoroutinePool::Post(Func const& func, Func const& callback)
+void AsyncCoroutinePool::RunCallback(Func && cb)
 {
-    PoolTask task{func, callback};
-    tasks_ << std::move(task);
+    size_t pointsCount = pointsCount_;
+    if (!pointsCount) {
+        cb();
+        return ;
+    }
+
+    size_t idx = ++robin_ % pointsCount;
+    points_[idx]->Post(std::move(cb));
+    points_[idx]->Notify();
 }
 bool AsyncCoroutinePool::AddCallbackPoint(AsyncCoroutinePool::CallbackPoint * point)
 {
@@ -71,9 +181,13 @@ bool AsyncCoroutinePool::AddCallbackPoint(AsyncCoroutinePool::CallbackPoint * po
 AsyncCoroutinePool::AsyncCoroutinePool(size_t maxCallbackPoints)
 {
     maxCoroutineCount_ = 0;
+    minCoroutineCount_ = 0;
+    idleTimeout_ = std::chrono::seconds(1);
     maxCallbackPoints_ = maxCallbackPoints;
     scheduler_ = Scheduler::Create();
     points_ = new CallbackPoint*[maxCallbackPoints_];
+    queueCount_ = (std::max)(std::thread::hardware_concurrency(), 1u);
+    queues_ = new LocalQueue[queueCount_];
 }
 
 size_t AsyncCoroutinePool::CallbackPoint::Run(size_t maxTrigger)
@@ -1,13 +1,19 @@
 #pragma once
 #include "common/inc/OsSupport.h"
 #include "common/inc/SpinLock.h"
+#include "common/inc/Clock.h"
 #include "co/sync/channel.h"
+#include "co/sync/segmented_queue.h"
+#include "co/sync/stack_wait_list.h"
 #include "scheduler/Scheduler.h"
 
 namespace co {
 
 // 协程池
 // 可以无缝与异步代码结合, 处理异步框架中的阻塞事件
+//
+// 任务按提交者所在的P分片存放在本地队列中, 工作协程优先处理本P的队列, 空闲时从其他队列偷取.
+// 工作协程按需创建, 最多maxCoroutineCount个; 空闲超过idleTimeout后退出, 最少保留minCoroutineCount个.
 class AsyncCoroutinePool
 {
 public:
@@ -15,13 +21,16 @@ public:
 
     typedef std::function<void()> Func;
 
-    // 初始化协程数量
-    void InitCoroutinePool(size_t maxCoroutineCount);
+    // 初始化协程数量上下限
+    void InitCoroutinePool(size_t maxCoroutineCount, size_t minCoroutineCount = 0);
 
-    // 启动协程池 
+    // 工作协程空闲多久后退出
+    void SetIdleTimeout(FastSteadyClock::duration idleTimeout);
+
+    // 启动协程池
     void Start(int minThreadNumber, int maxThreadNumber = 0);
 
-    void Post(Func const& func, Func const& callback);
+    void Post(Func func, Func callback);
 
     template <typename R>
     void Post(Channel<R> const& ret, std::function<R()> const& func) {
@@ -38,6 +47,15 @@ public:
         Post([=]{ *ctx = func(); }, [=]{ callback(*ctx); });
     }
 
+    // 当前工作协程数量
+    size_t CoroutineCount() const { return coroutineCount_; }
+
+    // 当前空闲(挂起等待任务)的工作协程数量
+    size_t IdleCount() const { return idleCount_; }
+
+    // 已提交还未开始执行的任务数量
+    size_t PendingCount() const { return pendingCount_; }
+
     // 触发点
     struct CallbackPoint
     {
@@ -73,11 +91,36 @@ private:
         Func cb_;
     };
 
+    // 任务队列分片
+    struct alignas(64) LocalQueue {
+        LFLock lock_;
+        SegmentedQueue<PoolTask> queue_;
+    };
+
+    // 提交者对应的分片: 池内协程用所在P的分片, 外部线程按线程ID散列
+    LocalQueue & SelectQueue();
+
+    // 先取本地分片, 再从其他分片偷
+    bool PopTask(PoolTask & task);
+
+    // 没有空闲的工作协程时按需扩容
+    void WakeupOrSpawn();
+
+    void Spawn();
+
+    void RunCallback(Func && cb);
+
 private:
     size_t maxCoroutineCount_;
-    std::atomic<int> coroutineCount_{0};
+    size_t minCoroutineCount_;
+    FastSteadyClock::duration idleTimeout_;
+    std::atomic<size_t> coroutineCount_{0};
+    std::atomic<size_t> idleCount_{0};
+    std::atomic<size_t> pendingCount_{0};
     Scheduler* scheduler_;
-    Channel<PoolTask> tasks_;
+    LocalQueue* queues_ = nullptr;
+    size_t queueCount_ = 0;
+    StackWaitList idle_;
     std::atomic<size_t> pointsCount_{0};
     std::atomic<size_t> writePointsCount_{0};
     size_t maxCallbackPoints_;
@@ -1,12 +1,22 @@
 #pragma once
 #include "common/inc/OsSupport.h"
 #include "common/inc/Clock.h"
+#include "common/inc/SpinLock.h"
 #include "co/sync/channel.h"
+#include "co/sync/co_mutex.h"
+#include "co/sync/stack_wait_list.h"
+#include "scheduler/Scheduler.h"
+#include "co/syntax_helper.h"
+#include <vector>
 
 namespace co {
 
 // 连接池
 // @typename Connection: 连接类型
+//
+// 空闲连接按P分片存放(LIFO), Get优先取本P分片, 取不到时从其他分片偷.
+// 池满时的等待者挂在StackWaitList上, 归还或销毁连接时唤醒.
+// 健康检查和空闲超时淘汰由Scheduler的定时器周期性触发, 在协程中后台执行, 不占用Get的路径.
 template <typename Connection>
 class ConnectionPool
 {
@@ -16,6 +26,20 @@ public:
     typedef std::function<void(Connection*)> Deleter;
     typedef std::function<bool(Connection*)> CheckAlive;
 
+    // 统计数据
+    struct Stats
+    {
+        uint64_t hits;              // 直接取到空闲连接
+        uint64_t misses;            // 新建连接
+        uint64_t waits;             // 池满时等待的次数
+        uint64_t waitTimeouts;      // 等待超时的次数
+        uint64_t waitNanoseconds;   // 累计等待时长
+        uint64_t maxWaitNanoseconds;// 最长的一次等待
+        uint64_t healthChecks;      // 后台健康检查次数
+        uint64_t evictedUnhealthy;  // 健康检查失败被销毁的连接数
+        uint64_t evictedIdle;       // 空闲超时被销毁的连接数
+    };
+
     // @Factory: 创建连接的工厂
     // @Deleter: 销毁连接, 传递NULL时会使用delete删除连接.
     // @maxConnection: 最大连接数, 0表示不限数量
@@ -24,37 +48,40 @@ public:
     explicit ConnectionPool(Factory f, Deleter d = NULL, size_t maxConnection = 0, size_t maxIdleConnection = 0)
         : factory_(f), deleter_(d), count_(0),
         maxConnection_(maxConnection),
-        maxIdleConnection_(maxIdleConnection == 0 ? maxConnection : maxIdleConnection),
-        channel_(maxIdleConnection_)
+        maxIdleConnection_(maxIdleConnection == 0 ? maxConnection : maxIdleConnection)
     {
-        if (maxIdleConnection_ == 0)
-            maxIdleConnection_ = maxConnection_;
-
         if (!deleter_) {
             deleter_ = [](Connection * ptr){ delete ptr; };
         }
+
+        shardCount_ = (std::max)(std::thread::hardware_concurrency(), 1u);
+        shards_ = new Shard[shardCount_];
     }
 
     ~ConnectionPool()
     {
-        Connection* ptr = nullptr;
-        while (channel_.TryPop(ptr)) {
-            Delete(ptr);
+        StopMaintenance();
+
+        for (size_t i = 0; i < shardCount_; ++i) {
+            for (Item & item : shards_[i].idle_)
+                Delete(item.conn_);
         }
+        delete[] shards_;
     }
 
     // 预创建一些连接
     // @nConnection: 连接数量, 大于maxIdleConnection_的部分无效
     void Reserve(size_t nConnection)
     {
-        for (size_t i = Count(); i < maxIdleConnection_; ++i)
+        for (size_t i = Count(); i < nConnection; ++i)
         {
+            if (maxIdleConnection_ && idleCount_ >= maxIdleConnection_)
+                break;
+
+            if (!TryIncrementCount()) break;
             Connection* connection = CreateOne();
             if (!connection) break;
-            if (!channel_.TryPush(connection)) {
-                Delete(connection);
-                break;
-            }
+            Put(connection);
         }
     }
 
@@ -64,37 +91,14 @@ public:
     ConnectionPtr Get(CheckAlive checkAliveOnGet = NULL,
             CheckAlive checkAliveOnPut = NULL)
     {
-        Connection* connection = nullptr;
-retry_get:
-        if (channel_.TryPop(connection)) {
-            if (checkAliveOnGet && !checkAliveOnGet(connection)) {
-                Delete(connection);
-                connection = nullptr;
-                goto retry_get;
-            }
-
-            return Out(connection, checkAliveOnPut);
-        }
-
-        connection = CreateOne();
-        if (connection)
-            return Out(connection, checkAliveOnPut);
-
-        channel_ >> connection;
-        if (checkAliveOnGet && !checkAliveOnGet(connection)) {
-            Delete(connection);
-            connection = nullptr;
-            goto retry_get;
-        }
-
-        return Out(connection, checkAliveOnPut);
+        return GetImpl(nullptr, checkAliveOnGet, checkAliveOnPut);
     }
 
     // 获取一个连接
     // 如果池空了并且连接数达到上限, 则会等待
     // 返回的智能指针销毁时, 会自动将连接归还给池
     //
-    // @timeout: 等待超时时间, 仅在协程中有效, 例: std::chrono::seconds(1)
+    // @timeout: 等待超时时间, 例: std::chrono::seconds(1)
     // @checkAliveOnGet: 申请时检查连接是否还有效
     // @checkAliveOnPut: 归还时检查连接是否还有效
     ConnectionPtr Get(FastSteadyClock::duration timeout,
@@ -102,62 +106,284 @@ retry_get:
             CheckAlive checkAliveOnPut = NULL)
     {
         FastSteadyClock::time_point deadline = FastSteadyClock::now() + timeout;
+        return GetImpl(&deadline, checkAliveOnGet, checkAliveOnPut);
+    }
+
+    // 启动后台维护
+    // @interval: 维护周期
+    // @healthCheck: 空闲超过一个周期的连接做健康检查, 失败的销毁. 传NULL不检查.
+    // @idleTimeout: 空闲超过该时长的连接直接销毁, 0表示不淘汰.
+    // @scheduler: 维护任务运行的调度器, 默认使用g_Scheduler.
+    void StartMaintenance(FastSteadyClock::duration interval,
+            CheckAlive healthCheck = NULL,
+            FastSteadyClock::duration idleTimeout = FastSteadyClock::duration::zero(),
+            Scheduler* scheduler = nullptr)
+    {
+        StopMaintenance();
+
+        std::shared_ptr<Maintainer> m(new Maintainer);
+        m->pool_ = this;
+        m->interval_ = interval;
+        m->healthCheck_ = healthCheck;
+        m->idleTimeout_ = idleTimeout;
+        m->scheduler_ = scheduler ? scheduler : &Scheduler::getInstance();
+        maintainer_ = m;
+        Maintainer::Schedule(m);
+    }
+
+    // 停止后台维护, 正在进行的维护会等待其完成
+    void StopMaintenance()
+    {
+        std::shared_ptr<Maintainer> m;
+        m.swap(maintainer_);
+        if (!m) return ;
+
+        std::unique_lock<CoMutex> lock(m->mtx_);
+        m->pool_ = nullptr;
+        m->timerId_.StopTimer();
+    }
+
+    size_t Count()
+    {
+        return count_;
+    }
+
+    size_t IdleCount()
+    {
+        return idleCount_;
+    }
+
+    Stats GetStats()
+    {
+        Stats s;
+        s.hits = stats_.hits_;
+        s.misses = stats_.misses_;
+        s.waits = stats_.waits_;
+        s.waitTimeouts = stats_.waitTimeouts_;
+        s.waitNanoseconds = stats_.waitNanoseconds_;
+        s.maxWaitNanoseconds = stats_.maxWaitNanoseconds_;
+        s.healthChecks = stats_.healthChecks_;
+        s.evictedUnhealthy = stats_.evictedUnhealthy_;
+        s.evictedIdle = stats_.evictedIdle_;
+        return s;
+    }
+
+private:
+    struct Item
+    {
+        Connection* conn_;
+        FastSteadyClock::time_point lastUsed_;
+    };
+
+    // 空闲连接分片
+    struct alignas(64) Shard
+    {
+        LFLock lock_;
+        std::vector<Item> idle_;
+    };
+
+    struct Counters
+    {
+        std::atomic<uint64_t> hits_{0};
+        std::atomic<uint64_t> misses_{0};
+        std::atomic<uint64_t> waits_{0};
+        std::atomic<uint64_t> waitTimeouts_{0};
+        std::atomic<uint64_t> waitNanoseconds_{0};
+        std::atomic<uint64_t> maxWaitNanoseconds_{0};
+        std::atomic<uint64_t> healthChecks_{0};
+        std::atomic<uint64_t> evictedUnhealthy_{0};
+        std::atomic<uint64_t> evictedIdle_{0};
+    };
+
+    // 后台维护任务的状态, 由定时器回调和维护协程共享.
+    // 连接池析构时置空pool_, 已触发的回调不再访问连接池.
+    struct Maintainer
+    {
+        CoMutex mtx_;
+        ConnectionPool* pool_ = nullptr;
+        FastSteadyClock::duration interval_;
+        FastSteadyClock::duration idleTimeout_;
+        CheckAlive healthCheck_;
+        Scheduler* scheduler_ = nullptr;
+        Scheduler::TimerType::TimerId timerId_;
+
+        static void Schedule(std::shared_ptr<Maintainer> const& m)
+        {
+            m->timerId_ = m->scheduler_->GetTimer().StartTimer(m->interval_, [m]{
+                    // 定时器线程不能阻塞, 健康检查放到协程中做
+                    ::co::__go(__FILE__, __LINE__) - __go_option<opt_scheduler>(m->scheduler_)
+                        - __go_option<opt_detach_cancel>(true) - [m]{
+                        std::unique_lock<CoMutex> lock(m->mtx_);
+                        if (!m->pool_) return ;
+                        m->pool_->Maintain(*m);
+                        Schedule(m);
+                    };
+                });
+        }
+    };
+
+    ConnectionPtr GetImpl(FastSteadyClock::time_point* deadline,
+            CheckAlive const& checkAliveOnGet, CheckAlive const& checkAliveOnPut)
+    {
+        FastSteadyClock::time_point waitStart{};
         Connection* connection = nullptr;
-retry_get:
-        if (channel_.TryPop(connection)) {
-            if (checkAliveOnGet && !checkAliveOnGet(connection)) {
-                Delete(connection);
-                connection = nullptr;
-                goto retry_get;
+        for (;;) {
+            connection = PopIdle();
+            if (connection) {
+                ++stats_.hits_;
+            } else if (TryIncrementCount()) {
+                connection = CreateOne();
+                if (!connection)
+                    return ConnectionPtr();
+                ++stats_.misses_;
             }
 
-            return Out(connection, checkAliveOnPut);
-        }
+            if (!connection) {
+                if (waitStart == FastSteadyClock::time_point{}) {
+                    waitStart = FastSteadyClock::now();
+                    ++stats_.waits_;
+                }
 
-        connection = CreateOne();
-        if (connection)
-            return Out(connection, checkAliveOnPut);
+                if (!Wait(deadline)) {
+                    ++stats_.waitTimeouts_;
+                    RecordWait(waitStart);
+                    return ConnectionPtr();
+                }
+                continue;
+            }
 
-        if (channel_.TimedPop(connection, deadline)) {
             if (checkAliveOnGet && !checkAliveOnGet(connection)) {
                 Delete(connection);
-                connection = nullptr;
-                goto retry_get;
+                continue;
             }
 
+            if (waitStart != FastSteadyClock::time_point{})
+                RecordWait(waitStart);
             return Out(connection, checkAliveOnPut);
         }
+    }
 
-        return ConnectionPtr();
+    // 等待有连接归还或被销毁, 超时返回false
+    bool Wait(FastSteadyClock::time_point* deadline)
+    {
+        std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+
+        // 先登记再检查, 与Put/Delete的先改状态再检查等待者配对, 不会丢失唤醒
+        waiterCount_.fetch_add(1, std::memory_order_seq_cst);
+        bool ready = idleCount_.load(std::memory_order_seq_cst) > 0 ||
+            !maxConnection_ || count_.load(std::memory_order_seq_cst) < maxConnection_;
+        if (ready) {
+            --waiterCount_;
+            return true;
+        }
+
+        bool ret = true;
+        if (!deadline) {
+            waiters_.park(lock);
+        } else {
+            FastSteadyClock::time_point now = FastSteadyClock::now();
+            ret = now < *deadline && waiters_.park_for(lock, *deadline - now);
+        }
+
+        --waiterCount_;
+        return ret;
     }
 
-    size_t Count()
+    void WakeupWaiter()
     {
-        return count_;
+        if (waiterCount_.load(std::memory_order_seq_cst) == 0)
+            return ;
+
+        std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+        waiters_.wakeOne();
     }
 
-private:
-    Connection* CreateOne()
+    void RecordWait(FastSteadyClock::time_point waitStart)
     {
-        if (++count_ > maxConnection_) {
-            --count_;
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                FastSteadyClock::now() - waitStart).count();
+        stats_.waitNanoseconds_ += ns;
+        uint64_t maxNs = stats_.maxWaitNanoseconds_;
+        while (ns > maxNs && !stats_.maxWaitNanoseconds_.compare_exchange_weak(maxNs, ns)) ;
+    }
+
+    // 归还者对应的分片: 协程用所在P的分片, 原生线程按线程ID散列
+    Shard & SelectShard()
+    {
+        Processor* proc = Processor::GetCurrentProcessor();
+        if (proc)
+            return shards_[proc->Id() % shardCount_];
+
+        static thread_local size_t threadHash = std::hash<unsigned long>()(NativeThreadID());
+        return shards_[threadHash % shardCount_];
+    }
+
+    // 先取本地分片, 再从其他分片偷
+    Connection* PopIdle()
+    {
+        if (idleCount_.load(std::memory_order_relaxed) == 0)
             return nullptr;
+
+        size_t begin = &SelectShard() - shards_;
+        for (size_t i = 0; i < shardCount_; ++i) {
+            Shard & shard = shards_[(begin + i) % shardCount_];
+            std::unique_lock<LFLock> lock(shard.lock_);
+            if (shard.idle_.empty())
+                continue;
+
+            Connection* connection = shard.idle_.back().conn_;
+            shard.idle_.pop_back();
+            lock.unlock();
+            --idleCount_;
+            return connection;
+        }
+        return nullptr;
+    }
+
+    // 占用一个连接名额, 达到上限返回false
+    bool TryIncrementCount()
+    {
+        if (++count_ > maxConnection_ && maxConnection_) {
+            --count_;
+            return false;
         }
+        return true;
+    }
 
-        return factory_();
+    // 需要先占用名额, 工厂创建失败时归还名额
+    Connection* CreateOne()
+    {
+        Connection* connection = factory_();
+        if (!connection) {
+            --count_;
+            WakeupWaiter();
+        }
+        return connection;
     }
 
     void Put(Connection* connection)
     {
-        if (!channel_.TryPush(connection)) {
+        if (maxIdleConnection_ && idleCount_.fetch_add(1) >= maxIdleConnection_) {
+            --idleCount_;
             Delete(connection);
+            return ;
+        } else if (!maxIdleConnection_) {
+            ++idleCount_;
+        }
+
+        Shard & shard = SelectShard();
+        {
+            std::unique_lock<LFLock> lock(shard.lock_);
+            shard.idle_.push_back(Item{connection, FastSteadyClock::now()});
         }
+        WakeupWaiter();
     }
 
     void Delete(Connection* connection)
     {
         --count_;
         deleter_(connection);
+        WakeupWaiter();
     }
 
     ConnectionPtr Out(Connection* connection, CheckAlive checkAliveOnPut)
@@ -172,13 +398,73 @@ private:
                 });
     }
 
+    // 后台维护: 逐个分片取出空闲连接, 在锁外做淘汰和健康检查, 存活的放回分片底部
+    void Maintain(Maintainer & m)
+    {
+        FastSteadyClock::time_point now = FastSteadyClock::now();
+        std::vector<Item> items;
+        for (size_t i = 0; i < shardCount_; ++i) {
+            Shard & shard = shards_[i];
+            {
+                std::unique_lock<LFLock> lock(shard.lock_);
+                items.swap(shard.idle_);
+            }
+            if (items.empty())
+                continue;
+
+            idleCount_ -= items.size();
+
+            size_t alive = 0;
+            for (Item & item : items) {
+                FastSteadyClock::duration idle = now - item.lastUsed_;
+                if (m.idleTimeout_ != FastSteadyClock::duration::zero() && idle >= m.idleTimeout_) {
+                    ++stats_.evictedIdle_;
+                    Delete(item.conn_);
+                    continue;
+                }
+
+                if (m.healthCheck_ && idle >= m.interval_) {
+                    ++stats_.healthChecks_;
+                    if (!m.healthCheck_(item.conn_)) {
+                        ++stats_.evictedUnhealthy_;
+                        Delete(item.conn_);
+                        continue;
+                    }
+                }
+
+                items[alive++] = item;
+            }
+            items.resize(alive);
+
+            if (!items.empty()) {
+                std::unique_lock<LFLock> lock(shard.lock_);
+                items.insert(items.end(), shard.idle_.begin(), shard.idle_.end());
+                items.swap(shard.idle_);
+                idleCount_ += alive;
+            }
+            items.clear();
+
+            for (size_t k = 0; k < alive; ++k)
+                WakeupWaiter();
+        }
+    }
+
 private:
     Factory factory_;
     Deleter deleter_;
     std::atomic<size_t> count_;
     size_t maxConnection_;
     size_t maxIdleConnection_;
-    Channel<Connection*> channel_;
+
+    Shard* shards_;
+    size_t shardCount_;
+    std::atomic<size_t> idleCount_{0};
+
+    StackWaitList waiters_;
+    std::atomic<size_t> waiterCount_{0};
+
+    std::shared_ptr<Maintainer> maintainer_;
+    Counters stats_;
 };
 
 } // namespace co
@@ -0,0 +1,108 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include <cstddef>
+#include <vector>
+#include <memory>
+
+namespace co {
+
+// 协程本地存储的槽位下标
+// 每个CLS定义处首次执行时分配一个全局唯一的下标, 下标从0开始连续分配
+typedef std::size_t CLSLocation;
+
+CLSLocation CLSAllocLocation();
+
+// 每个协程(或线程)一份的CLS存储
+// 前kInlineSlots个槽位内嵌在对象中, 其余放在overflow_中, 槽位地址在对象生命期内不变.
+// 值在首次访问时构造, 对象析构时(协程结束回收时)析构.
+class CLSStorage
+{
+public:
+    static const std::size_t kInlineSlots = 4;
+    static const std::size_t kInlineBytes = 16;
+
+    struct Slot
+    {
+        void* ptr = nullptr;
+        void (*destroy)(Slot&) = nullptr;
+        alignas(std::max_align_t) char buf[kInlineBytes];
+
+        template <typename T, typename ... Args>
+        T& Emplace(Args && ... args)
+        {
+            // 放不下的类型不实例化内嵌分支
+            if constexpr (sizeof(T) <= kInlineBytes && alignof(T) <= alignof(std::max_align_t)) {
+                ptr = new (buf) T(std::forward<Args>(args)...);
+                destroy = &DestroyInline<T>;
+            } else {
+                ptr = new T(std::forward<Args>(args)...);
+                destroy = &DestroyHeap<T>;
+            }
+            return *static_cast<T*>(ptr);
+        }
+
+        void Reset()
+        {
+            if (ptr) {
+                destroy(*this);
+                ptr = nullptr;
+                destroy = nullptr;
+            }
+        }
+
+        template <typename T>
+        static void DestroyInline(Slot & slot) { static_cast<T*>(slot.ptr)->~T(); }
+
+        template <typename T>
+        static void DestroyHeap(Slot & slot) { delete static_cast<T*>(slot.ptr); }
+    };
+
+    CLSStorage() = default;
+    CLSStorage(CLSStorage const&) = delete;
+    CLSStorage& operator=(CLSStorage const&) = delete;
+
+    ~CLSStorage()
+    {
+        Clear();
+    }
+
+    ALWAYS_INLINE Slot& Get(CLSLocation loc)
+    {
+        if (LIKELY(loc < kInlineSlots))
+            return inline_[loc];
+        return GetOverflow(loc);
+    }
+
+    // 析构所有已构造的值
+    void Clear()
+    {
+        for (Slot & slot : inline_)
+            slot.Reset();
+        if (overflow_) {
+            for (auto & slot : *overflow_)
+                if (slot) slot->Reset();
+            overflow_.reset();
+        }
+    }
+
+private:
+    Slot& GetOverflow(CLSLocation loc)
+    {
+        std::size_t idx = loc - kInlineSlots;
+        if (!overflow_)
+            overflow_.reset(new std::vector<std::unique_ptr<Slot>>);
+        if (idx >= overflow_->size())
+            overflow_->resize(idx + 1);
+        std::unique_ptr<Slot> & slot = (*overflow_)[idx];
+        if (!slot)
+            slot.reset(new Slot);
+        return *slot;
+    }
+
+    Slot inline_[kInlineSlots];
+
+    // 槽位单独分配, 扩容时内嵌在槽位中的值地址不变; 用到时才创建
+    std::unique_ptr<std::vector<std::unique_ptr<Slot>>> overflow_;
+};
+
+} // namespace co
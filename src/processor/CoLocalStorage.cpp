@@ -3,8 +3,13 @@
 namespace co {
 
 
-CLSMap* GetThreadLocalCLSMap() {
-    static thread_local CLSMap tlm;
+CLSLocation CLSAllocLocation() {
+    static std::atomic<CLSLocation> next{0};
+    return next++;
+}
+
+CLSStorage* GetThreadLocalCLSStorage() {
+    static thread_local CLSStorage tlm;
     return &tlm;
 }
 
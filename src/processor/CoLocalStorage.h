@@ -1,45 +1,28 @@
 #pragma once
 #include "common/inc/OsSupport.h"
-#include "common/inc/any.h"
 #include "processor/Processor.h"
+#include "processor/CLSStorage.h"
 #include "task/Task.h"
-#include <unordered_map>
-#include <typeinfo>
 #include <memory>
 #include <assert.h>
-#include <iostream>
 
 namespace co {
 
-typedef int* CLSLocation;
-
-class CLSMap {
-    std::unordered_map<CLSLocation, any> map_;
-
-public:
-    any& Get(CLSLocation loc) {
-        return map_[loc];
-    }
-};
-
-TaskRefDefine(CLSMap, ClsMap)
-
-extern CLSMap* GetThreadLocalCLSMap();
+extern CLSStorage* GetThreadLocalCLSStorage();
 
+// 同一个CLSLocation只能对应一种类型T
 template <typename T, typename ... Args>
 T& GetSpecific(CLSLocation loc, Args && ... args) {
     Task* tk = Processor::GetCurrentTask();
-    CLSMap *m = tk ? &TaskRefClsMap(tk) : GetThreadLocalCLSMap();
+    CLSStorage *m = tk ? &tk->cls_ : GetThreadLocalCLSStorage();
 
-    any& val = m->Get(loc);
-    if (val.empty()) {
-//        std::cout << "Set<T> val:" << (void*)&val << ", m:" << (void*)m << std::endl;
-//        std::cout << "sizeof:" << sizeof...(args) << std::endl;
-          
-          return val.emplace<T>(std::forward<Args>(args)...);
-    }
+    CLSStorage::Slot& slot = m->Get(loc);
+    if (UNLIKELY(!slot.ptr))
+        return slot.Emplace<T>(std::forward<Args>(args)...);
 
-    return any_cast<T&>(val);
+    assert(slot.destroy == &CLSStorage::Slot::DestroyInline<T> ||
+            slot.destroy == &CLSStorage::Slot::DestroyHeap<T>);
+    return *static_cast<T*>(slot.ptr);
 }
 
 template <typename T>
@@ -48,7 +31,9 @@ class CLSRef {
 public:
     template <typename ... Args>
     CLSRef(CLSLocation loc, Args && ... args) : loc_(loc) {
-        (void)GetSpecific<T>(loc_, std::forward<Args>(args)...);
+        // 无构造参数时推迟到首次访问再构造, 省掉一次查找
+        if (sizeof...(Args))
+            (void)GetSpecific<T>(loc_, std::forward<Args>(args)...);
     }
 
     operator T const&() const {
@@ -65,7 +50,7 @@ CLSRef<T> MakeCLSRef(CLSLocation loc, Args && ... args) {
     return CLSRef<T>(loc, std::forward<Args>(args)...);
 }
 
-#define GetCLSLocation() []{ static int dummy = 0; return &dummy; }()
+#define GetCLSLocation() []{ static const ::co::CLSLocation loc = ::co::CLSAllocLocation(); return loc; }()
 
 #define CLS(type, ...) \
     co::MakeCLSRef<type>(GetCLSLocation(), ##__VA_ARGS__)
@@ -5,14 +5,55 @@
 #if defined(LIBGO_SYS_Windows)
 # include "fiber/context.h"
 #else
+# include <string.h>
 namespace co {
 
+class Context;
+
+// 共享栈
+// 同一个P上的一组协程轮流在这块栈上执行, 同一时刻只有owner_的栈内容在栈上,
+// 其他协程已用的部分拷贝在各自的堆缓冲区中, 切入时再拷回原地址.
+struct SharedStack
+{
+    char* stack_ = nullptr;
+    uint32_t size_ = 0;
+    int protectPage_ = 0;
+
+    // 仅由所属P的线程修改, 导出调用栈时会在其他线程读
+    std::atomic<Context*> owner_{nullptr};
+
+    explicit SharedStack(std::size_t size) : size_(size)
+    {
+        stack_ = (char*)StackTraits::MallocFunc()(size_);
+        DebugPrint(dbg_task, "valloc shared stack. size=%u ptr=%p", size_, stack_);
+
+        int protectPage = StackTraits::GetProtectStackPageSize();
+        if (protectPage && StackTraits::ProtectStack(stack_, size_, protectPage))
+            protectPage_ = protectPage;
+    }
+
+    ~SharedStack()
+    {
+        DebugPrint(dbg_task, "free shared stack. ptr=%p", stack_);
+        if (protectPage_)
+            StackTraits::UnprotectStack(stack_, protectPage_);
+        StackTraits::FreeFunc()(stack_);
+    }
+
+    SharedStack(SharedStack const&) = delete;
+    SharedStack& operator=(SharedStack const&) = delete;
+};
+
 class Context
 {
 public:
+    // @stackSize: 为0时运行在共享栈上, 首次切入前由P绑定一个共享栈(BindSharedStack)
     Context(fn_t fn, intptr_t vp, std::size_t stackSize)
-        : fn_(fn), vp_(vp), stackSize_(stackSize)
+        : vp_(vp), fn_(fn), stackSize_(stackSize)
     {
+        if (!stackSize_)
+            return ;
+
         stack_ = (char*)StackTraits::MallocFunc()(stackSize_);
         DebugPrint(dbg_task, "valloc stack. size=%u ptr=%p",
                 stackSize_, stack_);
@@ -25,6 +66,11 @@ public:
     }
     ~Context()
     {
+        if (sharedStack_) {
+            ReleaseSharedStack();
+            return ;
+        }
+
         if (stack_) {
             DebugPrint(dbg_task, "free stack. ptr=%p", stack_);
             if (protectPage_)
@@ -36,6 +82,9 @@ public:
 
     ALWAYS_INLINE void SwapIn()
     {
+        if (UNLIKELY(sharedStack_ != nullptr) &&
+                sharedStack_->owner_.load(std::memory_order_relaxed) != this)
+            SwitchSharedStack();
         jump_fcontext(&GetTlsContext(), ctx_, vp_);
     }
 
@@ -55,13 +104,92 @@ public:
         return tls_context;
     }
 
+    // 栈的地址范围[StackLow, StackHigh)
+    ALWAYS_INLINE char* StackLow() const { return stack_; }
+    ALWAYS_INLINE char* StackHigh() const { return stack_ + stackSize_; }
+
+    // 切出时保存的上下文(栈顶指针), 仅在协程切出后有效
+    ALWAYS_INLINE fcontext_t SavedContext() const { return ctx_; }
+
+    // ---- 共享栈 ----
+    // 是否运行在共享栈上(含尚未绑定的)
+    ALWAYS_INLINE bool UsesSharedStack() const { return !stack_ || sharedStack_; }
+
+    // 尚未绑定共享栈
+    ALWAYS_INLINE bool NeedSharedStack() const { return !stack_; }
+
+    // 已绑定共享栈: 栈内容只能在这个共享栈的地址上恢复, 协程不能再迁移到其他P
+    ALWAYS_INLINE bool SharedStackBound() const { return sharedStack_ != nullptr; }
+
+    ALWAYS_INLINE void BindSharedStack(SharedStack* ss)
+    {
+        sharedStack_ = ss;
+        stack_ = ss->stack_;
+        stackSize_ = ss->size_;
+    }
+
+    // 栈内容当前是否在栈上(独立栈始终在), 不在时无法从栈上回溯调用栈
+    ALWAYS_INLINE bool StackResident() const
+    {
+        return !sharedStack_ || sharedStack_->owner_.load(std::memory_order_relaxed) == this;
+    }
+
+    // 已拷出的栈内容大小
+    ALWAYS_INLINE std::size_t SavedStackSize() const { return savedSize_; }
+
+    // 协程执行完毕后释放占用的共享栈和拷贝缓冲区, 由所属P的线程调用
+    void ReleaseSharedStack()
+    {
+        Context* self = this;
+        sharedStack_->owner_.compare_exchange_strong(self, nullptr, std::memory_order_relaxed);
+        free(saved_);
+        saved_ = nullptr;
+        savedSize_ = savedCap_ = 0;
+    }
+
 private:
-    fcontext_t ctx_;
-    fn_t fn_;
+    // 把占用者的栈内容拷出, 再把自己的拷回共享栈(首次切入时在共享栈上创建上下文).
+    // 在调度循环的线程栈上执行.
+    void SwitchSharedStack()
+    {
+        Context* owner = sharedStack_->owner_.load(std::memory_order_relaxed);
+        if (owner)
+            owner->SaveStack();
+
+        if (!ctx_)
+            ctx_ = make_fcontext(StackHigh(), stackSize_, fn_);
+        else if (savedSize_)
+            memcpy(StackHigh() - savedSize_, saved_, savedSize_);
+        sharedStack_->owner_.store(this, std::memory_order_relaxed);
+    }
+
+    void SaveStack()
+    {
+        // 切出时上下文压在栈顶, 从它到栈底即为已用的部分
+        uint32_t size = (uint32_t)(StackHigh() - (char*)ctx_);
+        if (size > savedCap_ || size < savedCap_ / 4) {
+            // 按实际用量分配, 用量大幅下降时缩小
+            free(saved_);
+            saved_ = (char*)malloc(size);
+            savedCap_ = size;
+        }
+        memcpy(saved_, (char*)ctx_, size);
+        savedSize_ = size;
+    }
+
+    // ctx_, vp_每次切换都要访问, 放在前面
+    fcontext_t ctx_ = nullptr;
     intptr_t vp_;
+    fn_t fn_;
     char* stack_ = nullptr;
     uint32_t stackSize_ = 0;
     int protectPage_ = 0;
+
+    // 共享栈, 以及切出后栈内容的拷贝
+    SharedStack* sharedStack_ = nullptr;
+    char* saved_ = nullptr;
+    uint32_t savedSize_ = 0;
+    uint32_t savedCap_ = 0;
 };
 } // namespace co
 
@@ -4,6 +4,14 @@
 #include "common/inc/Clock.h"
 #include <assert.h>
 #include "task/TaskRef.h"
+#include "netio/NetPoller.h"
+#include "netio/IoUring.h"
+#include "debug/SwitchTrace.h"
+#include "debug/Profiler.h"
+#include <string.h>
+#if defined(OS_Unix)
+#include <signal.h>
+#endif
 // #include "StreamApi.h"
 
 namespace co {
@@ -18,10 +26,18 @@ Processor::Processor(Scheduler * scheduler, int id, core::IQueue* up_queue, core
     , up_queue_(up_queue)
     , down_queue_(down_queue)
 {
-    up_queue_size_ = up_queue_->queue_size_bytes_;
-    down_queue_size_ = down_queue_->queue_size_bytes_;
+    // 环形队列的容量按包数计算, 不是字节数
+    up_queue_size_ = up_queue_->queue_size_pkts_;
+    down_queue_size_ = down_queue_->queue_size_pkts_;
 
     waitQueue_.setLock(&runnableQueue_.LockRef());
+    pinnedQueue_.setLock(&runnableQueue_.LockRef());
+
+    poller_ = new NetPoller;
+    if (!poller_->IsValid()) {
+        delete poller_;
+        poller_ = nullptr;
+    }
 }
 
 Processor* & Processor::GetCurrentProcessor()
@@ -40,39 +56,76 @@ Scheduler* Processor::GetCurrentScheduler()
 void Processor::AddTask(Task *tk)
 {
     DebugPrint(dbg_task | dbg_scheduler, "task(%s) add into proc(%u)(%p)", tk->DebugInfo(), id_, (void*)this);
+    AddTasks(&tk, 1);
+}
+
+void Processor::AddTasks(Task* const* tasks, std::size_t n)
+{
     task_packet_t pkt;
     memset(&pkt, 0, sizeof(pkt));
 
     // out of order and no scope fence
     pkt.header = (PACKET_TYPE_TASK << PACKET_HEADER_TYPE);
-    pkt.task = (void*)tk;
-    const uint32_t up_queue_mask = up_queue_size_ - 1;
-    uint64_t index = up_queue_->LoadWriteIndexRelaxed();
 
-    up_queue_size_ = up_queue_->queue_size_bytes_;
-    ((task_packet_t*)(up_queue_->queue_address_))[index & up_queue_mask] = pkt;
-    up_queue_->StoreWriteIndexRelaxed(index + 1);
-
-#if 0
+    // 本P和调度线程/原生线程都可能往这里投递, 用newQueue_的锁串行化生产者
     std::unique_lock<TaskQueue::lock_t> lock(newQueue_.LockRef());
-    newQueue_.pushWithoutLock(tk);
+    if (UNLIKELY(retired_.load(std::memory_order_relaxed))) {
+        // 已退休, 转交调度器另选P
+        lock.unlock();
+        for (std::size_t i = 0; i < n; ++i)
+            scheduler_->AddTask(tasks[i]);
+        return ;
+    }
+    uint64_t index = up_queue_->LoadWriteIndexRelaxed();
+    uint64_t used = index - up_queue_->LoadReadIndexRelaxed();
+    std::size_t room = used < up_queue_size_ ? up_queue_size_ - used : 0;
+    std::size_t k = (std::min)(n, room);
+    const uint32_t up_queue_mask = up_queue_size_ - 1;
+    for (std::size_t i = 0; i < k; ++i) {
+        pkt.task = (void*)tasks[i];
+        ((AqlPacket*)(up_queue_->queue_address_))[(index + i) & up_queue_mask].task = pkt;
+    }
+    if (k) {
+        std::atomic_thread_fence(std::memory_order_release);
+        up_queue_->StoreWriteIndexRelaxed(index + k);
+    }
+
+    for (std::size_t i = k; i < n; ++i) {
+        Task* tk = tasks[i];
+        if (tk->pinned_) {
+            // newQueue_中的协程会被偷走, 固定的协程直接放入pinnedQueue_
+            // 加锁顺序为先newQueue_后runnableQueue_, 持有runnableQueue_的锁时不会再去锁newQueue_
+            pinnedQueue_.push(tk);
+        } else {
+            // 队列满了, 放到newQueue_里, 由AddNewTasks一起取走
+            newQueue_.pushWithoutLock(tk);
+        }
+    }
     newQueue_.AssertLink();
-#endif
+    MetricsAdd(metrics_.tasksAdded, n);
+
     if (waiting_)
-        cv_.notify_all();
+        WakeupCondition();
     else
         notified_ = true;
 }
 
-
 void Processor::AddTask(SList<Task> && slist)
 {
     DebugPrint(dbg_scheduler, "task(num=%d) add into proc(%u)", (int)slist.size(), id_);
+    MetricsAdd(metrics_.stolenIn, slist.size());
+    if (SwitchTraceEnabled())
+        SwitchTraceRecord(ste_receive, id_, 0, MetricsNowNs(), slist.size());
     std::unique_lock<TaskQueue::lock_t> lock(newQueue_.LockRef());
+    if (UNLIKELY(retired_.load(std::memory_order_relaxed))) {
+        lock.unlock();
+        scheduler_->PickProcessor()->AddTask(std::move(slist));
+        return ;
+    }
     newQueue_.pushWithoutLock(std::move(slist));
     newQueue_.AssertLink();
     if (waiting_)
-        cv_.notify_all();
+        WakeupCondition();
     else
         notified_ = true;
 }
@@ -83,7 +136,7 @@ void Processor::NotifyCondition()
     std::unique_lock<TaskQueue::lock_t> lock(newQueue_.LockRef());
     if (waiting_) {
         DebugPrint(dbg_scheduler, "NotifyCondition for condition. [Proc(%d)] --------------------------", id_);
-        cv_.notify_all();
+        WakeupCondition();
     }
     else {
         DebugPrint(dbg_scheduler, "NotifyCondition for flag. [Proc(%d)] --------------------------", id_);
@@ -94,6 +147,11 @@ void Processor::NotifyCondition()
 void Processor::Process()
 {
     GetCurrentProcessor() = this;
+    ProfilerRegisterThread(id_);
+#if defined(OS_Unix)
+    thread_ = pthread_self();
+    threadStarted_.store(true, std::memory_order_release);
+#endif
 
     // pipe_ = new Pipe(this, id_);
     // pipe_->ConnectDownQueue(id_);
@@ -104,11 +162,27 @@ void Processor::Process()
 
     while (!scheduler_->IsStop())
     {
-        runnableQueue_.front(runningTask_);
+        // 调度线程请求退休: 确认没有任何协程后退出线程
+        if (UNLIKELY(retireRequested_.load(std::memory_order_acquire)) && TryRetire())
+            break;
+
+        // 两批调度之间零超时轮询一次, 就绪的协程加入本轮
+        if (poller_ && poller_->HasWaiters())
+            poller_->Poll(0);
+
+        // 上一轮积攒的io_uring请求一次提交, 顺便收割已完成的
+        if (uring_ && uring_->HasPending())
+            uring_->Flush();
+
+        // 无栈协程在调度循环里直接恢复, 不切换上下文
+        if (resumableHead_)
+            RunResumables();
+
+        runningTask_ = FrontRunnable();
 
         if (!runningTask_) {
             if (AddNewTasks())
-                runnableQueue_.front(runningTask_);
+                runningTask_ = FrontRunnable();
 
             if (!runningTask_) {
                 WaitCondition();
@@ -122,41 +196,31 @@ void Processor::Process()
 #endif
 
         addNewQuota_ = 1;
+        swapInNs_ = 0;
         while (runningTask_ && !scheduler_->IsStop()) {
-            runningTask_->state_ = TaskState::runnable;
-            runningTask_->proc_ = this;
-
-#if ENABLE_DEBUGGER
-            DebugPrint(dbg_switch, "enter task(%s)", runningTask_->DebugInfo());
-            if (Listener::GetTaskListener())
-                Listener::GetTaskListener()->onSwapIn(runningTask_->id_);
-#endif
-
-            ++switchCount_;
-
+            BeforeSwapIn(runningTask_);
             runningTask_->SwapIn();
 
-#if ENABLE_DEBUGGER
-            DebugPrint(dbg_switch, "leave task(%s) state=%d", runningTask_->DebugInfo(), (int)runningTask_->state_);
-#endif
+            // 期间可能发生过直接切换, runningTask_是最后切出的协程
+            AfterSwapOut(runningTask_);
 
             switch (runningTask_->state_) {
                 case TaskState::runnable:
                     {
                         std::unique_lock<TaskQueue::lock_t> lock(runnableQueue_.LockRef());
-                        auto next = (Task*)runningTask_->next;
+                        auto next = NextRunnableWithoutLock(runningTask_);
                         if (next) {
                             runningTask_ = next;
-                            runningTask_->check_ = runnableQueue_.check_;
                             break;
                         }
 
-                        if (addNewQuota_ < 1 || newQueue_.emptyUnsafe()) {
+                        if (addNewQuota_ < 1 || !HasNewTasks()) {
                             runningTask_ = nullptr;
                         } else {
                             lock.unlock();
                             if (AddNewTasks()) {
-                                runnableQueue_.next(runningTask_, runningTask_);
+                                std::unique_lock<TaskQueue::lock_t> lock2(runnableQueue_.LockRef());
+                                runningTask_ = NextRunnableWithoutLock(runningTask_);
                                 -- addNewQuota_;
                             } else {
                                 std::unique_lock<TaskQueue::lock_t> lock2(runnableQueue_.LockRef());
@@ -178,16 +242,24 @@ void Processor::Process()
                 case TaskState::done:
                 default:
                     {
-                        runnableQueue_.next(runningTask_, nextTask_);
+                        {
+                            std::unique_lock<TaskQueue::lock_t> lock(runnableQueue_.LockRef());
+                            nextTask_ = NextRunnableWithoutLock(runningTask_);
+                        }
                         if (!nextTask_ && addNewQuota_ > 0) {
                             if (AddNewTasks()) {
-                                runnableQueue_.next(runningTask_, nextTask_);
+                                std::unique_lock<TaskQueue::lock_t> lock(runnableQueue_.LockRef());
+                                nextTask_ = NextRunnableWithoutLock(runningTask_);
                                 -- addNewQuota_;
                             }
                         }
 
                         DebugPrint(dbg_task, "task(%s) done.", runningTask_->DebugInfo());
-                        runnableQueue_.erase(runningTask_);
+#if !defined(LIBGO_SYS_Windows)
+                        if (runningTask_->ctx_.SharedStackBound())
+                            runningTask_->ctx_.ReleaseSharedStack();
+#endif
+                        RunQueueOf(runningTask_).erase(runningTask_);
                         if (gcQueue_.size() > 16)
                             GC();
                         gcQueue_.push(runningTask_);
@@ -204,6 +276,199 @@ void Processor::Process()
             }
         }
     }
+
+    if (IsRetired())
+        OnRetired();
+}
+
+bool Processor::IsIdle()
+{
+    return waiting_ && !resumableHead_ && !HasNewTasks() && runnableQueue_.emptyUnsafe()
+        && pinnedQueue_.emptyUnsafe() && waitQueue_.emptyUnsafe();
+}
+
+void Processor::RequestRetire()
+{
+    // 先停止接受新协程, 再叫醒P线程确认
+    active_ = false;
+    retireRequested_.store(true, std::memory_order_release);
+    NotifyCondition();
+}
+
+bool Processor::TryRetire()
+{
+    GC();
+    std::unique_lock<TaskQueue::lock_t> lock(newQueue_.LockRef());
+    retireRequested_.store(false, std::memory_order_relaxed);
+
+    // 投递都在newQueue_的锁内进行, 持锁确认为空后置位retired_, 之后的投递都会转交其他P.
+    // 本P上没有正在执行的协程, 不会再有协程挂起到waitQueue_中.
+    bool idle = !resumableHead_ && !HasNewTasks()
+        && !(poller_ && poller_->HasWaiters()) && !(uring_ && uring_->HasPending());
+    if (idle) {
+        // 加锁顺序为先newQueue_后runnableQueue_
+        std::unique_lock<TaskQueue::lock_t> lock2(runnableQueue_.LockRef());
+        idle = runnableQueue_.emptyUnsafe() && pinnedQueue_.emptyUnsafe() && waitQueue_.emptyUnsafe();
+    }
+
+    if (!idle) {
+        // 期间又有了协程, 取消退休
+        DebugPrint(dbg_scheduler, "Proc(%d) retire canceled", id_);
+        active_ = true;
+        return false;
+    }
+
+    MetricsInc(metrics_.retires);
+    retired_.store(true, std::memory_order_release);
+    return true;
+}
+
+void Processor::OnRetired()
+{
+#if !defined(LIBGO_SYS_Windows)
+    // 没有协程绑定在共享栈上了
+    sharedStacks_.clear();
+    sharedStackNext_ = 0;
+#endif
+    delete uring_;
+    uring_ = nullptr;
+    uringFailed_ = false;
+#if defined(OS_Unix)
+    threadStarted_.store(false, std::memory_order_release);
+#endif
+    ProfilerUnregisterThread();
+    GetCurrentProcessor() = nullptr;
+    DebugPrint(dbg_scheduler, "Proc(%d) retired", id_);
+}
+
+void Processor::Revive()
+{
+    markSwitch_ = 0;
+    markTick_ = 0;
+    idleSinceUs_ = 0;
+    retireRequested_.store(false, std::memory_order_relaxed);
+    active_ = true;
+    retired_.store(false, std::memory_order_release);
+}
+
+void Processor::BeforeSwapIn(Task* tk)
+{
+    tk->state_ = TaskState::runnable;
+    tk->proc_ = this;
+
+#if !defined(LIBGO_SYS_Windows)
+    if (UNLIKELY(tk->ctx_.NeedSharedStack()))
+        tk->ctx_.BindSharedStack(AllocSharedStack());
+#endif
+
+#if ENABLE_DEBUGGER
+    DebugPrint(dbg_switch, "enter task(%s)", tk->DebugInfo());
+    if (Listener::GetTaskListener())
+        Listener::GetTaskListener()->onSwapIn(tk->id_);
+#endif
+
+    ++switchCount_;
+    MetricsInc(metrics_.switches);
+
+    // 调度延迟: 进入可执行状态到真正被执行
+    bool metrics = CoroutineOptions::getInstance().enable_metrics;
+    if (!metrics && !SwitchTraceEnabled())
+        swapInNs_ = 0;
+    else if (!swapInNs_)
+        swapInNs_ = MetricsNowNs();
+
+    if (metrics) {
+        if (tk->readyNs_) {
+            uint64_t delay = (std::max<int64_t>)(swapInNs_ - tk->readyNs_, 0);
+            if (tk->started_)
+                metrics_.wakeupToRun.Record(delay);
+            else
+                metrics_.createToRun.Record(delay);
+            tk->readyNs_ = 0;
+        }
+    }
+    tk->started_ = true;
+}
+
+void Processor::AfterSwapOut(Task* tk)
+{
+    // 切出的时间戳直接作为下一个协程的切入时间, 每次切换只读一次时钟
+    if (swapInNs_) {
+        int64_t swapOutNs = MetricsNowNs();
+        int64_t slice = (std::max<int64_t>)(swapOutNs - swapInNs_, 0);
+        if (CoroutineOptions::getInstance().enable_metrics)
+            metrics_.runSlice.Record(slice);
+        if (SwitchTraceEnabled())
+            SwitchTraceRecord(ste_run, id_, tk->id_, swapInNs_, slice, (uint8_t)tk->state_);
+        swapInNs_ = swapOutNs;
+    }
+
+#if ENABLE_DEBUGGER
+    DebugPrint(dbg_switch, "leave task(%s) state=%d", tk->DebugInfo(), (int)tk->state_);
+#endif
+}
+
+bool Processor::HasNewTasks()
+{
+    if (!newQueue_.emptyUnsafe())
+        return true;
+    return up_queue_->LoadWriteIndexRelaxed() != up_queue_->LoadReadIndexRelaxed();
+}
+
+bool Processor::CanSkipSchedule()
+{
+    if (HasNewTasks())
+        return false;
+    if (resumableHead_)
+        return false;
+    if (poller_ && poller_->HasWaiters())
+        return false;
+    if (uring_ && uring_->HasPending())
+        return false;
+    return true;
+}
+
+Task* Processor::PrepareSwitchToNext(Task* tk)
+{
+    assert(tk == runningTask_);
+    if (scheduler_->IsStop()) return nullptr;
+
+    // 与Process()中切出后选下一个协程的逻辑一致.
+    // 到了队尾时, 若调度循环没有事情要做(新协程, 轮询), 直接回到队首继续, 否则回到调度循环.
+    // 先不加锁看一眼, 需要回到调度循环时省掉一次加锁(与TSQueue::pop的做法相同)
+    bool runnable = tk->state_ == TaskState::runnable;
+    bool tail = runnable ? !tk->next && (!tk->pinned_ || runnableQueue_.emptyUnsafe()) : !nextTask_;
+    if (tail && !CanSkipSchedule())
+        return nullptr;
+
+    Task* next = nullptr;
+    {
+        std::unique_lock<TaskQueue::lock_t> lock(runnableQueue_.LockRef());
+        // 挂起时SuspendBySelf已选好下一个
+        next = runnable ? NextRunnableWithoutLock(tk) : nextTask_;
+
+        if (!next && tail)
+            next = FrontRunnableWithoutLock();
+
+        if (!next || next == tk)
+            return nullptr;
+
+#if !defined(LIBGO_SYS_Windows)
+        // 共享栈上的协程要在线程栈上拷贝栈内容, 交给调度循环切入
+        if (next->ctx_.UsesSharedStack())
+            return nullptr;
+#endif
+
+        if (!runnable)
+            nextTask_ = nullptr;
+        next->check_ = RunQueueOf(next).check_;
+        switchingTask_.store(tk, std::memory_order_relaxed);
+        runningTask_ = next;
+    }
+
+    AfterSwapOut(tk);
+    BeforeSwapIn(next);
+    return next;
 }
 
 Task* Processor::GetCurrentTask()
@@ -218,10 +483,71 @@ bool Processor::IsCoroutine()
 }
 
 std::size_t Processor::RunnableSize()
+{
+    return StealableSize() + pinnedQueue_.size();
+}
+
+std::size_t Processor::StealableSize()
 {
     return runnableQueue_.size() + newQueue_.size();
 }
 
+Task* Processor::FrontRunnable()
+{
+    std::unique_lock<TaskQueue::lock_t> lock(runnableQueue_.LockRef());
+    return FrontRunnableWithoutLock();
+}
+
+Task* Processor::FrontRunnableWithoutLock()
+{
+    Task* tk = (Task*)pinnedQueue_.head_->next;
+    if (!tk)
+        tk = (Task*)runnableQueue_.head_->next;
+    if (tk)
+        tk->check_ = RunQueueOf(tk).check_;
+    return tk;
+}
+
+Task* Processor::NextRunnableWithoutLock(Task* tk)
+{
+    Task* next = (Task*)tk->next;
+    if (!next && tk->pinned_)
+        next = (Task*)runnableQueue_.head_->next;
+    if (next)
+        next->check_ = RunQueueOf(next).check_;
+    return next;
+}
+
+ProcessorMetricsSnapshot Processor::GetMetrics()
+{
+    ProcessorMetricsSnapshot snap;
+    snap.id = id_;
+    snap.waiting = waiting_;
+    snap.retired = IsRetired();
+    snap.runnable = RunnableSize() +
+        (up_queue_->LoadWriteIndexRelaxed() - up_queue_->LoadReadIndexRelaxed());
+    snap.pinned = pinnedQueue_.size();
+    snap.blocked = waitQueue_.size();
+
+    auto load = [](std::atomic<uint64_t> const& c) { return c.load(std::memory_order_relaxed); };
+    snap.switches = load(metrics_.switches);
+    snap.suspends = load(metrics_.suspends);
+    snap.parks = load(metrics_.parks);
+    snap.parkNs = load(metrics_.parkNs);
+    snap.tasksAdded = load(metrics_.tasksAdded);
+    snap.stolenIn = load(metrics_.stolenIn);
+    snap.stolenOut = load(metrics_.stolenOut);
+    snap.wakeups = load(metrics_.wakeups);
+    snap.unparks = load(metrics_.unparks);
+    snap.preempts = load(metrics_.preempts);
+    snap.preemptRequests = load(metrics_.preemptRequests);
+    snap.retires = load(metrics_.retires);
+    snap.createToRun = HistogramSnapshot(metrics_.createToRun);
+    snap.wakeupToRun = HistogramSnapshot(metrics_.wakeupToRun);
+    snap.runSlice = HistogramSnapshot(metrics_.runSlice);
+    return snap;
+}
+
 // run in processing
 void Processor::WaitCondition()
 {
@@ -235,8 +561,52 @@ void Processor::WaitCondition()
 
     waiting_ = true;
     DebugPrint(dbg_scheduler, "WaitCondition. [Proc(%d)] --------------------------", id_);
-    cv_.wait(lock);
+    int64_t parkNs = MetricsNowNs();
+    if (poller_) {
+        // 置位waiting_之后的唤醒都会写eventfd, 解锁后再进入epoll_wait不会丢失
+        lock.unlock();
+        poller_->Poll(ParkTimeoutMs());
+        lock.lock();
+    } else {
+        cv_.wait(lock);
+    }
     waiting_ = false;
+    MetricsInc(metrics_.parks);
+    MetricsInc(metrics_.parkNs, (std::max<int64_t>)(MetricsNowNs() - parkNs, 0));
+}
+
+IoUring* Processor::GetUring()
+{
+    if (uring_ || uringFailed_ || !poller_)
+        return uring_;
+
+    // 完成事件写本P的eventfd, 阻塞在epoll_wait上时也能被唤醒
+    uring_ = new IoUring(poller_->NotifyFd());
+    if (!uring_->IsValid()) {
+        delete uring_;
+        uring_ = nullptr;
+        uringFailed_ = true;
+    }
+    return uring_;
+}
+
+void Processor::WakeupCondition()
+{
+    MetricsAdd(metrics_.unparks);
+    if (poller_)
+        poller_->Notify();
+    else
+        cv_.notify_all();
+}
+
+int Processor::ParkTimeoutMs()
+{
+    // 定时器在独立线程触发, 这里只是兜底: 不晚于下一个定时器醒来一次.
+    // 至少等1ms, 避免定时器线程还没处理完时空转.
+    static const int kMaxParkMs = 1000;
+    auto next = scheduler_->GetTimer().NextTrigger(std::chrono::milliseconds(kMaxParkMs));
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(next - FastSteadyClock::now()).count();
+    return (int)(std::min<long long>)((std::max<long long>)(ms, 1), kMaxParkMs);
 }
 
 void Processor::GC()
@@ -255,6 +625,7 @@ bool Processor::AddNewTasks()
 
     uint64_t write_index = up_queue_->LoadWriteIndexRelaxed();
     uint64_t read_index = up_queue_->LoadReadIndexRelaxed();
+    std::atomic_thread_fence(std::memory_order_acquire);
     size_t index = read_index;
     while(index != write_index) {
         AqlPacket& pkt = buffer[index % up_queue_size_];
@@ -264,8 +635,8 @@ bool Processor::AddNewTasks()
             printf("ERROR: receive invalid packet int cp");
             break;
         } else if (packet_type == PACKET_TYPE_TASK) {
-            printf("INFO: receive task packet");
-            runnableQueue_.push(reinterpret_cast<Task*>(pkt.task.task));
+            Task* tk = reinterpret_cast<Task*>(pkt.task.task);
+            RunQueueOf(tk).push(tk);
         }
         index++;
         auto header=pkt.dispatch.header;
@@ -277,10 +648,9 @@ bool Processor::AddNewTasks()
         up_queue_->StoreReadIndexRelaxed(index);
     }
 
-#if 0
+    // 调度线程steal后通过AddTask(SList)转移过来的协程
     runnableQueue_.push(newQueue_.pop_all());
     newQueue_.AssertLink();
-#endif
     return true;
 }
 
@@ -290,6 +660,77 @@ bool Processor::IsBlocking()
     return NowMicrosecond() > markTick_ + CoroutineOptions::getInstance().cycle_timeout_us;
 }
 
+void Processor::CheckPreempt()
+{
+    uint32_t slice = CoroutineOptions::getInstance().preempt_slice_us;
+    if (!slice) return;
+
+    uint64_t switchCount = markSwitch_;
+    if (!switchCount || switchCount != switchCount_) return;
+    if (preemptSwitch_.load(std::memory_order_relaxed) == switchCount) return;
+    if (NowMicrosecond() < markTick_ + slice) return;
+
+    // 没有其他协程在等(含还在投递队列中的新协程), 让出也还是它
+    std::size_t pending = RunnableSize() +
+        (up_queue_->LoadWriteIndexRelaxed() - up_queue_->LoadReadIndexRelaxed());
+    if (pending <= 1) return;
+
+#if defined(OS_Unix)
+    if (!threadStarted_.load(std::memory_order_acquire) || !InstallPreemptHandler())
+        return ;
+
+    preemptSwitch_.store(switchCount, std::memory_order_relaxed);
+    MetricsAdd(metrics_.preemptRequests);
+    DebugPrint(dbg_scheduler, "Proc(%d) preempt request. switch=%lu",
+            id_, (unsigned long)switchCount);
+    pthread_kill(thread_, SIGURG);
+#endif
+}
+
+void Processor::Preempt()
+{
+    PreemptFlag() = 0;
+
+    // 信号可能在协程切换之后才到达, 只抢占调度线程看到的那次调度
+    Processor* proc = GetCurrentProcessor();
+    if (!proc || !proc->runningTask_ ||
+            proc->switchCount_ != proc->preemptSwitch_.load(std::memory_order_relaxed))
+        return ;
+
+    MetricsAdd(proc->metrics_.preempts);
+    proc->CoYield();
+}
+
+#if defined(OS_Unix)
+void Processor::PreemptSignalHandler(int)
+{
+    // 只置标志, 由协程在安全点(co_preempt_check)自行让出
+    PreemptFlag() = 1;
+}
+
+bool Processor::InstallPreemptHandler()
+{
+    // SIGURG默认被忽略, 业务已经安装了自己的处理函数时不抢占
+    static bool installed = []{
+        struct sigaction old;
+        if (sigaction(SIGURG, nullptr, &old) != 0)
+            return false;
+        if ((old.sa_flags & SA_SIGINFO) || (old.sa_handler != SIG_DFL && old.sa_handler != SIG_IGN)) {
+            DebugPrint(dbg_scheduler, "SIGURG handler already installed, preemption disabled");
+            return false;
+        }
+
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = &Processor::PreemptSignalHandler;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        return sigaction(SIGURG, &sa, nullptr) == 0;
+    }();
+    return installed;
+}
+#endif
+
 void Processor::Mark()
 {
     if (runningTask_ && markSwitch_ != switchCount_) {
@@ -314,19 +755,28 @@ SList<Task> Processor::Steal(std::size_t n)
             return slist;
 
         std::unique_lock<TaskQueue::lock_t> lock(runnableQueue_.LockRef());
-        bool pushRunningTask = false, pushNextTask = false;
+        bool pushRunningTask = false, pushNextTask = false, pushSwitchingTask = false;
+        Task* switchingTask = switchingTask_.load(std::memory_order_acquire);
         if (runningTask_)
             pushRunningTask = runnableQueue_.eraseWithoutLock(runningTask_, true) || slist.erase(runningTask_, newQueue_.check_);
         if (nextTask_)
             pushNextTask = runnableQueue_.eraseWithoutLock(nextTask_, true) || slist.erase(nextTask_, newQueue_.check_);
+        if (switchingTask)
+            pushSwitchingTask = runnableQueue_.eraseWithoutLock(switchingTask, true) || slist.erase(switchingTask, newQueue_.check_);
         auto slist2 = runnableQueue_.pop_backWithoutLock(n - slist.size());
         if (pushRunningTask)
             runnableQueue_.pushWithoutLock(runningTask_);
         if (pushNextTask)
             runnableQueue_.pushWithoutLock(nextTask_);
+        if (pushSwitchingTask)
+            runnableQueue_.pushWithoutLock(switchingTask);
+        KeepSharedStackTasks(slist2);
         lock.unlock();
 
         slist2.append(std::move(slist));
+        MetricsAdd(metrics_.stolenOut, slist2.size());
+        if (SwitchTraceEnabled() && !slist2.empty())
+            SwitchTraceRecord(ste_steal, id_, 0, MetricsNowNs(), slist2.size());
         if (!slist2.empty())
             DebugPrint(dbg_scheduler, "Proc(%d).Stealed = %d", id_, (int)slist2.size());
         return slist2;
@@ -337,47 +787,143 @@ SList<Task> Processor::Steal(std::size_t n)
         newQueue_.AssertLink();
 
         std::unique_lock<TaskQueue::lock_t> lock(runnableQueue_.LockRef());
-        bool pushRunningTask = false, pushNextTask = false;
+        bool pushRunningTask = false, pushNextTask = false, pushSwitchingTask = false;
+        Task* switchingTask = switchingTask_.load(std::memory_order_acquire);
         if (runningTask_)
             pushRunningTask = runnableQueue_.eraseWithoutLock(runningTask_, true) || slist.erase(runningTask_, newQueue_.check_);
         if (nextTask_)
             pushNextTask = runnableQueue_.eraseWithoutLock(nextTask_, true) || slist.erase(nextTask_, newQueue_.check_);
+        if (switchingTask)
+            pushSwitchingTask = runnableQueue_.eraseWithoutLock(switchingTask, true) || slist.erase(switchingTask, newQueue_.check_);
         auto slist2 = runnableQueue_.pop_allWithoutLock();
         if (pushRunningTask)
             runnableQueue_.pushWithoutLock(runningTask_);
         if (pushNextTask)
             runnableQueue_.pushWithoutLock(nextTask_);
+        if (pushSwitchingTask)
+            runnableQueue_.pushWithoutLock(switchingTask);
+        KeepSharedStackTasks(slist2);
         lock.unlock();
 
         slist2.append(std::move(slist));
+        MetricsAdd(metrics_.stolenOut, slist2.size());
+        if (SwitchTraceEnabled() && !slist2.empty())
+            SwitchTraceRecord(ste_steal, id_, 0, MetricsNowNs(), slist2.size());
         if (!slist2.empty())
             DebugPrint(dbg_scheduler, "Proc(%d).Stealed all = %d", id_, (int)slist2.size());
         return slist2;
     }
 }
 
+void Processor::KeepSharedStackTasks(SList<Task> & slist)
+{
+#if !defined(LIBGO_SYS_Windows)
+    for (auto it = slist.begin(); it != slist.end(); ) {
+        Task* tk = &*it;
+        ++it;
+        if (!tk->ctx_.SharedStackBound())
+            continue;
+
+        // 引用计数从slist转移到runnableQueue_
+        IncrementRef(tk);
+        slist.erase(tk);
+        runnableQueue_.pushWithoutLock(tk, false);
+    }
+#endif
+}
+
+#if !defined(LIBGO_SYS_Windows)
+SharedStack* Processor::AllocSharedStack()
+{
+    std::size_t count = (std::max)(CoroutineOptions::getInstance().shared_stack_count, 1);
+    std::size_t index = sharedStackNext_++ % count;
+    if (index >= sharedStacks_.size()) {
+        sharedStacks_.emplace_back(new SharedStack(CoroutineOptions::getInstance().shared_stack_size));
+        index = sharedStacks_.size() - 1;
+    }
+    return sharedStacks_[index].get();
+}
+#endif
+
+void Processor::ForEachSuspendedTask(std::function<void(Task*)> const& fn)
+{
+    std::unique_lock<TaskQueue::lock_t> lock(waitQueue_.LockRef());
+    for (TSQueueHook* pos = waitQueue_.head_->next; pos; pos = pos->next) {
+        // 刚挂起的协程在Process切换runningTask_之前还没有切出, 直接切换中的协程同理
+        Task* tk = (Task*)pos;
+        if (tk != runningTask_ && tk != switchingTask_.load(std::memory_order_acquire))
+            fn(tk);
+    }
+}
+
 Processor::SuspendEntry Processor::Suspend()
 {
     Task* tk = GetCurrentTask();
     assert(tk);
     assert(tk->proc_);
-    return tk->proc_->SuspendBySelf(tk);
+    SuspendEntry entry = tk->proc_->SuspendBySelf(tk);
+    if (UNLIKELY(tk->cancellable_))
+        tk->cancel_->Watch(tk, entry.id_);
+    return entry;
+}
+
+// 带超时的挂起总是可以被取消唤醒: 调用方本来就要处理未被通知就超时醒来的情况
+Processor::SuspendEntry Processor::SuspendWithTimer()
+{
+    Task* tk = GetCurrentTask();
+    assert(tk);
+    assert(tk->proc_);
+    SuspendEntry entry = tk->proc_->SuspendBySelf(tk);
+    if (UNLIKELY(!!tk->cancel_))
+        tk->cancel_->Watch(tk, entry.id_);
+    return entry;
+}
+
+Processor::CancellableScope::CancellableScope()
+{
+    Task* tk = GetCurrentTask();
+    if (!tk || !tk->cancel_)
+        return ;
+
+    tk_ = tk;
+    prev_ = tk->cancellable_;
+    tk->cancellable_ = true;
+}
+
+Processor::CancellableScope::~CancellableScope()
+{
+    if (tk_)
+        tk_->cancellable_ = prev_;
+}
+
+void Processor::TraceTimerWakeup(SuspendEntry const& entry)
+{
+    if (!SwitchTraceEnabled())
+        return ;
+
+    IncursivePtr<Task> tkPtr = entry.tk_.lock();
+    if (!tkPtr || entry.id_ != TaskRefSuspendId(tkPtr.get())) return ;
+
+    Processor* proc = tkPtr->proc_;
+    SwitchTraceRecord(ste_timer, proc ? proc->id_ : 0, tkPtr->id_, MetricsNowNs());
 }
 
 Processor::SuspendEntry Processor::Suspend(FastSteadyClock::duration dur)
 {
-    SuspendEntry entry = Suspend();
+    SuspendEntry entry = SuspendWithTimer();
     GetCurrentScheduler()->GetTimer().StartTimer(dur,
             [entry]() mutable {
+                TraceTimerWakeup(entry);
                 Processor::Wakeup(entry);
             });
     return entry;
 }
 Processor::SuspendEntry Processor::Suspend(FastSteadyClock::time_point timepoint)
 {
-    SuspendEntry entry = Suspend();
+    SuspendEntry entry = SuspendWithTimer();
     GetCurrentScheduler()->GetTimer().StartTimer(timepoint,
             [entry]() mutable {
+                TraceTimerWakeup(entry);
                 Processor::Wakeup(entry);
             });
     return entry;
@@ -392,11 +938,14 @@ Processor::SuspendEntry Processor::SuspendBySelf(Task* tk)
     uint64_t id = ++ TaskRefSuspendId(tk);
 
     std::unique_lock<TaskQueue::lock_t> lock(runnableQueue_.LockRef());
-    runnableQueue_.nextWithoutLock(runningTask_, nextTask_);
-    runnableQueue_.eraseWithoutLock(runningTask_, false, false);
+    nextTask_ = NextRunnableWithoutLock(runningTask_);
+    RunQueueOf(runningTask_).eraseWithoutLock(runningTask_, false, false);
 
     DebugPrint(dbg_suspend, "tk(%s) Suspend. nextTask(%s)", tk->DebugInfo(), nextTask_->DebugInfo());
     waitQueue_.pushWithoutLock(runningTask_, false);
+    MetricsInc(metrics_.suspends);
+    if (SwitchTraceEnabled())
+        SwitchTraceRecord(ste_suspend, id_, tk->id_, MetricsNowNs());
     return SuspendEntry{ WeakPtr<Task>(tk), id };
 }
 
@@ -408,6 +957,60 @@ bool Processor::IsExpire(SuspendEntry const& entry)
     return false;
 }
 
+void Processor::AddResumable(Resumable* r)
+{
+    std::unique_lock<TaskQueue::lock_t> lock(newQueue_.LockRef());
+    if (UNLIKELY(retired_.load(std::memory_order_relaxed))) {
+        lock.unlock();
+        scheduler_->AddResumable(r);
+        return ;
+    }
+    r->next_ = nullptr;
+    if (resumableTail_)
+        resumableTail_->next_ = r;
+    else
+        resumableHead_ = r;
+    resumableTail_ = r;
+    if (waiting_)
+        WakeupCondition();
+    else
+        notified_ = true;
+}
+
+void Processor::PostResumable(Resumable* r)
+{
+    Processor* proc = r->proc_;
+    if (proc && proc->active_) {
+        proc->AddResumable(r);
+        return ;
+    }
+
+    Scheduler* scheduler = proc ? proc->scheduler_ : GetCurrentScheduler();
+    if (!scheduler) scheduler = &Scheduler::getInstance();
+    scheduler->AddResumable(r);
+}
+
+void Processor::RunResumables()
+{
+    Resumable* r;
+    {
+        std::unique_lock<TaskQueue::lock_t> lock(newQueue_.LockRef());
+        r = resumableHead_;
+        resumableHead_ = resumableTail_ = nullptr;
+    }
+
+    // 恢复后节点可能已随协程帧释放, 或已被其他线程重新加入队列, 先取出next_
+    while (r) {
+        Resumable* next = r->next_;
+        r->next_ = nullptr;
+        r->proc_ = this;
+        ++switchCount_;
+        MetricsInc(metrics_.switches);
+        r->resume_(r);
+        r = next;
+    }
+}
+
 bool Processor::Wakeup(SuspendEntry const& entry, std::function<void()> const& functor)
 {
     IncursivePtr<Task> tkPtr = entry.tk_.lock();
@@ -431,7 +1034,12 @@ bool Processor::WakeupBySelf(IncursivePtr<Task> const& tkPtr, uint64_t id, std::
     bool ret = waitQueue_.eraseWithoutLock(tk, false, false);
     (void)ret;
     assert(ret);
-    size_t sizeAfterPush = runnableQueue_.pushWithoutLock(tk, false);
+    MetricsAdd(metrics_.wakeups);
+    if (CoroutineOptions::getInstance().enable_metrics)
+        tk->readyNs_ = MetricsNowNs();
+    if (SwitchTraceEnabled())
+        SwitchTraceRecord(ste_wakeup, id_, tk->id_, MetricsNowNs());
+    size_t sizeAfterPush = RunQueueOf(tk).pushWithoutLock(tk, false);
     DebugPrint(dbg_suspend, "tk(%s) Wakeup. tk->state_ = %s. is-in-proc(%d). sizeAfterPush=%lu",
             tk->DebugInfo(), GetTaskStateName(tk->state_), GetCurrentProcessor() == this, sizeAfterPush);
     if (sizeAfterPush == 1 && GetCurrentProcessor() != this) {
@@ -2,7 +2,9 @@
 #include "common/inc/OsSupport.h"
 #include "common/inc/Clock.h"
 #include "task/Task.h"
+#include "task/Resumable.h"
 #include "common/inc/TsQueue.h"
+#include "debug/Metrics.h"
 // #include "Stream.h"
 
 #if ENABLE_DEBUGGER
@@ -11,6 +13,13 @@
 #include <condition_variable>
 #include <mutex>
 #include <atomic>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <csignal>
+#if defined(OS_Unix)
+#include <pthread.h>
+#endif
 
 namespace core {
 class IQueue;
@@ -19,6 +28,8 @@ class IQueue;
 namespace co {
 
 class Scheduler;
+class NetPoller;
+class IoUring;
 
 // 协程执行器
 // 对应一个线程, 负责本线程的协程调度, 非线程安全.
@@ -36,10 +47,30 @@ private:
     // 非激活的P仅仅是不能接受新的协程加入, 仍然可以强行AddTask并正常处理.
     volatile bool active_ = true;
 
+    // 退休: 调度线程请求后, 由P线程在调度循环中确认没有任何协程, 然后退出线程.
+    // retired_在newQueue_的锁内置位, 之后投递给本P的协程/无栈协程都转交调度器另选P.
+    // P对象不释放, 其他线程持有的指针始终有效; 再次扩展时复用.
+    std::atomic<bool> retireRequested_{false};
+    std::atomic<bool> retired_{false};
+
+    // P线程, 退休后由调度线程join
+    std::thread osThread_;
+
+    // 空闲计时(调度线程专用): 从idleSinceUs_起一直空闲, 期间调度次数停在idleSwitch_
+    uint64_t idleSwitch_ = 0;
+    int64_t idleSinceUs_ = 0;
+
     // 当前正在运行的协程
     Task* runningTask_{nullptr};
     Task* nextTask_{nullptr};
 
+    // 直接切换时, 已让出runningTask_但上下文还没保存完的协程, 不能被steal走
+    // 由切入的协程清空
+    std::atomic<Task*> switchingTask_{nullptr};
+
+    // 当前协程切入的时间戳(ns), 0表示不需要统计
+    int64_t swapInNs_ = 0;
+
     // 每轮调度只加有限次数新协程, 防止新协程创建新协程产生死循环
     int addNewQuota_ = 0;
 
@@ -50,25 +81,59 @@ private:
     // 协程调度次数
     volatile uint64_t switchCount_ = 0;
 
+    // 已请求抢占的那次调度(switchCount_的值), 由调度线程写
+    std::atomic<uint64_t> preemptSwitch_{0};
+
+#if defined(OS_Unix)
+    // P线程, 用于发送抢占信号
+    pthread_t thread_;
+    std::atomic<bool> threadStarted_{false};
+#endif
+
     // 协程队列
     typedef TSQueue<Task, true> TaskQueue;
     TaskQueue runnableQueue_;
     TaskQueue waitQueue_;
+
+    // 固定在本P上的可执行协程, 与runnableQueue_共用一把锁
+    // 单独存放, 偷协程时不用在runnableQueue_中逐个跳过; 每轮调度先执行这里的协程
+    TaskQueue pinnedQueue_;
     TSQueue<Task, false> gcQueue_;
 
     TaskQueue newQueue_;
 
+    // 待恢复的无栈协程, 与newQueue_共用一把锁, 每轮调度开始时全部恢复一次
+    Resumable* resumableHead_ = nullptr;
+    Resumable* resumableTail_ = nullptr;
+
     // queue_t
     core::IQueue* up_queue_;          // receive from scheduler
     core::IQueue* down_queue_;        // send to scheduler
     size_t up_queue_size_ {4096};
     size_t down_queue_size_ {4096};
 
+    // 网络轮询器, 无可执行协程时阻塞在其上等待fd就绪或被唤醒
+    // 创建失败时退化为使用条件变量等待
+    NetPoller* poller_ = nullptr;
+
+    // io_uring, 首次使用时在本P的线程上创建, 创建失败后不再尝试
+    IoUring* uring_ = nullptr;
+    bool uringFailed_ = false;
+
     // 等待的条件变量
     std::condition_variable_any cv_;
     std::atomic_bool waiting_{false};
     bool notified_ = false;
 
+    // 运行指标
+    ProcessorMetrics metrics_;
+
+#if !defined(LIBGO_SYS_Windows)
+    // 共享栈, 用到时才创建, 新绑定的协程轮流分配
+    std::vector<std::unique_ptr<SharedStack>> sharedStacks_;
+    std::size_t sharedStackNext_ = 0;
+#endif
+
     static int s_check_;
 
 public:
@@ -80,15 +145,41 @@ public:
 
     inline Scheduler* GetScheduler() { return scheduler_; }
 
+    inline NetPoller* GetPoller() { return poller_; }
+
+    // 本P的io_uring, 不支持时返回nullptr. 仅由本P的线程调用.
+    IoUring* GetUring();
+
     // 获取当前正在执行的协程
     static Task* GetCurrentTask();
 
     // 是否在协程中
     static bool IsCoroutine();
 
+    // 当前协程是否运行在共享栈上(挂起后栈内容会被拷走)
+    ALWAYS_INLINE static bool IsSharedStackTask();
+
+    // 协程调度次数, 可在其他线程读取
+    // 配合IsRunningSince判断某一时刻正在执行的协程是否仍未被切出, 用于自适应自旋
+    ALWAYS_INLINE uint64_t SwitchCount() const { return switchCount_; }
+
+    ALWAYS_INLINE bool IsRunningSince(uint64_t switchCount) const
+    {
+        return switchCount_ == switchCount && !waiting_;
+    }
+
+    // 运行指标快照, 可在其他线程调用
+    ProcessorMetricsSnapshot GetMetrics();
+
     // 协程切出
     ALWAYS_INLINE static void StaticCoYield();
 
+    // 协程被切入后调用, 结束直接切换
+    ALWAYS_INLINE static void FinishSwitch();
+
+    // 抢占检查点: 调度线程请求抢占当前协程时让出, 否则只有一次线程局部变量的读
+    ALWAYS_INLINE static void PreemptCheck();
+
     // 挂起标识
     struct SuspendEntry {
         WeakPtr<Task> tk_;
@@ -121,6 +212,40 @@ public:
     // 唤醒协程
     static bool Wakeup(SuspendEntry const& entry, std::function<void()> const& functor = NULL);
 
+    // 让挂起的无栈协程重新可执行: 回到上次执行它的P, 该P不再活跃(或从未执行过)时由调度器选择
+    static void PostResumable(Resumable* r);
+
+    // 加入本P的无栈协程队列, 可在任意线程调用
+    void AddResumable(Resumable* r);
+
+    // 当前协程是否已被取消(所属的TaskGroup被取消), 不在协程中时返回false
+    ALWAYS_INLINE static bool IsCancelled();
+
+    // 取消点: 当前协程已被取消时抛出co::task_cancelled
+    ALWAYS_INLINE static void CancellationPoint();
+
+    // 可取消区间: 区间内不带超时的挂起也会被取消提前唤醒(带超时的挂起总是可以), 表现与超时相同.
+    // 只用于能处理"未被通知就醒来"的等待.
+    class CancellableScope
+    {
+    public:
+        CancellableScope();
+        ~CancellableScope();
+
+        // 当前协程是否已被取消
+        ALWAYS_INLINE bool Cancelled() const { return tk_ && tk_->cancel_->cancelled(); }
+
+        // 已被取消时抛出task_cancelled, 在等待之前和等待失败(超时)之后调用
+        ALWAYS_INLINE void Check() const { if (UNLIKELY(Cancelled())) throw task_cancelled(); }
+
+    private:
+        CancellableScope(CancellableScope const&) = delete;
+        CancellableScope& operator=(CancellableScope const&) = delete;
+
+        Task* tk_ = nullptr;
+        bool prev_ = false;
+    };
+
     // 测试一个SuspendEntry是否还可能有效
     static bool IsExpire(SuspendEntry const& entry);
 
@@ -133,11 +258,44 @@ private:
     // 暂兼用于负载指数
     std::size_t RunnableSize();
 
+    // 可以被偷走的待执行协程数量
+    std::size_t StealableSize();
+
+    // 是否已退休(线程已退出或正在退出)
+    ALWAYS_INLINE bool IsRetired() const { return retired_.load(std::memory_order_acquire); }
+
+    // 没有任何协程(待执行/挂起/待加入/无栈协程), 且在等待中. 不加锁, 仅供调度线程判断空闲
+    bool IsIdle();
+
+    // 请求退休, 由调度线程调用
+    void RequestRetire();
+
+    // 复用已退休的P, 由调度线程在启动新线程前调用
+    void Revive();
+
     ALWAYS_INLINE void CoYield();
 
+    // 协程切出时选出本P上可以直接切入的下一个协程, 并完成切换前的记录
+    // 没有合适的协程时返回nullptr, 由调度循环处理
+    // 跳转本身在内联的CoYield中进行, 切回来时不多一层函数返回
+    Task* PrepareSwitchToNext(Task* tk);
+
+    // 是否有待加入的新协程(up_queue_或newQueue_中), 不加锁
+    bool HasNewTasks();
+
+    // 调度循环在两批调度之间是否无事可做(没有待加入的新协程, 没有需要轮询的io)
+    bool CanSkipSchedule();
+
+    // 协程切入前/切出后的记录(调度计数, 调度延迟, 执行时长, 调度跟踪)
+    void BeforeSwapIn(Task* tk);
+    void AfterSwapOut(Task* tk);
+
     // 新创建、阻塞后触发的协程add进来
     void AddTask(Task *tk);
 
+    // 批量加入新创建的协程, 一次加锁投递, 最多唤醒一次
+    void AddTasks(Task* const* tasks, std::size_t n);
+
     // 调度
     void Process();
 
@@ -154,17 +312,52 @@ private:
     // 阻塞状态不再加入新的协程, 并由调度线程steal走所有协程(正在执行的除外)
     bool IsBlocking();
 
-    // 偷协程
+    // 当前协程执行超过抢占时间片时向P线程发送抢占信号(调度线程调用, 需先Mark)
+    void CheckPreempt();
+
+    // 偷协程, pinnedQueue_中的协程不会被偷走
     SList<Task> Steal(std::size_t n);
+
+    // 已绑定共享栈的协程不能迁移, 从偷出的列表中放回runnableQueue_, 需持有runnableQueue_的锁
+    void KeepSharedStackTasks(SList<Task> & slist);
+
+    // 遍历已挂起(已切出)的协程, fn在持锁期间调用, 期间协程不会被唤醒
+    void ForEachSuspendedTask(std::function<void(Task*)> const& fn);
     /// --------------------------------------
 
 private:
     void WaitCondition();
 
+    // 唤醒处于等待状态的P, 需持有newQueue_的锁
+    void WakeupCondition();
+
+    // 阻塞等待的超时时间: 到下一个定时器触发为止
+    int ParkTimeoutMs();
+
     void GC();
 
     bool AddNewTasks();
 
+    // 恢复队列中的无栈协程, 期间新加入的留到下一轮
+    void RunResumables();
+
+    // 确认没有任何协程后置为退休, 否则取消退休请求. 在P线程的调度循环中调用
+    bool TryRetire();
+
+    // 退休后释放线程相关的资源(共享栈, io_uring, 采样缓冲区)
+    void OnRetired();
+
+    // 协程所在的可执行队列
+    ALWAYS_INLINE TaskQueue& RunQueueOf(Task* tk)
+    {
+        return tk->pinned_ ? pinnedQueue_ : runnableQueue_;
+    }
+
+    // 本轮调度的第一个/下一个协程: 先pinnedQueue_, 再runnableQueue_. WithoutLock版本需持有runnableQueue_的锁
+    Task* FrontRunnable();
+    Task* FrontRunnableWithoutLock();
+    Task* NextRunnableWithoutLock(Task* tk);
+
     // 调度线程打标记, 用于检测阻塞
     void Mark();
 
@@ -172,9 +365,79 @@ private:
 
     SuspendEntry SuspendBySelf(Task* tk);
 
+    // 带超时挂起的前半部分, 之后由调用方启动定时器
+    static SuspendEntry SuspendWithTimer();
+
     bool WakeupBySelf(IncursivePtr<Task> const& tkPtr, uint64_t id, std::function<void()> const& functor);
+
+    // 定时器到期唤醒协程, 记录调度跟踪事件
+    static void TraceTimerWakeup(SuspendEntry const& entry);
+
+#if !defined(LIBGO_SYS_Windows)
+    SharedStack* AllocSharedStack();
+#endif
+
+    // 抢占请求标志, 由抢占信号在P线程上置位
+    ALWAYS_INLINE static volatile sig_atomic_t & PreemptFlag()
+    {
+        static thread_local volatile sig_atomic_t flag = 0;
+        return flag;
+    }
+
+    static void Preempt();
+
+#if defined(OS_Unix)
+    static void PreemptSignalHandler(int);
+    static bool InstallPreemptHandler();
+#endif
+};
+
+// 挂起期间会被唤醒方读写的等待者数据(等待节点, 接收结果的变量等)
+// 通常直接放在等待者的栈上; 共享栈协程挂起后栈内容会被拷走, 此时改为放在堆上.
+template <typename T>
+class SuspendLocal
+{
+public:
+    template <typename ... Args>
+    explicit SuspendLocal(Args && ... args)
+    {
+        if (UNLIKELY(Processor::IsSharedStackTask())) {
+            heap_.reset(new T(std::forward<Args>(args)...));
+            ptr_ = heap_.get();
+        } else {
+            ptr_ = new (&local_) T(std::forward<Args>(args)...);
+        }
+    }
+
+    ~SuspendLocal()
+    {
+        if (!heap_)
+            ptr_->~T();
+    }
+
+    ALWAYS_INLINE T* get() const { return ptr_; }
+    ALWAYS_INLINE T& operator*() const { return *ptr_; }
+    ALWAYS_INLINE T* operator->() const { return ptr_; }
+
+private:
+    SuspendLocal(SuspendLocal const&) = delete;
+    SuspendLocal& operator=(SuspendLocal const&) = delete;
+
+    T* ptr_;
+    std::unique_ptr<T> heap_;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type local_;
 };
 
+ALWAYS_INLINE bool Processor::IsSharedStackTask()
+{
+#if !defined(LIBGO_SYS_Windows)
+    Task* tk = GetCurrentTask();
+    return tk && tk->ctx_.UsesSharedStack();
+#else
+    return false;
+#endif
+}
+
 ALWAYS_INLINE void Processor::StaticCoYield()
 {
     auto proc = GetCurrentProcessor();
@@ -194,7 +457,45 @@ ALWAYS_INLINE void Processor::CoYield()
         Listener::GetTaskListener()->onSwapOut(tk->id_);
 #endif
 
+#if !defined(LIBGO_SYS_Windows)
+    if (tk->state_ != TaskState::done && CoroutineOptions::getInstance().enable_direct_switch) {
+        Task* next = PrepareSwitchToNext(tk);
+        if (next) {
+            tk->SwapTo(next);
+            FinishSwitch();
+            return ;
+        }
+    }
+#endif
+
     tk->SwapOut();
+    FinishSwitch();
+}
+
+ALWAYS_INLINE void Processor::PreemptCheck()
+{
+    if (UNLIKELY(PreemptFlag()))
+        Preempt();
+}
+
+ALWAYS_INLINE bool Processor::IsCancelled()
+{
+    Task* tk = GetCurrentTask();
+    return tk && tk->cancel_ && tk->cancel_->cancelled();
+}
+
+ALWAYS_INLINE void Processor::CancellationPoint()
+{
+    if (UNLIKELY(IsCancelled()))
+        throw task_cancelled();
+}
+
+ALWAYS_INLINE void Processor::FinishSwitch()
+{
+    // 切回来时可能已被steal到其他P上
+    auto proc = GetCurrentProcessor();
+    if (proc && proc->switchingTask_.load(std::memory_order_relaxed))
+        proc->switchingTask_.store(nullptr, std::memory_order_release);
 }
 
 
@@ -11,6 +11,7 @@
 #include "core/IRuntime.h"
 #include "Stream.h"
 #include <thread>
+#include <new>
 
 using namespace core;
 namespace co
@@ -76,15 +77,70 @@ Scheduler::~Scheduler()
     Stop();
 }
 
-void Scheduler::CreateTask(TaskF const& fn, TaskOpt const& opt)
+// CreateTasks的一段协程的Task对象(连同尾部的anys_存储)在一块内存中连续分配,
+// 段内的Task全部析构后整块释放. 段内有长期运行的协程时整块内存都不会释放.
+struct TaskSlab
 {
-    Task* tk = new Task(fn, opt.stack_size_ ? opt.stack_size_ : CoroutineOptions::getInstance().stack_size);
+    Scheduler* scheduler_;
+    std::atomic<std::size_t> refs_;
+    std::size_t stride_;
+
+    static std::size_t AlignUp(std::size_t size)
+    {
+        return (size + alignof(Task) - 1) / alignof(Task) * alignof(Task);
+    }
+
+    static TaskSlab* Create(Scheduler* scheduler, std::size_t n)
+    {
+        std::size_t stride = AlignUp(sizeof(Task) + TaskAnys::StorageSize());
+        void* mem = ::operator new(AlignUp(sizeof(TaskSlab)) + stride * n);
+        return new (mem) TaskSlab{scheduler, {n}, stride};
+    }
+
+    void* At(std::size_t index)
+    {
+        return reinterpret_cast<char*>(this) + AlignUp(sizeof(TaskSlab)) + stride_ * index;
+    }
+
+    void Release()
+    {
+        if (--refs_ == 0)
+            ::operator delete(this);
+    }
+};
+
+Task* Scheduler::NewTask(TaskF const& fn, TaskOpt const& opt, uint64_t id,
+        TaskSlab* slab, std::size_t index)
+{
+    std::size_t stackSize = opt.stack_size_ ? opt.stack_size_ : CoroutineOptions::getInstance().stack_size;
+#if !defined(LIBGO_SYS_Windows)
+    if (opt.shared_stack_)
+        stackSize = 0;
+#endif
+    Task* tk;
+    if (slab) {
+        tk = ::new (slab->At(index)) Task(fn, stackSize);
+        tk->SetDeleter(Deleter(&Scheduler::DeleteSlabTask, slab));
+    } else {
+        tk = new Task(fn, stackSize);
+        tk->SetDeleter(Deleter(&Scheduler::DeleteTask, this));
+    }
 //    printf("new tk = %p  impl = %p\n", tk, tk->impl_);
-    tk->SetDeleter(Deleter(&Scheduler::DeleteTask, this));
-    tk->id_ = ++GetTaskIdFactory();
-    TaskRefAffinity(tk) = opt.affinity_;
+    tk->id_ = id;
+    tk->pinned_ = opt.affinity_ || opt.processor_ >= 0;
+
+    CancelToken* token = opt.cancel_;
+    if (!token && !opt.detach_cancel_) {
+        Task* creator = Processor::GetCurrentTask();
+        token = creator ? creator->cancel_.get() : nullptr;
+    }
+    if (token) {
+        tk->cancel_ = IncursivePtr<CancelToken>(token);
+        token->AddTask(tk);
+    }
     TaskRefLocation(tk).Init(opt.file_, opt.lineno_);
-    ++taskCount_;
+    if (CoroutineOptions::getInstance().enable_metrics)
+        tk->readyNs_ = MetricsNowNs();
 
     DebugPrint(dbg_task, "task(%s) created in scheduler(%p).", TaskDebugInfo(tk), (void*)this);
 #if ENABLE_DEBUGGER
@@ -92,8 +148,88 @@ void Scheduler::CreateTask(TaskF const& fn, TaskOpt const& opt)
         Listener::GetTaskListener()->onCreated(tk->id_);
     }
 #endif
+    return tk;
+}
 
-    AddTask(tk);
+void Scheduler::CreateTask(TaskF const& fn, TaskOpt const& opt)
+{
+    Task* tk = NewTask(fn, opt, ++GetTaskIdFactory());
+    ++taskCount_;
+    AddTask(tk, opt.processor_);
+}
+
+// CreateTasks的协程共用一份fn, 最后一个执行完的协程负责释放
+struct BulkTaskFn
+{
+    std::function<void(std::size_t)> fn_;
+    std::atomic<std::size_t> refs_;
+
+    BulkTaskFn(std::function<void(std::size_t)> const& fn, std::size_t n) : fn_(fn), refs_(n) {}
+};
+
+// 第i个协程的入口, 只有两个字段, 可以放进std::function的内部存储, 不用为每个协程单独分配
+struct BulkTaskCall
+{
+    BulkTaskFn* bulk_;
+    std::size_t index_;
+
+    void operator()() const
+    {
+        struct Release {
+            BulkTaskFn* bulk_;
+            ~Release() { if (--bulk_->refs_ == 0) delete bulk_; }
+        } release{bulk_};
+        bulk_->fn_(index_);
+    }
+};
+
+void Scheduler::CreateTasks(std::size_t n, std::function<void(std::size_t)> const& fn, TaskOpt const& opt)
+{
+    if (!n) return ;
+
+    BulkTaskFn* bulk = new BulkTaskFn(fn, n);
+    uint64_t id = GetTaskIdFactory().fetch_add(n) + 1;
+    taskCount_ += n;
+
+    // 指定了P时全部投递到该P, 否则平分给活跃的P
+    std::vector<Processor*> procs;
+    std::size_t pcount = processers_.size();
+    if (opt.processor_ >= 0 && pcount > 0) {
+        procs.push_back(processers_[opt.processor_ % pcount]);
+    } else {
+        for (std::size_t i = 0; i < pcount; ++i) {
+            auto p = processers_[i];
+            if (p && p->active_)
+                procs.push_back(p);
+        }
+    }
+
+    // 每段的Task对象一次分配
+    static const std::size_t kMaxChunk = 1024;
+    if (procs.empty()) {
+        for (std::size_t i = 0; i < n; ) {
+            std::size_t count = (std::min)(n - i, kMaxChunk);
+            TaskSlab* slab = TaskSlab::Create(this, count);
+            for (std::size_t k = 0; k < count; ++k, ++i)
+                AddTask(NewTask(BulkTaskCall{bulk, i}, opt, id + i, slab, k), opt.processor_);
+        }
+        return ;
+    }
+
+    // 每个P分到连续的一段, 创建完一段就投递, 先投递的P可以先开始执行.
+    // 每段不超过P的投递队列容量: 段太大时协程创建完要过很久才执行, 已经不在cache中了,
+    // 此时按段轮流投递给各P.
+    std::size_t chunk = (std::min)((n + procs.size() - 1) / procs.size(), kMaxChunk);
+    std::vector<Task*> tasks;
+    tasks.reserve(chunk);
+    for (std::size_t i = 0, pi = 0; i < n; ++pi) {
+        tasks.clear();
+        std::size_t count = (std::min)(n - i, chunk);
+        TaskSlab* slab = TaskSlab::Create(this, count);
+        for (std::size_t k = 0; k < count; ++k, ++i)
+            tasks.push_back(NewTask(BulkTaskCall{bulk, i}, opt, id + i, slab, k));
+        procs[pi % procs.size()]->AddTasks(tasks.data(), tasks.size());
+    }
 }
 
 void Scheduler::DeleteTask(RefObject* tk, void* arg)
@@ -103,6 +239,15 @@ void Scheduler::DeleteTask(RefObject* tk, void* arg)
     --self->taskCount_;
 }
 
+void Scheduler::DeleteSlabTask(RefObject* tk, void* arg)
+{
+    TaskSlab* slab = (TaskSlab*)arg;
+    Scheduler* self = slab->scheduler_;
+    static_cast<Task*>(tk)->~Task();
+    --self->taskCount_;
+    slab->Release();
+}
+
 bool Scheduler::IsCoroutine()
 {
     return !!Processor::GetCurrentTask();
@@ -226,21 +371,110 @@ Scheduler::TimerType & Scheduler::StaticGetTimer() {
     return timer;
 }
 
-void Scheduler::NewProcessThread()
+std::size_t Scheduler::NewProcessThread()
 {
-    IQueue* up_queue;
-    IQueue* down_queue;
-    GetStreamPool()->AcquireQueue(nullptr, 1024, &up_queue);       // softqueue
-    GetStreamPool()->AcquireQueue(nullptr, 1024, &down_queue);
+    // 优先复用已退休的P
+    Processor* p = nullptr;
+    std::size_t pcount = processers_.size();
+    std::size_t idx = 0;
+    for (; idx < pcount; ++idx) {
+        if (processers_[idx]->IsRetired()) {
+            p = processers_[idx];
+            break;
+        }
+    }
+
+    if (p) {
+        if (p->osThread_.joinable())
+            p->osThread_.join();
+        p->Revive();
+        DebugPrint(dbg_scheduler, "---> Revive Processor(%d)", p->id_);
+    } else {
+        IQueue* up_queue;
+        IQueue* down_queue;
+        GetStreamPool()->AcquireQueue(nullptr, 1024, &up_queue);       // softqueue
+        GetStreamPool()->AcquireQueue(nullptr, 1024, &down_queue);
+
+        p = new Processor(this, pcount, up_queue, down_queue);
+        DebugPrint(dbg_scheduler, "---> Create Processor(%d)", p->id_);
+    }
 
-    auto p = new Processor(this, processers_.size(), up_queue, down_queue);
-    DebugPrint(dbg_scheduler, "---> Create Processor(%d)", p->id_);
     std::thread t([this, p]{
             DebugPrint(dbg_thread, "Start process(sched=%p) thread id: %lu", (void*)this, NativeThreadID());
             p->Process();
             });
-    t.detach();
-    processers_.push_back(p);
+    p->osThread_.swap(t);
+    if (idx == pcount)
+        processers_.push_back(p);
+
+    // 第一个P: 接收之前暂存的协程. 先push_back再加锁, 之后的AddPending都会返回false
+    if (pcount == 0) {
+        std::unique_lock<std::mutex> lock(pendingMtx_);
+        if (!pendingTasks_.empty())
+            p->AddTasks(pendingTasks_.data(), pendingTasks_.size());
+        for (Resumable* r : pendingResumables_)
+            p->AddResumable(r);
+        std::vector<Task*>().swap(pendingTasks_);
+        std::vector<Resumable*>().swap(pendingResumables_);
+    }
+    return idx;
+}
+
+void Scheduler::RetireIdleProcessor()
+{
+    uint32_t retireUs = CoroutineOptions::getInstance().processor_idle_retire_us;
+    if (!retireUs)
+        return ;
+
+    // Start时创建的P不回收, 至少保留一个
+    std::size_t keep = (std::max)(minThreadNumber_ - 1, 1);
+    int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+            FastSteadyClock::now().time_since_epoch()).count();
+
+    std::size_t pcount = processers_.size();
+
+    // 外部线程创建的协程投递到lastActive_, 阻塞过后它常停在扩展出来的P上, 使其一直不空闲;
+    // 保留的P恢复活跃后改投给它们
+    if (lastActive_ >= keep) {
+        for (std::size_t i = 0; i < keep && i < pcount; ++i) {
+            if (processers_[i]->active_) {
+                lastActive_ = i;
+                break;
+            }
+        }
+    }
+
+    Processor* candidate = nullptr;
+    bool pending = false;
+    for (std::size_t i = keep; i < pcount; ++i) {
+        auto p = processers_[i];
+        if (p->IsRetired())
+            continue;
+
+        if (p->retireRequested_) {
+            pending = true;
+            continue;
+        }
+
+        // 调度次数变化说明期间执行过协程, 重新计时
+        if (!p->IsIdle() || p->switchCount_ != p->idleSwitch_ || !p->idleSinceUs_) {
+            p->idleSwitch_ = p->switchCount_;
+            p->idleSinceUs_ = now;
+            continue;
+        }
+
+        // 序号大的优先退休
+        if (now - p->idleSinceUs_ >= (int64_t)retireUs)
+            candidate = p;
+    }
+
+    // 上一个还没退休完时不请求新的, 逐个回收
+    if (pending || !candidate)
+        return ;
+
+    DebugPrint(dbg_scheduler, "Retire processer(%d)", candidate->id_);
+    candidate->idleSinceUs_ = 0;
+    candidate->RequestRetire();
 }
 
 void Scheduler::DispatcherThread()
@@ -259,8 +493,17 @@ void Scheduler::DispatcherThread()
         std::map<idx_t, std::size_t> blockings;
 
         int isActiveCount = 0;
+        int liveCount = 0;
         for (std::size_t i = 0; i < pcount; i++) {
             auto p = processers_[i];
+            if (p->IsRetired()) {
+                // 回收已退休的P线程
+                if (p->osThread_.joinable())
+                    p->osThread_.join();
+                continue;
+            }
+            ++liveCount;
+
             if (p->IsBlocking()) {
                 blockings[i] = p->RunnableSize();
                 if (p->active_) {
@@ -278,11 +521,14 @@ void Scheduler::DispatcherThread()
 
         for (std::size_t i = 0; i < pcount; i++) {
             auto p = processers_[i];
+            if (p->IsRetired())
+                continue;
+
             std::size_t loadaverage = p->RunnableSize();
             totalLoadaverage += loadaverage;
 
             if (!p->active_) {
-                if (activeQuota > 0 && !p->IsBlocking()) {
+                if (activeQuota > 0 && !p->IsBlocking() && !p->retireRequested_) {
                     p->active_ = true;
                     activeQuota--;
                     DebugPrint(dbg_scheduler, "Active processer(%d)", (int)i);
@@ -295,18 +541,23 @@ void Scheduler::DispatcherThread()
                 p->Mark();
             }
 
+            p->CheckPreempt();
+
             if (loadaverage > 0 && p->IsWaiting()) {
                 p->NotifyCondition();
             }
         }
 
-        if (actives.empty() && (int)pcount < maxThreadNumber_) {
+        if (actives.empty() && liveCount < maxThreadNumber_) {
             // 全部阻塞, 并且还有协程待执行, 起新线程
-            NewProcessThread();
-            actives.insert(ActiveMap::value_type{0, pcount});
-            ++pcount;
+            idx_t idx = NewProcessThread();
+            actives.insert(ActiveMap::value_type{0, idx});
+            pcount = processers_.size();
         }
 
+        // 阻塞过后多出来的P空闲太久时退休
+        RetireIdleProcessor();
+
         // 全部阻塞并且不能起新线程, 无需调度, 等待即可
         if (actives.empty())
             continue;
@@ -363,7 +614,7 @@ void Scheduler::DispatcherThread()
             }
 
             auto maxP = processers_[actives.rbegin()->second];
-            std::size_t stealN = (std::min)(maxP->RunnableSize() / 2, waitN * 1024);
+            std::size_t stealN = (std::min)(maxP->StealableSize() / 2, waitN * 1024);
             if (!stealN)
                 continue;
 
@@ -389,9 +640,15 @@ void Scheduler::DispatcherThread()
     }
 }
 
-void Scheduler::AddTask(Task* tk)
+void Scheduler::AddTask(Task* tk, int processor)
 {
     DebugPrint(dbg_scheduler, "Add task(%s) to runnable list.", tk->DebugInfo());
+    std::size_t pcount = processers_.size();
+    if (processor >= 0 && pcount > 0) {
+        processers_[processor % pcount]->AddTask(tk);
+        return ;
+    }
+
     /*
     auto proc = tk->proc_;
     if (proc && proc->active_) {
@@ -400,23 +657,75 @@ void Scheduler::AddTask(Task* tk)
     }*/
 
     // add task to self
+    // 固定的协程留在创建它的P上, 即使该P暂时处于非激活状态
     auto proc = Processor::GetCurrentProcessor();
-    if (proc && proc->active_ && proc->GetScheduler() == this) {
+    if (proc && (proc->active_ || tk->pinned_) && proc->GetScheduler() == this) {
         proc->AddTask(tk);
         return ;
     }
 
     // send task to scheduler
     // FIXME send task to neighbour queue
+    proc = PickProcessor();
+    if (UNLIKELY(!proc)) {
+        if (AddPending(tk))
+            return ;
+        proc = PickProcessor();
+    }
+    proc->AddTask(tk);
+}
+
+Processor* Scheduler::PickProcessor()
+{
+    auto proc = Processor::GetCurrentProcessor();
+    if (proc && proc->active_ && proc->GetScheduler() == this)
+        return proc;
+
+    // 都不活跃(阻塞中)时交给第一个未退休的P, 退休的P不会再执行协程
+    Processor* fallback = nullptr;
     std::size_t pcount = processers_.size();
     std::size_t idx = lastActive_;
     for (std::size_t i = 0; i < pcount; ++i, ++idx) {
         idx = idx % pcount;
         proc = processers_[idx];
-        if (proc && proc->active_)
-            break;
+        if (proc->active_)
+            return proc;
+        if (!fallback && !proc->IsRetired())
+            fallback = proc;
     }
-    proc->AddTask(tk);
+    return fallback;
+}
+
+bool Scheduler::AddPending(Task* tk)
+{
+    std::unique_lock<std::mutex> lock(pendingMtx_);
+    if (processers_.size())
+        return false;
+
+    DebugPrint(dbg_scheduler, "No processor yet, task(%s) pending.", tk->DebugInfo());
+    pendingTasks_.push_back(tk);
+    return true;
+}
+
+bool Scheduler::AddPending(Resumable* r)
+{
+    std::unique_lock<std::mutex> lock(pendingMtx_);
+    if (processers_.size())
+        return false;
+
+    pendingResumables_.push_back(r);
+    return true;
+}
+
+void Scheduler::AddResumable(Resumable* r)
+{
+    auto proc = PickProcessor();
+    if (UNLIKELY(!proc)) {
+        if (AddPending(r))
+            return ;
+        proc = PickProcessor();
+    }
+    proc->AddResumable(r);
 }
 
 uint32_t Scheduler::TaskCount()
@@ -424,6 +733,54 @@ uint32_t Scheduler::TaskCount()
     return taskCount_;
 }
 
+std::size_t Scheduler::ProcessorCount()
+{
+    std::size_t n = 0;
+    std::size_t pcount = processers_.size();
+    for (std::size_t i = 0; i < pcount; ++i) {
+        auto p = processers_[i];
+        if (p && p->active_)
+            ++n;
+    }
+    return n;
+}
+
+int Scheduler::IdleProcessor()
+{
+    // 从上次找到的位置往后找, 连续的并行工作不会都交给同一个P
+    std::size_t pcount = processers_.size();
+    std::size_t start = nextIdle_.fetch_add(1, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < pcount; ++i) {
+        std::size_t idx = (start + i) % pcount;
+        auto p = processers_[idx];
+        if (p && p->active_ && p->IsWaiting() && p->RunnableSize() == 0)
+            return (int)idx;
+    }
+    return -1;
+}
+
+SchedulerMetrics Scheduler::GetMetrics()
+{
+    SchedulerMetrics metrics;
+    metrics.taskCount = taskCount_;
+    std::size_t pcount = processers_.size();
+    for (std::size_t i = 0; i < pcount; ++i) {
+        metrics.processors.push_back(processers_[i]->GetMetrics());
+        ProcessorMetricsSnapshot & p = metrics.processors.back();
+        metrics.createToRun.Merge(p.createToRun);
+        metrics.wakeupToRun.Merge(p.wakeupToRun);
+        metrics.runSlice.Merge(p.runSlice);
+    }
+    return metrics;
+}
+
+void Scheduler::ForEachSuspendedTask(std::function<void(Task*)> const& fn)
+{
+    std::size_t pcount = processers_.size();
+    for (std::size_t i = 0; i < pcount; ++i)
+        processers_[i]->ForEachSuspendedTask(fn);
+}
+
 uint64_t Scheduler::GetCurrentTaskID()
 {
     Task* tk = Processor::GetCurrentTask();
@@ -17,12 +17,18 @@ class StreamPool;
 
 namespace co {
 
+struct TaskSlab;
+
 struct TaskOpt
 {
-    bool affinity_ = false;
+    bool affinity_ = false;             // 固定在加入的P上, 不会被偷走
+    bool shared_stack_ = false;         // 运行在共享栈上, 见CoroutineOptions::shared_stack_size
+    int processor_ = -1;                // 加入指定的P并固定在上面, -1表示不指定
     int lineno_ = 0;
     std::size_t stack_size_ = 0;
     const char* file_ = nullptr;
+    CancelToken* cancel_ = nullptr;     // 取消令牌(TaskGroup), 不指定时继承创建者协程的令牌
+    bool detach_cancel_ = false;        // 不继承创建者协程的取消令牌, 库内部的常驻协程使用
 };
 
 // 协程调度器
@@ -40,6 +46,11 @@ public:
     // 创建一个协程
     void CreateTask(TaskF const& fn, TaskOpt const& opt);
 
+    // 批量创建n个协程, 第i个协程执行fn(i), 所有协程共用一份fn
+    // 与循环创建相比: 协程ID一次分配, 协程按连续的段平分给活跃的P(指定了opt.processor_时全部给该P),
+    // 每段的Task对象一次分配, 每段一次投递、最多唤醒一次P; n不超过P数量x1024时每个P只投递一次
+    void CreateTasks(std::size_t n, std::function<void(std::size_t)> const& fn, TaskOpt const& opt = TaskOpt());
+
     // 当前是否处于协程中
     bool IsCoroutine();
 
@@ -50,7 +61,8 @@ public:
     // @minThreadNumber : 最小调度线程数, 为0时, 设置为cpu核心数.
     // @maxThreadNumber : 最大调度线程数, 为0时, 设置为minThreadNumber.
     //          如果maxThreadNumber大于minThreadNumber, 则当协程产生长时间阻塞时,
-    //          可以自动扩展调度线程数.
+    //          可以自动扩展调度线程数; 扩展出来的线程空闲超过
+    //          CoroutineOptions::processor_idle_retire_us后退出, 再次扩展时复用.
     void Start(int minThreadNumber = 1, int maxThreadNumber = 0);
     void goStart(int minThreadNumber = 1, int maxThreadNumber = 0);
     static const int s_ulimitedMaxThreadNumber = 40960;
@@ -66,6 +78,19 @@ public:
     // 当前调度器中的协程数量
     uint32_t TaskCount();
 
+    // 活跃的调度线程(P)数量
+    std::size_t ProcessorCount();
+
+    // 找一个空闲(等待中且没有待执行协程)的活跃P, 返回其序号, 没有时返回-1
+    // 用于把可并行的工作直接交给空闲的P, 不必等dispatcher下一轮steal
+    int IdleProcessor();
+
+    // 运行指标快照: 各P的计数器/队列长度/调度延迟直方图
+    SchedulerMetrics GetMetrics();
+
+    // 遍历所有已挂起(已切出)的协程, fn在持有所在P的锁时调用, 期间协程不会被唤醒
+    void ForEachSuspendedTask(std::function<void(Task*)> const& fn);
+
     // 当前协程ID, ID从1开始（不在协程中则返回0）
     uint64_t GetCurrentTaskID();
 
@@ -97,24 +122,52 @@ private:
     Scheduler& operator=(Scheduler const&) = delete;
     Scheduler& operator=(Scheduler &&) = delete;
 
+    // 创建协程对象, 不计入taskCount_, 也不加入P
+    // @slab: 非空时构造在slab的第index个位置上, 见CreateTasks
+    Task* NewTask(TaskF const& fn, TaskOpt const& opt, uint64_t id,
+            TaskSlab* slab = nullptr, std::size_t index = 0);
+
     static void DeleteTask(RefObject* tk, void* arg);
+    static void DeleteSlabTask(RefObject* tk, void* arg);
+
+    // 选一个P接收协程: 优先当前P, 否则轮流选择活跃的P, 都不活跃时选一个未退休的
+    // Start还没创建出任何P时返回nullptr
+    Processor* PickProcessor();
+
+    // 还没有P时暂存协程, 第一个P创建后转交给它; 已经有P时返回false
+    bool AddPending(Task* tk);
+    bool AddPending(Resumable* r);
+
+    // 将一个无栈协程加入可执行队列中, 按PickProcessor选择P
+    void AddResumable(Resumable* r);
 
     // 将一个协程加入可执行队列中
-    void AddTask(Task* tk);
+    // @processor: 加入指定的P, -1表示优先加入当前P, 否则轮流选择活跃的P
+    void AddTask(Task* tk, int processor = -1);
 
     // dispatcher线程函数
     // 1.根据待执行协程计算负载, 将高负载的P中的协程steal一些给空载的P
     // 2.侦测到阻塞的P(单个协程运行时间超过阀值), 将P中的其他协程steal给其他P
     void DispatcherThread();
 
-    void NewProcessThread();
+    // 启动一个P线程, 优先复用已退休的P, 返回P的序号
+    std::size_t NewProcessThread();
+
+    // 请求扩展出来的P中空闲最久的一个退休(每轮最多一个), 由调度线程调用
+    void RetireIdleProcessor();
 
     TimerType & StaticGetTimer();
 
     core::StreamPool* stream_pool_;
 
     // deque of Processor, write by start or dispatch thread
-    Deque<Processor*> processers_;
+    // 多读一写: 其他线程随时读, 无需加锁; 退休的P留在原位, 序号不变
+    ConcurrentDeque<Processor*> processers_;
+
+    // 第一个P创建之前加入的协程
+    std::mutex pendingMtx_;
+    std::vector<Task*> pendingTasks_;
+    std::vector<Resumable*> pendingResumables_;
 
     std::vector<core::IQueue> up_queues_;
     size_t queue_size {128};
@@ -125,6 +178,9 @@ private:
 
     volatile uint32_t lastActive_ = 0;
 
+    // IdleProcessor的起始查找位置
+    std::atomic<std::size_t> nextIdle_{0};
+
     TimerType *timer_ = nullptr;
 
     int minThreadNumber_ = 1;
@@ -0,0 +1,34 @@
+#include "co/sync/co_latch.h"
+
+namespace co
+{
+
+void Latch::wait()
+{
+    if (try_wait())
+        return ;
+
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    if (try_wait())
+        return ;
+
+    waiters_.park(lock);
+}
+
+bool Latch::wait_async(StackWaitList::Node* node, Resumable* r)
+{
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    if (try_wait())
+        return false;
+
+    waiters_.park_async(node, r);
+    return true;
+}
+
+void Latch::wakeAll()
+{
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    waiters_.wakeAll();
+}
+
+} //namespace co
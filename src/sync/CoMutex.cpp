@@ -0,0 +1,155 @@
+#include "co/sync/co_mutex.h"
+#include "common/inc/SpinLock.h"
+
+namespace co
+{
+
+CoMutex::CoMutex()
+    : sem_(0)
+{
+    cv_.setRelockAfterWait(false);
+}
+
+CoMutex::~CoMutex()
+{
+    assert(sem_ < kWaiter);
+}
+
+void CoMutex::lock()
+{
+    if (LIKELY(!starving_.load(std::memory_order_relaxed) && tryAcquire())) {
+        setOwner();
+        return ;
+    }
+
+    FastSteadyClock::time_point waitStart{};
+    for (;;) {
+        if (!starving_.load(std::memory_order_relaxed) && spin()) {
+            setOwner();
+            return ;
+        }
+
+        if (waitStart == FastSteadyClock::time_point{})
+            waitStart = FastSteadyClock::now();
+
+        if (park(waitStart)) {
+            setOwner();
+            return ;
+        }
+    }
+}
+
+bool CoMutex::try_lock()
+{
+    if (tryAcquire()) {
+        setOwner();
+        return true;
+    }
+    return false;
+}
+
+bool CoMutex::is_lock()
+{
+    return sem_.load(std::memory_order_relaxed) & kLocked;
+}
+
+void CoMutex::unlock()
+{
+    ownerProc_.store(nullptr, std::memory_order_relaxed);
+
+    if (LIKELY(!starving_.load(std::memory_order_acquire))) {
+        long s = sem_.fetch_sub(kLocked, std::memory_order_release) - kLocked;
+        assert(s >= 0);
+        if (s < kWaiter)
+            return ;
+
+        // 有等待者, 唤醒一个重新竞争
+        std::unique_lock<lock_t> lock(lock_);
+        if (sem_.load(std::memory_order_relaxed) >= kWaiter && cv_.notify_one())
+            sem_.fetch_sub(kWaiter, std::memory_order_relaxed);
+        return ;
+    }
+
+    // 交接模式: 不释放锁, 直接交给队首的等待者
+    std::unique_lock<lock_t> lock(lock_);
+    if (starving_.load(std::memory_order_relaxed)) {
+        if (cv_.notify_one([](bool* & handoff){ *handoff = true; })) {
+            sem_.fetch_sub(kWaiter, std::memory_order_relaxed);
+            return ;
+        }
+
+        starving_.store(false, std::memory_order_relaxed);
+    }
+
+    long s = sem_.fetch_sub(kLocked, std::memory_order_release) - kLocked;
+    if (s >= kWaiter && cv_.notify_one())
+        sem_.fetch_sub(kWaiter, std::memory_order_relaxed);
+}
+
+bool CoMutex::ownerIsRunning()
+{
+    Processor* proc = ownerProc_.load(std::memory_order_relaxed);
+
+    // 原生线程持有时无法得知其运行状态, 按运行中处理, 自旋次数有上限
+    if (!proc)
+        return true;
+
+    // 持有者与自己在同一个P上, 自旋没有意义
+    if (proc == Processor::GetCurrentProcessor())
+        return false;
+
+    return proc->IsRunningSince(ownerSwitch_.load(std::memory_order_relaxed));
+}
+
+void CoMutex::setOwner()
+{
+    Processor* proc = Processor::GetCurrentProcessor();
+    if (proc)
+        ownerSwitch_.store(proc->SwitchCount(), std::memory_order_relaxed);
+    ownerProc_.store(proc, std::memory_order_relaxed);
+}
+
+bool CoMutex::spin()
+{
+    for (int i = 0; i < kSpinCount; ++i) {
+        if (tryAcquire())
+            return true;
+
+        if (starving_.load(std::memory_order_relaxed) || !ownerIsRunning())
+            return false;
+
+        CpuRelax();
+    }
+
+    return tryAcquire();
+}
+
+bool CoMutex::park(FastSteadyClock::time_point waitStart)
+{
+    std::unique_lock<lock_t> lock(lock_);
+
+    // 先登记为等待者再尝试加锁, unlock在lock_下检查等待者, 因此不会丢失唤醒
+    long s = sem_.fetch_add(kWaiter, std::memory_order_relaxed) + kWaiter;
+    while (!(s & kLocked)) {
+        if (sem_.compare_exchange_weak(s, (s - kWaiter) | kLocked,
+                    std::memory_order_acquire, std::memory_order_relaxed))
+            return true;
+    }
+
+    SuspendLocal<bool> handoff(false);
+    cv_.wait(lock, handoff.get());
+
+    if (*handoff) {
+        // 已经持有锁. 等待时间不长或者已没有其他等待者时, 退出交接模式
+        if (FastSteadyClock::now() - waitStart < kStarvationThreshold ||
+                sem_.load(std::memory_order_relaxed) < kWaiter)
+            starving_.store(false, std::memory_order_relaxed);
+        return true;
+    }
+
+    if (FastSteadyClock::now() - waitStart > kStarvationThreshold)
+        starving_.store(true, std::memory_order_relaxed);
+    return false;
+}
+
+} //namespace co
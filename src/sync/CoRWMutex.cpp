@@ -0,0 +1,208 @@
+#include "co/sync/co_rwmutex.h"
+#include "common/inc/SpinLock.h"
+
+namespace co
+{
+
+CoRWMutex::CoRWMutex(bool writePriority)
+    : lockState_(0), writePriority_(writePriority)
+{
+    rCv_.setRelockAfterWait(false);
+    wCv_.setRelockAfterWait(false);
+    readView_.self_ = this;
+    writeView_.self_ = this;
+}
+
+CoRWMutex::~CoRWMutex()
+{
+    assert(readWaiting_ == 0);
+    assert(writeWaiting_ == 0);
+}
+
+void CoRWMutex::RLock()
+{
+    for (int spin = 0;; ++spin) {
+        std::unique_lock<LFLock> lock(lock_);
+        if (canRead()) {
+            ++lockState_;
+            return ;
+        }
+
+        if (spin < kSpinCount && lockState_ == -1 && writerIsRunning()) {
+            lock.unlock();
+            CpuRelax();
+            continue;
+        }
+
+        ++readWaiting_;
+        SuspendLocal<bool> granted(false);
+        rCv_.wait(lock, granted.get());
+        if (*granted)
+            return ;
+    }
+}
+
+bool CoRWMutex::RTryLock()
+{
+    std::unique_lock<LFLock> lock(lock_);
+    if (!canRead())
+        return false;
+
+    ++lockState_;
+    return true;
+}
+
+void CoRWMutex::RUnlock()
+{
+    std::unique_lock<LFLock> lock(lock_);
+    assert(lockState_ > 0);
+    if (--lockState_ > 0)
+        return ;
+
+    if (writeWaiting_ > 0 && wCv_.notify_one([](bool* & granted){ *granted = true; })) {
+        --writeWaiting_;
+        lockState_ = -1;
+    }
+}
+
+void CoRWMutex::WLock()
+{
+    for (int spin = 0;; ++spin) {
+        std::unique_lock<LFLock> lock(lock_);
+        if (lockState_ == 0) {
+            lockState_ = -1;
+            setWriter();
+            return ;
+        }
+
+        if (spin < kSpinCount && lockState_ == -1 && writerIsRunning()) {
+            lock.unlock();
+            CpuRelax();
+            continue;
+        }
+
+        ++writeWaiting_;
+        SuspendLocal<bool> granted(false);
+        wCv_.wait(lock, granted.get());
+        if (*granted) {
+            setWriter();
+            return ;
+        }
+    }
+}
+
+bool CoRWMutex::WTryLock()
+{
+    std::unique_lock<LFLock> lock(lock_);
+    if (lockState_ != 0)
+        return false;
+
+    lockState_ = -1;
+    setWriter();
+    return true;
+}
+
+void CoRWMutex::WUnlock()
+{
+    writerProc_.store(nullptr, std::memory_order_relaxed);
+
+    std::unique_lock<LFLock> lock(lock_);
+    assert(lockState_ == -1);
+
+    // 读者批量进入
+    if (readWaiting_ > 0) {
+        size_t n = rCv_.notify_all([](bool* & granted){ *granted = true; });
+        readWaiting_ = 0;
+        if (n > 0) {
+            lockState_ = n;
+            return ;
+        }
+    }
+
+    if (writeWaiting_ > 0 && wCv_.notify_one([](bool* & granted){ *granted = true; })) {
+        --writeWaiting_;
+        return ;
+    }
+
+    lockState_ = 0;
+}
+
+bool CoRWMutex::IsLock()
+{
+    std::unique_lock<LFLock> lock(lock_);
+    return lockState_ == -1;
+}
+
+bool CoRWMutex::writerIsRunning()
+{
+    Processor* proc = writerProc_.load(std::memory_order_relaxed);
+    if (!proc)
+        return true;
+
+    if (proc == Processor::GetCurrentProcessor())
+        return false;
+
+    return proc->IsRunningSince(writerSwitch_.load(std::memory_order_relaxed));
+}
+
+void CoRWMutex::setWriter()
+{
+    Processor* proc = Processor::GetCurrentProcessor();
+    if (proc)
+        writerSwitch_.store(proc->SwitchCount(), std::memory_order_relaxed);
+    writerProc_.store(proc, std::memory_order_relaxed);
+}
+
+void CoRWMutex::ReadView::lock()
+{
+    self_->RLock();
+}
+bool CoRWMutex::ReadView::try_lock()
+{
+    return self_->RTryLock();
+}
+bool CoRWMutex::ReadView::is_lock()
+{
+    return self_->IsLock();
+}
+void CoRWMutex::ReadView::unlock()
+{
+    self_->RUnlock();
+}
+
+void CoRWMutex::WriteView::lock()
+{
+    self_->WLock();
+}
+bool CoRWMutex::WriteView::try_lock()
+{
+    return self_->WTryLock();
+}
+bool CoRWMutex::WriteView::is_lock()
+{
+    return self_->IsLock();
+}
+void CoRWMutex::WriteView::unlock()
+{
+    self_->WUnlock();
+}
+
+CoRWMutex::ReadView& CoRWMutex::Reader()
+{
+    return readView_;
+}
+CoRWMutex::WriteView& CoRWMutex::Writer()
+{
+    return writeView_;
+}
+
+CoRWMutex::ReadView& CoRWMutex::reader()
+{
+    return readView_;
+}
+CoRWMutex::WriteView& CoRWMutex::writer()
+{
+    return writeView_;
+}
+
+} //namespace co
@@ -0,0 +1,27 @@
+#include "co/sync/co_semaphore.h"
+
+namespace co
+{
+
+void Semaphore::acquireSlow()
+{
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    if (pending_ > 0) {
+        // release先于入队发生, 直接领取
+        --pending_;
+        return ;
+    }
+
+    waiters_.park(lock);
+}
+
+void Semaphore::releaseSlow(long wakeups)
+{
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    for (long i = 0; i < wakeups; ++i) {
+        if (!waiters_.wakeOne())
+            ++pending_;
+    }
+}
+
+} //namespace co
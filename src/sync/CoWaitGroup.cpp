@@ -0,0 +1,34 @@
+#include "co/sync/co_wait_group.h"
+
+namespace co
+{
+
+void WaitGroup::wait()
+{
+    if (count_.load(std::memory_order_acquire) == 0)
+        return ;
+
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    if (count_.load(std::memory_order_acquire) == 0)
+        return ;
+
+    waiters_.park(lock);
+}
+
+bool WaitGroup::wait_async(StackWaitList::Node* node, Resumable* r)
+{
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    if (count_.load(std::memory_order_acquire) == 0)
+        return false;
+
+    waiters_.park_async(node, r);
+    return true;
+}
+
+void WaitGroup::wakeAll()
+{
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    waiters_.wakeAll();
+}
+
+} //namespace co
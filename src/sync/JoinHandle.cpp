@@ -0,0 +1,160 @@
+#include "co/sync/join_handle.h"
+#include "processor/Processor.h"
+#include <mutex>
+#include <condition_variable>
+
+namespace co
+{
+
+// 一次when_all/when_any/wait的等待者, 挂起期间由完成的协程通知
+struct JoinWaiter
+{
+    std::mutex mtx;
+    std::condition_variable cv;
+    Processor::SuspendEntry entry;
+    std::size_t pending = 0;
+    std::size_t first = (std::size_t)-1;
+    bool done = false;
+    JoinWaitNode node;
+
+    // 在JoinState的锁内调用, 此时等待者一定还没有返回
+    void Notify(std::size_t index)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (first == (std::size_t)-1)
+            first = index;
+        if (done || --pending > 0)
+            return ;
+
+        done = true;
+        if (entry) {
+            Processor::SuspendEntry e = std::move(entry);
+            Processor::Wakeup(e);
+            return ;
+        }
+        cv.notify_one();
+    }
+};
+
+void JoinStateBase::wait()
+{
+    if (ready())
+        return ;
+
+    JoinStateBase* self = this;
+    WaitJoinStates(&self, 1, 1);
+}
+
+bool JoinStateBase::AddWaiter(JoinWaitNode* node)
+{
+    std::unique_lock<LFLock> lock(lock_);
+    if (ready_.load(std::memory_order_relaxed))
+        return false;
+
+    node->next = waiters_;
+    waiters_ = node;
+    return true;
+}
+
+void JoinStateBase::RemoveWaiter(JoinWaitNode* node)
+{
+    // 即使节点已被SetReady取走也要拿一次锁, 等它对该节点的通知结束
+    std::unique_lock<LFLock> lock(lock_);
+    for (JoinWaitNode** pos = &waiters_; *pos; pos = &(*pos)->next) {
+        if (*pos == node) {
+            *pos = node->next;
+            return ;
+        }
+    }
+}
+
+void JoinStateBase::SetReady()
+{
+    std::unique_lock<LFLock> lock(lock_);
+    ready_.store(true, std::memory_order_release);
+    while (waiters_) {
+        JoinWaitNode* node = waiters_;
+        waiters_ = node->next;
+        if (node->resumable)
+            Processor::PostResumable(node->resumable);
+        else
+            node->waiter->Notify(node->index);
+    }
+}
+
+std::size_t WaitJoinStates(JoinStateBase* const* states, std::size_t n, std::size_t need)
+{
+    if (need == 0 || need > n)
+        need = n;
+
+    // 快速路径: 已经满足条件时不登记
+    std::size_t readyCount = 0, first = (std::size_t)-1;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (states[i]->ready()) {
+            ++readyCount;
+            if (first == (std::size_t)-1)
+                first = i;
+        }
+    }
+    if (readyCount >= need)
+        return first;
+
+    // 协程中的等待是取消点
+    Processor::CancellableScope scope;
+    scope.Check();
+
+    SuspendLocal<JoinWaiter> waiter;
+    std::vector<JoinWaitNode> nodes;
+    JoinWaitNode* nodeArray = &waiter->node;
+    if (n > 1) {
+        nodes.resize(n);
+        nodeArray = nodes.data();
+    }
+
+    // 登记时不持有waiter->mtx: SetReady在JoinState的锁内通知等待者, 加锁顺序只能是JoinState -> waiter
+    waiter->pending = need;
+    for (std::size_t i = 0; i < n; ++i) {
+        JoinWaitNode* node = &nodeArray[i];
+        node->waiter = waiter.get();
+        node->index = i;
+        if (states[i]->AddWaiter(node))
+            continue;
+
+        // 已经完成的直接计数
+        node->waiter = nullptr;
+        std::unique_lock<std::mutex> lock(waiter->mtx);
+        if (waiter->first == (std::size_t)-1)
+            waiter->first = i;
+        if (!waiter->done && --waiter->pending == 0)
+            waiter->done = true;
+    }
+
+    std::unique_lock<std::mutex> lock(waiter->mtx);
+    if (!waiter->done) {
+        if (Processor::IsCoroutine()) {
+            waiter->entry = Processor::Suspend();
+            lock.unlock();
+            Processor::StaticCoYield();
+        } else {
+            waiter->cv.wait(lock, [&]{ return waiter->done; });
+            lock.unlock();
+        }
+    } else {
+        lock.unlock();
+    }
+
+    // 注销剩余的节点(when_any时未完成的那些), 之后不会再有通知
+    for (std::size_t i = 0; i < n; ++i)
+        if (nodeArray[i].waiter)
+            states[i]->RemoveWaiter(&nodeArray[i]);
+
+    // 没等到就醒来, 是被取消唤醒的
+    lock.lock();
+    if (!waiter->done) {
+        lock.unlock();
+        scope.Check();
+    }
+    return waiter->first;
+}
+
+} //namespace co
@@ -0,0 +1,164 @@
+#include "co/sync/parallel.h"
+#include "processor/Processor.h"
+
+namespace co
+{
+
+static Scheduler* currentScheduler()
+{
+    Scheduler* scheduler = Processor::GetCurrentScheduler();
+    return scheduler ? scheduler : &Scheduler::getInstance();
+}
+
+// 子区间协程的入口
+struct ParallelPieceCall
+{
+    ParallelJob* job_;
+    ParallelJob::Piece* piece_;
+
+    void operator()()
+    {
+        job_->RunPiece(piece_);
+    }
+};
+
+ParallelJob::ParallelJob(std::size_t grain)
+    : grain_(grain ? grain : 1), scheduler_(currentScheduler())
+{
+}
+
+ParallelJob::~ParallelJob()
+{
+    Piece* p = pieces_.load(std::memory_order_acquire);
+    while (p) {
+        Piece* next = p->next;
+        delete p;
+        p = next;
+    }
+}
+
+ParallelJob::Piece* ParallelJob::NewPiece(std::size_t begin, std::size_t end)
+{
+    Piece* p = new Piece;
+    p->begin = begin;
+    p->end = end;
+    p->next = pieces_.load(std::memory_order_relaxed);
+    while (!pieces_.compare_exchange_weak(p->next, p, std::memory_order_release, std::memory_order_relaxed)) ;
+    return p;
+}
+
+ParallelJob::Piece* ParallelJob::Fork(std::size_t begin, std::size_t end)
+{
+    Piece* p = NewPiece(begin, end);
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    IncrementRef();
+
+    // 优先交给空闲的P, 它立即开始执行; 没有空闲的P时留在本P, 由派生者认领回来,
+    // 或者在本P被阻塞时由dispatcher偷给其他P
+    TaskOpt opt;
+    opt.shared_stack_ = true;
+    opt.processor_ = scheduler_->IdleProcessor();
+    scheduler_->CreateTask(ParallelPieceCall{this, p}, opt);
+    return p;
+}
+
+void ParallelJob::Finish()
+{
+    if (pending_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return ;
+
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    waiters_.wakeAll();
+}
+
+void ParallelJob::Fail(std::exception_ptr eptr)
+{
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    if (!eptr_)
+        eptr_ = eptr;
+    stopped_.store(true, std::memory_order_relaxed);
+}
+
+void ParallelJob::Run(std::size_t begin, std::size_t end)
+{
+    try {
+        Execute(begin, end);
+    } catch (...) {
+        Fail(std::current_exception());
+    }
+    Finish();
+}
+
+void ParallelJob::RunPiece(Piece* p)
+{
+    if (Claim(p))
+        Run(p->begin, p->end);
+    DecrementRef();
+}
+
+void ParallelJob::Wait()
+{
+    if (!pending_.load(std::memory_order_acquire))
+        return ;
+
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    if (!pending_.load(std::memory_order_acquire))
+        return ;
+
+    waiters_.park(lock);
+}
+
+void ParallelJob::Launch(std::size_t n, std::size_t parts)
+{
+    // 默认每个执行者(各P和发起者)两段
+    if (!parts)
+        parts = (scheduler_->ProcessorCount() + 1) * 2;
+    parts = (std::min)(parts, (n + grain_ - 1) / grain_);
+    if (!parts) parts = 1;
+
+    parts_.reserve(parts);
+    for (std::size_t i = 0; i < parts; ++i)
+        parts_.push_back(NewPiece(n * i / parts, n * (i + 1) / parts));
+    pending_.fetch_add(parts, std::memory_order_relaxed);
+
+    // 第一段留给自己, 其余的平分给各P
+    if (parts > 1) {
+        for (std::size_t i = 1; i < parts; ++i)
+            IncrementRef();
+
+        TaskOpt opt;
+        opt.shared_stack_ = true;
+        scheduler_->CreateTasks(parts - 1, [this](std::size_t i) {
+                    RunPiece(parts_[i + 1]);
+                }, opt);
+    }
+
+    // 倒序认领: 最后投递的段最晚被执行
+    for (std::size_t i = 0; i < parts; ++i) {
+        Piece* p = parts_[i ? parts - i : 0];
+        if (Claim(p))
+            Run(p->begin, p->end);
+    }
+
+    Wait();
+
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    std::exception_ptr eptr = eptr_;
+    lock.unlock();
+    if (eptr)
+        std::rethrow_exception(eptr);
+}
+
+std::size_t ParallelDefaultGrain(std::size_t n)
+{
+    std::size_t grain = n / ((currentScheduler()->ProcessorCount() + 1) * 8);
+    return grain ? grain : 1;
+}
+
+bool ParallelSerialOnly()
+{
+    std::size_t count = currentScheduler()->ProcessorCount();
+    return count == 0 || (count == 1 && Processor::IsCoroutine());
+}
+
+} //namespace co
@@ -0,0 +1,126 @@
+#include "co/sync/task_group.h"
+#include "processor/Processor.h"
+
+namespace co
+{
+
+void TaskGroupState::Done()
+{
+    if (pending_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return ;
+
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    waiters_.wakeAll();
+}
+
+void TaskGroupState::Fail(std::exception_ptr eptr)
+{
+    {
+        std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+        if (!eptr_)
+            eptr_ = eptr;
+    }
+    Cancel();
+}
+
+void TaskGroupState::Wait()
+{
+    if (!Pending())
+        return ;
+
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    if (!Pending())
+        return ;
+
+    waiters_.park(lock);
+}
+
+bool TaskGroupState::WaitUntil(FastSteadyClock::time_point deadline)
+{
+    if (!Pending())
+        return true;
+
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    if (!Pending())
+        return true;
+
+    auto now = FastSteadyClock::now();
+    if (deadline <= now)
+        return false;
+
+    // Done在持锁时唤醒, 超时或被取消醒来时可能刚好全部结束
+    return waiters_.park_for(lock, deadline - now) || !Pending();
+}
+
+bool TaskGroupState::WaitAsync(StackWaitList::Node* node, Resumable* r)
+{
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    if (!Pending())
+        return false;
+
+    waiters_.park_async(node, r);
+    return true;
+}
+
+std::exception_ptr TaskGroupState::Error()
+{
+    std::unique_lock<StackWaitList::lock_t> lock(waiters_.mutex());
+    return eptr_;
+}
+
+TaskGroup::TaskGroup()
+{
+    // 在协程中创建时挂到所在协程的令牌下, 随外层一起取消
+    Task* tk = Processor::GetCurrentTask();
+    state_ = new TaskGroupState(tk ? tk->cancel_.get() : nullptr);
+}
+
+TaskGroup::~TaskGroup()
+{
+    if (state_->Pending()) {
+        state_->Cancel();
+        state_->Wait();
+    }
+    state_->DecrementRef();
+}
+
+void TaskGroup::wait()
+{
+    state_->Wait();
+    std::exception_ptr eptr = state_->Error();
+    if (eptr)
+        std::rethrow_exception(eptr);
+}
+
+bool TaskGroup::wait_until(FastSteadyClock::time_point deadline)
+{
+    if (!state_->WaitUntil(deadline))
+        return false;
+
+    std::exception_ptr eptr = state_->Error();
+    if (eptr)
+        std::rethrow_exception(eptr);
+    return true;
+}
+
+bool TaskGroup::wait_async(StackWaitList::Node* node, Resumable* r)
+{
+    return state_->WaitAsync(node, r);
+}
+
+void TaskGroup::cancel()
+{
+    state_->Cancel();
+}
+
+bool TaskGroup::cancelled() const
+{
+    return state_->cancelled();
+}
+
+std::size_t TaskGroup::size() const
+{
+    return state_->Pending();
+}
+
+} //namespace co
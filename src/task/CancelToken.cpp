@@ -0,0 +1,98 @@
+#include "task/CancelToken.h"
+#include "task/Task.h"
+#include "processor/Processor.h"
+#include <vector>
+
+namespace co
+{
+
+CancelToken::CancelToken(CancelToken* parent)
+    : parent_(parent)
+{
+    if (!parent)
+        return ;
+
+    std::unique_lock<LFLock> lock(parent->lock_);
+    nextSibling_ = parent->children_;
+    if (nextSibling_)
+        nextSibling_->prevSibling_ = this;
+    parent->children_ = this;
+    if (parent->cancelled())
+        cancelled_.store(true, std::memory_order_release);
+}
+
+CancelToken::~CancelToken()
+{
+    assert(!tasks_);
+    if (!parent_)
+        return ;
+
+    std::unique_lock<LFLock> lock(parent_->lock_);
+    if (prevSibling_)
+        prevSibling_->nextSibling_ = nextSibling_;
+    else
+        parent_->children_ = nextSibling_;
+    if (nextSibling_)
+        nextSibling_->prevSibling_ = prevSibling_;
+}
+
+void CancelToken::Cancel()
+{
+    std::vector<Processor::SuspendEntry> entries;
+    {
+        std::unique_lock<LFLock> lock(lock_);
+        if (cancelled())
+            return ;
+
+        cancelled_.store(true, std::memory_order_release);
+        for (Task* tk = tasks_; tk; tk = tk->cancelNext_)
+            if (tk->cancelSuspendId_)
+                entries.push_back(Processor::SuspendEntry{WeakPtr<Task>(tk), tk->cancelSuspendId_});
+
+        // 子令牌析构时要先拿父令牌的锁才能摘链, 持锁期间子令牌一定有效
+        for (CancelToken* child = children_; child; child = child->nextSibling_)
+            child->Cancel();
+    }
+
+    // 已经醒来(挂起ID变化)的唤醒会失败, 不受影响
+    for (auto & entry : entries)
+        Processor::Wakeup(entry);
+}
+
+void CancelToken::AddTask(Task* tk)
+{
+    std::unique_lock<LFLock> lock(lock_);
+    tk->cancelPrev_ = nullptr;
+    tk->cancelNext_ = tasks_;
+    if (tasks_)
+        tasks_->cancelPrev_ = tk;
+    tasks_ = tk;
+}
+
+void CancelToken::RemoveTask(Task* tk)
+{
+    std::unique_lock<LFLock> lock(lock_);
+    if (tk->cancelPrev_)
+        tk->cancelPrev_->cancelNext_ = tk->cancelNext_;
+    else
+        tasks_ = tk->cancelNext_;
+    if (tk->cancelNext_)
+        tk->cancelNext_->cancelPrev_ = tk->cancelPrev_;
+    tk->cancelPrev_ = tk->cancelNext_ = nullptr;
+}
+
+void CancelToken::Watch(Task* tk, uint64_t suspendId)
+{
+    {
+        std::unique_lock<LFLock> lock(lock_);
+        if (!cancelled()) {
+            tk->cancelSuspendId_ = suspendId;
+            return ;
+        }
+    }
+
+    // 挂起之前已被取消, 撤销本次挂起
+    Processor::Wakeup(Processor::SuspendEntry{WeakPtr<Task>(tk), suspendId});
+}
+
+} //namespace co
@@ -0,0 +1,56 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+#include "common/inc/SpinLock.h"
+#include "common/inc/LangSupport.h"
+#include <exception>
+
+namespace co
+{
+
+struct Task;
+
+/// 协程被取消时从取消点抛出
+// 协程入口会捕获它并正常结束, 用户代码一般不需要处理, 只需保证RAII释放资源.
+struct task_cancelled : public std::exception
+{
+    const char* what() const noexcept override { return "co::task_cancelled"; }
+};
+
+/// 取消令牌
+// 协程创建时挂到令牌上(TaskGroup::spawn指定, 或继承创建者的令牌), 结束时摘下.
+// 可取消的挂起(带超时的挂起, 以及CancellableScope内的挂起)登记本次挂起的ID,
+// Cancel时逐个唤醒, 被唤醒的一方表现与超时相同, 由取消点抛出task_cancelled.
+// 子令牌(嵌套的TaskGroup)随父令牌一起取消.
+class CancelToken : public RefObject
+{
+public:
+    explicit CancelToken(CancelToken* parent = nullptr);
+    ~CancelToken();
+
+    ALWAYS_INLINE bool cancelled() const { return cancelled_.load(std::memory_order_acquire); }
+
+    // 置位取消标志, 唤醒所有处于可取消挂起中的协程
+    void Cancel();
+
+    // 协程创建/结束时调用
+    void AddTask(Task* tk);
+    void RemoveTask(Task* tk);
+
+    // 协程已挂起(suspendId为本次挂起的ID), 登记为可取消; 已取消时立即唤醒
+    void Watch(Task* tk, uint64_t suspendId);
+
+private:
+    CancelToken(CancelToken const&) = delete;
+    CancelToken& operator=(CancelToken const&) = delete;
+
+    std::atomic<bool> cancelled_{false};
+    LFLock lock_;
+    Task* tasks_ = nullptr;
+
+    IncursivePtr<CancelToken> parent_;
+    CancelToken* children_ = nullptr;
+    CancelToken* prevSibling_ = nullptr;
+    CancelToken* nextSibling_ = nullptr;
+};
+
+} //namespace co
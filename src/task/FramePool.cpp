@@ -0,0 +1,174 @@
+#include "task/FramePool.h"
+#include <mutex>
+#include <vector>
+#include <new>
+
+namespace co
+{
+
+namespace
+{
+
+const std::size_t kClassBytes = 64;
+const std::size_t kClasses = 16;            // 最大1KB
+const std::size_t kBatch = 256;             // 线程本地与全局之间一次转移的数量
+const std::size_t kChunkBytes = 64 * 1024;
+
+struct FreeNode
+{
+    FreeNode* next;
+};
+
+// 一批空闲帧
+struct Batch
+{
+    FreeNode* head;
+    std::size_t count;
+};
+
+struct GlobalPool
+{
+    std::mutex mtx;
+    std::vector<Batch> batches[kClasses];
+    std::atomic<std::size_t> bytes{0};
+};
+
+GlobalPool& Global()
+{
+    // 不析构: 线程退出时仍可能归还
+    static GlobalPool* pool = new GlobalPool;
+    return *pool;
+}
+
+// 线程本地缓存的状态: 线程退出时缓存析构之后(其他thread_local对象析构中)的分配/释放直接走全局
+enum { cache_none, cache_alive, cache_dead };
+thread_local int tlsCacheState = cache_none;
+
+struct LocalCache
+{
+    FreeNode* head[kClasses] = {};
+    std::size_t count[kClasses] = {};
+    char* chunk = nullptr;
+    std::size_t chunkLeft = 0;
+
+    LocalCache() { tlsCacheState = cache_alive; }
+
+    ~LocalCache()
+    {
+        tlsCacheState = cache_dead;
+        GlobalPool& g = Global();
+        std::unique_lock<std::mutex> lock(g.mtx);
+        for (std::size_t c = 0; c < kClasses; ++c)
+            if (head[c])
+                g.batches[c].push_back(Batch{head[c], count[c]});
+    }
+};
+
+// 已析构时返回nullptr
+LocalCache* Local()
+{
+    if (UNLIKELY(tlsCacheState == cache_dead))
+        return nullptr;
+
+    static thread_local LocalCache cache;
+    return &cache;
+}
+
+void GlobalPush(std::size_t cls, FreeNode* head, std::size_t count)
+{
+    GlobalPool& g = Global();
+    std::unique_lock<std::mutex> lock(g.mtx);
+    g.batches[cls].push_back(Batch{head, count});
+}
+
+void* Carve(LocalCache& cache, std::size_t bytes)
+{
+    if (cache.chunkLeft < bytes) {
+        // 剩余的零头不再使用
+        cache.chunk = (char*)::operator new(kChunkBytes);
+        cache.chunkLeft = kChunkBytes;
+        Global().bytes.fetch_add(kChunkBytes, std::memory_order_relaxed);
+    }
+
+    void* p = cache.chunk;
+    cache.chunk += bytes;
+    cache.chunkLeft -= bytes;
+    return p;
+}
+
+} //namespace
+
+void* FrameAlloc(std::size_t size)
+{
+    std::size_t cls = (size + kClassBytes - 1) / kClassBytes - 1;
+    if (cls >= kClasses)
+        return ::operator new(size);
+
+    LocalCache* cache = Local();
+    if (UNLIKELY(!cache)) {
+        Global().bytes.fetch_add((cls + 1) * kClassBytes, std::memory_order_relaxed);
+        return ::operator new((cls + 1) * kClassBytes);
+    }
+
+    FreeNode* node = cache->head[cls];
+    if (node) {
+        cache->head[cls] = node->next;
+        --cache->count[cls];
+        return node;
+    }
+
+    {
+        GlobalPool& g = Global();
+        std::unique_lock<std::mutex> lock(g.mtx);
+        if (!g.batches[cls].empty()) {
+            Batch b = g.batches[cls].back();
+            g.batches[cls].pop_back();
+            lock.unlock();
+
+            cache->head[cls] = b.head->next;
+            cache->count[cls] = b.count - 1;
+            return b.head;
+        }
+    }
+
+    return Carve(*cache, (cls + 1) * kClassBytes);
+}
+
+void FrameFree(void* ptr, std::size_t size)
+{
+    std::size_t cls = (size + kClassBytes - 1) / kClassBytes - 1;
+    if (cls >= kClasses) {
+        ::operator delete(ptr);
+        return ;
+    }
+
+    FreeNode* node = (FreeNode*)ptr;
+    LocalCache* cache = Local();
+    if (UNLIKELY(!cache)) {
+        node->next = nullptr;
+        GlobalPush(cls, node, 1);
+        return ;
+    }
+
+    node->next = cache->head[cls];
+    cache->head[cls] = node;
+    if (++cache->count[cls] < kBatch * 2)
+        return ;
+
+    // 留下一批, 其余的交给全局
+    FreeNode* tail = node;
+    for (std::size_t i = 1; i < kBatch; ++i)
+        tail = tail->next;
+    FreeNode* rest = tail->next;
+    tail->next = nullptr;
+    std::size_t restCount = cache->count[cls] - kBatch;
+    cache->count[cls] = kBatch;
+    GlobalPush(cls, rest, restCount);
+}
+
+std::size_t FramePoolBytes()
+{
+    return Global().bytes.load(std::memory_order_relaxed);
+}
+
+} //namespace co
@@ -0,0 +1,18 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+
+namespace co
+{
+
+/// 无栈协程帧的内存池
+// 按64字节分级, 不超过1KB的帧从池中分配, 更大的直接用operator new.
+// 每个线程一份空闲链表, 分配/释放不加锁; 空闲太多时成批交给全局链表, 线程本地为空时先从全局取一批,
+// 再从本线程的64KB大块中切分. 帧常在一个P上创建, 在另一个P上结束, 批量流转避免单向堆积.
+// 切分出去的内存不归还系统.
+void* FrameAlloc(std::size_t size);
+void FrameFree(void* ptr, std::size_t size);
+
+// 池从系统申请的总字节数(含空闲)
+std::size_t FramePoolBytes();
+
+} //namespace co
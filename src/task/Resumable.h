@@ -0,0 +1,20 @@
+#pragma once
+#include "common/inc/OsSupport.h"
+
+namespace co
+{
+
+class Processor;
+
+/// 可被P调度的无栈执行体(C++20协程帧, 见co/async.h)
+// 与Task共用P的调度循环, 但没有独立的栈和上下文: P在调度循环里直接调用resume_,
+// 它执行到下一个挂起点时返回. 节点嵌在协程帧里, 入队/出队不分配内存.
+// 不参与steal, 唤醒时回到上次执行它的P(该P不再活跃时由调度器另选).
+struct Resumable
+{
+    Resumable* next_ = nullptr;
+    Processor* proc_ = nullptr;             // 上次执行所在的P
+    void (*resume_)(Resumable*) = nullptr;
+};
+
+} //namespace co
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <string>
 #include <algorithm>
+#include <new>
 // #include "../debug/listener.h"
 #include "scheduler/Scheduler.h"
 #include "task/TaskRef.h"
@@ -27,6 +28,9 @@ const char* GetTaskStateName(TaskState state)
 
 void Task::Run()
 {
+    // 可能是由其他协程直接切换进来的
+    Processor::FinishSwitch();
+
     auto call_fn = [this]() {
 #if ENABLE_DEBUGGER
         if (Listener::GetTaskListener()) {
@@ -34,7 +38,12 @@ void Task::Run()
         }
 #endif
 
-        this->fn_();
+        try {
+            this->fn_();
+        } catch (task_cancelled const&) {
+            // 被取消的协程从取消点退出, 视为正常结束
+            DebugPrint(dbg_task, "task(%s) cancelled.", DebugInfo());
+        }
         this->fn_ = TaskF(); //让协程function对象的析构也在协程中执行
 
 #if ENABLE_DEBUGGER
@@ -69,6 +78,11 @@ void Task::Run()
     }
 #endif
 
+    if (cancel_) {
+        cancel_->RemoveTask(this);
+        cancel_.reset();
+    }
+
     state_ = TaskState::done;
     Processor::StaticCoYield();
 }
@@ -80,7 +94,8 @@ void FCONTEXT_CALL Task::StaticRun(intptr_t vp)
 }
 
 Task::Task(TaskF const& fn, std::size_t stack_size)
-    : ctx_(&Task::StaticRun, (intptr_t)this, stack_size), fn_(fn)
+    : ctx_(&Task::StaticRun, (intptr_t)this, stack_size), fn_(fn),
+    anys_(reinterpret_cast<char*>(this) + sizeof(Task))
 {
 //    DebugPrint(dbg_task, "task(%s) construct. this=%p", DebugInfo(), this);
 }
@@ -90,9 +105,24 @@ Task::~Task()
 //    printf("delete Task = %p, impl = %p, weak = %ld\n", this, this->impl_, (long)this->impl_->weak_);
     assert(!this->prev);
     assert(!this->next);
+    // 没有执行过的协程(调度器已停止)还挂在取消令牌上
+    if (cancel_)
+        cancel_->RemoveTask(this);
 //    DebugPrint(dbg_task, "task(%s) destruct. this=%p", DebugInfo(), this);
 }
 
+static_assert(alignof(Task) >= TaskAnys::kMaxAlign, "anys_ storage alignment");
+
+void* Task::operator new(std::size_t size)
+{
+    return ::operator new(size + TaskAnys::StorageSize());
+}
+
+void Task::operator delete(void* ptr)
+{
+    ::operator delete(ptr);
+}
+
 const char* Task::DebugInfo()
 {
     if (reinterpret_cast<void*>(this) == nullptr) return "nil";
@@ -3,7 +3,9 @@
 #include "common/inc/Anys.h"
 #include "common/inc/TsQueue.h"
 #include "processor/Context.h"
+#include "processor/CLSStorage.h"
 #include "debug/CoDebugger.h"
+#include "task/CancelToken.h"
 
 namespace co
 {
@@ -25,21 +27,41 @@ struct TaskGroupKey {};
 typedef Anys<TaskGroupKey> TaskAnys;
 
 
+// 字段按访问频率排列: 基类(引用计数, 队列指针)之后紧跟调度热数据(不超过一个cache line),
+// 冷数据放在后面, TaskRef的存储附在对象尾部.
 struct Task
     : public TSQueueHook, public SharedRefObject, public CoDebugger::DebuggerBase<Task>
 {
+    // ---- 调度热数据 ----
     TaskState state_ = TaskState::runnable;
-    uint64_t id_;
+    bool started_ = false;
+    bool pinned_ = false;               // 固定在所在P上执行, 不会被偷走
+    bool cancellable_ = false;          // 处于CancellableScope中, 挂起可以被取消唤醒
     Processor* proc_ = nullptr;
+    atomic_t<uint64_t> suspendId_ {0};
+
+    // 进入可执行状态的时间戳(ns), 用于统计调度延迟, 0表示不统计
+    int64_t readyNs_ = 0;
+
     Context ctx_;
+
+    // ---- 冷数据 ----
+    uint64_t id_;
+    uint64_t yieldCount_ = 0;
     TaskF fn_;
     std::exception_ptr eptr_;           // 保存exception的指针
-    TaskAnys anys_;
+    CLSStorage cls_;                    // 协程本地存储
 
-    uint64_t yieldCount_ = 0;
+    // 取消令牌, 以及挂在令牌上的链表指针和最近一次可取消挂起的ID
+    IncursivePtr<CancelToken> cancel_;
+    Task* cancelPrev_ = nullptr;
+    Task* cancelNext_ = nullptr;
+    uint64_t cancelSuspendId_ = 0;
 
-    atomic_t<uint64_t> suspendId_ {0};
+    // TaskRefDefine注册的数据, 存储紧跟在Task对象之后, 与Task一次分配
+    TaskAnys anys_;
 
+    // @stack_size: 为0时运行在P的共享栈上
     Task(TaskF const& fn, std::size_t stack_size);
     ~Task();
 
@@ -47,10 +69,12 @@ struct Task
     {
         ctx_.SwapIn();
     }
-    //ALWAYS_INLINE void SwapTo(Task* other)
-    //{
-    //    ctx_.SwapTo(other->ctx_);
-    //}
+#if !defined(LIBGO_SYS_Windows)
+    ALWAYS_INLINE void SwapTo(Task* other)
+    {
+        ctx_.SwapTo(other->ctx_);
+    }
+#endif
     ALWAYS_INLINE void SwapOut()
     {
         ctx_.SwapOut();
@@ -58,6 +82,10 @@ struct Task
 
     const char* DebugInfo();
 
+    // 分配时在尾部附带anys_的存储
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr);
+
 private:
     void Run();
 
@@ -74,14 +102,14 @@ private:
     ALWAYS_INLINE type& TaskRef ## name(Task *tk) \
     { \
         typedef type T; \
-        static int idx = -1; \
+        static std::size_t offset = (std::size_t)-1; \
         if (UNLIKELY(tk == TaskInitPtr)) { \
-            if (idx == -1) \
-                idx = TaskAnys::Register<T>(); \
+            if (offset == (std::size_t)-1) \
+                offset = TaskAnys::Offset(TaskAnys::Register<T>()); \
             static T ignore{}; \
             return ignore; \
         } \
-        return tk->anys_.get<T>(idx); \
+        return tk->anys_.at<T>(offset); \
     }
 #define TaskRefInit(name) do { TaskRef ## name(TaskInitPtr); } while(0)
 
@@ -6,7 +6,6 @@
 namespace co
 {
 
-TaskRefDefine(bool, Affinity)
 TaskRefDefine(SourceLocation, Location)
 TaskRefDefine(std::string, DebugInfo)
 TaskRefDefine(atomic_t<uint64_t>, SuspendId)
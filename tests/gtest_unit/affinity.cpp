@@ -0,0 +1,108 @@
+#include <iostream>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+static int procId()
+{
+    return Processor::GetCurrentProcessor()->Id();
+}
+
+static int procCount()
+{
+    return (int)co_sched.GetMetrics().processors.size();
+}
+
+TEST(Affinity, processor)
+{
+    while (procCount() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    // 放到指定的P上, 多次让出后仍在该P上
+    int pcount = procCount();
+    std::atomic<int> wrong{0}, done{0};
+    for (int i = 0; i < pcount * 2; ++i)
+        go co_processor(i) [&, i]{
+            for (int j = 0; j < 100; ++j) {
+                if (procId() != i % pcount)
+                    ++wrong;
+                co_yield;
+            }
+            ++done;
+        };
+    WaitUntilNoTask();
+    EXPECT_EQ(done, pcount * 2);
+    EXPECT_EQ(wrong, 0);
+}
+
+TEST(Affinity, notStolen)
+{
+    // P0被判定为阻塞后其他协程都被偷走, 固定的协程留在P0上, 等阻塞结束后继续执行
+    while (procCount() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    const int n = 50;
+    std::atomic<int> moved{0}, stolen{0}, started{0}, pinnedDone{0};
+    go co_processor(0) [&]{
+        for (int i = 0; i < n; ++i) {
+            go co_affinity [&]{
+                for (int j = 0; j < 10; ++j) {
+                    co_yield;
+                    if (procId() != 0)
+                        ++moved;
+                }
+                ++pinnedDone;
+            };
+            go [&]{
+                ++started;
+                bool s = false;
+                for (int j = 0; j < 10; ++j) {
+                    co_yield;
+                    if (procId() != 0)
+                        s = true;
+                }
+                if (s) ++stolen;
+            };
+        }
+
+        // 等新协程都进入本P的可执行队列(还在up_queue_中的协程不会被偷)
+        while (started < n)
+            co_yield;
+        auto end = chrono::steady_clock::now() + chrono::microseconds(co_opt.cycle_timeout_us * 3);
+        while (chrono::steady_clock::now() < end)
+            ;
+    };
+    WaitUntilNoTask();
+    EXPECT_EQ(pinnedDone, n);
+    EXPECT_EQ(moved, 0);
+    EXPECT_GT(stolen, 0);
+}
+
+TEST(Affinity, loadBalance)
+{
+    // 负载均衡从繁忙的P偷协程时跳过固定的协程
+    while (procCount() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    const int n = 500;
+    std::atomic<int> moved{0}, done{0};
+    go co_processor(0) [&]{
+        for (int i = 0; i < n; ++i)
+            go co_affinity [&]{
+                for (int j = 0; j < 200; ++j) {
+                    if (procId() != 0)
+                        ++moved;
+                    co_yield;
+                }
+                ++done;
+            };
+    };
+    WaitUntilNoTask();
+    EXPECT_EQ(done, n);
+    EXPECT_EQ(moved, 0);
+}
@@ -0,0 +1,271 @@
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+// 无栈协程需要以-std=c++20编译
+#if defined(__cpp_impl_coroutine)
+
+static void waitProcessors()
+{
+    while (co_sched.GetMetrics().processors.size() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+}
+
+static co::Async<int> addOne(int v)
+{
+    co_await co::async_yield();
+    co_return v + 1;
+}
+
+static co::Async<int> chain(int n)
+{
+    int v = 0;
+    for (int i = 0; i < n; ++i)
+        v = co_await addOne(v);
+    co_return v;
+}
+
+TEST(Async, spawnAndGet)
+{
+    waitProcessors();
+
+    // 原生线程中get()阻塞等待
+    auto h = co::spawn(chain(100));
+    EXPECT_EQ(h.get(), 100);
+
+    // 普通协程中get()只挂起当前协程
+    std::atomic<int> got{0};
+    co_wait_group wg;
+    wg.add(1);
+    go [&]{
+        got = co::spawn(chain(10)).get();
+        wg.done();
+    };
+    wg.wait();
+    EXPECT_EQ(got, 10);
+}
+
+static co::Async<void> thrower()
+{
+    co_await co::async_yield();
+    throw std::runtime_error("boom");
+}
+
+static co::Async<int> catcher()
+{
+    try {
+        co_await thrower();
+    } catch (std::runtime_error &) {
+        co_return 1;
+    }
+    co_return 0;
+}
+
+TEST(Async, exception)
+{
+    EXPECT_THROW(co::spawn(thrower()).get(), std::runtime_error);
+    EXPECT_EQ(co::spawn(catcher()).get(), 1);
+}
+
+static co::Async<long> sleeper(int ms)
+{
+    auto start = FastSteadyClock::now();
+    co_await co::async_sleep(std::chrono::milliseconds(ms));
+    co_return std::chrono::duration_cast<std::chrono::milliseconds>(FastSteadyClock::now() - start).count();
+}
+
+TEST(Async, sleep)
+{
+    EXPECT_GE(co::spawn(sleeper(20)).get(), 19);
+    EXPECT_EQ(co::spawn(sleeper(0)).get(), 0);
+}
+
+static co::Async<int> consumer(co_chan<int> ch)
+{
+    int sum = 0, v = 0;
+    while (co_await co::async_pop(ch, v))
+        sum += v;
+    co_return sum;
+}
+
+static co::Async<int> consumeN(co_chan<int> ch, int n)
+{
+    int sum = 0, v = 0;
+    for (int i = 0; i < n; ++i) {
+        co_await co::async_pop(ch, v);
+        sum += v;
+    }
+    co_return sum;
+}
+
+static co::Async<void> producer(co_chan<int> ch, int n, bool close = true)
+{
+    for (int i = 1; i <= n; ++i)
+        co_await co::async_push(ch, i);
+    if (close)
+        ch.Close();
+}
+
+TEST(Async, channel)
+{
+    // 无缓冲: 无栈协程之间交替唤醒
+    {
+        co_chan<int> ch;
+        auto c = co::spawn(consumer(ch));
+        co::detach(producer(ch, 1000));
+        EXPECT_EQ(c.get(), 500500);
+    }
+
+    // 有缓冲, 与普通协程混合读写(关闭时缓冲区中的数据会被丢弃, 按个数读)
+    {
+        co_chan<int> ch(16);
+        auto c = co::spawn(consumeN(ch, 1000));
+        go [=]{
+            for (int i = 1; i <= 1000; ++i)
+                ch << i;
+        };
+        EXPECT_EQ(c.get(), 500500);
+    }
+
+    // CAS实现不支持直接登记无栈协程, 由共享栈协程代为等待
+    {
+        co_chan<int> ch(4, 16);
+        auto c = co::spawn(consumeN(ch, 1000));
+        co::detach(producer(ch, 1000, false));
+        EXPECT_EQ(c.get(), 500500);
+    }
+
+    // 无栈协程写, 普通协程读
+    {
+        co_chan<int> ch;
+        co::detach(producer(ch, 100));
+        auto c = co::spawn([=]{
+                    int sum = 0, v;
+                    for (int i = 0; i < 100; ++i) {
+                        ch >> v;
+                        sum += v;
+                    }
+                    return sum;
+                });
+        EXPECT_EQ(c.get(), 5050);
+    }
+}
+
+static co::Async<int> awaitStackful()
+{
+    // 无栈协程等待普通协程
+    int a = co_await co::spawn([]{ co_sleep(5); return 20; });
+    auto h = co::spawn([]{ co_yield; return 22; });
+    int b = co_await h;
+    co_return a + b;
+}
+
+TEST(Async, awaitStackful)
+{
+    EXPECT_EQ(co::spawn(awaitStackful()).get(), 42);
+}
+
+static co::Async<int> awaitStackless()
+{
+    // spawn出去的无栈协程在其他P上并发执行
+    std::vector<co::JoinHandle<int>> hs;
+    for (int i = 0; i < 100; ++i)
+        hs.push_back(co::spawn(chain(i)));
+    int sum = 0;
+    for (auto & h : hs)
+        sum += co_await h;
+    co_return sum;
+}
+
+TEST(Async, awaitStackless)
+{
+    EXPECT_EQ(co::spawn(awaitStackless()).get(), 4950);
+}
+
+static co::Async<void> latchWaiter(co_latch & latch, std::atomic<int> & passed)
+{
+    co_await co::async_wait(latch);
+    ++passed;
+}
+
+TEST(Async, latchAndWaitGroup)
+{
+    co_latch latch(3);
+    std::atomic<int> passed{0};
+    std::vector<co::JoinHandle<void>> hs;
+    for (int i = 0; i < 10; ++i)
+        hs.push_back(co::spawn(latchWaiter(latch, passed)));
+
+    for (int i = 0; i < 3; ++i)
+        go [&]{ co_sleep(1); latch.count_down(); };
+    for (auto & h : hs)
+        h.get();
+    EXPECT_EQ(passed, 10);
+
+    co_wait_group wg;
+    std::atomic<int> done{0};
+    wg.add(20);
+    for (int i = 0; i < 20; ++i)
+        go [&]{ co_yield; ++done; wg.done(); };
+    // 协程帧中保存的是lambda对象的指针, lambda要活到协程结束
+    auto waitAll = [&]() -> co::Async<int> {
+        co_await co::async_wait(wg);
+        co_return done.load();
+    };
+    auto w = co::spawn(waitAll());
+    EXPECT_EQ(w.get(), 20);
+}
+
+TEST(Async, taskGroup)
+{
+    co::TaskGroup group;
+    std::atomic<int> ran{0};
+    for (int i = 0; i < 10; ++i)
+        group.spawn([&]{ co_yield; ++ran; });
+    auto waitGroup = [&]() -> co::Async<int> {
+        co_await co::async_wait(group);
+        co_return ran.load();
+    };
+    auto h = co::spawn(waitGroup());
+    EXPECT_EQ(h.get(), 10);
+
+    co::TaskGroup failing;
+    failing.spawn([]{ throw std::runtime_error("fail"); });
+    auto waitFailing = [&]() -> co::Async<void> {
+        co_await co::async_wait(failing);
+    };
+    auto f = co::spawn(waitFailing());
+    EXPECT_THROW(f.get(), std::runtime_error);
+}
+
+TEST(Async, many)
+{
+    const int n = 100000;
+    co_chan<int> ch(1024);
+    std::atomic<int> finished{0};
+    auto body = [&](int i) -> co::Async<void> {
+        co_await co::async_yield();
+        co_await co::async_push(ch, i & 1);
+        ++finished;
+    };
+    for (int i = 0; i < n; ++i)
+        co::detach(body(i));
+
+    int sum = 0, v;
+    for (int i = 0; i < n; ++i) {
+        ch >> v;
+        sum += v;
+    }
+    EXPECT_EQ(sum, n / 2);
+    while (finished < n)
+        usleep(1000);
+}
+
+#endif // __cpp_impl_coroutine
@@ -69,3 +69,60 @@ TEST(AsyncPool, AsyncPool)
     while (val != c * 3 + 2)
         cbPoint->Run();
 }
+
+TEST(AsyncPool, Elastic)
+{
+    AsyncCoroutinePool * pool = AsyncCoroutinePool::Create();
+    pool->InitCoroutinePool(64, 2);
+    pool->SetIdleTimeout(std::chrono::milliseconds(50));
+    pool->Start(2);
+    EXPECT_EQ(pool->CoroutineCount(), 2u);
+
+    // 工作协程阻塞时按需扩容, 不超过上限
+    std::atomic<int> val{0};
+    co_chan<void> block(1024);
+    for (int i = 0; i < 200; ++i)
+        pool->Post([&]{ block >> nullptr; ++val; }, NULL);
+    while (pool->CoroutineCount() < 64)
+        usleep(1000);
+    EXPECT_EQ(pool->CoroutineCount(), 64u);
+
+    for (int i = 0; i < 200; ++i)
+        block << nullptr;
+    while (val != 200)
+        usleep(1000);
+
+    // 空闲超时后回收到常驻数量
+    for (int i = 0; i < 1000 && pool->CoroutineCount() > 2; ++i)
+        usleep(1000);
+    EXPECT_EQ(pool->CoroutineCount(), 2u);
+    EXPECT_EQ(pool->PendingCount(), 0u);
+}
+
+TEST(AsyncPool, PostFromCancelledGroup)
+{
+    AsyncCoroutinePool * pool = AsyncCoroutinePool::Create();
+    pool->InitCoroutinePool(1, 0);
+    pool->Start(2, 2);
+
+    // 工作协程由TaskGroup内的协程按需创建, 组被取消时不能把它一起取消
+    std::atomic<int> first{0}, second{0};
+    {
+        co::TaskGroup group;
+        group.spawn([&]{
+            pool->Post([&]{ co_sleep(100); ++first; }, NULL);
+        });
+        for (int i = 0; i < 1000 && pool->CoroutineCount() == 0; ++i)
+            usleep(1000);
+        usleep(20 * 1000);
+        group.cancel();
+        group.wait();
+    }
+
+    // 协程数已达上限, 之后的任务仍然要有工作协程执行
+    pool->Post([&]{ ++second; }, NULL);
+    for (int i = 0; i < 3000 && second == 0; ++i)
+        usleep(1000);
+    EXPECT_EQ(first, 1);
+    EXPECT_EQ(second, 1);
+}
@@ -14,7 +14,7 @@ using namespace co;
 
 #define SLEEP(ms) \
     do {\
-        Processer::Suspend(milliseconds(ms)); co_yield;\
+        Processor::Suspend(milliseconds(ms)); co_yield;\
     } while(0)
 
 TEST(Channel, capacity0)
@@ -186,6 +186,34 @@ TEST(Channel, capacityN)
     }
 }
 
+TEST(Channel, unbounded)
+{
+    co_chan<int> ch(co_chan<int>::kUnbounded);
+    const int n = 100000;
+
+    // 超过ringbuffer上限, push不会阻塞
+    for (int i = 0; i < n; ++i) {
+        EXPECT_TRUE(ch.TryPush(i));
+    }
+    EXPECT_EQ(ch.size(), (std::size_t)n);
+
+    go [&]{
+        for (int i = 0; i < n; ++i) {
+            int x = -1;
+            ch >> x;
+            EXPECT_EQ(x, i);
+        }
+        EXPECT_YIELD(0);
+    };
+    WaitUntilNoTask();
+    EXPECT_TRUE(ch.empty());
+
+    // 读空后再次读写, 复用已回收的chunk
+    go [&]{ ch << 1; ch << 2; };
+    go [&]{ int x = 0; ch >> x; EXPECT_EQ(x, 1); ch >> x; EXPECT_EQ(x, 2); };
+    WaitUntilNoTask();
+}
+
 TEST(Channel, capacity0Try)
 {
     co_chan<int> ch;
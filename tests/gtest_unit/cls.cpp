@@ -0,0 +1,87 @@
+#include <iostream>
+#include <unistd.h>
+#include <string>
+#include <gtest/gtest.h>
+#define TEST_MIN_THREAD 2
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+struct Counted
+{
+    static atomic<int> alive;
+    int v;
+    explicit Counted(int v = 0) : v(v) { ++alive; }
+    ~Counted() { --alive; }
+};
+atomic<int> Counted::alive{0};
+
+int& slotInt() { return co_cls(int, 7); }
+string& slotStr() { return co_cls(string, "init"); }
+Counted& slotCounted() { return co_cls(Counted, 3); }
+
+TEST(CLS, coroutine)
+{
+    // 调度器在其他线程启动, 等P创建出来
+    while (co_sched.GetMetrics().processors.size() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    const int n = 100;
+    atomic<int> ok{0};
+    for (int i = 0; i < n; ++i)
+        go [&, i]{
+            EXPECT_EQ(slotInt(), 7);
+            EXPECT_EQ(slotStr(), "init");
+            slotInt() = i;
+            slotStr() = to_string(i);
+            co_yield;
+            if (slotInt() == i && slotStr() == to_string(i))
+                ++ok;
+        };
+    WaitUntilNoTask();
+    EXPECT_EQ(ok, n);
+}
+
+TEST(CLS, thread)
+{
+    // 不在协程中时每个线程一份
+    slotInt() = 100;
+    thread t([]{ EXPECT_EQ(slotInt(), 7); slotInt() = 1; });
+    t.join();
+    EXPECT_EQ(slotInt(), 100);
+}
+
+TEST(CLS, destroy)
+{
+    int before = Counted::alive;
+    go []{
+        EXPECT_EQ(slotCounted().v, 3);
+        slotCounted().v = 4;
+        EXPECT_EQ(slotCounted().v, 4);
+    };
+    WaitUntilNoTask();
+    // 协程结束回收后析构
+    for (int i = 0; i < 100 && Counted::alive != before; ++i)
+        usleep(1000);
+    EXPECT_EQ(Counted::alive, before);
+}
+
+TEST(CLS, overflow)
+{
+    // 超过内嵌槽位数的CLS放到overflow中
+    go []{
+        int & a = co_cls(int, 1);
+        int & b = co_cls(int, 2);
+        int & c = co_cls(int, 3);
+        int & d = co_cls(int, 4);
+        int & e = co_cls(int, 5);
+        string & f = co_cls(string, 64, 'x');
+        int* pe = &e;
+        EXPECT_EQ(a + b + c + d + e, 15);
+        EXPECT_EQ(f.size(), 64u);
+        co_yield;
+        EXPECT_EQ(pe, &e);
+    };
+    WaitUntilNoTask();
+}
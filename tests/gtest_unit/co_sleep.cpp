@@ -0,0 +1,64 @@
+#include <iostream>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#define TEST_MIN_THREAD 2
+#define TEST_MAX_THREAD 2
+#include "gtest_exit.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+// TEST_MIN_THREAD为2, Start(2)只创建一个P: 协程睡眠时不阻塞线程,
+// 1000个协程并发睡眠的总耗时约等于单次睡眠时长
+TEST(CoSleep, concurrent)
+{
+    // 等调度线程创建出P, 计时不包含启动
+    while (!g_Scheduler.ProcessorCount())
+        usleep(1000);
+
+    const int n = 1000;
+    std::atomic<int> done{0};
+    auto start = steady_clock::now();
+    for (int i = 0; i < n; ++i)
+        go [&]{
+            auto t = steady_clock::now();
+            co_sleep(100);
+            EXPECT_GE(duration_cast<milliseconds>(steady_clock::now() - t).count(), 100);
+            ++done;
+        };
+    WaitUntilNoTask();
+    auto cost = duration_cast<milliseconds>(steady_clock::now() - start).count();
+    EXPECT_EQ(done, n);
+    EXPECT_LT(cost, 1000);
+}
+
+TEST(CoSleep, forUntil)
+{
+    go []{
+        auto t = steady_clock::now();
+        co::sleep_for(microseconds(20500));
+        EXPECT_GE(duration_cast<microseconds>(steady_clock::now() - t).count(), 20500);
+
+        t = steady_clock::now();
+        co::sleep_until(t + milliseconds(30));
+        EXPECT_GE(duration_cast<milliseconds>(steady_clock::now() - t).count(), 30);
+
+        t = steady_clock::now();
+        co::sleep_until(system_clock::now() + milliseconds(30));
+        EXPECT_GE(duration_cast<milliseconds>(steady_clock::now() - t).count(), 29);
+
+        // 非正的时长相当于yield
+        co::sleep_for(milliseconds(0));
+        co::sleep_for(milliseconds(-5));
+        co::sleep_until(steady_clock::now() - seconds(1));
+    };
+    WaitUntilNoTask();
+}
+
+TEST(CoSleep, nativeThread)
+{
+    auto t = steady_clock::now();
+    co_sleep(20);
+    EXPECT_GE(duration_cast<milliseconds>(steady_clock::now() - t).count(), 20);
+}
@@ -0,0 +1,214 @@
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace std::chrono;
+using namespace co;
+
+struct Conn {
+    int id;
+    bool alive;
+};
+
+static std::atomic<int> gCreated{0};
+static std::atomic<int> gDeleted{0};
+
+static Conn* newConn()
+{
+    return new Conn{++gCreated, true};
+}
+
+static void deleteConn(Conn* c)
+{
+    ++gDeleted;
+    delete c;
+}
+
+typedef ConnectionPool<Conn> Pool;
+
+static void waitFor(std::function<bool()> const& pred, int timeoutMs)
+{
+    for (int i = 0; i < timeoutMs && !pred(); ++i)
+        usleep(1000);
+}
+
+TEST(ConnectionPool, getPutAcrossShards)
+{
+    gCreated = gDeleted = 0;
+    {
+        Pool pool(&newConn, &deleteConn, 8);
+
+        // 主线程预创建的连接放在主线程的分片里, 其他线程取的时候从这个分片偷
+        pool.Reserve(8);
+        EXPECT_EQ(pool.Count(), 8u);
+        EXPECT_EQ(pool.IdleCount(), 8u);
+
+        std::atomic<int> done{0};
+        std::atomic<int> nulls{0};
+        for (int i = 0; i < 200; ++i)
+            go [&]{
+                for (int k = 0; k < 10; ++k) {
+                    auto c = pool.Get();
+                    if (!c) ++nulls;
+                    co_yield;
+                }
+                ++done;
+            };
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+            threads.emplace_back([&]{
+                    for (int k = 0; k < 100; ++k) {
+                        auto c = pool.Get();
+                        if (!c) ++nulls;
+                    }
+                });
+        for (auto & t : threads)
+            t.join();
+        WaitUntilNoTask();
+
+        EXPECT_EQ(done, 200);
+        EXPECT_EQ(nulls, 0);
+        // 名额已满, 全部复用预创建的连接
+        EXPECT_EQ(gCreated, 8);
+        EXPECT_EQ(pool.Count(), 8u);
+        EXPECT_EQ(pool.IdleCount(), 8u);
+
+        auto stats = pool.GetStats();
+        EXPECT_EQ(stats.misses, 0u);
+        EXPECT_EQ(stats.hits, 200u * 10 + 4 * 100);
+    }
+    EXPECT_EQ(gDeleted, 8);
+}
+
+TEST(ConnectionPool, timedGetNative)
+{
+    gCreated = gDeleted = 0;
+    Pool pool(&newConn, &deleteConn, 1);
+    auto held = pool.Get();
+    ASSERT_TRUE(!!held);
+
+    // 原生线程上等待超时
+    GTimer gt;
+    std::thread([&]{
+            auto c = pool.Get(milliseconds(100));
+            EXPECT_FALSE(!!c);
+        }).join();
+    EXPECT_GE(gt.ms(), 99);
+    EXPECT_EQ(pool.GetStats().waitTimeouts, 1u);
+
+    // 等待期间有连接归还
+    std::atomic<bool> got{false};
+    std::thread t([&]{
+            auto c = pool.Get(seconds(3));
+            got = !!c;
+        });
+    usleep(50 * 1000);
+    EXPECT_FALSE(got);
+    held.reset();
+    t.join();
+    EXPECT_TRUE(got);
+    EXPECT_EQ(gCreated, 1);
+    EXPECT_GE(pool.GetStats().waits, 2u);
+}
+
+TEST(ConnectionPool, unlimited)
+{
+    gCreated = gDeleted = 0;
+    {
+        // maxConnection为0表示不限数量, 空闲连接数也不限
+        Pool pool(&newConn, &deleteConn, 0);
+        std::vector<Pool::ConnectionPtr> conns;
+        for (int i = 0; i < 1000; ++i) {
+            conns.push_back(pool.Get(milliseconds(10)));
+            EXPECT_TRUE(!!conns.back());
+        }
+        EXPECT_EQ(pool.Count(), 1000u);
+        EXPECT_EQ(pool.GetStats().waits, 0u);
+
+        conns.clear();
+        EXPECT_EQ(pool.IdleCount(), 1000u);
+        EXPECT_EQ(gDeleted, 0);
+    }
+    EXPECT_EQ(gDeleted, 1000);
+}
+
+TEST(ConnectionPool, factoryReturnsNull)
+{
+    gCreated = gDeleted = 0;
+    std::atomic<bool> fail{true};
+    Pool pool([&]{ return fail ? (Conn*)nullptr : newConn(); }, &deleteConn, 1);
+
+    // 创建失败时归还名额, 不会占满连接池
+    for (int i = 0; i < 3; ++i) {
+        auto c = pool.Get(milliseconds(10));
+        EXPECT_FALSE(!!c);
+        EXPECT_EQ(pool.Count(), 0u);
+    }
+    pool.Reserve(1);
+    EXPECT_EQ(pool.Count(), 0u);
+    EXPECT_EQ(pool.IdleCount(), 0u);
+
+    // 工厂恢复后正常创建, 池满时等待的协程在连接归还后取到
+    fail = false;
+    auto held = pool.Get();
+    ASSERT_TRUE(!!held);
+    std::atomic<int> got{0};
+    go [&]{
+        auto c = pool.Get(seconds(3));
+        if (c) ++got;
+    };
+    usleep(20 * 1000);
+    held.reset();
+    WaitUntilNoTask();
+    EXPECT_EQ(got, 1);
+    EXPECT_EQ(pool.GetStats().misses, 1u);
+}
+
+TEST(ConnectionPool, maintenance)
+{
+    gCreated = gDeleted = 0;
+    Pool pool(&newConn, &deleteConn, 10);
+    pool.Reserve(10);
+    {
+        // 标记一半连接失效
+        std::vector<Pool::ConnectionPtr> conns;
+        for (int i = 0; i < 10; ++i)
+            conns.push_back(pool.Get());
+        for (int i = 0; i < 5; ++i)
+            conns[i]->alive = false;
+    }
+    EXPECT_EQ(pool.IdleCount(), 10u);
+
+    // 空闲超过一个周期的连接做健康检查, 失效的被销毁
+    pool.StartMaintenance(milliseconds(20), [](Conn* c){ return c->alive; });
+    waitFor([&]{ return pool.GetStats().evictedUnhealthy >= 5; }, 3000);
+    EXPECT_EQ(pool.GetStats().evictedUnhealthy, 5u);
+    EXPECT_EQ(pool.Count(), 5u);
+    EXPECT_EQ(pool.IdleCount(), 5u);
+    EXPECT_EQ(gDeleted, 5);
+    EXPECT_GE(pool.GetStats().healthChecks, 10u);
+
+    // 停止后不再检查
+    pool.StopMaintenance();
+    uint64_t checks = pool.GetStats().healthChecks;
+    usleep(100 * 1000);
+    EXPECT_EQ(pool.GetStats().healthChecks, checks);
+
+    // 空闲超时淘汰, 借出中的连接不受影响
+    pool.StartMaintenance(milliseconds(20), NULL, milliseconds(100));
+    auto fresh = pool.Get();
+    waitFor([&]{ return pool.GetStats().evictedIdle >= 4; }, 3000);
+    EXPECT_EQ(pool.GetStats().evictedIdle, 4u);
+    EXPECT_EQ(pool.IdleCount(), 0u);
+    EXPECT_EQ(pool.Count(), 1u);
+    pool.StopMaintenance();
+    fresh.reset();
+    EXPECT_EQ(pool.IdleCount(), 1u);
+    EXPECT_EQ(pool.GetStats().healthChecks, checks);
+}
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+#include <atomic>
+#include <set>
+#include <mutex>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+static std::vector<uint64_t> tasksAdded()
+{
+    std::vector<uint64_t> v;
+    for (auto const& p : co_sched.GetMetrics().processors)
+        v.push_back(p.tasksAdded);
+    return v;
+}
+
+TEST(CreateTasks, indexAndId)
+{
+    while (co_sched.GetMetrics().processors.size() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    // 超过单个P的投递队列容量(1024), 多出的部分走newQueue_
+    const std::size_t n = 10000;
+    std::vector<std::atomic<int>> hits(n);
+    std::mutex mtx;
+    std::set<uint64_t> ids;
+    auto before = tasksAdded();
+    co_sched.CreateTasks(n, [&](std::size_t i) {
+        ++hits[i];
+        std::unique_lock<std::mutex> lock(mtx);
+        ids.insert(co_sched.GetCurrentTaskID());
+    });
+    WaitUntilNoTask();
+
+    int wrong = 0;
+    for (auto & h : hits)
+        if (h != 1) ++wrong;
+    EXPECT_EQ(wrong, 0);
+
+    // 协程ID一次分配, 是连续的
+    ASSERT_EQ(ids.size(), n);
+    EXPECT_EQ(*ids.rbegin() - *ids.begin(), n - 1);
+
+    // 按段(不超过1024个)轮流分给各P, 每个P分到的数量最多相差一段
+    auto after = tasksAdded();
+    for (std::size_t i = 0; i < before.size(); ++i) {
+        EXPECT_GE(after[i] - before[i], n / before.size() - 1024);
+    }
+}
+
+TEST(CreateTasks, processor)
+{
+    const std::size_t n = 2000;
+    std::atomic<int> wrong{0}, done{0};
+    TaskOpt opt;
+    opt.processor_ = 1;
+    co_sched.CreateTasks(n, [&](std::size_t) {
+        for (int j = 0; j < 3; ++j) {
+            if (Processor::GetCurrentProcessor()->Id() != 1)
+                ++wrong;
+            co_yield;
+        }
+        ++done;
+    }, opt);
+    WaitUntilNoTask();
+    EXPECT_EQ(done, (int)n);
+    EXPECT_EQ(wrong, 0);
+}
+
+TEST(CreateTasks, empty)
+{
+    std::atomic<int> done{0};
+    co_sched.CreateTasks(0, [&](std::size_t) { ++done; });
+    WaitUntilNoTask();
+    EXPECT_EQ(done, 0);
+}
+
+static std::size_t& slotIndex() { return co_cls(std::size_t, 0); }
+
+TEST(CreateTasks, slab)
+{
+    // 同一段的Task对象连续分配, 协程本地存储各自独立
+    const std::size_t n = 3000;
+    std::atomic<int> wrong{0}, done{0};
+    co_chan<void> release(n);
+    co_sched.CreateTasks(n, [&](std::size_t i) {
+        slotIndex() = i;
+        co_yield;
+        // 部分协程晚于同段的其他协程结束, 其他Task析构后它们仍然有效
+        if (i % 1024 == 0)
+            release >> nullptr;
+        if (slotIndex() != i)
+            ++wrong;
+        ++done;
+    });
+    while (done < (int)(n - (n + 1023) / 1024))
+        usleep(1000);
+    for (std::size_t i = 0; i < (n + 1023) / 1024; ++i)
+        release << nullptr;
+    WaitUntilNoTask();
+    EXPECT_EQ(done, (int)n);
+    EXPECT_EQ(wrong, 0);
+    EXPECT_EQ(co_sched.TaskCount(), 0u);
+}
@@ -0,0 +1,116 @@
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+#include <gtest/gtest.h>
+#define TEST_MIN_THREAD 2
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+static uint64_t switches()
+{
+    uint64_t n = 0;
+    for (auto const& p : co_sched.GetMetrics().processors)
+        n += p.switches;
+    return n;
+}
+
+// 单个P上3个协程交替yield, 记录执行顺序
+static vector<int> yieldOrder(bool direct)
+{
+    co_opt.enable_direct_switch = direct;
+    vector<int> order;
+    co_mutex mtx;
+    mtx.lock();
+    for (int i = 0; i < 3; ++i)
+        go [&, i]{
+            mtx.lock();
+            mtx.unlock();
+            for (int j = 0; j < 5; ++j) {
+                order.push_back(i);
+                co_yield;
+            }
+        };
+    // 3个协程都进入队列后再开始
+    usleep(20 * 1000);
+    mtx.unlock();
+    WaitUntilNoTask();
+    co_opt.enable_direct_switch = true;
+    return order;
+}
+
+TEST(DirectSwitch, yield)
+{
+    // 调度器在其他线程启动, 等P创建出来
+    while (co_sched.GetMetrics().processors.size() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    vector<int> a = yieldOrder(false);
+    vector<int> b = yieldOrder(true);
+    EXPECT_EQ(a.size(), 15u);
+    EXPECT_EQ(a, b);
+    for (size_t i = 3; i < b.size(); ++i) {
+        EXPECT_EQ(b[i], b[i - 3]);
+    }
+}
+
+TEST(DirectSwitch, channel)
+{
+    const int n = 10000;
+    for (bool direct : {false, true}) {
+        co_opt.enable_direct_switch = direct;
+        uint64_t before = switches();
+        long sum = 0;
+        co_chan<int> ping, pong;
+        go [=]{
+            for (int i = 0; i < n; ++i) {
+                ping << i;
+                int v;
+                pong >> v;
+            }
+        };
+        go [=, &sum]{
+            for (int i = 0; i < n; ++i) {
+                int v;
+                ping >> v;
+                sum += v;
+                pong << v;
+            }
+        };
+        WaitUntilNoTask();
+        EXPECT_EQ(sum, (long)n * (n - 1) / 2);
+        // 每个来回至少两次切换, 直接切换也计入调度次数
+        EXPECT_GE(switches() - before, (uint64_t)n * 2);
+    }
+    co_opt.enable_direct_switch = true;
+}
+
+TEST(DirectSwitch, mixed)
+{
+    // 混合sleep/mutex/yield, 其中一个协程长时间占用P, 其余协程被调度线程steal到其他P
+    const int n = 200;
+    atomic<int> done{0};
+    long counter = 0;
+    co_mutex mtx;
+    go []{
+        auto start = chrono::steady_clock::now();
+        while (chrono::steady_clock::now() - start < chrono::milliseconds(300)) ;
+    };
+    for (int i = 0; i < n; ++i)
+        go [&, i]{
+            for (int j = 0; j < 200; ++j) {
+                std::unique_lock<co_mutex> lock(mtx);
+                ++counter;
+                lock.unlock();
+                if ((i + j) % 50 == 0)
+                    co_sleep(1);
+                else
+                    co_yield;
+            }
+            ++done;
+        };
+    WaitUntilNoTask();
+    EXPECT_EQ(done, n);
+    EXPECT_EQ(counter, n * 200);
+}
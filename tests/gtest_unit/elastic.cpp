@@ -0,0 +1,201 @@
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <time.h>
+#include <sys/syscall.h>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+// 直接发起系统调用, 不经过hook, 阻塞整个P线程
+static void blockThread(int ms)
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    syscall(SYS_nanosleep, &ts, nullptr);
+}
+
+static void liveAndSlots(Scheduler* sched, std::size_t & live, std::size_t & slots)
+{
+    auto metrics = sched->GetMetrics();
+    slots = metrics.processors.size();
+    live = 0;
+    for (auto & p : metrics.processors)
+        if (!p.retired)
+            ++live;
+}
+
+static bool waitLive(Scheduler* sched, std::size_t expect, int timeoutMs)
+{
+    std::size_t live, slots;
+    for (int i = 0; i < timeoutMs; ++i) {
+        liveAndSlots(sched, live, slots);
+        if (live == expect)
+            return true;
+        usleep(1000);
+    }
+    return false;
+}
+
+// 阻塞n个P线程ms毫秒, 等全部结束
+static void blockingBurst(Scheduler* sched, int n, int ms)
+{
+    std::atomic<int> done{0};
+    for (int i = 0; i < n; ++i)
+        go co_scheduler(sched) [&]{ blockThread(ms); ++done; };
+    while (done < n)
+        usleep(1000);
+}
+
+TEST(Elastic, burstAndRecovery)
+{
+    uint32_t retireUs = co_opt.processor_idle_retire_us;
+    co_opt.processor_idle_retire_us = 50 * 1000;
+
+    // Start(3, 8)创建2个P, 最多扩展到8个
+    Scheduler* sched = Scheduler::Create();
+    sched->goStart(3, 8);
+    ASSERT_TRUE(waitLive(sched, 2, 5000));
+
+    blockingBurst(sched, 6, 400);
+    std::size_t live, slots;
+    liveAndSlots(sched, live, slots);
+    EXPECT_GT(slots, 2u);
+    std::size_t peak = slots;
+
+    // 空闲后扩展出来的P逐个退休, 回到Start时的数量
+    EXPECT_TRUE(waitLive(sched, 2, 5000));
+    uint64_t retires = 0;
+    for (auto & p : sched->GetMetrics().processors)
+        retires += p.retires;
+    // 阈值很短, 阻塞期间空出来的P也可能先退休再被复用
+    EXPECT_GE(retires, peak - 2);
+
+    // 退休后仍然可以正常调度
+    std::atomic<int> ran{0};
+    for (int i = 0; i < 100; ++i)
+        go co_scheduler(sched) [&]{ co_yield; ++ran; };
+    while (ran < 100)
+        usleep(1000);
+
+    // 再次扩展时复用退休的P, 不新增
+    blockingBurst(sched, 6, 400);
+    liveAndSlots(sched, live, slots);
+    EXPECT_LE(slots, (std::max)(peak, (std::size_t)8));
+    EXPECT_TRUE(waitLive(sched, 2, 5000));
+
+    co_opt.processor_idle_retire_us = retireUs;
+}
+
+TEST(Elastic, retiredProcessorReroutes)
+{
+    uint32_t retireUs = co_opt.processor_idle_retire_us;
+    co_opt.processor_idle_retire_us = 20 * 1000;
+
+    Scheduler* sched = Scheduler::Create();
+    sched->goStart(2, 4);
+    ASSERT_TRUE(waitLive(sched, 1, 5000));
+
+    blockingBurst(sched, 3, 300);
+    std::size_t live, slots;
+    liveAndSlots(sched, live, slots);
+    ASSERT_GT(slots, 1u);
+    ASSERT_TRUE(waitLive(sched, 1, 5000));
+
+    // 指定给已退休P的协程转交其他P执行
+    std::atomic<int> ran{0};
+    for (int i = 0; i < 10; ++i)
+        go co_scheduler(sched) co_processor((int)slots - 1) [&]{ ++ran; };
+    for (int i = 0; i < 5000 && ran < 10; ++i)
+        usleep(1000);
+    EXPECT_EQ(ran, 10);
+
+    co_opt.processor_idle_retire_us = retireUs;
+}
+
+TEST(Elastic, suspendedTasksKeepProcessor)
+{
+    uint32_t retireUs = co_opt.processor_idle_retire_us;
+    co_opt.processor_idle_retire_us = 20 * 1000;
+
+    Scheduler* sched = Scheduler::Create();
+    sched->goStart(2, 4);
+    ASSERT_TRUE(waitLive(sched, 1, 5000));
+
+    // 扩展出来的P上挂起的协程会被唤醒回原P, 这样的P不退休
+    co_chan<int> ch;
+    std::atomic<int> blocked{0};
+    go co_scheduler(sched) [&]{ ++blocked; blockThread(300); };
+    while (!blocked)
+        usleep(1000);
+    std::atomic<int> got{0};
+    for (int i = 0; i < 4; ++i)
+        go co_scheduler(sched) [&]{ int v; ch >> v; got += v; };
+
+    // 挂起期间空闲时间早已超过退休时长, 持有挂起协程的P都没有退休
+    usleep(300 * 1000);
+    uint64_t suspended = 0;
+    for (auto & p : sched->GetMetrics().processors) {
+        suspended += p.blocked;
+        if (p.blocked)
+            EXPECT_FALSE(p.retired);
+    }
+    EXPECT_EQ(suspended, 4u);
+
+    for (int i = 0; i < 4; ++i)
+        ch << 1;
+    for (int i = 0; i < 5000 && got < 4; ++i)
+        usleep(1000);
+    EXPECT_EQ(got, 4);
+    EXPECT_TRUE(waitLive(sched, 1, 5000));
+
+    co_opt.processor_idle_retire_us = retireUs;
+}
+
+TEST(Elastic, tasksBeforeStart)
+{
+    // Start创建出第一个P之前加入的协程先暂存, 之后交给第一个P执行
+    Scheduler* sched = Scheduler::Create();
+    std::atomic<int> ran{0};
+    for (int i = 0; i < 100; ++i)
+        go co_scheduler(sched) [&]{ co_yield; ++ran; };
+    for (int i = 0; i < 10; ++i)
+        go co_scheduler(sched) co_processor(i) [&]{ ++ran; };
+    usleep(10 * 1000);
+    EXPECT_EQ(ran, 0);
+
+    sched->goStart(2, 2);
+    for (int i = 0; i < 5000 && ran < 110; ++i)
+        usleep(1000);
+    EXPECT_EQ(ran, 110);
+}
+
+TEST(Elastic, concurrentDeque)
+{
+    ConcurrentDeque<std::size_t> dq;
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> errors{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&]{
+                while (!stop) {
+                    std::size_t n = dq.size();
+                    for (std::size_t i = 0; i < n; ++i)
+                        if (dq[i] != i * 3)
+                            ++errors;
+                }
+            });
+    }
+
+    const std::size_t n = 20000;
+    for (std::size_t i = 0; i < n; ++i)
+        dq.push_back(i * 3);
+    stop = true;
+    for (auto & t : readers)
+        t.join();
+    EXPECT_EQ(errors, 0u);
+    EXPECT_EQ(dq.size(), n);
+}
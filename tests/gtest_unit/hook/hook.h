@@ -26,7 +26,7 @@ inline T* getHookVal(T t, int line) {
 
 #define HOOK_EQ(x) do { \
         CHECK_POINT(); \
-        if (!::co::Processer::IsCoroutine()) { \
+        if (!::co::Processor::IsCoroutine()) { \
             setHookVal(x, __LINE__); \
         } else { \
             auto ptr = getHookVal(x, __LINE__); \
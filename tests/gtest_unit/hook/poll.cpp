@@ -101,7 +101,7 @@ void timeoutIs0()
         HOOK_EQ(pfds[1].revents);
     }
 
-    if (Processer::IsCoroutine()) {
+    if (Processor::IsCoroutine()) {
         EXPECT_EQ(g_Scheduler.GetCurrentTaskYieldCount(), yc);
     }
 
@@ -122,7 +122,7 @@ void timeoutIs0()
         HOOK_EQ(pfds[1].revents);
     }
 
-    if (Processer::IsCoroutine()) {
+    if (Processor::IsCoroutine()) {
         EXPECT_EQ(g_Scheduler.GetCurrentTaskYieldCount(), yc);
     }
     EXPECT_EQ(close(fds[1]), 0);
@@ -270,7 +270,7 @@ void timeoutIs1()
         HOOK_EQ(n);
         HOOK_EQ(pfds[0].revents);
         HOOK_EQ(pfds[1].revents);
-        //            printf("tk(%s) poll cost %d ms\n", co::Processer::GetCurrentTask()->DebugInfo(), gtx.ms());
+        //            printf("tk(%s) poll cost %d ms\n", co::Processor::GetCurrentTask()->DebugInfo(), gtx.ms());
         //            co_sleep(50);
         //            exit(1);
         TIMER_CHECK(gt, 200, 50);
@@ -367,7 +367,7 @@ void timeoutIs1()
         GTimer gt;
         auto yc = g_Scheduler.GetCurrentTaskYieldCount();
         int n = poll(pfds, 1, 300);
-        if (Processer::IsCoroutine()) {
+        if (Processor::IsCoroutine()) {
             EXPECT_EQ(g_Scheduler.GetCurrentTaskYieldCount(), yc + 1);
         }
         TIMER_CHECK(gt, 300, 50);
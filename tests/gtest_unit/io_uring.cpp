@@ -0,0 +1,150 @@
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#include "netio/IoUring.h"
+#include "gtest_exit.h"
+using namespace std;
+
+// co::read等与::read同名, 这里不using namespace co
+
+static bool uringAvailable()
+{
+    bool res = false;
+    go [&]{ res = !!co::IoUring::Current(); };
+    WaitUntilNoTask();
+    return res;
+}
+
+TEST(IoUring, file)
+{
+    if (!uringAvailable())
+        cout << "io_uring not available, run fallback path" << endl;
+
+    char path[] = "./io_uring_test.XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    unlink(path);
+
+    go [=]{
+        // 当前位置写, 指定偏移写
+        EXPECT_EQ(co::write(fd, "hello ", 6), 6);
+        EXPECT_EQ(co::write(fd, "world", 5, 6), 5);
+        EXPECT_EQ(co::fsync(fd), 0);
+
+        char buf[16] = {};
+        EXPECT_EQ(co::read(fd, buf, sizeof(buf), 0), 11);
+        EXPECT_STREQ(buf, "hello world");
+
+        char a[5] = {}, b[6] = {};
+        struct iovec iov[2] = { {a, 4}, {b, 5} };
+        EXPECT_EQ(co::readv(fd, iov, 2, 2), 9);
+        EXPECT_EQ(string(a), "llo ");
+        EXPECT_EQ(string(b), "world");
+
+        struct iovec wiov[2] = { {(void*)"ab", 2}, {(void*)"cd", 2} };
+        EXPECT_EQ(co::writev(fd, wiov, 2, 0), 4);
+        EXPECT_EQ(co::read(fd, buf, 4, 0), 4);
+        EXPECT_EQ(string(buf, 4), "abcd");
+
+        EXPECT_EQ(co::read(-1, buf, 4), -1);
+        EXPECT_EQ(errno, EBADF);
+    };
+    WaitUntilNoTask();
+    close(fd);
+}
+
+TEST(IoUring, socket)
+{
+    // 阻塞和非阻塞socket都应表现为阻塞语义
+    for (int nonblock = 0; nonblock < 2; ++nonblock) {
+        int fds[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        if (nonblock) {
+            fcntl(fds[0], F_SETFL, O_NONBLOCK);
+            fcntl(fds[1], F_SETFL, O_NONBLOCK);
+        }
+
+        const int n = 100;
+        go [=]{
+            char buf[8];
+            for (int i = 0; i < n; ++i) {
+                ASSERT_EQ(co::read(fds[0], buf, sizeof(buf)), (ssize_t)sizeof(buf));
+                ASSERT_EQ(co::write(fds[0], buf, sizeof(buf)), (ssize_t)sizeof(buf));
+            }
+        };
+        go [=]{
+            char buf[8];
+            for (int i = 0; i < n; ++i) {
+                memset(buf, i, sizeof(buf));
+                ASSERT_EQ(co::write(fds[1], buf, sizeof(buf)), (ssize_t)sizeof(buf));
+                memset(buf, 0, sizeof(buf));
+                ASSERT_EQ(co::read(fds[1], buf, sizeof(buf)), (ssize_t)sizeof(buf));
+                EXPECT_EQ(buf[7], (char)i);
+            }
+        };
+        WaitUntilNoTask();
+        close(fds[0]);
+        close(fds[1]);
+    }
+}
+
+TEST(IoUring, acceptConnect)
+{
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(lfd, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    ASSERT_EQ(::bind(lfd, (sockaddr*)&addr, sizeof(addr)), 0);
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(getsockname(lfd, (sockaddr*)&addr, &len), 0);
+    ASSERT_EQ(listen(lfd, 16), 0);
+
+    go [=]{
+        sockaddr_in peer;
+        socklen_t plen = sizeof(peer);
+        int fd = co::accept(lfd, (sockaddr*)&peer, &plen, SOCK_CLOEXEC);
+        ASSERT_GE(fd, 0);
+        EXPECT_EQ(plen, sizeof(peer));
+        char buf[4];
+        EXPECT_EQ(co::read(fd, buf, 4), 4);
+        EXPECT_EQ(string(buf, 4), "ping");
+        close(fd);
+    };
+    go [=]{
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_GE(fd, 0);
+        EXPECT_EQ(co::connect(fd, (const sockaddr*)&addr, sizeof(addr)), 0);
+        EXPECT_EQ(co::write(fd, "ping", 4), 4);
+        close(fd);
+    };
+    WaitUntilNoTask();
+    close(lfd);
+}
+
+TEST(IoUring, many)
+{
+    // 超过ring大小的并发请求
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    const int n = 1000;
+    std::atomic<int> done{0};
+    for (int i = 0; i < n; ++i)
+        go [&]{
+            char c;
+            if (co::read(fds[0], &c, 1) == 1)
+                ++done;
+        };
+    go [&]{
+        for (int i = 0; i < n; ++i)
+            co::write(fds[1], "x", 1);
+    };
+    WaitUntilNoTask();
+    EXPECT_EQ(done, n);
+    close(fds[0]);
+    close(fds[1]);
+}
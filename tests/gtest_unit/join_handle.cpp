@@ -0,0 +1,120 @@
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+TEST(JoinHandle, fromThread)
+{
+    while (co_sched.GetMetrics().processors.size() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    auto h = co::spawn([]{ co_sleep(10); return 42; });
+    EXPECT_TRUE(h.valid());
+    EXPECT_EQ(h.get(), 42);
+    EXPECT_FALSE(h.valid());
+}
+
+TEST(JoinHandle, fromCoroutine)
+{
+    std::atomic<int> sum{0};
+    co_wait_group wg;
+    wg.add(10);
+    for (int i = 0; i < 10; ++i) {
+        go [&, i]{
+            // 协程中get()只挂起当前协程
+            auto h = co::spawn([i]{ co_yield; return i * 2; });
+            sum += h.get();
+            wg.done();
+        };
+    }
+    wg.wait();
+    EXPECT_EQ(sum, 90);
+}
+
+TEST(JoinHandle, voidAndException)
+{
+    std::atomic<int> ran{0};
+    co::JoinHandle<void> h = co::spawn([&]{ ++ran; });
+    h.get();
+    EXPECT_EQ(ran, 1);
+
+    auto e = co::spawn([]() -> int { throw std::runtime_error("boom"); });
+    EXPECT_THROW(e.get(), std::runtime_error);
+}
+
+TEST(JoinHandle, moveOnly)
+{
+    co::Future<std::unique_ptr<int>> h = co::spawn([]{ return std::unique_ptr<int>(new int(7)); });
+    std::unique_ptr<int> p = h.get();
+    ASSERT_TRUE(!!p);
+    EXPECT_EQ(*p, 7);
+}
+
+TEST(JoinHandle, whenAll)
+{
+    std::vector<co::JoinHandle<int>> hs;
+    for (int i = 0; i < 100; ++i)
+        hs.push_back(co::spawn([i]{ co_yield; return i; }));
+    co::when_all(hs);
+    int sum = 0;
+    for (auto & h : hs) {
+        EXPECT_TRUE(h.ready());
+        sum += h.get();
+    }
+    EXPECT_EQ(sum, 4950);
+
+    auto a = co::spawn([]{ return 1; });
+    auto b = co::spawn([]{ return std::string("x"); });
+    co::when_all(a, b);
+    EXPECT_TRUE(a.ready() && b.ready());
+}
+
+TEST(JoinHandle, whenAny)
+{
+    co_latch gate(1);
+    auto slow = co::spawn([&]{ gate.wait(); return 1; });
+    auto fast = co::spawn([]{ return 2; });
+    EXPECT_EQ(co::when_any(slow, fast), 1u);
+    EXPECT_FALSE(slow.ready());
+    gate.count_down();
+    EXPECT_EQ(slow.get(), 1);
+
+    // 在协程中等待
+    std::atomic<int> idx{-1};
+    co_wait_group wg;
+    wg.add(1);
+    go [&]{
+        std::vector<co::JoinHandle<int>> hs;
+        hs.push_back(co::spawn([]{ co_sleep(200); return 0; }));
+        hs.push_back(co::spawn([]{ co_sleep(5); return 1; }));
+        idx = (int)co::when_any(hs);
+        wg.done();
+    };
+    wg.wait();
+    EXPECT_EQ(idx, 1);
+}
+
+TEST(JoinHandle, sharedStack)
+{
+    co::TaskOpt opt;
+    opt.shared_stack_ = true;
+    std::vector<co::JoinHandle<int>> hs;
+    for (int i = 0; i < 100; ++i) {
+        hs.push_back(co::spawn(opt, [i]{
+            // 共享栈协程中等待其他协程
+            auto inner = co::spawn([i]{ co_yield; return i; });
+            return inner.get() + 1;
+        }));
+    }
+    int sum = 0;
+    for (auto & h : hs)
+        sum += h.get();
+    EXPECT_EQ(sum, 5050);
+}
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <unistd.h>
+#include <string>
+#include <gtest/gtest.h>
+#define TEST_MIN_THREAD 2
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+TEST(Metrics, histogram)
+{
+    for (uint64_t v : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 1000ull, 123456789ull, ~0ull}) {
+        int idx = LatencyHistogram::BucketOf(v);
+        EXPECT_LT(idx, LatencyHistogram::kBuckets);
+        EXPECT_GE(LatencyHistogram::BucketUpperBound(idx), v);
+        if (idx > 0) {
+            EXPECT_LT(LatencyHistogram::BucketUpperBound(idx - 1), v);
+        }
+    }
+
+    LatencyHistogram h;
+    for (uint64_t v = 1; v <= 1000; ++v)
+        h.Record(v * 1000);
+    HistogramSnapshot s(h);
+    EXPECT_EQ(s.count, 1000u);
+    EXPECT_EQ(s.max, 1000000u);
+    EXPECT_EQ(s.sum, 500500000u);
+
+    // 相对误差不超过1/8
+    uint64_t p50 = s.Percentile(0.5);
+    EXPECT_GE(p50, 500000u);
+    EXPECT_LE(p50, 500000u * 9 / 8);
+    EXPECT_EQ(s.Percentile(1.0), 1000000u);
+    EXPECT_EQ(s.CountBelow(~0ull), 1000u);
+
+    HistogramSnapshot m;
+    m.Merge(s);
+    m.Merge(s);
+    EXPECT_EQ(m.count, 2000u);
+    EXPECT_EQ(m.Percentile(0.5), p50);
+}
+
+TEST(Metrics, scheduler)
+{
+    // 调度器在其他线程启动, 等P创建出来
+    while (co_sched.GetMetrics().processors.size() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    co_opt.enable_metrics = true;
+    SchedulerMetrics before = co_sched.GetMetrics();
+
+    const int n = 100;
+    co_wait_group wg;
+    wg.add(n);
+    for (int i = 0; i < n; ++i)
+        go [&]{
+            co_yield;
+            co_sleep(1);
+            wg.done();
+        };
+    wg.wait();
+    WaitUntilNoTask();
+    co_opt.enable_metrics = false;
+
+    SchedulerMetrics after = co_sched.GetMetrics();
+    ASSERT_FALSE(after.processors.empty());
+    uint64_t added = 0, switches = 0, suspends = 0, wakeups = 0;
+    for (size_t i = 0; i < after.processors.size(); ++i) {
+        ProcessorMetricsSnapshot const& p = after.processors[i];
+        ProcessorMetricsSnapshot b;
+        if (i < before.processors.size())
+            b = before.processors[i];
+        added += p.tasksAdded - b.tasksAdded;
+        switches += p.switches - b.switches;
+        suspends += p.suspends - b.suspends;
+        wakeups += p.wakeups - b.wakeups;
+    }
+    EXPECT_GE(added, (uint64_t)n);
+    EXPECT_GE(switches, (uint64_t)n * 3);
+    EXPECT_GE(suspends, (uint64_t)n);
+    EXPECT_GE(wakeups, (uint64_t)n);
+    EXPECT_GE(after.createToRun.count - before.createToRun.count, (uint64_t)n);
+    EXPECT_GE(after.wakeupToRun.count - before.wakeupToRun.count, (uint64_t)n);
+    EXPECT_GE(after.runSlice.count - before.runSlice.count, (uint64_t)n * 3);
+}
+
+TEST(Metrics, prometheus)
+{
+    string text;
+    ExportMetrics(co_sched, [&](string const& s) { text = s; });
+    EXPECT_NE(text.find("# TYPE libgo_processor_switches_total counter"), string::npos);
+    EXPECT_NE(text.find("libgo_processor_switches_total{processor=\"0\"} "), string::npos);
+    EXPECT_NE(text.find("# TYPE libgo_wakeup_to_run_seconds histogram"), string::npos);
+    EXPECT_NE(text.find("libgo_wakeup_to_run_seconds_bucket{processor=\"0\",le=\"1e-06\"} "), string::npos);
+    EXPECT_NE(text.find("libgo_run_slice_seconds_bucket{processor=\"0\",le=\"+Inf\"} "), string::npos);
+    EXPECT_NE(text.find("libgo_run_slice_seconds_count{processor=\"0\"} "), string::npos);
+
+    string path = "/tmp/libgo_metrics_test.prom";
+    ASSERT_TRUE(ExportMetrics(co_sched, path));
+    FILE* fp = fopen(path.c_str(), "r");
+    ASSERT_TRUE(!!fp);
+    char buf[128] = {};
+    EXPECT_TRUE(!!fgets(buf, sizeof(buf), fp));
+    EXPECT_EQ(string(buf).find("# HELP libgo_tasks"), 0u);
+    fclose(fp);
+    unlink(path.c_str());
+}
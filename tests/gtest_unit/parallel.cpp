@@ -0,0 +1,158 @@
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <random>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+static void waitProcessors()
+{
+    while (co_sched.GetMetrics().processors.size() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+}
+
+TEST(Parallel, forEachIndexOnce)
+{
+    waitProcessors();
+
+    const int n = 100000;
+    std::vector<std::atomic<int>> hits(n);
+    for (auto & h : hits) h = 0;
+
+    co::parallel_for(0, n, 100, [&](int i){ ++hits[i]; });
+    for (int i = 0; i < n; ++i)
+        ASSERT_EQ(hits[i], 1) << i;
+
+    // 自动grain, 非零起点
+    std::atomic<long> sum{0};
+    co::parallel_for(-500L, 500L, [&](long i){ sum += i; });
+    EXPECT_EQ(sum, -500);
+
+    // 空区间和单个元素
+    int calls = 0;
+    co::parallel_for(5, 5, 1, [&](int){ ++calls; });
+    co::parallel_for(5, 6, 1, [&](int){ ++calls; });
+    EXPECT_EQ(calls, 1);
+}
+
+TEST(Parallel, usesManyProcessors)
+{
+    std::mutex mtx;
+    std::set<std::thread::id> threads;
+    co::parallel_for(0, 64, 1, [&](int){
+        // 每段都足够长, 空闲的P都会认领到
+        usleep(2000);
+        std::lock_guard<std::mutex> lock(mtx);
+        threads.insert(std::this_thread::get_id());
+    });
+    EXPECT_GE(threads.size(), 2u);
+}
+
+TEST(Parallel, reduce)
+{
+    const long n = 1000000;
+    long sum = co::parallel_reduce(0L, n, 1000, 0L,
+            [](long i){ return i; },
+            [](long a, long b){ return a + b; });
+    EXPECT_EQ(sum, n * (n - 1) / 2);
+
+    long maxv = co::parallel_reduce(0, 10000, (long)-1,
+            [](int i){ return (long)((i * 7919) % 10007); },
+            [](long a, long b){ return (std::max)(a, b); });
+    EXPECT_EQ(maxv, 10006);
+
+    EXPECT_EQ(co::parallel_reduce(3, 3, 42, [](int i){ return i; }, [](int a, int b){ return a + b; }), 42);
+}
+
+TEST(Parallel, sort)
+{
+    std::mt19937 rng(12345);
+    std::vector<int> v(300000);
+    for (auto & x : v) x = (int)(rng() % 100000);
+    std::vector<int> expect = v;
+    std::sort(expect.begin(), expect.end());
+
+    co::parallel_sort(v.begin(), v.end());
+    EXPECT_TRUE(v == expect);
+
+    // 大量重复元素, 降序比较, 小grain
+    std::vector<int> d(100000);
+    for (auto & x : d) x = (int)(rng() % 3);
+    co::parallel_sort(d.begin(), d.end(), 64, std::greater<int>());
+    EXPECT_TRUE(std::is_sorted(d.begin(), d.end(), std::greater<int>()));
+
+    // 已有序和全部相等
+    std::vector<int> s(50000, 7);
+    co::parallel_sort(s.begin(), s.end(), 128, std::less<int>());
+    EXPECT_TRUE(std::is_sorted(s.begin(), s.end()));
+    for (int i = 0; i < (int)s.size(); ++i) s[i] = i;
+    co::parallel_sort(s.begin(), s.end(), 128, std::less<int>());
+    EXPECT_TRUE(std::is_sorted(s.begin(), s.end()));
+}
+
+TEST(Parallel, exceptionPropagates)
+{
+    std::atomic<int> ran{0};
+    EXPECT_THROW(co::parallel_for(0, 100000, 10, [&](int i){
+                ++ran;
+                if (i == 5000) throw std::runtime_error("fail");
+            }), std::runtime_error);
+    // 出错后其余的段不再执行
+    EXPECT_LT(ran, 100000);
+}
+
+TEST(Parallel, insideCoroutine)
+{
+    // 协程中调用: 调用者参与执行, 等待时不阻塞所在的P
+    const int kCallers = 8;
+    std::atomic<int> ok{0};
+    std::atomic<long> side{0};
+    co_wait_group wg;
+    wg.add(kCallers + 1);
+    for (int c = 0; c < kCallers; ++c) {
+        go [&]{
+            long sum = co::parallel_reduce(0L, 200000L, 500, 0L,
+                    [](long i){ return i & 7; },
+                    [](long a, long b){ return a + b; });
+            if (sum == 200000L / 8 * 28) ++ok;
+
+            std::vector<int> v(20000);
+            for (int i = 0; i < (int)v.size(); ++i) v[i] = (int)v.size() - i;
+            co::parallel_sort(v.begin(), v.end(), 256, std::less<int>());
+            if (!std::is_sorted(v.begin(), v.end())) ok = -1000;
+            wg.done();
+        };
+    }
+    // 同时运行的其他协程不受影响
+    go [&]{
+        for (int i = 0; i < 20; ++i) {
+            ++side;
+            co_sleep(1);
+        }
+        wg.done();
+    };
+    wg.wait();
+    EXPECT_EQ(ok, kCallers);
+    EXPECT_EQ(side, 20);
+}
+
+TEST(Parallel, nested)
+{
+    std::atomic<long> total{0};
+    co::parallel_for(0, 16, 1, [&](int){
+        long s = co::parallel_reduce(0, 1000, 10, 0L,
+                [](int i){ return (long)i; },
+                [](long a, long b){ return a + b; });
+        total += s;
+    });
+    EXPECT_EQ(total, 16L * 999 * 1000 / 2);
+}
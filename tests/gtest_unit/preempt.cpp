@@ -0,0 +1,99 @@
+#include <iostream>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#define TEST_MIN_THREAD 2
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+static uint64_t metric(uint64_t ProcessorMetricsSnapshot::* field)
+{
+    uint64_t n = 0;
+    for (auto const& p : co_sched.GetMetrics().processors)
+        n += p.*field;
+    return n;
+}
+
+// 单个P上, 一个计算密集的协程执行spinMs, 期间另一个协程每1ms醒来一次, 返回醒来的次数
+static int starvedTicks(int spinMs)
+{
+    std::atomic<bool> spinning{false}, stop{false};
+    std::atomic<int> ticks{0};
+    go [&]{
+        spinning = true;
+        auto end = chrono::steady_clock::now() + chrono::milliseconds(spinMs);
+        while (chrono::steady_clock::now() < end)
+            co_preempt_check();
+        stop = true;
+    };
+    go [&]{
+        while (!spinning) co_yield;
+        while (!stop) {
+            co_sleep(1);
+            if (!stop) ++ticks;
+        }
+    };
+    WaitUntilNoTask();
+    return ticks;
+}
+
+TEST(Preempt, slice)
+{
+    while (co_sched.GetMetrics().processors.size() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    // 关掉阻塞检测, 避免等待的协程被偷到其他P上
+    uint32_t cycleTimeout = co_opt.cycle_timeout_us;
+    co_opt.cycle_timeout_us = 60 * 1000 * 1000;
+
+    // 不开启抢占时, 计算协程独占P
+    co_opt.preempt_slice_us = 0;
+    EXPECT_EQ(starvedTicks(200), 0);
+
+    co_opt.preempt_slice_us = 5000;
+    uint64_t requests = metric(&ProcessorMetricsSnapshot::preemptRequests);
+    uint64_t preempts = metric(&ProcessorMetricsSnapshot::preempts);
+    int ticks = starvedTicks(300);
+    co_opt.preempt_slice_us = 0;
+    co_opt.cycle_timeout_us = cycleTimeout;
+
+    // 每个时间片(5ms, 调度线程1ms一轮)至少让出一次
+    EXPECT_GT(ticks, 10);
+    EXPECT_GT(metric(&ProcessorMetricsSnapshot::preemptRequests), requests);
+    EXPECT_GT(metric(&ProcessorMetricsSnapshot::preempts), preempts);
+}
+
+TEST(Preempt, noRequest)
+{
+    // 没有抢占请求时检查点不让出
+    uint64_t yields = 0;
+    go [&]{
+        uint64_t before = co_sched.GetCurrentTaskYieldCount();
+        for (int i = 0; i < 100000; ++i)
+            co_preempt_check();
+        yields = co_sched.GetCurrentTaskYieldCount() - before;
+    };
+    WaitUntilNoTask();
+    EXPECT_EQ(yields, 0u);
+
+    // 不在协程中也可以调用
+    co_preempt_check();
+}
+
+TEST(Preempt, alone)
+{
+    // P上没有其他协程等待时不发抢占请求
+    co_opt.preempt_slice_us = 2000;
+    uint64_t requests = metric(&ProcessorMetricsSnapshot::preemptRequests);
+    go [&]{
+        auto end = chrono::steady_clock::now() + chrono::milliseconds(50);
+        while (chrono::steady_clock::now() < end)
+            co_preempt_check();
+    };
+    WaitUntilNoTask();
+    co_opt.preempt_slice_us = 0;
+    EXPECT_EQ(metric(&ProcessorMetricsSnapshot::preemptRequests), requests);
+}
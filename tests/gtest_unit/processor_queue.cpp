@@ -0,0 +1,41 @@
+#include <iostream>
+#include <unistd.h>
+#include <atomic>
+#include <time.h>
+#include <sys/syscall.h>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+// 直接发起系统调用, 不经过hook, 阻塞整个P线程
+static void blockThread(int ms)
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    syscall(SYS_nanosleep, &ts, nullptr);
+}
+
+// P线程阻塞期间投递的协程远多于投递环的容量(1024个包),
+// 放不下的进newQueue_, 不能写出环形缓冲区
+TEST(ProcessorQueue, overflowWhileBlocked)
+{
+    // Start(2, 2)只有一个P, 也不会扩展新线程
+    Scheduler* sched = Scheduler::Create();
+    sched->goStart(2, 2);
+    usleep(100 * 1000);
+
+    std::atomic<bool> blocked{false};
+    go co_scheduler(sched) [&]{ blocked = true; blockThread(50); };
+    while (!blocked)
+        usleep(1000);
+
+    const int n = 5000;
+    std::atomic<int> ran{0};
+    for (int i = 0; i < n; ++i)
+        go co_scheduler(sched) [&]{ ++ran; };
+
+    for (int i = 0; i < 5000 && ran < n; ++i)
+        usleep(1000);
+    EXPECT_EQ(ran, n);
+}
@@ -0,0 +1,88 @@
+#include <iostream>
+#include <unistd.h>
+#include <string>
+#include <gtest/gtest.h>
+#define TEST_MIN_THREAD 2
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+static string readAll(FILE* fp)
+{
+    string s;
+    rewind(fp);
+    char buf[4096];
+    while (fgets(buf, sizeof(buf), fp))
+        s += buf;
+    fclose(fp);
+    return s;
+}
+
+static volatile uint64_t sink = 0;
+
+__attribute__((noinline)) static void spin(int ms)
+{
+    auto end = chrono::steady_clock::now() + chrono::milliseconds(ms);
+    while (chrono::steady_clock::now() < end)
+        for (int i = 0; i < 1000; ++i)
+            sink = sink + i;
+}
+
+TEST(Profiler, sample)
+{
+    // 调度器在其他线程启动, 等P创建出来
+    while (co_sched.GetMetrics().processors.size() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    ProfilerClear();
+    ASSERT_TRUE(ProfilerStart(1000));
+    EXPECT_TRUE(ProfilerRunning());
+    EXPECT_FALSE(ProfilerStart(1000));
+    go []{ spin(300); };
+    WaitUntilNoTask();
+    ProfilerStop();
+    EXPECT_FALSE(ProfilerRunning());
+
+    size_t n = 0;
+    FILE* fp = tmpfile();
+    n = ProfilerDumpFolded(fp);
+    string s = readAll(fp);
+
+    // 300ms CPU时间, 实际采样频率受内核时钟中断频率(CONFIG_HZ)限制
+    EXPECT_GE(n, 30u) << s;
+    EXPECT_EQ(s.find("coroutine;"), 0u) << s;
+    EXPECT_NE(s.find(" "), string::npos);
+
+    ProfilerClear();
+    fp = tmpfile();
+    EXPECT_EQ(ProfilerDumpFolded(fp), 0u);
+    fclose(fp);
+}
+
+TEST(Profiler, suspended)
+{
+    co_chan<int> ch;
+    const int n = 10;
+    for (int i = 0; i < n; ++i)
+        go [=]{
+            int v;
+            ch >> v;
+        };
+    while (co_sched.TaskCount() < (uint32_t)n)
+        usleep(1000);
+    usleep(10000);
+
+    FILE* fp = tmpfile();
+    EXPECT_EQ(DumpSuspendedStacks(co_sched, fp), (size_t)n);
+    string s = readAll(fp);
+    size_t tasks = 0;
+    for (size_t pos = s.find("suspended:"); pos != string::npos; pos = s.find("suspended:", pos + 1))
+        ++tasks;
+    EXPECT_EQ(tasks, (size_t)n);
+    EXPECT_NE(s.find("    #1 "), string::npos) << s;
+
+    for (int i = 0; i < n; ++i)
+        ch << i;
+    WaitUntilNoTask();
+}
@@ -0,0 +1,98 @@
+#include <iostream>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#include <boost/thread.hpp>
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+TEST(Semaphore, simple)
+{
+    co_semaphore sem(2);
+    EXPECT_TRUE(sem.try_acquire());
+    EXPECT_TRUE(sem.try_acquire());
+    EXPECT_FALSE(sem.try_acquire());
+    EXPECT_EQ(sem.value(), 0);
+
+    go [&]{
+        sem.acquire();
+        sem.acquire();
+    };
+    go [&]{
+        sem.release();
+        sem.release(2);
+    };
+    WaitUntilNoTask();
+    EXPECT_EQ(sem.value(), 1);
+}
+
+TEST(Semaphore, limit)
+{
+    co_semaphore sem(4);
+    std::atomic<int> running{0}, maxRunning{0};
+    for (int i = 0; i < 1000; ++i)
+        go [&]{
+            sem.acquire();
+            int r = ++running;
+            int m = maxRunning;
+            while (r > m && !maxRunning.compare_exchange_weak(m, r)) ;
+            co_yield;
+            --running;
+            sem.release();
+        };
+    WaitUntilNoTask();
+    EXPECT_LE(maxRunning, 4);
+    EXPECT_EQ(sem.value(), 4);
+}
+
+TEST(Semaphore, thread)
+{
+    co_semaphore sem(0);
+    boost::thread_group tg;
+    for (int i = 0; i < 4; ++i)
+        tg.create_thread([&]{
+                for (int k = 0; k < 1000; ++k)
+                    sem.acquire();
+            });
+    for (int i = 0; i < 4000; ++i)
+        go [&]{ sem.release(); };
+    tg.join_all();
+    WaitUntilNoTask();
+    EXPECT_EQ(sem.value(), 0);
+}
+
+TEST(WaitGroup, simple)
+{
+    co_wait_group wg;
+    wg.wait();
+
+    std::atomic<int> n{0};
+    wg.add(100);
+    for (int i = 0; i < 100; ++i)
+        go [&]{ ++n; co_yield; wg.done(); };
+    go [&]{ wg.wait(); EXPECT_EQ(n, 100); };
+    wg.wait();
+    EXPECT_EQ(n, 100);
+    EXPECT_EQ(wg.count(), 0);
+    WaitUntilNoTask();
+
+    // 计数归零后可以复用
+    wg.add();
+    go [&]{ wg.done(); };
+    wg.wait();
+    WaitUntilNoTask();
+}
+
+TEST(Latch, simple)
+{
+    co_latch latch(10);
+    EXPECT_FALSE(latch.try_wait());
+
+    std::atomic<int> n{0};
+    for (int i = 0; i < 10; ++i)
+        go [&]{ ++n; latch.arrive_and_wait(); EXPECT_EQ(n, 10); };
+    latch.wait();
+    EXPECT_TRUE(latch.try_wait());
+    WaitUntilNoTask();
+}
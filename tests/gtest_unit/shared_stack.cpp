@@ -0,0 +1,130 @@
+#include <iostream>
+#include <unistd.h>
+#include <vector>
+#include <atomic>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+// 栈上填充一段与id相关的数据, 多次yield后检查是否完好
+static bool fillAndCheck(int id, int depth)
+{
+    char buf[1024];
+    for (size_t i = 0; i < sizeof(buf); ++i)
+        buf[i] = (char)(id * 31 + depth * 7 + i);
+
+    bool ok = true;
+    if (depth > 0)
+        ok = fillAndCheck(id, depth - 1);
+    co_yield;
+
+    for (size_t i = 0; i < sizeof(buf); ++i)
+        if (buf[i] != (char)(id * 31 + depth * 7 + i))
+            return false;
+    return ok;
+}
+
+TEST(SharedStack, preserve)
+{
+    while (co_sched.GetMetrics().processors.size() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    const int n = 1000;
+    std::atomic<int> ok{0}, done{0};
+    for (int i = 0; i < n; ++i) {
+        // 混入独立栈的协程
+        if (i % 3 == 0) {
+            go [&, i]{
+                if (fillAndCheck(i, i % 8)) ++ok;
+                ++done;
+            };
+        } else {
+            go co_shared_stack [&, i]{
+                EXPECT_TRUE(Processor::IsSharedStackTask());
+                if (fillAndCheck(i, i % 8)) ++ok;
+                ++done;
+            };
+        }
+    }
+    WaitUntilNoTask();
+    EXPECT_EQ(done, n);
+    EXPECT_EQ(ok, n);
+}
+
+TEST(SharedStack, pinned)
+{
+    // 绑定共享栈后不会被偷到其他P上
+    const int n = 200;
+    std::atomic<int> moved{0};
+    for (int i = 0; i < n; ++i)
+        go co_shared_stack [&]{
+            Processor* proc = Processor::GetCurrentProcessor();
+            for (int j = 0; j < 100; ++j) {
+                co_yield;
+                if (Processor::GetCurrentProcessor() != proc)
+                    ++moved;
+            }
+        };
+    WaitUntilNoTask();
+    EXPECT_EQ(moved, 0);
+}
+
+TEST(SharedStack, sync)
+{
+    // 等待者的数据在挂起期间被唤醒方读写, 不能留在共享栈上
+    const int n = 100;
+    co_mutex mtx;
+    long counter = 0;
+    co_chan<long> ch;
+    co_chan<long> buffered(4);
+    std::atomic<long> sum{0}, bsum{0};
+
+    for (int i = 0; i < n; ++i) {
+        go co_shared_stack [&, i]{
+            for (int j = 0; j < 20; ++j) {
+                std::unique_lock<co_mutex> lock(mtx);
+                ++counter;
+                if (j % 5 == 0) co_yield;
+            }
+            ch << (long)i;
+            buffered << (long)i;
+        };
+        go co_shared_stack [&]{
+            long v = 0;
+            ch >> v;
+            sum += v;
+            long b = 0;
+            buffered >> b;
+            bsum += b;
+            co_sleep(1);
+        };
+    }
+    WaitUntilNoTask();
+    EXPECT_EQ(counter, n * 20);
+    EXPECT_EQ(sum, (long)n * (n - 1) / 2);
+    EXPECT_EQ(bsum, (long)n * (n - 1) / 2);
+}
+
+TEST(SharedStack, waitGroup)
+{
+    const int n = 100;
+    std::atomic<int> done{0};
+    co_wait_group wg;
+    wg.add(n);
+    for (int i = 0; i < n; ++i)
+        go co_shared_stack [&]{
+            co_sleep(1);
+            ++done;
+            wg.done();
+        };
+
+    std::atomic<bool> waited{false};
+    go co_shared_stack [&]{
+        wg.wait();
+        waited = (done == n);
+    };
+    WaitUntilNoTask();
+    EXPECT_TRUE(waited);
+}
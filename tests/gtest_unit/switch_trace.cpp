@@ -0,0 +1,76 @@
+#include <iostream>
+#include <unistd.h>
+#include <string>
+#include <gtest/gtest.h>
+#define TEST_MIN_THREAD 2
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+static string exportToString(size_t & n)
+{
+    FILE* fp = tmpfile();
+    n = SwitchTraceExport(fp);
+    string s;
+    rewind(fp);
+    char buf[512];
+    while (fgets(buf, sizeof(buf), fp))
+        s += buf;
+    fclose(fp);
+    return s;
+}
+
+static size_t countOf(string const& s, string const& sub)
+{
+    size_t n = 0;
+    for (size_t pos = s.find(sub); pos != string::npos; pos = s.find(sub, pos + 1))
+        ++n;
+    return n;
+}
+
+TEST(SwitchTrace, disabled)
+{
+    // 调度器在其他线程启动, 等P创建出来
+    while (co_sched.GetMetrics().processors.size() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    SwitchTraceClear();
+    SwitchTraceEnable(false);
+    go []{ co_yield; };
+    WaitUntilNoTask();
+
+    size_t n = 0;
+    string s = exportToString(n);
+    EXPECT_EQ(n, 0u);
+    EXPECT_NE(s.find("\"traceEvents\":["), string::npos);
+}
+
+TEST(SwitchTrace, events)
+{
+    SwitchTraceClear();
+    SwitchTraceEnable(true);
+    uint64_t id = 0;
+    go [&]{
+        id = co_sched.GetCurrentTaskID();
+        co_yield;
+        co_sleep(1);
+    };
+    WaitUntilNoTask();
+    SwitchTraceEnable(false);
+
+    size_t n = 0;
+    string s = exportToString(n);
+    string task = "\"task\":" + to_string(id) + ",";
+    // 首次执行/yield/睡眠醒来各一段
+    EXPECT_EQ(countOf(s, "\"ph\":\"X\",") , 3u) << s;
+    EXPECT_EQ(countOf(s, task + "\"state\":\"Runnable\""), 1u);
+    EXPECT_EQ(countOf(s, task + "\"state\":\"Block\""), 1u);
+    EXPECT_EQ(countOf(s, task + "\"state\":\"Done\""), 1u);
+    EXPECT_EQ(countOf(s, "\"name\":\"suspend\""), 1u);
+    EXPECT_EQ(countOf(s, "\"name\":\"timer\""), 1u);
+    EXPECT_EQ(countOf(s, "\"name\":\"wakeup\""), 1u);
+    EXPECT_NE(s.find("\"args\":{\"name\":\"Processor "), string::npos);
+    EXPECT_GE(n, 6u);
+    SwitchTraceClear();
+}
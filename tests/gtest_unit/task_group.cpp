@@ -0,0 +1,206 @@
+#include <iostream>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+// 协程退出(正常结束或被取消)时计数
+struct ExitCounter
+{
+    std::atomic<int> & n_;
+    ~ExitCounter() { ++n_; }
+};
+
+static long elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return (long)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+TEST(TaskGroup, wait)
+{
+    while (co_sched.GetMetrics().processors.size() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    std::atomic<int> done{0};
+    co::TaskGroup group;
+    for (int i = 0; i < 100; ++i)
+        group.spawn([&]{ co_sleep(1); ++done; });
+    group.wait();
+    EXPECT_EQ(done, 100);
+    EXPECT_EQ(group.size(), 0u);
+}
+
+TEST(TaskGroup, cancelSleepAndChannel)
+{
+    std::atomic<int> exited{0}, finished{0};
+    co_chan<int> ch;
+    co::TaskGroup group;
+    for (int i = 0; i < 10; ++i) {
+        group.spawn([&]{
+            ExitCounter c{exited};
+            for (;;) co_sleep(10000);
+            ++finished;
+        });
+        group.spawn([&]{
+            ExitCounter c{exited};
+            int v;
+            ch >> v;        // 不带超时的读
+            ++finished;
+        });
+        group.spawn([&]{
+            ExitCounter c{exited};
+            int v;
+            ch.TimedPop(v, std::chrono::seconds(10));
+            ++finished;
+        });
+    }
+    co_sleep(20);
+    EXPECT_FALSE(group.wait_for(std::chrono::milliseconds(1)));
+
+    auto start = std::chrono::steady_clock::now();
+    group.cancel();
+    group.wait();
+    EXPECT_LT(elapsedMs(start), 1000);
+    EXPECT_EQ(exited, 30);
+    EXPECT_EQ(finished, 0);
+    EXPECT_TRUE(group.cancelled());
+
+    // 被取消的等待不影响channel后续的使用
+    go [=]{ ch << 7; };
+    int v = 0;
+    ch >> v;
+    EXPECT_EQ(v, 7);
+}
+
+TEST(TaskGroup, cancelJoinAndIo)
+{
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    std::atomic<int> joinCancelled{0}, readErrno{0};
+    co::TaskGroup group;
+    group.spawn([&]{
+        auto h = co::spawn([]{ co_sleep(10000); return 1; });
+        try {
+            h.get();
+        } catch (co::task_cancelled const&) {
+            ++joinCancelled;
+            throw;
+        }
+    });
+    group.spawn([&]{
+        char buf[8];
+        ssize_t n = read(fds[0], buf, sizeof(buf));
+        if (n < 0)
+            readErrno = errno;
+    });
+    co_sleep(20);
+
+    auto start = std::chrono::steady_clock::now();
+    group.cancel();
+    group.wait();
+    EXPECT_LT(elapsedMs(start), 1000);
+    EXPECT_EQ(joinCancelled, 1);
+    EXPECT_EQ(readErrno, ECANCELED);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(TaskGroup, inheritAndNested)
+{
+    std::atomic<int> exited{0};
+    co::TaskGroup group;
+    group.spawn([&]{
+        // go创建的子协程继承取消令牌
+        go [&]{
+            ExitCounter c{exited};
+            for (;;) co_sleep(10000);
+        };
+
+        // 嵌套的组随外层一起取消
+        co::TaskGroup inner;
+        inner.spawn([&]{
+            ExitCounter c{exited};
+            for (;;) co_sleep(10000);
+        });
+        inner.wait();
+    });
+    co_sleep(20);
+    group.cancel();
+    group.wait();
+    for (int i = 0; i < 1000 && exited < 2; ++i)
+        co_sleep(1);
+    EXPECT_EQ(exited, 2);
+}
+
+TEST(TaskGroup, exceptionCancelsGroup)
+{
+    std::atomic<int> exited{0};
+    co::TaskGroup group;
+    for (int i = 0; i < 5; ++i) {
+        group.spawn([&]{
+            ExitCounter c{exited};
+            for (;;) co_sleep(10000);
+        });
+    }
+    group.spawn([]{
+        co_sleep(5);
+        throw std::runtime_error("fail");
+    });
+    EXPECT_THROW(group.wait(), std::runtime_error);
+    EXPECT_EQ(exited, 5);
+    EXPECT_TRUE(group.cancelled());
+
+    // 已取消的组不再创建协程
+    std::atomic<int> ran{0};
+    group.spawn([&]{ ++ran; });
+    EXPECT_EQ(group.size(), 0u);
+    co_sleep(5);
+    EXPECT_EQ(ran, 0);
+}
+
+TEST(TaskGroup, nonCancellableWait)
+{
+    // 不是取消点的等待(co_latch)不受取消影响
+    co_latch latch(1);
+    std::atomic<int> passed{0};
+    co::TaskGroup group;
+    group.spawn([&]{
+        latch.wait();
+        ++passed;
+    });
+    co_sleep(10);
+    group.cancel();
+    co_sleep(10);
+    EXPECT_EQ(passed, 0);
+    latch.count_down();
+    group.wait();
+    EXPECT_EQ(passed, 1);
+}
+
+TEST(TaskGroup, destructorCancels)
+{
+    std::atomic<int> exited{0};
+    auto start = std::chrono::steady_clock::now();
+    {
+        co::TaskGroup group;
+        for (int i = 0; i < 10; ++i) {
+            group.spawn([&]{
+                ExitCounter c{exited};
+                for (;;) co_sleep(10000);
+            });
+        }
+        co_sleep(10);
+    }
+    EXPECT_LT(elapsedMs(start), 1000);
+    EXPECT_EQ(exited, 10);
+}
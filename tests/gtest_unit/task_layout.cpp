@@ -0,0 +1,53 @@
+#include <iostream>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#define TEST_MIN_THREAD 2
+#include "coroutine.h"
+#include "gtest_exit.h"
+#include "task/TaskRef.h"
+using namespace std;
+using namespace co;
+
+TEST(TaskLayout, hotFields)
+{
+    // 调度器在其他线程启动, 等P创建出来
+    while (co_sched.GetMetrics().processors.size() < TEST_MIN_THREAD - 1)
+        usleep(1000);
+
+    go []{
+        Task* tk = Processor::GetCurrentTask();
+
+        // 调度热数据(状态, 所属P, 挂起ID, 就绪时间, 切换上下文)集中在64字节内
+        char* begin = (char*)&tk->state_;
+        char* end = (char*)&tk->ctx_ + sizeof(void*) * 2;
+        EXPECT_LE(end - begin, 64);
+        for (char* p : {(char*)&tk->proc_, (char*)&tk->suspendId_, (char*)&tk->readyNs_}) {
+            EXPECT_GE(p, begin);
+            EXPECT_LT(p, end);
+        }
+    };
+    WaitUntilNoTask();
+}
+
+TEST(TaskLayout, anysInline)
+{
+    int line = __LINE__ + 1;
+    go [line]{
+        Task* tk = Processor::GetCurrentTask();
+        char* begin = (char*)tk + sizeof(Task);
+        char* end = begin + TaskAnys::StorageSize();
+
+        // TaskRef的存储紧跟在Task之后
+        char* p = (char*)&TaskRefLocation(tk);
+        EXPECT_GE(p, begin);
+        EXPECT_LT(p, end);
+        EXPECT_EQ(TaskRefLocation(tk).lineno_, line);
+
+        p = (char*)&TaskRefDebugInfo(tk);
+        EXPECT_GE(p, begin);
+        EXPECT_LT(p, end);
+        co_sched.SetCurrentTaskDebugInfo("layout");
+        EXPECT_EQ(TaskRefDebugInfo(tk), "layout");
+    };
+    WaitUntilNoTask();
+}
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <unistd.h>
+#include <string>
+#include <gtest/gtest.h>
+#include "coroutine.h"
+#include "gtest_exit.h"
+using namespace std;
+using namespace co;
+
+static string dumpToString(size_t & n)
+{
+    FILE* fp = tmpfile();
+    n = TraceDump(fp);
+    string s;
+    rewind(fp);
+    char buf[512];
+    while (fgets(buf, sizeof(buf), fp))
+        s += buf;
+    fclose(fp);
+    return s;
+}
+
+static size_t countOf(string const& s, string const& sub)
+{
+    size_t n = 0;
+    for (size_t pos = s.find(sub); pos != string::npos; pos = s.find(sub, pos + 1))
+        ++n;
+    return n;
+}
+
+TEST(Trace, mask)
+{
+    TraceClear();
+    co_opt.debug = dbg_none;
+    DebugPrint(dbg_hook, "disabled %d", 1);
+
+    co_opt.debug = dbg_hook | dbg_timer;
+    DebugPrint(dbg_hook, "enabled %d", 2);
+    DebugPrint(dbg_ioblock, "other category %d", 3);
+    go []{ DebugPrint(dbg_hook, "in coroutine %s", "x"); };
+    WaitUntilNoTask();
+    co_opt.debug = dbg_none;
+
+    size_t n = 0;
+    string s = dumpToString(n);
+    EXPECT_EQ(s.find("disabled"), string::npos);
+    EXPECT_EQ(s.find("other category"), string::npos);
+    EXPECT_NE(s.find("enabled 2"), string::npos);
+    EXPECT_NE(s.find("in coroutine x"), string::npos);
+    EXPECT_NE(s.find("trace.cpp"), string::npos);
+    EXPECT_GE(n, 2u);
+
+    TraceClear();
+    dumpToString(n);
+    EXPECT_EQ(n, 0u);
+}
+
+TEST(Trace, ringOverwrite)
+{
+    TraceClear();
+    co_opt.debug = dbg_hook;
+    for (size_t i = 0; i < kTraceRingSize * 2; ++i)
+        DebugPrint(dbg_hook, "record %d", (int)i);
+    co_opt.debug = dbg_none;
+
+    // 只保留最新的kTraceRingSize条
+    size_t n = 0;
+    string s = dumpToString(n);
+    EXPECT_EQ(countOf(s, "record "), kTraceRingSize);
+    EXPECT_EQ(s.find("record 0\n"), string::npos);
+    EXPECT_NE(s.find("record " + to_string(kTraceRingSize * 2 - 1) + "\n"), string::npos);
+    TraceClear();
+}
+
+TEST(Trace, threads)
+{
+    TraceClear();
+    co_opt.debug = dbg_hook;
+    vector<thread> ts;
+    for (int t = 0; t < 4; ++t)
+        ts.emplace_back([=]{
+                for (int i = 0; i < 100; ++i)
+                    DebugPrint(dbg_hook, "thread %d record %d", t, i);
+            });
+    for (auto & t : ts)
+        t.join();
+    co_opt.debug = dbg_none;
+
+    size_t n = 0;
+    string s = dumpToString(n);
+    EXPECT_EQ(countOf(s, " record "), 400u);
+    TraceClear();
+}
@@ -0,0 +1,137 @@
+#include "co/coroutine.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <stdio.h>
+#include <unistd.h>
+using namespace std;
+using namespace std::chrono;
+
+#define O(x) cout << x << endl
+
+// 互斥锁竞争场景的压测
+// 用法: ./mutex_bench.t [thread_count]
+static int thread_count = 4;
+static const int co_count = 1000;
+static const int lock_per_co = 1000;
+
+static void waitTasks()
+{
+    while (g_Scheduler.TaskCount() > 0)
+        usleep(1000);
+}
+
+// 临界区内做work次空循环
+static ALWAYS_INLINE void work(int n)
+{
+    for (volatile int i = 0; i < n; ++i) ;
+}
+
+template <typename Mutex>
+void benchMutex(const char* name, int critical, int outside, int count = lock_per_co)
+{
+    Mutex mtx;
+    long counter = 0;
+    auto start = steady_clock::now();
+    for (int i = 0; i < co_count; ++i) {
+        go [&]{
+            for (int k = 0; k < count; ++k) {
+                {
+                    std::unique_lock<Mutex> lock(mtx);
+                    ++counter;
+                    work(critical);
+                }
+                work(outside);
+            }
+        };
+    }
+    waitTasks();
+    auto ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    long total = (long)co_count * count;
+    printf("%-12s critical=%-5d outside=%-5d counter=%ld cost=%ld ms, %ld ns/lock\n",
+            name, critical, outside, counter, (long)(ns / 1000000), (long)(ns / total));
+}
+
+void benchRWMutex(int readPercent)
+{
+    co_rwmutex m;
+    long value = 0;
+    auto start = steady_clock::now();
+    for (int i = 0; i < co_count; ++i) {
+        go [&, i]{
+            for (int k = 0; k < lock_per_co; ++k) {
+                if ((i * lock_per_co + k) % 100 < readPercent) {
+                    std::unique_lock<co_rmutex> lock(m.Reader());
+                    work(50);
+                    (void)value;
+                } else {
+                    std::unique_lock<co_wmutex> lock(m.Writer());
+                    ++value;
+                    work(50);
+                }
+            }
+        };
+    }
+    waitTasks();
+    auto ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    long total = (long)co_count * lock_per_co;
+    printf("co_rwmutex   read=%d%% cost=%ld ms, %ld ns/lock\n",
+            readPercent, (long)(ns / 1000000), (long)(ns / total));
+}
+
+// 原生线程下的自旋锁竞争
+template <typename Lock>
+void benchSpinLock(const char* name)
+{
+    Lock lk;
+    long counter = 0;
+    const long n = 1000000;
+    auto start = steady_clock::now();
+    std::vector<std::thread> tg;
+    for (int i = 0; i < thread_count; ++i) {
+        tg.emplace_back([&]{
+                for (long k = 0; k < n; ++k) {
+                    std::unique_lock<Lock> lock(lk);
+                    ++counter;
+                }
+            });
+    }
+    for (auto & t : tg)
+        t.join();
+    auto ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    printf("%-12s threads=%d counter=%ld cost=%ld ms, %ld ns/lock\n",
+            name, thread_count, counter, (long)(ns / 1000000), (long)(ns / (n * thread_count)));
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1)
+        thread_count = atoi(argv[1]);
+
+    co_sched.Start(thread_count + 1);
+    usleep(100 * 1000);
+
+    O("---------- short critical section ----------");
+    benchMutex<co_mutex>("co_mutex", 10, 100);
+    benchMutex<std::mutex>("std::mutex", 10, 100);
+
+    O("---------- long critical section ----------");
+    benchMutex<co_mutex>("co_mutex", 5000, 100, lock_per_co / 10);
+    benchMutex<std::mutex>("std::mutex", 5000, 100, lock_per_co / 10);
+
+    O("---------- rwmutex ----------");
+    benchRWMutex(99);
+    benchRWMutex(90);
+    benchRWMutex(50);
+
+    O("---------- spinlock ----------");
+    benchSpinLock<co::LFLock>("LFLock");
+    benchSpinLock<co::LFLock2>("LFLock2");
+    benchSpinLock<std::mutex>("std::mutex");
+
+    co_sched.Stop();
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <stdlib.h>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 数据局部性: 每组协程反复读写同一块分片数据(大小接近L2), 每次处理完让出.
+// 不固定时协程随负载均衡在P之间迁移, 分片在各核的cache之间来回搬运;
+// 用co_processor把一组协程固定在同一个P上, 分片一直留在该核的cache中.
+// 用法: affinity_bench [P数量] [分片KB], 默认4个P, 256KB.
+// cache miss的差异可在perf stat -e cache-misses,LLC-load-misses下对比两段输出.
+
+static const int kRounds = 200;
+static const int kTasksPerGroup = 8;
+
+static int procId()
+{
+    return ::co::Processor::GetCurrentProcessor()->Id();
+}
+
+void bench(bool pinned, int procs, size_t shardBytes)
+{
+    int groups = procs * 2;
+    O("---------- " << (pinned ? "pinned (co_processor)" : "unpinned") << ": groups=" << groups
+            << " tasks/group=" << kTasksPerGroup << " shard=" << shardBytes / 1024 << "KB ----------");
+
+    std::vector<std::vector<uint64_t>> shards(groups, std::vector<uint64_t>(shardBytes / sizeof(uint64_t), 1));
+    std::atomic<long> migrations{0};
+    co_wait_group wg;
+    wg.add(groups * kTasksPerGroup);
+    {
+        Bench b;
+        for (int g = 0; g < groups; ++g) {
+            for (int t = 0; t < kTasksPerGroup; ++t) {
+                auto fn = [&, g]{
+                    std::vector<uint64_t> & shard = shards[g];
+                    int proc = procId();
+                    for (int r = 0; r < kRounds; ++r) {
+                        for (size_t i = 0; i < shard.size(); i += 8)
+                            shard[i] += shard[(i + 64) % shard.size()];
+                        co_yield;
+                        if (procId() != proc) {
+                            proc = procId();
+                            ++migrations;
+                        }
+                    }
+                    wg.done();
+                };
+                if (pinned)
+                    go co_processor(g % procs) fn;
+                else
+                    go fn;
+            }
+        }
+        wg.wait();
+        b.add((long)groups * kTasksPerGroup * kRounds);
+    }
+    O("migrations: " << migrations);
+    while (!co_sched.IsEmpty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+int main(int argc, char** argv)
+{
+    int procs = argc > 1 ? atoi(argv[1]) : 4;
+    size_t shardKB = argc > 2 ? atol(argv[2]) : 256;
+
+    std::thread([=]{ co_sched.Start(procs + 1); }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (int i = 0; i < 2; ++i) {
+        bench(false, procs, shardKB * 1024);
+        bench(true, procs, shardKB * 1024);
+    }
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+// 无栈协程(co::Async)的内存与吞吐
+//   1. 创建N个无栈协程, 全部挂起在一个co_latch上, 记录进程RSS和协程帧池的大小, 再统一唤醒直到全部结束
+//   2. N个无栈协程各自在channel上交换一次数据
+//   3. 与共享栈协程(Task)比较, 共享栈协程是有栈协程中最省内存的形式
+//      有栈协程每个要1KB以上, 数量默认取N/10, 比较的是每个协程的内存
+// 用法: async_bench [N] [P数] [共享栈协程数], 默认10M, cpu核心数, N/10
+// 需要以-std=c++20编译.
+
+#if defined(__cpp_impl_coroutine)
+
+static long rssKB()
+{
+    FILE* f = fopen("/proc/self/status", "r");
+    if (!f) return 0;
+    char line[256];
+    long kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "VmRSS:", 6) == 0) {
+            kb = atol(line + 6);
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+static double elapsedMs(steady_clock::time_point start)
+{
+    return duration_cast<microseconds>(steady_clock::now() - start).count() / 1000.0;
+}
+
+static std::atomic<long> gStarted{0};
+static std::atomic<long> gFinished{0};
+
+static co::Async<void> parked(co_latch & latch)
+{
+    ++gStarted;
+    co_await co::async_wait(latch);
+    ++gFinished;
+}
+
+static co::Async<void> pingStackless(co_chan<int> ch, bool writer)
+{
+    int v = 1;
+    if (writer)
+        co_await co::async_push(ch, v);
+    else
+        co_await co::async_pop(ch, v);
+    ++gFinished;
+}
+
+static void waitFinished(long n)
+{
+    while (gFinished < n)
+        std::this_thread::sleep_for(milliseconds(1));
+}
+
+static void report(const char* name, long n, long rss0, long rssPeak, double createMs, double runMs)
+{
+    double perTask = (double)(rssPeak - rss0) * 1024 / n;
+    O(std::setw(22) << std::left << name << std::right << std::fixed << std::setprecision(1)
+            << " | rss +" << std::setw(8) << (rssPeak - rss0) / 1024.0 << " MB"
+            << " (" << std::setw(6) << perTask << " B/task)"
+            << " | create " << std::setw(8) << createMs << " ms ("
+            << std::setw(6) << n / createMs / 1000 << " M/s)"
+            << " | run " << std::setw(8) << runMs << " ms ("
+            << std::setw(6) << n / runMs / 1000 << " M/s)");
+}
+
+int main(int argc, char** argv)
+{
+    long n = argc > 1 ? atol(argv[1]) : 10000000;
+    int procs = argc > 2 ? atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+    long stackful = argc > 3 ? atol(argv[3]) : n / 10;
+    if (procs < 1) procs = 1;
+
+    // Start(k)创建k-1个P
+    std::thread([=]{ co_sched.Start(procs + 1); }).detach();
+    while ((int)co_sched.ProcessorCount() < procs)
+        std::this_thread::sleep_for(milliseconds(1));
+
+    O("tasks=" << n << " procs=" << procs);
+
+    // 1. 无栈协程: 全部同时挂起
+    {
+        gFinished = 0;
+        co_latch latch(1);
+        long rss0 = rssKB();
+        auto t = steady_clock::now();
+        for (long i = 0; i < n; ++i)
+            co::detach(parked(latch));
+        double createMs = elapsedMs(t);
+
+        // 等全部执行到挂起点
+        while (gStarted < n)
+            std::this_thread::sleep_for(milliseconds(1));
+        long rssPeak = rssKB();
+
+        t = steady_clock::now();
+        latch.count_down();
+        waitFinished(n);
+        double runMs = elapsedMs(t);
+        report("stackless parked", n, rss0, rssPeak, createMs, runMs);
+        O("    frame pool: " << co::FramePoolBytes() / 1024 / 1024 << " MB");
+    }
+
+    // 2. 无栈协程: 两两在无缓冲channel上交换一次
+    {
+        gFinished = 0;
+        long rss0 = rssKB();
+        auto t = steady_clock::now();
+        for (long i = 0; i < n / 2; ++i) {
+            co_chan<int> ch;
+            co::detach(pingStackless(ch, true));
+            co::detach(pingStackless(ch, false));
+        }
+        double createMs = elapsedMs(t);
+        long rssPeak = rssKB();
+        waitFinished(n / 2 * 2);
+        double runMs = elapsedMs(t);
+        report("stackless channel", n / 2 * 2, rss0, rssPeak, createMs, runMs);
+    }
+
+    // 3. 共享栈协程: 全部同时挂起
+    {
+        gStarted = 0;
+        gFinished = 0;
+        co_latch latch(1);
+        long rss0 = rssKB();
+        auto t = steady_clock::now();
+        for (long i = 0; i < stackful; ++i)
+            go co_shared_stack [&]{
+                ++gStarted;
+                latch.wait();
+                ++gFinished;
+            };
+        double createMs = elapsedMs(t);
+        while (gStarted < stackful)
+            std::this_thread::sleep_for(milliseconds(1));
+        long rssPeak = rssKB();
+
+        t = steady_clock::now();
+        latch.count_down();
+        waitFinished(stackful);
+        double runMs = elapsedMs(t);
+        report("shared-stack parked", stackful, rss0, rssPeak, createMs, runMs);
+    }
+    return 0;
+}
+
+#else
+
+int main()
+{
+    O("async_bench requires -std=c++20");
+    return 0;
+}
+
+#endif // __cpp_impl_coroutine
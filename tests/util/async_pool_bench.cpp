@@ -0,0 +1,99 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <unistd.h>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+static co::AsyncCoroutinePool* gPool = co::AsyncCoroutinePool::Create();
+
+// 常驻内存(KB)
+long RssKB()
+{
+    long pages = 0, rss = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    if (fscanf(f, "%ld %ld", &pages, &rss) != 2) rss = 0;
+    fclose(f);
+    return rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void ShowPool(const char* when)
+{
+    printf("[%s] coroutines=%zu idle=%zu pending=%zu rss=%ld KB\n", when,
+            gPool->CoroutineCount(), gPool->IdleCount(), gPool->PendingCount(), RssKB());
+}
+
+// 逐个提交, 统计从Post到开始执行的延迟
+void benchLatency(long n)
+{
+    O("---------- post-to-run latency (one by one) ----------");
+    std::vector<long> lat(n);
+    std::atomic<long> done{0};
+    for (long i = 0; i < n; ++i) {
+        auto tp = steady_clock::now();
+        gPool->Post([&, i, tp]{
+                lat[i] = duration_cast<nanoseconds>(steady_clock::now() - tp).count();
+                ++done;
+            }, NULL);
+        while (done <= i)
+            std::this_thread::yield();
+    }
+    std::sort(lat.begin(), lat.end());
+    long sum = 0;
+    for (long v : lat) sum += v;
+    printf("avg=%ld ns p50=%ld ns p99=%ld ns max=%ld ns\n",
+            sum / n, lat[n / 2], lat[n * 99 / 100], lat[n - 1]);
+}
+
+// 批量提交, 统计从提交到全部完成的吞吐
+void benchThroughput(long n, int threads)
+{
+    O("---------- post-to-completion throughput (" << threads << " posting threads) ----------");
+    std::atomic<long> done{0};
+    {
+        Bench b;
+        std::vector<std::thread> tg;
+        for (int t = 0; t < threads; ++t)
+            tg.emplace_back([&]{
+                    for (long i = 0; i < n / threads; ++i)
+                        gPool->Post([&]{ ++done; }, NULL);
+                });
+        for (auto & t : tg)
+            t.join();
+        while (done < n / threads * threads)
+            usleep(100);
+        b.add(n);
+    }
+    ShowPool("after burst");
+}
+
+int main(int argc, char** argv)
+{
+    gPool->InitCoroutinePool(1024, 4);
+    gPool->SetIdleTimeout(milliseconds(200));
+    gPool->Start(4);
+    usleep(100 * 1000);
+    ShowPool("started");
+
+    benchLatency(100000);
+    benchThroughput(1000000, 1);
+    benchThroughput(1000000, 4);
+
+    // 工作协程空闲超时后回收到常驻数量
+    usleep(1000 * 1000);
+    ShowPool("idle");
+    return 0;
+}
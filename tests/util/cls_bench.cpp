@@ -0,0 +1,88 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include "co/coroutine.h"
+#include "common/inc/any.h"
+#include "processor/Processor.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 旧实现: 以静态变量地址为key的unordered_map<int*, any>, 用于对比
+// (map放在thread_local中, 查当前协程的开销照算)
+namespace old_cls {
+    typedef int* Location;
+    co::any& Get(Location loc) {
+        static thread_local co::Task* volatile tk;
+        tk = co::Processor::GetCurrentTask();
+        static thread_local std::unordered_map<Location, co::any> map;
+        return map[loc];
+    }
+    template <typename T, typename ... Args>
+    T& GetSpecific(Location loc, Args && ... args) {
+        co::any& val = Get(loc);
+        if (val.empty())
+            return val.emplace<T>(std::forward<Args>(args)...);
+        return co::any_cast<T&>(val);
+    }
+    template <typename T>
+    struct Ref {
+        Location loc_;
+        template <typename ... Args>
+        Ref(Location loc, Args && ... args) : loc_(loc) { (void)GetSpecific<T>(loc_, std::forward<Args>(args)...); }
+        operator T&() { return GetSpecific<T>(loc_); }
+    };
+}
+#define OLD_CLS(type) old_cls::Ref<type>([]{ static int i; return &i; }())
+
+volatile long sink;
+
+// 在协程中反复读写CLS变量
+template <typename F>
+void benchAccess(const char* name, long n, F f)
+{
+    O("---------- " << name << " n=" << n << " ----------");
+    co_wait_group wg;
+    wg.add(1);
+    {
+        Bench b;
+        go [&]{
+            long sum = 0;
+            for (long i = 0; i < n; ++i)
+                sum += f(i);
+            sink = sum;
+            wg.done();
+        };
+        wg.wait();
+        b.add(n);
+    }
+}
+
+int main()
+{
+    std::thread([]{ co_sched.Start(2); }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const long n = 10000000;
+    benchAccess("new: 1 var", n, [](long i) { int & v = co_cls(int); return v += (int)i; });
+    benchAccess("old: 1 var", n, [](long i) { int & v = OLD_CLS(int); return v += (int)i; });
+
+    // 8个变量, 超出内嵌槽位的部分走overflow
+    benchAccess("new: 8 vars", n / 8, [](long i) {
+            return (int&)co_cls(int) + (int&)co_cls(int) + (int&)co_cls(int) + (int&)co_cls(int)
+                + (int&)co_cls(int) + (int&)co_cls(int) + (int&)co_cls(int) + (int&)co_cls(int) + (int)i;
+        });
+    benchAccess("old: 8 vars", n / 8, [](long i) {
+            return (int&)OLD_CLS(int) + (int&)OLD_CLS(int) + (int&)OLD_CLS(int) + (int&)OLD_CLS(int)
+                + (int&)OLD_CLS(int) + (int&)OLD_CLS(int) + (int&)OLD_CLS(int) + (int&)OLD_CLS(int) + (int)i;
+        });
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <unistd.h>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 模拟的连接, 健康检查耗时checkCost微秒
+struct FakeConnection {
+    int id;
+    bool alive = true;
+};
+static std::atomic<int> gConnId{0};
+static const int checkCost = 50;
+
+static bool CheckAlive(FakeConnection* c) {
+    usleep(checkCost);
+    return c->alive;
+}
+
+// 旧实现: 所有Get/Put经过一个Channel, 取出时同步做健康检查
+struct ChannelPool {
+    co_chan<FakeConnection*> ch;
+    std::atomic<size_t> count{0};
+    size_t max;
+    explicit ChannelPool(size_t m) : ch(m), max(m) {}
+    ~ChannelPool() { FakeConnection* c; while (ch.TryPop(c)) delete c; }
+
+    std::shared_ptr<FakeConnection> Get() {
+        FakeConnection* c = nullptr;
+        if (!ch.TryPop(c)) {
+            if (++count <= max)
+                c = new FakeConnection{++gConnId};
+            else {
+                --count;
+                ch >> c;
+            }
+        } else if (!CheckAlive(c)) {
+            delete c;
+            c = new FakeConnection{++gConnId};
+        }
+        return std::shared_ptr<FakeConnection>(c, [this](FakeConnection* p){ ch.TryPush(p); });
+    }
+};
+
+typedef co::ConnectionPool<FakeConnection> ShardedPool;
+
+static const int cCoroutines = 1000;
+static const int cLoop = 200;
+
+template <typename Pool>
+void run(const char* name, Pool & pool)
+{
+    O("---------- " << name << " (" << cCoroutines << " coroutines x " << cLoop << " Get/Put) ----------");
+    std::atomic<int> done{0};
+    {
+        Bench b;
+        for (int i = 0; i < cCoroutines; ++i)
+            go [&]{
+                for (int k = 0; k < cLoop; ++k) {
+                    auto c = pool.Get();
+                    if (k % 16 == 0) co_yield;
+                }
+                ++done;
+            };
+        while (done < cCoroutines)
+            usleep(1000);
+        b.add((long)cCoroutines * cLoop);
+    }
+}
+
+void showStats(ShardedPool & pool)
+{
+    auto s = pool.GetStats();
+    printf("count=%zu idle=%zu hits=%lu misses=%lu waits=%lu timeouts=%lu avg_wait=%lu ns max_wait=%lu ns\n",
+            pool.Count(), pool.IdleCount(), (unsigned long)s.hits, (unsigned long)s.misses,
+            (unsigned long)s.waits, (unsigned long)s.waitTimeouts,
+            (unsigned long)(s.waits ? s.waitNanoseconds / s.waits : 0), (unsigned long)s.maxWaitNanoseconds);
+    printf("health_checks=%lu evicted_unhealthy=%lu evicted_idle=%lu\n",
+            (unsigned long)s.healthChecks, (unsigned long)s.evictedUnhealthy, (unsigned long)s.evictedIdle);
+}
+
+int main(int argc, char** argv)
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    co_sched.Start(threads);
+    usleep(100 * 1000);
+
+    for (size_t max : {1024, 16}) {
+        O("========== maxConnection = " << max << " ==========");
+        {
+            ChannelPool pool(max);
+            run("channel pool, inline check", pool);
+        }
+        {
+            ShardedPool pool([]{ return new FakeConnection{++gConnId}; }, NULL, max);
+            pool.StartMaintenance(milliseconds(100), &CheckAlive, seconds(1));
+            run("sharded pool, background check", pool);
+            showStats(pool);
+        }
+    }
+    return 0;
+}
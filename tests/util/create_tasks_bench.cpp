@@ -0,0 +1,89 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <stdlib.h>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 批量创建: 循环go与Scheduler::CreateTasks的创建速率, 以及全部执行完的耗时
+// 用法: create_tasks_bench [协程数], 默认1000000
+// 协程运行在共享栈上, 否则百万个独立栈超过vm.max_map_count.
+
+static std::atomic<long> gDone{0};
+static std::atomic<long> gSum{0};
+
+static void waitDone(long n)
+{
+    while (gDone < n)
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    while (!co_sched.IsEmpty())
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+void benchLoop(long n, bool inCoroutine)
+{
+    O("---------- loop go: tasks=" << n << (inCoroutine ? " (from coroutine)" : " (from thread)") << " ----------");
+    gDone = 0;
+    auto spawn = [n]{
+        Bench b;
+        for (long i = 0; i < n; ++i)
+            go co_shared_stack [i]{ gSum += i; ++gDone; };
+        b.add(n);
+        O("spawn:");
+    };
+    {
+        Timer t;
+        if (inCoroutine)
+            go spawn;
+        else
+            spawn();
+        waitDone(n);
+        O("spawn and run all:");
+    }
+}
+
+void benchBulk(long n, bool inCoroutine)
+{
+    O("---------- CreateTasks: tasks=" << n << (inCoroutine ? " (from coroutine)" : " (from thread)") << " ----------");
+    gDone = 0;
+    auto spawn = [n]{
+        Bench b;
+        co::TaskOpt opt;
+        opt.shared_stack_ = true;
+        co_sched.CreateTasks(n, [](std::size_t i) { gSum += i; ++gDone; }, opt);
+        b.add(n);
+        O("spawn:");
+    };
+    {
+        Timer t;
+        if (inCoroutine)
+            go spawn;
+        else
+            spawn();
+        waitDone(n);
+        O("spawn and run all:");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    long n = argc > 1 ? atol(argv[1]) : 1000000;
+
+    std::thread([]{ co_sched.Start(5); }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (bool inCoroutine : {false, true}) {
+        benchLoop(n, inCoroutine);
+        benchBulk(n, inCoroutine);
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 对比直接切换关闭/开启时单个P上的切换吞吐, 每个op为一次协程切换
+
+// 两个协程通过无缓冲channel交替挂起/唤醒
+void benchPingPong(int rounds)
+{
+    O("---------- channel ping-pong: enable_direct_switch=" << co_opt.enable_direct_switch << " rounds=" << rounds << " ----------");
+    co_wait_group wg;
+    wg.add(2);
+    co_chan<int> ping, pong;
+    {
+        Bench b;
+        go [=, &wg]{
+            int v = 0;
+            for (int i = 0; i < rounds; ++i) {
+                ping << i;
+                pong >> v;
+            }
+            wg.done();
+        };
+        go [=, &wg]{
+            int v = 0;
+            for (int i = 0; i < rounds; ++i) {
+                ping >> v;
+                pong << v;
+            }
+            wg.done();
+        };
+        wg.wait();
+        b.add((long)rounds * 2);
+    }
+}
+
+void benchYield(int tasks, int yields)
+{
+    O("---------- yield: enable_direct_switch=" << co_opt.enable_direct_switch << " tasks=" << tasks << " yields=" << yields << " ----------");
+    co_wait_group wg;
+    wg.add(tasks);
+    {
+        Bench b;
+        for (int i = 0; i < tasks; ++i)
+            go [&]{
+                for (int j = 0; j < yields; ++j)
+                    co_yield;
+                wg.done();
+            };
+        wg.wait();
+        b.add((long)tasks * yields);
+    }
+}
+
+int main()
+{
+    // 单个P, 所有切换都发生在同一个线程上
+    std::thread([]{ co_sched.Start(2); }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (bool direct : {false, true}) {
+        co_opt.enable_direct_switch = direct;
+        benchPingPong(1000000);
+        benchYield(2, 1000000);
+        benchYield(100, 20000);
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// echo: 每对socketpair一个服务端协程原样回写, 一个客户端协程一问一答并统计往返延迟
+static const int cMsgSize = 64;
+
+static void setNonBlock(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+// 非阻塞fd上读写n字节, EAGAIN时通过netpoller挂起当前协程
+static bool ioFull(int fd, char* buf, size_t n, bool isRead)
+{
+    size_t done = 0;
+    while (done < n) {
+        ssize_t res = isRead ? ::read(fd, buf + done, n - done) : ::write(fd, buf + done, n - done);
+        if (res > 0) {
+            done += res;
+            continue;
+        }
+
+        if (res == 0)
+            return false;
+
+        if (errno == EINTR)
+            continue;
+
+        if (errno != EAGAIN)
+            return false;
+
+        if (co::NetPoller::WaitFd(fd, isRead ? EPOLLIN : EPOLLOUT) < 0)
+            return false;
+    }
+    return true;
+}
+
+static void printLatency(vector<long> & lat)
+{
+    if (lat.empty()) return ;
+    std::sort(lat.begin(), lat.end());
+    long sum = 0;
+    for (long v : lat) sum += v;
+    O("Latency avg: " << sum / (long)lat.size() << " ns, p50: " << lat[lat.size() / 2]
+            << " ns, p99: " << lat[lat.size() * 99 / 100] << " ns");
+}
+
+void benchCoroutine(int pairs, int rounds)
+{
+    O("---------- coroutine echo over netpoller: pairs=" << pairs << " rounds=" << rounds << " ----------");
+    vector<int> fds(pairs * 2);
+    for (int i = 0; i < pairs; ++i) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, &fds[i * 2]) < 0) {
+            O("socketpair failed, errno=" << errno);
+            return ;
+        }
+        setNonBlock(fds[i * 2]);
+        setNonBlock(fds[i * 2 + 1]);
+    }
+
+    vector<vector<long>> lats(pairs);
+    co_wait_group wg;
+    wg.add(pairs * 2);
+    {
+        Bench b;
+        for (int i = 0; i < pairs; ++i) {
+            int sfd = fds[i * 2], cfd = fds[i * 2 + 1];
+            go [=, &wg]{
+                char buf[cMsgSize];
+                while (ioFull(sfd, buf, sizeof(buf), true))
+                    if (!ioFull(sfd, buf, sizeof(buf), false))
+                        break;
+                wg.done();
+            };
+            go [=, &wg, &lats]{
+                char buf[cMsgSize] = {};
+                vector<long> & lat = lats[i];
+                lat.reserve(rounds);
+                for (int r = 0; r < rounds; ++r) {
+                    auto start = steady_clock::now();
+                    if (!ioFull(cfd, buf, sizeof(buf), false)) break;
+                    if (!ioFull(cfd, buf, sizeof(buf), true)) break;
+                    lat.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+                }
+                // 关闭写端, 服务端读到EOF后退出
+                shutdown(cfd, SHUT_WR);
+                wg.done();
+            };
+        }
+        wg.wait();
+        b.add((long)pairs * rounds);
+    }
+
+    vector<long> all;
+    for (auto & lat : lats)
+        all.insert(all.end(), lat.begin(), lat.end());
+    printLatency(all);
+
+    for (int fd : fds)
+        close(fd);
+}
+
+// 对照组: 每对socketpair两个线程, 阻塞读写
+void benchThread(int pairs, int rounds)
+{
+    O("---------- thread echo over blocking fd: pairs=" << pairs << " rounds=" << rounds << " ----------");
+    vector<int> fds(pairs * 2);
+    for (int i = 0; i < pairs; ++i)
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, &fds[i * 2]) < 0) {
+            O("socketpair failed, errno=" << errno);
+            return ;
+        }
+
+    vector<vector<long>> lats(pairs);
+    vector<std::thread> threads;
+    {
+        Bench b;
+        for (int i = 0; i < pairs; ++i) {
+            int sfd = fds[i * 2], cfd = fds[i * 2 + 1];
+            threads.emplace_back([=]{
+                char buf[cMsgSize];
+                while (ioFull(sfd, buf, sizeof(buf), true))
+                    if (!ioFull(sfd, buf, sizeof(buf), false))
+                        break;
+            });
+            threads.emplace_back([=, &lats]{
+                char buf[cMsgSize] = {};
+                vector<long> & lat = lats[i];
+                lat.reserve(rounds);
+                for (int r = 0; r < rounds; ++r) {
+                    auto start = steady_clock::now();
+                    if (!ioFull(cfd, buf, sizeof(buf), false)) break;
+                    if (!ioFull(cfd, buf, sizeof(buf), true)) break;
+                    lat.push_back(duration_cast<nanoseconds>(steady_clock::now() - start).count());
+                }
+                shutdown(cfd, SHUT_WR);
+            });
+        }
+        for (auto & t : threads)
+            t.join();
+        b.add((long)pairs * rounds);
+    }
+
+    vector<long> all;
+    for (auto & lat : lats)
+        all.insert(all.end(), lat.begin(), lat.end());
+    printLatency(all);
+
+    for (int fd : fds)
+        close(fd);
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    co_sched.Start(threads);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    benchThread(1, 20000);
+    benchCoroutine(1, 20000);
+    benchThread(16, 2000);
+    benchCoroutine(16, 2000);
+    benchCoroutine(1000, 100);
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+// 弹性P池: 一段阻塞突发(阻塞系统调用占住P线程)前后的线程数与调度延迟
+//   idle -> burst -> recovery 三个阶段, 每100ms输出一行:
+//   存活的P数(未退休)/P槽位数, 这段时间内探测协程从创建到执行的延迟 p50/max
+//   分别在关闭回收(processor_idle_retire_us=0)和开启回收时各跑一遍
+// 用法: elastic_bench [阻塞协程数] [每个阻塞ms] [退休阈值ms], 默认16, 300, 200
+
+static void blockThread(int ms)
+{
+    // 直接发起系统调用, 不经过hook, 整个P线程阻塞
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    syscall(SYS_nanosleep, &ts, nullptr);
+}
+
+static std::mutex gLatLock;
+static std::vector<long> gLatUs;
+
+static void probe(co::Scheduler* sched)
+{
+    auto created = steady_clock::now();
+    go co_scheduler(sched) [created]{
+        long us = duration_cast<microseconds>(steady_clock::now() - created).count();
+        std::lock_guard<std::mutex> lock(gLatLock);
+        gLatUs.push_back(us);
+    };
+}
+
+static void report(co::Scheduler* sched, long ms, const char* phase)
+{
+    std::vector<long> lat;
+    {
+        std::lock_guard<std::mutex> lock(gLatLock);
+        lat.swap(gLatUs);
+    }
+    std::sort(lat.begin(), lat.end());
+    auto metrics = sched->GetMetrics();
+    size_t live = 0;
+    uint64_t retires = 0;
+    for (auto & p : metrics.processors) {
+        if (!p.retired) ++live;
+        retires += p.retires;
+    }
+    O(std::setw(6) << ms << " ms " << std::setw(9) << std::left << phase << std::right
+            << " | P live " << std::setw(3) << live << " / slots " << std::setw(3) << metrics.processors.size()
+            << " retires " << std::setw(3) << retires
+            << " | probe(us) n=" << std::setw(3) << lat.size()
+            << " p50=" << std::setw(7) << (lat.empty() ? 0 : lat[lat.size() / 2])
+            << " max=" << std::setw(7) << (lat.empty() ? 0 : lat.back()));
+}
+
+void benchBurst(int blockers, int blockMs, int retireMs)
+{
+    O("---------- processor_idle_retire_us=" << retireMs * 1000 << " blockers=" << blockers
+            << " x " << blockMs << " ms ----------");
+    co_opt.processor_idle_retire_us = retireMs * 1000;
+
+    co::Scheduler* sched = co::Scheduler::Create();
+    std::thread([sched]{ sched->Start(3, 32); }).detach();
+    std::this_thread::sleep_for(milliseconds(100));
+
+    // idle 500ms, 突发阻塞分两波, 之后观察恢复
+    const long idleMs = 500, burstMs = blockMs * 2, totalMs = idleMs + burstMs + std::max(retireMs * 10, 1000) + 1000;
+    auto start = steady_clock::now();
+    long nextReport = 100;
+    int wave = 0;
+    for (;;) {
+        long ms = duration_cast<milliseconds>(steady_clock::now() - start).count();
+        if (ms >= totalMs)
+            break;
+        if (wave < 2 && ms >= idleMs + wave * blockMs) {
+            for (int i = 0; i < blockers / 2; ++i)
+                go co_scheduler(sched) [blockMs]{ blockThread(blockMs); };
+            ++wave;
+        }
+        probe(sched);
+        if (ms >= nextReport) {
+            const char* phase = ms <= idleMs ? "idle" : ms <= idleMs + burstMs ? "burst" : "recovery";
+            report(sched, ms, phase);
+            nextReport += 100;
+        }
+        std::this_thread::sleep_for(milliseconds(5));
+    }
+    sched->Stop();
+}
+
+int main(int argc, char** argv)
+{
+    int blockers = argc > 1 ? atoi(argv[1]) : 16;
+    int blockMs = argc > 2 ? atoi(argv[2]) : 300;
+    int retireMs = argc > 3 ? atoi(argv[3]) : 200;
+
+    benchBurst(blockers, blockMs, 0);
+    benchBurst(blockers, blockMs, retireMs);
+    return 0;
+}
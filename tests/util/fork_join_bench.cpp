@@ -0,0 +1,90 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// fork-join: 创建cTasks个协程, 等待全部完成
+static const long cTasks = 1000000;
+static const int cStackSize = 16 * 1024;
+
+void benchChannel()
+{
+    O("---------- fork-join by co_chan<nullptr_t> ----------");
+    co_chan<std::nullptr_t> ch(cTasks);
+    Bench b;
+    for (long i = 0; i < cTasks; ++i)
+        go co_stack(cStackSize) [=]{ ch << nullptr; };
+    for (long i = 0; i < cTasks; ++i)
+        ch >> nullptr;
+    b.add(cTasks);
+}
+
+void benchWaitGroup()
+{
+    O("---------- fork-join by co_wait_group ----------");
+    co_wait_group wg;
+    Bench b;
+    wg.add(cTasks);
+    for (long i = 0; i < cTasks; ++i)
+        go co_stack(cStackSize) [&]{ wg.done(); };
+    wg.wait();
+    b.add(cTasks);
+}
+
+void benchLatch()
+{
+    O("---------- fork-join by co_latch ----------");
+    co_latch latch(cTasks);
+    Bench b;
+    for (long i = 0; i < cTasks; ++i)
+        go co_stack(cStackSize) [&]{ latch.count_down(); };
+    latch.wait();
+    b.add(cTasks);
+}
+
+// 信号量限制并发度, 协程间互相唤醒
+void benchSemaphore()
+{
+    O("---------- co_semaphore(8) guarded tasks ----------");
+    co_semaphore sem(8);
+    co_wait_group wg;
+    std::atomic<long> running{0}, maxRunning{0};
+    Bench b;
+    wg.add(cTasks);
+    for (long i = 0; i < cTasks; ++i)
+        go co_stack(cStackSize) [&]{
+            sem.acquire();
+            long r = ++running;
+            long m = maxRunning;
+            while (r > m && !maxRunning.compare_exchange_weak(m, r)) ;
+            co_yield;
+            --running;
+            sem.release();
+            wg.done();
+        };
+    wg.wait();
+    b.add(cTasks);
+    OUT(maxRunning);
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    co_sched.Start(threads);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    benchChannel();
+    benchWaitGroup();
+    benchLatch();
+    benchSemaphore();
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 阻塞式客户端: 客户端代码只用普通的阻塞read/write, 不感知协程.
+// 服务端在独立的调度器中, 每个请求模拟1ms的处理耗时(usleep)后回写.
+// 单个原生线程一次只能有一个请求在途; 开启hook后一个线程上的N个协程可以同时有N个请求在途.
+static const int cMsgSize = 64;
+static const int cServiceUs = 1000;
+
+static bool blockingFull(int fd, char* buf, size_t n, bool isRead)
+{
+    size_t done = 0;
+    while (done < n) {
+        ssize_t res = isRead ? ::read(fd, buf + done, n - done) : ::write(fd, buf + done, n - done);
+        if (res > 0) {
+            done += res;
+            continue;
+        }
+
+        if (res < 0 && errno == EINTR)
+            continue;
+
+        return false;
+    }
+    return true;
+}
+
+static co::Scheduler* serverSched = nullptr;
+
+static vector<int> startServer(int conns)
+{
+    vector<int> clients;
+    for (int i = 0; i < conns; ++i) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+            O("socketpair failed, errno=" << errno);
+            break;
+        }
+
+        int sfd = sv[0];
+        clients.push_back(sv[1]);
+        go co_scheduler(serverSched) [=]{
+            char buf[cMsgSize];
+            while (blockingFull(sfd, buf, sizeof(buf), true)) {
+                usleep(cServiceUs);
+                if (!blockingFull(sfd, buf, sizeof(buf), false))
+                    break;
+            }
+            close(sfd);
+        };
+    }
+    return clients;
+}
+
+void benchThread(int rounds)
+{
+    O("---------- one native thread, blocking client: rounds=" << rounds << " ----------");
+    vector<int> fds = startServer(1);
+    if (fds.empty()) return ;
+
+    {
+        Bench b;
+        std::thread([&]{
+            char buf[cMsgSize] = {};
+            for (int r = 0; r < rounds; ++r) {
+                if (!blockingFull(fds[0], buf, sizeof(buf), false)) break;
+                if (!blockingFull(fds[0], buf, sizeof(buf), true)) break;
+                ++b;
+            }
+        }).join();
+    }
+    close(fds[0]);
+}
+
+void benchCoroutine(int conns, int rounds)
+{
+    O("---------- " << conns << " coroutines on one thread, blocking client: rounds=" << rounds << " ----------");
+    vector<int> fds = startServer(conns);
+    if (fds.empty()) return ;
+
+    std::atomic<long> reqs{0};
+    co_wait_group wg;
+    wg.add(fds.size());
+    {
+        Bench b;
+        for (int fd : fds) {
+            go [=, &wg, &reqs]{
+                char buf[cMsgSize] = {};
+                for (int r = 0; r < rounds; ++r) {
+                    if (!blockingFull(fd, buf, sizeof(buf), false)) break;
+                    if (!blockingFull(fd, buf, sizeof(buf), true)) break;
+                    ++reqs;
+                }
+                close(fd);
+                wg.done();
+            };
+        }
+        wg.wait();
+        b.add(reqs);
+    }
+}
+
+int main(int argc, char** argv) {
+    // 客户端固定一个P, 体现单线程上的并发请求数 (Start(n)创建n-1个P)
+    co_sched.Start(2);
+    serverSched = co::Scheduler::Create();
+    serverSched->Start(argc > 1 ? atoi(argv[1]) : 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    benchThread(500);
+    benchCoroutine(1, 500);
+    benchCoroutine(100, 50);
+    benchCoroutine(1000, 10);
+    return 0;
+}
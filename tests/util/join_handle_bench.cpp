@@ -0,0 +1,112 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <stdlib.h>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// fork-join: 一个协程派生fanout个子协程计算, 再汇总结果, 重复rounds轮.
+// 对比三种取结果的方式:
+//   channel: 每个子协程一个容量为1的channel, 父协程逐个读取
+//   spawn:   co::spawn返回JoinHandle, 父协程逐个get()
+//   when_all: 先co::when_all等待全部完成, 再get()
+// 用法: join_handle_bench [fanout] [rounds], 默认100, 2000
+
+static long work(long i)
+{
+    long s = 0;
+    for (long j = 0; j < 64; ++j)
+        s += (i ^ j) * 31;
+    return s;
+}
+
+template <typename Fn>
+void bench(const char* name, int fanout, int rounds, Fn const& fn)
+{
+    O("---------- " << name << ": fanout=" << fanout << " rounds=" << rounds << " ----------");
+    std::atomic<long> sum{0};
+    co_wait_group wg;
+    wg.add(1);
+    {
+        Bench b;
+        go [&]{
+            for (int r = 0; r < rounds; ++r)
+                sum += fn(fanout);
+            wg.done();
+        };
+        wg.wait();
+        b.add((long)fanout * rounds);
+    }
+    O("sum: " << sum);
+    while (!co_sched.IsEmpty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+long forkJoinChannel(int fanout)
+{
+    std::vector<co_chan<long>> chans;
+    chans.reserve(fanout);
+    for (int i = 0; i < fanout; ++i) {
+        chans.emplace_back(1);
+        co_chan<long> ch = chans.back();
+        go [ch, i]{ ch << work(i); };
+    }
+    long s = 0;
+    for (auto & ch : chans) {
+        long v;
+        ch >> v;
+        s += v;
+    }
+    return s;
+}
+
+long forkJoinSpawn(int fanout)
+{
+    std::vector<co::JoinHandle<long>> hs;
+    hs.reserve(fanout);
+    for (int i = 0; i < fanout; ++i)
+        hs.push_back(co::spawn([i]{ return work(i); }));
+    long s = 0;
+    for (auto & h : hs)
+        s += h.get();
+    return s;
+}
+
+long forkJoinWhenAll(int fanout)
+{
+    std::vector<co::JoinHandle<long>> hs;
+    hs.reserve(fanout);
+    for (int i = 0; i < fanout; ++i)
+        hs.push_back(co::spawn([i]{ return work(i); }));
+    co::when_all(hs);
+    long s = 0;
+    for (auto & h : hs)
+        s += h.get();
+    return s;
+}
+
+int main(int argc, char** argv)
+{
+    int fanout = argc > 1 ? atoi(argv[1]) : 100;
+    int rounds = argc > 2 ? atoi(argv[2]) : 2000;
+
+    std::thread([]{ co_sched.Start(4); }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (int i = 0; i < 2; ++i) {
+        bench("channel", fanout, rounds, forkJoinChannel);
+        bench("spawn", fanout, rounds, forkJoinSpawn);
+        bench("when_all", fanout, rounds, forkJoinWhenAll);
+    }
+    return 0;
+}
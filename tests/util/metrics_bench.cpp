@@ -0,0 +1,114 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 对比调度延迟直方图关闭/开启时的创建/切换/唤醒吞吐, 以及导出指标的开销
+void benchSpawn(int n)
+{
+    O("---------- spawn: enable_metrics=" << co_opt.enable_metrics << " n=" << n << " ----------");
+    std::atomic<int> done{0};
+    {
+        Bench b;
+        for (int i = 0; i < n; ++i)
+            go [&]{ ++done; };
+        while (done < n)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        b.add(n);
+    }
+}
+
+void benchYield(int tasks, int yields)
+{
+    O("---------- yield: enable_metrics=" << co_opt.enable_metrics << " tasks=" << tasks << " yields=" << yields << " ----------");
+    co_wait_group wg;
+    wg.add(tasks);
+    {
+        Bench b;
+        for (int i = 0; i < tasks; ++i)
+            go [&]{
+                for (int j = 0; j < yields; ++j)
+                    co_yield;
+                wg.done();
+            };
+        wg.wait();
+        b.add((long)tasks * yields);
+    }
+}
+
+// 两个协程通过无缓冲channel交替挂起/唤醒
+void benchWakeup(int pairs, int rounds)
+{
+    O("---------- wakeup: enable_metrics=" << co_opt.enable_metrics << " pairs=" << pairs << " rounds=" << rounds << " ----------");
+    co_wait_group wg;
+    wg.add(pairs * 2);
+    {
+        Bench b;
+        for (int i = 0; i < pairs; ++i) {
+            co_chan<int> ping, pong;
+            go [=, &wg]{
+                int v = 0;
+                for (int j = 0; j < rounds; ++j) {
+                    ping << j;
+                    pong >> v;
+                }
+                wg.done();
+            };
+            go [=, &wg]{
+                int v = 0;
+                for (int j = 0; j < rounds; ++j) {
+                    ping >> v;
+                    pong << v;
+                }
+                wg.done();
+            };
+        }
+        wg.wait();
+        b.add((long)pairs * rounds * 2);
+    }
+}
+
+void benchExport(int n)
+{
+    O("---------- export: n=" << n << " ----------");
+    size_t bytes = 0;
+    {
+        Bench b;
+        for (int i = 0; i < n; ++i)
+            co::ExportMetrics(co_sched, [&](std::string const& s){ bytes = s.size(); });
+        b.add(n);
+    }
+    OUT(bytes);
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    co_sched.Start(threads);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (bool on : {false, true}) {
+        co_opt.enable_metrics = on;
+        benchSpawn(200000);
+        benchYield(100, 20000);
+        benchWakeup(100, 10000);
+    }
+    co_opt.enable_metrics = false;
+
+    benchExport(1000);
+
+    co::SchedulerMetrics m = co_sched.GetMetrics();
+    O("create->run p50=" << m.createToRun.Percentile(0.5) << "ns p99=" << m.createToRun.Percentile(0.99) << "ns");
+    O("wakeup->run p50=" << m.wakeupToRun.Percentile(0.5) << "ns p99=" << m.wakeupToRun.Percentile(0.99) << "ns");
+    O("run slice   p50=" << m.runSlice.Percentile(0.5) << "ns p99=" << m.runSlice.Percentile(0.99) << "ns");
+    return 0;
+}
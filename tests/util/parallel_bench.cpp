@@ -0,0 +1,141 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <stdlib.h>
+#include <math.h>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+// 并行算法的扩展性: 对1个P到全部核心数个P的调度器, 分别测量
+//   parallel_for    : 逐元素做一段浮点计算
+//   parallel_reduce : 逐元素求和
+//   parallel_sort   : 随机整数排序
+// 各自与单线程串行版本比较, 输出耗时和加速比.
+// 调用者是调度器上的一个协程, 参与执行的线程数就是P的数量.
+// 用法: parallel_bench [最大P数] [元素数], 默认为cpu核心数, 4M
+
+static volatile double gSink = 0;
+
+static double work(double x)
+{
+    for (int k = 0; k < 32; ++k)
+        x = sqrt(x * x + 1.0) * 0.999;
+    return x;
+}
+
+static double elapsedMs(steady_clock::time_point start)
+{
+    return duration_cast<microseconds>(steady_clock::now() - start).count() / 1000.0;
+}
+
+struct Result { double forMs, reduceMs, sortMs; };
+
+static Result run(std::size_t n, std::vector<int> const& input)
+{
+    Result r;
+    std::vector<double> out(n);
+
+    auto t = steady_clock::now();
+    co::parallel_for((std::size_t)0, n, [&](std::size_t i){ out[i] = work((double)i); });
+    r.forMs = elapsedMs(t);
+    gSink = out[n / 2];
+
+    t = steady_clock::now();
+    double sum = co::parallel_reduce((std::size_t)0, n, 0.0,
+            [&](std::size_t i){ return out[i]; },
+            [](double a, double b){ return a + b; });
+    r.reduceMs = elapsedMs(t);
+    gSink = sum;
+
+    std::vector<int> v = input;
+    t = steady_clock::now();
+    co::parallel_sort(v.begin(), v.end());
+    r.sortMs = elapsedMs(t);
+    if (!std::is_sorted(v.begin(), v.end()))
+        O("parallel_sort result is not sorted!");
+    return r;
+}
+
+static Result serial(std::size_t n, std::vector<int> const& input)
+{
+    Result r;
+    std::vector<double> out(n);
+
+    auto t = steady_clock::now();
+    for (std::size_t i = 0; i < n; ++i) out[i] = work((double)i);
+    r.forMs = elapsedMs(t);
+    gSink = out[n / 2];
+
+    t = steady_clock::now();
+    double sum = 0;
+    for (std::size_t i = 0; i < n; ++i) sum += out[i];
+    r.reduceMs = elapsedMs(t);
+    gSink = sum;
+
+    std::vector<int> v = input;
+    t = steady_clock::now();
+    std::sort(v.begin(), v.end());
+    r.sortMs = elapsedMs(t);
+    return r;
+}
+
+static void print(const char* name, int procs, Result const& r, Result const& base)
+{
+    O(std::setw(8) << name << std::setw(4) << procs << std::fixed << std::setprecision(1)
+            << " | for " << std::setw(8) << r.forMs << " ms x" << std::setprecision(2) << base.forMs / r.forMs
+            << std::setprecision(1)
+            << " | reduce " << std::setw(7) << r.reduceMs << " ms x" << std::setprecision(2) << base.reduceMs / r.reduceMs
+            << std::setprecision(1)
+            << " | sort " << std::setw(8) << r.sortMs << " ms x" << std::setprecision(2) << base.sortMs / r.sortMs);
+}
+
+int main(int argc, char** argv)
+{
+    int hw = (int)std::thread::hardware_concurrency();
+    int maxProcs = argc > 1 ? atoi(argv[1]) : hw;
+    std::size_t n = argc > 2 ? (std::size_t)atol(argv[2]) : (4u << 20);
+    if (maxProcs < 1) maxProcs = 1;
+
+    std::mt19937 rng(1);
+    std::vector<int> input(n);
+    for (auto & x : input) x = (int)rng();
+
+    O("elements=" << n << " cores=" << hw);
+    Result base = serial(n, input);
+    print("serial", 1, base, base);
+
+    std::vector<int> counts;
+    for (int p = 1; p < maxProcs; p *= 2)
+        counts.push_back(p);
+    counts.push_back(maxProcs);
+
+    for (int procs : counts) {
+        // Start(k)创建k-1个P
+        co::Scheduler* sched = co::Scheduler::Create();
+        sched->goStart(procs + 1);
+        while ((int)sched->ProcessorCount() < procs)
+            std::this_thread::sleep_for(milliseconds(1));
+
+        std::atomic<bool> done{false};
+        Result r;
+        go co_scheduler(sched) [&]{
+            run(n, input);      // 预热
+            r = run(n, input);
+            done = true;
+        };
+        while (!done)
+            std::this_thread::sleep_for(milliseconds(1));
+        print("co", procs, r, base);
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 公平性: 单个P上几个计算密集的协程与一个每1ms醒来一次的延迟敏感协程混跑,
+// 统计延迟敏感协程的唤醒延迟, 以及计算协程的总耗时(抢占带来的额外开销)
+
+static volatile uint64_t gSink = 0;
+
+// 一段不可被优化掉的计算
+static void crunch(int n)
+{
+    uint64_t x = gSink;
+    for (int i = 0; i < n; ++i)
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    gSink = x;
+}
+
+void benchFairness(uint32_t sliceUs, int cpuTasks, int cpuMs)
+{
+    O("---------- fairness: preempt_slice_us=" << sliceUs << " cpu tasks=" << cpuTasks << " x " << cpuMs << " ms ----------");
+    co_opt.preempt_slice_us = sliceUs;
+
+    // 先测出cpuMs对应的计算量
+    auto t0 = steady_clock::now();
+    crunch(10000000);
+    long perMs = 10000000L / std::max<long>(duration_cast<microseconds>(steady_clock::now() - t0).count(), 1) * 1000;
+    long total = perMs * cpuMs;
+
+    std::atomic<int> running{cpuTasks};
+    std::vector<long> lateUs;
+    co_wait_group wg;
+    wg.add(cpuTasks + 1);
+    auto start = steady_clock::now();
+    std::atomic<long> cpuDoneMs{0};
+
+    for (int i = 0; i < cpuTasks; ++i)
+        go [&]{
+            for (long done = 0; done < total; done += 1000) {
+                crunch(1000);
+                co_preempt_check();
+            }
+            long ms = duration_cast<milliseconds>(steady_clock::now() - start).count();
+            if (ms > cpuDoneMs) cpuDoneMs = ms;
+            --running;
+            wg.done();
+        };
+
+    go [&]{
+        while (running > 0) {
+            auto expect = steady_clock::now() + milliseconds(1);
+            co_sleep(1);
+            lateUs.push_back(duration_cast<microseconds>(steady_clock::now() - expect).count());
+        }
+        wg.done();
+    };
+    wg.wait();
+
+    std::sort(lateUs.begin(), lateUs.end());
+    auto pct = [&](double p) { return lateUs.empty() ? 0 : lateUs[(size_t)(p * (lateUs.size() - 1))]; };
+    O("latency task ticks: " << lateUs.size() << "  late(us) p50=" << pct(0.5) << " p99=" << pct(0.99)
+            << " max=" << (lateUs.empty() ? 0 : lateUs.back()));
+    O("cpu tasks finished after " << cpuDoneMs << " ms (ideal " << cpuTasks * cpuMs << " ms)");
+    co_opt.preempt_slice_us = 0;
+}
+
+// 没有抢占请求时检查点的开销
+void benchCheck(long n)
+{
+    O("---------- co_preempt_check() without request: " << n << " ----------");
+    co_wait_group wg;
+    wg.add(1);
+    go [&]{
+        {
+            Bench b;
+            for (long i = 0; i < n; ++i)
+                co_preempt_check();
+            b.add(n);
+        }
+        wg.done();
+    };
+    wg.wait();
+}
+
+int main()
+{
+    // 单个P; 关掉阻塞检测, 否则计算协程所在P被判定为阻塞后其他协程会被偷到新线程上
+    co_opt.cycle_timeout_us = 60 * 1000 * 1000;
+    std::thread([]{ co_sched.Start(2); }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    benchCheck(100000000);
+    for (uint32_t slice : {0u, 10000u, 2000u})
+        benchFairness(slice, 2, 300);
+    return 0;
+}
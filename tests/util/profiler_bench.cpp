@@ -0,0 +1,70 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 对比采样关闭/100Hz/1kHz时计算+切换混合负载的吞吐
+static volatile uint64_t sink = 0;
+
+__attribute__((noinline)) void work(int n)
+{
+    for (int i = 0; i < n; ++i)
+        sink = sink + i;
+}
+
+void benchWork(const char* name, int tasks, int rounds)
+{
+    O("---------- " << name << ": tasks=" << tasks << " rounds=" << rounds << " ----------");
+    co_wait_group wg;
+    wg.add(tasks);
+    {
+        Bench b;
+        for (int i = 0; i < tasks; ++i)
+            go [&]{
+                for (int j = 0; j < rounds; ++j) {
+                    work(1000);
+                    co_yield;
+                }
+                wg.done();
+            };
+        wg.wait();
+        b.add((long)tasks * rounds);
+    }
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    co_sched.Start(threads);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (int i = 0; i < 2; ++i) {
+        benchWork("profiler off", 100, 5000);
+
+        co::ProfilerStart(100);
+        benchWork("profiler 100Hz", 100, 5000);
+        co::ProfilerStop();
+
+        co::ProfilerStart(1000);
+        benchWork("profiler 1kHz", 100, 5000);
+        co::ProfilerStop();
+    }
+
+    {
+        O("---------- dump ----------");
+        Timer t;
+        FILE* fp = fopen("/dev/null", "w");
+        O("samples: " << co::ProfilerDumpFolded(fp));
+        fclose(fp);
+    }
+    return 0;
+}
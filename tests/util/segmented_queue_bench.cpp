@@ -0,0 +1,132 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <list>
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include "co/coroutine.h"
+#include "co/sync/segmented_queue.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 统计operator new分配的字节数和次数
+static std::atomic<long> gAllocBytes{0};
+static std::atomic<long> gAllocCount{0};
+
+void* operator new(std::size_t size) {
+    void* p = malloc(size + 16);
+    if (!p) throw std::bad_alloc();
+    *(std::size_t*)p = size;
+    gAllocBytes += size;
+    ++gAllocCount;
+    return (char*)p + 16;
+}
+void operator delete(void* p) noexcept {
+    if (!p) return ;
+    char* base = (char*)p - 16;
+    gAllocBytes -= *(std::size_t*)base;
+    free(base);
+}
+void operator delete(void* p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+struct Msg {
+    char buf[64];
+};
+
+static const long cOps = 10000000;
+static const long cBatch = 1000;
+static const long cFootprint[] = {1000, 100000, 1000000};
+
+template <typename Q>
+void benchThroughput(const char* name)
+{
+    O("---------- " << name << " push/pop (batch=" << cBatch << ") ----------");
+    Q q;
+    Msg m = {};
+    long allocs = gAllocCount;
+    {
+        Bench b;
+        for (long i = 0; i < cOps / cBatch; ++i) {
+            for (long j = 0; j < cBatch; ++j)
+                q.push(m);
+            for (long j = 0; j < cBatch; ++j)
+                q.pop(m);
+        }
+        b.add(cOps);
+    }
+    OUT(gAllocCount - allocs);
+}
+
+template <typename Q>
+void benchFootprint(const char* name)
+{
+    O("---------- " << name << " footprint ----------");
+    for (long n : cFootprint) {
+        long before = gAllocBytes;
+        {
+            Q q;
+            Msg m = {};
+            for (long i = 0; i < n; ++i)
+                q.push(m);
+            long bytes = gAllocBytes - before;
+            O("  elements=" << n << " bytes=" << bytes << " bytes/element=" << (double)bytes / n);
+            for (long i = 0; i < n; ++i)
+                q.pop(m);
+            O("  drained, bytes retained=" << gAllocBytes - before);
+        }
+    }
+}
+
+// 统一push/pop接口
+struct ListQueue {
+    std::list<Msg> l;
+    void push(Msg const& m) { l.push_back(m); }
+    bool pop(Msg & m) {
+        if (l.empty()) return false;
+        m = l.front();
+        l.pop_front();
+        return true;
+    }
+};
+
+typedef co::SegmentedQueue<Msg> SegQueue;
+
+void benchChannel()
+{
+    O("---------- Channel(kUnbounded) push/pop from native thread ----------");
+    co_chan<long> ch(co_chan<long>::kUnbounded);
+    long allocs = gAllocCount;
+    {
+        Bench b;
+        for (long i = 0; i < cOps / cBatch; ++i) {
+            for (long j = 0; j < cBatch; ++j)
+                ch << j;
+            long v;
+            for (long j = 0; j < cBatch; ++j)
+                ch >> v;
+        }
+        b.add(cOps);
+    }
+    OUT(gAllocCount - allocs);
+}
+
+int main() {
+    benchThroughput<ListQueue>("std::list");
+    benchThroughput<SegQueue>("SegmentedQueue");
+
+    benchFootprint<ListQueue>("std::list");
+    benchFootprint<SegQueue>("SegmentedQueue");
+
+    benchChannel();
+    return 0;
+}
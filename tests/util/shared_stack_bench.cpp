@@ -0,0 +1,109 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 对比独立栈/共享栈协程: 每个空闲(挂起)协程占用的内存, 以及大量协程轮流yield时的切换开销
+// 用法: shared_stack_bench [协程数...], 默认 10000 1000000 10000000
+// 独立栈每个协程单独mmap一块栈, 超过vm.max_map_count(默认65530)后无法创建, 只测较小的规模.
+
+static const long kMaxPrivateTasks = 50000;
+
+// 常驻内存(KB)
+long RssKB()
+{
+    long pages = 0, rss = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    if (fscanf(f, "%ld %ld", &pages, &rss) != 2) rss = 0;
+    fclose(f);
+    return rss * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// 每个协程在栈上用掉一些空间后挂起, 模拟常见的空闲协程
+static void work(co_wait_group & ready, co_wait_group & start, co_wait_group & done, int yields)
+{
+    char buf[256];
+    for (size_t i = 0; i < sizeof(buf); ++i)
+        buf[i] = (char)i;
+
+    ready.done();
+    start.wait();
+
+    for (int i = 0; i < yields; ++i)
+        co_yield;
+
+    if (buf[sizeof(buf) - 1] != (char)(sizeof(buf) - 1))
+        abort();
+    done.done();
+}
+
+void bench(bool shared, long n, int yields)
+{
+    O("---------- " << (shared ? "shared stack" : "private stack") << ": tasks=" << n << " yields=" << yields << " ----------");
+    if (!shared && n > kMaxPrivateTasks) {
+        O("skipped: one mapping per stack, exceeds vm.max_map_count");
+        return ;
+    }
+
+    co_wait_group ready, start, done;
+    ready.add(n);
+    start.add(1);
+    done.add(n);
+
+    long rss0 = RssKB();
+    {
+        Timer t;
+        for (long i = 0; i < n; ++i) {
+            if (shared)
+                go co_shared_stack [&]{ work(ready, start, done, yields); };
+            else
+                go [&]{ work(ready, start, done, yields); };
+        }
+        ready.wait();
+        O("create and park " << n << " tasks:");
+    }
+    long rss1 = RssKB();
+    O("Memory per idle task: " << (rss1 - rss0) * 1024 / n << " bytes (rss +" << (rss1 - rss0) / 1024 << " MB)");
+
+    {
+        Bench b;
+        start.done();
+        done.wait();
+        b.add(n * yields);
+    }
+    while (!co_sched.IsEmpty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<long> counts;
+    for (int i = 1; i < argc; ++i)
+        counts.push_back(atol(argv[i]));
+    if (counts.empty())
+        counts = {10000, 1000000, 10000000};
+
+    // 单个P, 切换开销不受偷协程影响
+    std::thread([]{ co_sched.Start(2); }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (long n : counts) {
+        bench(false, n, 10);
+        bench(true, n, 10);
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 大量协程同时co_sleep: 统计唤醒延迟(实际醒来时间 - 期望醒来时间)和睡眠期间的CPU占用
+static long cpuUs()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000L
+        + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+void benchSleep(int tasks, int minMs, int maxMs)
+{
+    O("---------- " << tasks << " coroutines co_sleep(" << minMs << "~" << maxMs << "ms) ----------");
+    vector<int> lateUs(tasks);
+    co_wait_group wg;
+    wg.add(tasks);
+
+    long cpu0;
+    steady_clock::time_point wall0;
+    {
+        Bench b;
+        for (int i = 0; i < tasks; ++i) {
+            int ms = minMs + i % (maxMs - minMs + 1);
+            go co_stack(16 * 1024) [=, &wg, &lateUs]{
+                auto expect = steady_clock::now() + milliseconds(ms);
+                co_sleep(ms);
+                lateUs[i] = (int)duration_cast<microseconds>(steady_clock::now() - expect).count();
+                wg.done();
+            };
+        }
+        b.add(tasks);
+        O("spawned");
+        cpu0 = cpuUs();
+        wall0 = steady_clock::now();
+    }
+
+    wg.wait();
+    long cpu = cpuUs() - cpu0;
+    long wall = duration_cast<microseconds>(steady_clock::now() - wall0).count();
+    O("Sleep phase: wall " << wall / 1000 << " ms, cpu " << cpu / 1000 << " ms ("
+            << std::setprecision(3) << 100.0 * cpu / std::max(wall, 1L) << "% of one core)");
+
+    std::sort(lateUs.begin(), lateUs.end());
+    O("Wake late: min " << lateUs.front() << " us, p50 " << lateUs[tasks / 2]
+            << " us, p99 " << lateUs[(long)tasks * 99 / 100] << " us, max " << lateUs.back() << " us");
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int tasks = argc > 2 ? atoi(argv[2]) : 1000000;
+    co_sched.Start(threads);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    benchSleep(1000, 10, 10);
+    benchSleep(tasks, 1000, 2000);
+    return 0;
+}
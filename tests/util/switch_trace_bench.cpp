@@ -0,0 +1,73 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 对比调度跟踪关闭/开启时的切换开销
+// 单个P上跑一组协程互相yield, Per op即为一次切换的耗时
+void benchYield(int tasks, int yields)
+{
+    O("---------- yield: trace=" << co::SwitchTraceEnabled() << " tasks=" << tasks << " yields=" << yields << " ----------");
+    co_wait_group wg;
+    wg.add(tasks);
+    {
+        Bench b;
+        for (int i = 0; i < tasks; ++i)
+            go [&]{
+                for (int j = 0; j < yields; ++j)
+                    co_yield;
+                wg.done();
+            };
+        wg.wait();
+        b.add((long)tasks * yields);
+    }
+}
+
+void benchSleep(int tasks)
+{
+    O("---------- sleep: trace=" << co::SwitchTraceEnabled() << " tasks=" << tasks << " ----------");
+    co_wait_group wg;
+    wg.add(tasks);
+    {
+        Bench b;
+        for (int i = 0; i < tasks; ++i)
+            go [&]{
+                co_sleep(1);
+                wg.done();
+            };
+        wg.wait();
+        b.add(tasks);
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "/dev/null";
+    co_sched.Start(2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (bool on : {false, true, false, true}) {
+        co::SwitchTraceEnable(on);
+        benchYield(10, 200000);
+        benchSleep(100000);
+    }
+    co::SwitchTraceEnable(false);
+
+    {
+        O("---------- export to " << path << " ----------");
+        Timer t;
+        FILE* fp = fopen(path, "w");
+        O("events: " << co::SwitchTraceExport(fp));
+        fclose(fp);
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+
+// 超时负载: 每个请求派生kSubTasks个子协程, 每个子协程反复"计算一段 -> 等待下游(睡眠)",
+// 总耗时远超请求的期限. 请求在期限到达时放弃等待:
+//   detach: 旧的go写法, 无法取消, 子协程继续跑完, 白白消耗CPU
+//   cancel: 子协程放进TaskGroup, 期限到达时cancel, 子协程在下一个取消点退出
+// 输出子协程实际执行的计算段数、进程CPU时间, 以及全部协程退出所需的时间.
+// 用法: task_group_bench [请求数] [期限ms], 默认200, 5ms
+
+static const int kSubTasks = 4;
+static const int kSlices = 200;          // 每个子协程的计算段数
+static const int kSliceUs = 50;          // 每段计算时长
+
+static std::atomic<long> gSlices{0};
+static volatile long gSink = 0;
+
+static double cpuSeconds()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static void slice()
+{
+    auto end = steady_clock::now() + microseconds(kSliceUs);
+    long s = 0;
+    while (steady_clock::now() < end)
+        s += s * 31 + 7;
+    gSink = s;
+    ++gSlices;
+}
+
+static void subTask()
+{
+    for (int i = 0; i < kSlices; ++i) {
+        slice();
+        co_sleep(1);        // 等待下游
+    }
+}
+
+void bench(bool cancel, int requests, int deadlineMs)
+{
+    O("---------- " << (cancel ? "cancel (TaskGroup)" : "detach (go)") << ": requests=" << requests
+            << " subtasks=" << kSubTasks << " deadline=" << deadlineMs << "ms ----------");
+    gSlices = 0;
+    double cpu0 = cpuSeconds();
+    auto t0 = steady_clock::now();
+
+    co_wait_group handled;
+    handled.add(requests);
+    for (int r = 0; r < requests; ++r) {
+        go [&, cancel]{
+            if (cancel) {
+                co::TaskGroup group;
+                for (int i = 0; i < kSubTasks; ++i)
+                    group.spawn(subTask);
+                if (!group.wait_for(milliseconds(deadlineMs)))
+                    group.cancel();
+                // 析构时等待子协程退出
+            } else {
+                co_chan<int> results(kSubTasks);
+                for (int i = 0; i < kSubTasks; ++i)
+                    go [results]{ subTask(); results << 1; };
+                auto deadline = co::FastSteadyClock::now() + milliseconds(deadlineMs);
+                for (int i = 0; i < kSubTasks; ++i)
+                    if (!results.TimedPop(nullptr, deadline))
+                        break;
+            }
+            handled.done();
+        };
+    }
+    handled.wait();
+    auto handledMs = duration_cast<milliseconds>(steady_clock::now() - t0).count();
+
+    while (!co_sched.IsEmpty())
+        std::this_thread::sleep_for(milliseconds(1));
+    auto drainedMs = duration_cast<milliseconds>(steady_clock::now() - t0).count();
+
+    long full = (long)requests * kSubTasks * kSlices;
+    O("all requests answered: " << handledMs << " ms");
+    O("all coroutines exited: " << drainedMs << " ms");
+    O("slices executed: " << gSlices << " / " << full << " (" << std::setprecision(3) << 100.0 * gSlices / full << "%)");
+    O("cpu: " << std::setprecision(3) << cpuSeconds() - cpu0 << " s");
+}
+
+int main(int argc, char** argv)
+{
+    int requests = argc > 1 ? atoi(argv[1]) : 200;
+    int deadlineMs = argc > 2 ? atoi(argv[2]) : 5;
+
+    std::thread([]{ co_sched.Start(4); }).detach();
+    std::this_thread::sleep_for(milliseconds(100));
+
+    for (int i = 0; i < 2; ++i) {
+        bench(false, requests, deadlineMs);
+        bench(true, requests, deadlineMs);
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "co/coroutine.h"
+#include "task/Task.h"
+#include "task/TaskRef.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+volatile uint64_t sink;
+
+// 乱序创建n个任务(不执行, 栈只分配不使用), 工作集大于cache
+std::vector<co::Task*> makeTasks(int n)
+{
+    std::vector<co::Task*> tasks;
+    for (int i = 0; i < n; ++i)
+        tasks.push_back(new co::Task([]{}, 1024));
+    std::shuffle(tasks.begin(), tasks.end(), std::mt19937(1));
+    return tasks;
+}
+
+ALWAYS_INLINE uint64_t touchHot(co::Task* tk)
+{
+    return (uint64_t)tk->state_ + (uintptr_t)tk->proc_ + tk->suspendId_.load(std::memory_order_relaxed) + tk->readyNs_;
+}
+
+// 沿队列链表遍历, 访问调度时用到的字段(状态, 所属P, 挂起ID, 就绪时间)
+void benchWalk(std::vector<co::Task*> const& tasks, int rounds)
+{
+    O("---------- run-queue walk: sizeof(Task)=" << sizeof(co::Task) << " tasks=" << tasks.size() << " rounds=" << rounds << " ----------");
+    co::TSQueue<co::Task, false> queue;
+    for (co::Task* tk : tasks)
+        queue.push(tk);
+
+    {
+        Bench b;
+        uint64_t sum = 0;
+        for (int r = 0; r < rounds; ++r) {
+            co::Task* tk = nullptr;
+            for (queue.front(tk); tk; tk = (co::Task*)tk->next)
+                sum += touchHot(tk);
+        }
+        sink = sum;
+        b.add((long)tasks.size() * rounds);
+    }
+
+    while (queue.pop()) ;
+}
+
+// 按指针数组扫描(访存互不依赖, 耗时取决于每个任务访问的cache line数)
+void benchScan(std::vector<co::Task*> const& tasks, int rounds)
+{
+    O("---------- scan hot fields: tasks=" << tasks.size() << " rounds=" << rounds << " ----------");
+    Bench b;
+    uint64_t sum = 0;
+    for (int r = 0; r < rounds; ++r)
+        for (co::Task* tk : tasks)
+            sum += touchHot(tk);
+    sink = sum;
+    b.add((long)tasks.size() * rounds);
+}
+
+void benchTaskRef(std::vector<co::Task*> const& tasks, int rounds)
+{
+    O("---------- scan TaskRef: tasks=" << tasks.size() << " rounds=" << rounds << " ----------");
+    Bench b;
+    uint64_t sum = 0;
+    for (int r = 0; r < rounds; ++r)
+        for (co::Task* tk : tasks)
+            sum += (uint64_t)co::TaskRefDebugInfo(tk).size() + (uint64_t)co::TaskRefLocation(tk).lineno_;
+    sink = sum;
+    b.add((long)tasks.size() * rounds);
+}
+
+void benchYield(int tasks, int yields)
+{
+    O("---------- yield: tasks=" << tasks << " yields=" << yields << " ----------");
+    co_wait_group wg;
+    wg.add(tasks);
+    {
+        Bench b;
+        for (int i = 0; i < tasks; ++i)
+            go [&]{
+                for (int j = 0; j < yields; ++j)
+                    co_yield;
+                wg.done();
+            };
+        wg.wait();
+        b.add((long)tasks * yields);
+    }
+}
+
+int main()
+{
+    std::thread([]{ co_sched.Start(2); }).detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<co::Task*> tasks = makeTasks(100000);
+    benchWalk(tasks, 20);
+    benchScan(tasks, 20);
+    benchTaskRef(tasks, 20);
+    for (co::Task* tk : tasks)
+        tk->DecrementRef();
+
+    benchYield(1, 2000000);
+    benchYield(10000, 200);
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include "co/coroutine.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 对比跟踪关闭/开启时的创建和切换吞吐.
+// 分别以-DLIBGO_TRACE_LEVEL=0/1/2编译, 关闭时的数据应当一致.
+void benchSpawn(int n)
+{
+    O("---------- spawn: debug=" << std::hex << co_opt.debug.load() << std::dec << " n=" << n << " ----------");
+    std::atomic<int> done{0};
+    {
+        Bench b;
+        for (int i = 0; i < n; ++i)
+            go [&]{ ++done; };
+        while (done < n)
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        b.add(n);
+    }
+}
+
+void benchYield(int tasks, int yields)
+{
+    O("---------- yield: debug=" << std::hex << co_opt.debug.load() << std::dec << " tasks=" << tasks << " yields=" << yields << " ----------");
+    co_wait_group wg;
+    wg.add(tasks);
+    {
+        Bench b;
+        for (int i = 0; i < tasks; ++i)
+            go [&]{
+                for (int j = 0; j < yields; ++j)
+                    co_yield;
+                wg.done();
+            };
+        wg.wait();
+        b.add((long)tasks * yields);
+    }
+}
+
+void benchDebugPrint(int n)
+{
+    O("---------- DebugPrint: debug=" << std::hex << co_opt.debug.load() << std::dec << " n=" << n << " ----------");
+    Bench b;
+    for (int i = 0; i < n; ++i)
+        DebugPrint(co::dbg_task, "bench %d", i);
+    b.add(n);
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    co_sched.Start(threads);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    O("LIBGO_TRACE_LEVEL=" << LIBGO_TRACE_LEVEL);
+
+    co_opt.debug = co::dbg_none;
+    benchSpawn(200000);
+    benchYield(100, 20000);
+    benchDebugPrint(100000000);
+
+    co_opt.debug = co::dbg_all;
+    benchSpawn(200000);
+    benchYield(100, 20000);
+    benchDebugPrint(1000000);
+    co_opt.debug = co::dbg_none;
+
+    FILE* fp = fopen("/dev/null", "w");
+    {
+        O("---------- TraceDump ----------");
+        Timer t;
+        O("records: " << co::TraceDump(fp));
+    }
+    fclose(fp);
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include "co/coroutine.h"
+#include "netio/IoUring.h"
+using namespace std;
+using namespace std::chrono;
+
+#define OUT(x) cout << #x << " = " << x << endl
+#define O(x) cout << x << endl
+
+struct Timer { Timer() : tp(system_clock::now()) {} virtual ~Timer() { auto dur = system_clock::now() - tp; O("Cost " << duration_cast<milliseconds>(dur).count() << " ms"); } system_clock::time_point tp; };
+struct Bench : public Timer { Bench() : val(0) {} virtual ~Bench() { auto dur = system_clock::now() - tp; O("Per op: " << duration_cast<nanoseconds>(dur).count() / std::max(val, 1L) << " ns"); auto perf = (double)val / std::max<long>(duration_cast<milliseconds>(dur).count(), 1) / 10; if (perf < 1) O("Performance: " << std::setprecision(3) << perf << " w/s"); else O("Performance: " << perf << " w/s"); } Bench& operator++() { ++val; return *this; } Bench& operator++(int) { ++val; return *this; } Bench& add(long v) { val += v; return *this; } long val; };
+
+// 对比三种模式:
+//   blocking: 普通系统调用, 文件读写阻塞所在线程
+//   epoll:    非阻塞socket + netpoller (文件没有就绪通知, 该模式只用于socket)
+//   io_uring: co::read/co::write, 每轮调度批量提交
+static const int cBlockSize = 4096;
+static const int cMsgSize = 64;
+
+static bool uringAvailable()
+{
+    std::atomic<int> res{-1};
+    go [&]{ res = co::IoUring::Current() ? 1 : 0; };
+    while (res < 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return res == 1;
+}
+
+static int makeFile(const char* path, int blocks)
+{
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) return -1;
+    unlink(path);
+    vector<char> buf(cBlockSize, 'x');
+    for (int i = 0; i < blocks; ++i)
+        if (::write(fd, buf.data(), buf.size()) != (ssize_t)buf.size())
+            return -1;
+    return fd;
+}
+
+// 多个协程并发按块随机读同一个文件
+void benchFileRead(const char* mode, bool uring, int fd, int blocks, int conc, int reads)
+{
+    O("---------- file read(" << mode << "): concurrency=" << conc << " reads=" << reads << " ----------");
+    co_opt.enable_io_uring = uring;
+    co_wait_group wg;
+    wg.add(conc);
+    {
+        Bench b;
+        for (int i = 0; i < conc; ++i) {
+            go [=, &wg]{
+                char buf[cBlockSize];
+                unsigned seed = i;
+                for (int r = 0; r < reads; ++r) {
+                    off_t off = (off_t)(rand_r(&seed) % blocks) * cBlockSize;
+                    if (co::read(fd, buf, sizeof(buf), off) != (ssize_t)sizeof(buf)) {
+                        O("read failed, errno=" << errno);
+                        break;
+                    }
+                }
+                wg.done();
+            };
+        }
+        wg.wait();
+        b.add((long)conc * reads);
+    }
+}
+
+static bool ioFullEpoll(int fd, char* buf, size_t n, bool isRead)
+{
+    size_t done = 0;
+    while (done < n) {
+        ssize_t res = isRead ? ::read(fd, buf + done, n - done) : ::write(fd, buf + done, n - done);
+        if (res > 0) {
+            done += res;
+            continue;
+        }
+
+        if (res == 0 || errno != EAGAIN)
+            return false;
+
+        if (co::NetPoller::WaitFd(fd, isRead ? EPOLLIN : EPOLLOUT) < 0)
+            return false;
+    }
+    return true;
+}
+
+static bool ioFullCo(int fd, char* buf, size_t n, bool isRead)
+{
+    size_t done = 0;
+    while (done < n) {
+        ssize_t res = isRead ? co::read(fd, buf + done, n - done) : co::write(fd, buf + done, n - done);
+        if (res <= 0)
+            return false;
+        done += res;
+    }
+    return true;
+}
+
+// socketpair上一问一答的echo
+void benchSocket(const char* mode, int pairs, int rounds)
+{
+    O("---------- socket echo(" << mode << "): pairs=" << pairs << " rounds=" << rounds << " ----------");
+    bool threads = mode[0] == 'b';
+    bool epoll = mode[0] == 'e';
+    co_opt.enable_io_uring = !threads && !epoll;
+    auto io = epoll ? ioFullEpoll : ioFullCo;
+
+    vector<int> fds(pairs * 2);
+    for (int i = 0; i < pairs; ++i) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, &fds[i * 2]) < 0) {
+            O("socketpair failed, errno=" << errno);
+            return ;
+        }
+        if (epoll) {
+            fcntl(fds[i * 2], F_SETFL, O_NONBLOCK);
+            fcntl(fds[i * 2 + 1], F_SETFL, O_NONBLOCK);
+        }
+    }
+
+    auto server = [=](int fd) {
+        char buf[cMsgSize];
+        while (io(fd, buf, sizeof(buf), true))
+            if (!io(fd, buf, sizeof(buf), false))
+                break;
+    };
+    auto client = [=](int fd) {
+        char buf[cMsgSize] = {};
+        for (int r = 0; r < rounds; ++r)
+            if (!io(fd, buf, sizeof(buf), false) || !io(fd, buf, sizeof(buf), true))
+                break;
+        shutdown(fd, SHUT_WR);
+    };
+
+    {
+        Bench b;
+        if (threads) {
+            vector<std::thread> ts;
+            for (int i = 0; i < pairs; ++i) {
+                ts.emplace_back(server, fds[i * 2]);
+                ts.emplace_back(client, fds[i * 2 + 1]);
+            }
+            for (auto & t : ts)
+                t.join();
+        } else {
+            co_wait_group wg;
+            wg.add(pairs * 2);
+            for (int i = 0; i < pairs; ++i) {
+                int sfd = fds[i * 2], cfd = fds[i * 2 + 1];
+                go [=, &wg]{ server(sfd); wg.done(); };
+                go [=, &wg]{ client(cfd); wg.done(); };
+            }
+            wg.wait();
+        }
+        b.add((long)pairs * rounds);
+    }
+
+    for (int fd : fds)
+        close(fd);
+}
+
+int main(int argc, char** argv) {
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    co_sched.Start(threads);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    bool uring = uringAvailable();
+    if (!uring)
+        O("io_uring not available, skip io_uring cases");
+
+    const int blocks = 16 * 1024;   // 64MB
+    int fd = makeFile("./uring_bench.tmp", blocks);
+    if (fd < 0) {
+        O("create file failed, errno=" << errno);
+        return 1;
+    }
+
+    benchFileRead("blocking", false, fd, blocks, 64, 2000);
+    if (uring)
+        benchFileRead("io_uring", true, fd, blocks, 64, 2000);
+    close(fd);
+
+    benchSocket("blocking", 16, 2000);
+    benchSocket("epoll", 16, 2000);
+    if (uring)
+        benchSocket("io_uring", 16, 2000);
+    benchSocket("epoll", 1000, 100);
+    if (uring)
+        benchSocket("io_uring", 1000, 100);
+    return 0;
+}